@@ -1,10 +1,24 @@
 #include "libflipper.h"
+#include "adc.h"
 
-enum { _adc_configure };
+enum {
+    _adc_configure,
+    _adc_stream_start,
+    _adc_stream_stop,
+    _adc_stream_read,
+    _adc_stream_dropped,
+    _adc_stream_period
+};
 
 int adc_configure(void);
+int adc_stream_start(uint32_t hz, uint32_t sequence, uint8_t length);
+int adc_stream_stop(void);
+uint32_t adc_stream_read(void *dst, uint32_t count);
+uint32_t adc_stream_dropped(void);
+uint32_t adc_stream_period(void);
 
-void *adc_interface[] = { &adc_configure };
+void *adc_interface[] = { &adc_configure,   &adc_stream_start,   &adc_stream_stop,
+                          &adc_stream_read, &adc_stream_dropped, &adc_stream_period };
 
 LF_MODULE(adc, "adc", adc_interface);
 
@@ -13,3 +27,35 @@ LF_WEAK int adc_configure(void) {
     lf_invoke(lf_get_selected(), "adc", _adc_configure, lf_int_t, &retval, NULL);
     return (int)retval;
 }
+
+LF_WEAK int adc_stream_start(uint32_t hz, uint32_t sequence, uint8_t length) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "adc", _adc_stream_start, lf_int_t, &retval,
+              lf_args(lf_infer(hz), lf_infer(sequence), lf_infer(length)));
+    return (int)retval;
+}
+
+LF_WEAK int adc_stream_stop(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "adc", _adc_stream_stop, lf_int_t, &retval, NULL);
+    return (int)retval;
+}
+
+LF_WEAK uint32_t adc_stream_read(void *dst, uint32_t count) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "adc", _adc_stream_read, lf_uint32_t, &retval,
+              lf_args(lf_ptr(dst), lf_infer(count)));
+    return (uint32_t)retval;
+}
+
+LF_WEAK uint32_t adc_stream_dropped(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "adc", _adc_stream_dropped, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
+
+LF_WEAK uint32_t adc_stream_period(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "adc", _adc_stream_period, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
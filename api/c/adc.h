@@ -1,7 +1,35 @@
 #ifndef __adc_h__
 #define __adc_h__
 
+/* The number of samples a streamed block holds. */
+#define ADC_BLOCK_SAMPLES 256
+/* The most channels a stream's sequence converts on each trigger. */
+#define ADC_SEQUENCE_MAX 8
+
+/* Set in a block's flags if conversions were lost between it and the block before it. */
+#define ADC_BLOCK_GAP (1 << 0)
+
+/* The header of a streamed block. It is followed by ADC_BLOCK_SAMPLES samples, of which 'count' are valid. */
+struct _adc_block {
+    /* The index of the block's first sample among all of those converted since the stream started. */
+    uint32_t first;
+    /* The cycle counter when the block was filled. */
+    uint32_t cycles;
+    /* The number of samples in the block, a whole number of sequences. */
+    uint16_t count;
+    /* ADC_BLOCK_GAP, if conversions were lost before the block. */
+    uint16_t flags;
+} __attribute__((packed));
+
+/* The size of a streamed block, including its header, as 'adc_stream_read' writes it. */
+#define ADC_BLOCK_SIZE (sizeof(struct _adc_block) + ADC_BLOCK_SAMPLES * sizeof(uint16_t))
+
 /* Declare the prototypes for all of the functions within this module. */
 int adc_configure(void);
+int adc_stream_start(uint32_t hz, uint32_t sequence, uint8_t length);
+int adc_stream_stop(void);
+uint32_t adc_stream_read(void *dst, uint32_t count);
+uint32_t adc_stream_dropped(void);
+uint32_t adc_stream_period(void);
 
 #endif
@@ -0,0 +1,31 @@
+#include "libflipper.h"
+#include "devlog.h"
+
+enum { _devlog_configure, _devlog_read, _devlog_dropped };
+
+int devlog_configure(void);
+uint32_t devlog_read(void *dst, uint32_t size);
+uint32_t devlog_dropped(void);
+
+void *devlog_interface[] = { &devlog_configure, &devlog_read, &devlog_dropped };
+
+LF_MODULE(devlog, "devlog", devlog_interface);
+
+LF_WEAK int devlog_configure(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "devlog", _devlog_configure, lf_int_t, &retval, NULL);
+    return (int)retval;
+}
+
+LF_WEAK uint32_t devlog_read(void *dst, uint32_t size) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "devlog", _devlog_read, lf_uint32_t, &retval,
+              lf_args(lf_ptr(dst), lf_infer(size)));
+    return (uint32_t)retval;
+}
+
+LF_WEAK uint32_t devlog_dropped(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "devlog", _devlog_dropped, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
@@ -0,0 +1,25 @@
+#ifndef __devlog_h__
+#define __devlog_h__
+
+/* The header of a record in the device log. It is followed by 'length' bytes of text. */
+struct _devlog_record {
+    /* The cycle counter when the text was written. */
+    uint32_t cycles;
+    /* The PID of the task that wrote the text, or UINT8_MAX if no task was running. */
+    uint8_t pid;
+    /* The number of bytes of text that follow. */
+    uint8_t length;
+} __attribute__((packed));
+
+/* The most text a single record holds. Longer writes are split across records. */
+#define DEVLOG_TEXT_MAX 120
+
+/* Declare the prototypes for all of the functions within this module. */
+int devlog_configure(void);
+uint32_t devlog_read(void *dst, uint32_t size);
+uint32_t devlog_dropped(void);
+
+/* Appends text to the log without blocking. Only available on the device. */
+uint32_t devlog_write(const void *text, uint32_t length);
+
+#endif
@@ -0,0 +1,38 @@
+#include "libflipper.h"
+#include "fmrtrace.h"
+
+enum { _fmrtrace_configure, _fmrtrace_enable, _fmrtrace_read, _fmrtrace_dropped };
+
+int fmrtrace_configure(void);
+int fmrtrace_enable(uint8_t enable);
+uint32_t fmrtrace_read(struct _fmrtrace_record *dst, uint32_t count);
+uint32_t fmrtrace_dropped(void);
+
+void *fmrtrace_interface[] = { &fmrtrace_configure, &fmrtrace_enable, &fmrtrace_read, &fmrtrace_dropped };
+
+LF_MODULE(fmrtrace, "fmrtrace", fmrtrace_interface);
+
+LF_WEAK int fmrtrace_configure(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "fmrtrace", _fmrtrace_configure, lf_int_t, &retval, NULL);
+    return (int)retval;
+}
+
+LF_WEAK int fmrtrace_enable(uint8_t enable) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "fmrtrace", _fmrtrace_enable, lf_int_t, &retval, lf_args(lf_infer(enable)));
+    return (int)retval;
+}
+
+LF_WEAK uint32_t fmrtrace_read(struct _fmrtrace_record *dst, uint32_t count) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "fmrtrace", _fmrtrace_read, lf_uint32_t, &retval,
+              lf_args(lf_ptr(dst), lf_infer(count)));
+    return (uint32_t)retval;
+}
+
+LF_WEAK uint32_t fmrtrace_dropped(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "fmrtrace", _fmrtrace_dropped, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
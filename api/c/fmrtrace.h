@@ -0,0 +1,25 @@
+#ifndef __fmrtrace_h__
+#define __fmrtrace_h__
+
+/* The times at which the device reached each phase of handling a packet. */
+struct _fmrtrace_record {
+    /* The number of packets traced before this one since tracing was enabled. */
+    uint32_t seq;
+    /* The packet's class. */
+    uint8_t type;
+    /* The module and function called, if the packet was a call. */
+    uint8_t module;
+    uint8_t function;
+    /* A bit for each phase that was reached, as enumerated in fmr.h. */
+    uint8_t phases;
+    /* The cycle counter at each phase. */
+    uint32_t cycles[fmr_phase_count];
+} __attribute__((packed));
+
+/* Declare the prototypes for all of the functions within this module. */
+int fmrtrace_configure(void);
+int fmrtrace_enable(uint8_t enable);
+uint32_t fmrtrace_read(struct _fmrtrace_record *dst, uint32_t count);
+uint32_t fmrtrace_dropped(void);
+
+#endif
@@ -0,0 +1,44 @@
+#include "libflipper.h"
+#include "prof.h"
+
+enum { _prof_configure, _prof_start, _prof_stop, _prof_read, _prof_dropped };
+
+int prof_configure(void);
+int prof_start(uint32_t hz);
+int prof_stop(void);
+uint32_t prof_read(struct _prof_sample *dst, uint32_t count);
+uint32_t prof_dropped(void);
+
+void *prof_interface[] = { &prof_configure, &prof_start, &prof_stop, &prof_read, &prof_dropped };
+
+LF_MODULE(prof, "prof", prof_interface);
+
+LF_WEAK int prof_configure(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "prof", _prof_configure, lf_int_t, &retval, NULL);
+    return (int)retval;
+}
+
+LF_WEAK int prof_start(uint32_t hz) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "prof", _prof_start, lf_int_t, &retval, lf_args(lf_infer(hz)));
+    return (int)retval;
+}
+
+LF_WEAK int prof_stop(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "prof", _prof_stop, lf_int_t, &retval, NULL);
+    return (int)retval;
+}
+
+LF_WEAK uint32_t prof_read(struct _prof_sample *dst, uint32_t count) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "prof", _prof_read, lf_uint32_t, &retval, lf_args(lf_ptr(dst), lf_infer(count)));
+    return (uint32_t)retval;
+}
+
+LF_WEAK uint32_t prof_dropped(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "prof", _prof_dropped, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
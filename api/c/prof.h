@@ -0,0 +1,24 @@
+#ifndef __prof_h__
+#define __prof_h__
+
+/* A sample taken by the profiler. */
+struct _prof_sample {
+    /* The address of the instruction that was interrupted. */
+    uint32_t pc;
+    /* The link register of the interrupted code. */
+    uint32_t lr;
+    /* The PID of the task that was running. */
+    uint8_t pid;
+    /* The exception being handled when the sample was taken, or zero in thread mode. */
+    uint8_t exception;
+    uint16_t reserved;
+} __attribute__((packed));
+
+/* Declare the prototypes for all of the functions within this module. */
+int prof_configure(void);
+int prof_start(uint32_t hz);
+int prof_stop(void);
+uint32_t prof_read(struct _prof_sample *dst, uint32_t count);
+uint32_t prof_dropped(void);
+
+#endif
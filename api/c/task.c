@@ -0,0 +1,44 @@
+#include "libflipper.h"
+#include "task.h"
+
+enum { _task_configure, _task_count, _task_stats, _task_switches, _task_clock };
+
+int task_configure(void);
+uint32_t task_count(void);
+uint32_t task_stats(struct _task_stats *dst, uint32_t count);
+uint32_t task_switches(void);
+uint32_t task_clock(void);
+
+void *task_interface[] = { &task_configure, &task_count, &task_stats, &task_switches, &task_clock };
+
+LF_MODULE(task, "task", task_interface);
+
+LF_WEAK int task_configure(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "task", _task_configure, lf_int_t, &retval, NULL);
+    return (int)retval;
+}
+
+LF_WEAK uint32_t task_count(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "task", _task_count, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
+
+LF_WEAK uint32_t task_stats(struct _task_stats *dst, uint32_t count) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "task", _task_stats, lf_uint32_t, &retval, lf_args(lf_ptr(dst), lf_infer(count)));
+    return (uint32_t)retval;
+}
+
+LF_WEAK uint32_t task_switches(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "task", _task_switches, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
+
+LF_WEAK uint32_t task_clock(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "task", _task_clock, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
@@ -0,0 +1,30 @@
+#ifndef __task_h__
+#define __task_h__
+
+/* The run-time statistics of a task. */
+struct _task_stats {
+    /* The task's PID. */
+    uint32_t pid;
+    /* The task's status, as enumerated by 'os_task_status'. */
+    uint8_t status;
+    /* Nonzero if the task has been found to have overflowed its stack. */
+    uint8_t overflowed;
+    uint16_t reserved;
+    /* The size of the task's stack in bytes. */
+    uint32_t stack_size;
+    /* The most of its stack the task has used, in bytes. */
+    uint32_t stack_used;
+    /* The number of times the task has been switched in. */
+    uint32_t switches;
+    /* The cycles the task has spent running. */
+    uint64_t runtime;
+} __attribute__((packed));
+
+/* Declare the prototypes for all of the functions within this module. */
+int task_configure(void);
+uint32_t task_count(void);
+uint32_t task_stats(struct _task_stats *dst, uint32_t count);
+uint32_t task_switches(void);
+uint32_t task_clock(void);
+
+#endif
@@ -1,18 +1,22 @@
 #include "libflipper.h"
 
-enum { _timer_register, _timer_configure };
+enum { _timer_register, _timer_configure, _timer_start, _timer_cancel, _timer_active, _timer_ticks };
 
 int timer_register(uint32_t ticks, void* callback);
 int timer_configure(void);
+uint32_t timer_start(uint32_t ticks, uint32_t period, void *callback, void *arg);
+int timer_cancel(uint32_t id);
+uint32_t timer_active(void);
+uint32_t timer_ticks(void);
 
-void* timer_interface[] = { &timer_register, &timer_configure };
+void* timer_interface[] = { &timer_register, &timer_configure, &timer_start, &timer_cancel, &timer_active, &timer_ticks };
 
 LF_MODULE(timer, "timer", timer_interface);
 
 LF_WEAK int timer_register(uint32_t ticks, void* callback) {
     lf_return_t retval;
     lf_invoke(lf_get_selected(), "timer", _timer_register, lf_int_t, &retval,
-              lf_args(lf_infer(ticks), lf_infer(callback)));
+              lf_args(lf_infer(ticks), lf_ptr(callback)));
     return (int)retval;
 }
 
@@ -21,3 +25,28 @@ LF_WEAK int timer_configure(void) {
     lf_invoke(lf_get_selected(), "timer", _timer_configure, lf_int_t, &retval, NULL);
     return (int)retval;
 }
+
+LF_WEAK uint32_t timer_start(uint32_t ticks, uint32_t period, void *callback, void *arg) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "timer", _timer_start, lf_uint32_t, &retval,
+              lf_args(lf_infer(ticks), lf_infer(period), lf_ptr(callback), lf_ptr(arg)));
+    return (uint32_t)retval;
+}
+
+LF_WEAK int timer_cancel(uint32_t id) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "timer", _timer_cancel, lf_int_t, &retval, lf_args(lf_infer(id)));
+    return (int)retval;
+}
+
+LF_WEAK uint32_t timer_active(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "timer", _timer_active, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
+
+LF_WEAK uint32_t timer_ticks(void) {
+    lf_return_t retval;
+    lf_invoke(lf_get_selected(), "timer", _timer_ticks, lf_uint32_t, &retval, NULL);
+    return (uint32_t)retval;
+}
@@ -4,5 +4,9 @@
 /* Declare the prototypes for all of the functions within this module. */
 int timer_configure(void);
 int timer_register(uint32_t ticks, void *callback);
+uint32_t timer_start(uint32_t ticks, uint32_t period, void *callback, void *arg);
+int timer_cancel(uint32_t id);
+uint32_t timer_active(void);
+uint32_t timer_ticks(void);
 
 #endif
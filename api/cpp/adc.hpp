@@ -0,0 +1,24 @@
+/* adc.hpp - Typed calls to the functions of the 'adc' module. */
+
+#ifndef __lf_adc_hpp__
+#define __lf_adc_hpp__
+
+#include <flipper/flipper.hpp>
+#include <flipper/adc.h>
+
+namespace flipper::adc {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "adc";
+
+using configure = function<0, int()>;
+using stream_start = function<1, int(uint32_t hz, uint32_t sequence, uint8_t length)>;
+using stream_stop = function<2, int()>;
+using stream_read = function<3, uint32_t(void *dst, uint32_t count)>;
+using stream_dropped = function<4, uint32_t()>;
+using stream_period = function<5, uint32_t()>;
+using clock = function<6, uint32_t()>;
+
+} // namespace flipper::adc
+
+#endif
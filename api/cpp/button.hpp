@@ -0,0 +1,18 @@
+/* button.hpp - Typed calls to the functions of the 'button' module. */
+
+#ifndef __lf_button_hpp__
+#define __lf_button_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::button {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "button";
+
+using read = function<0, uint8_t()>;
+using configure = function<1, int()>;
+
+} // namespace flipper::button
+
+#endif
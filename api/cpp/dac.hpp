@@ -0,0 +1,17 @@
+/* dac.hpp - Typed calls to the functions of the 'dac' module. */
+
+#ifndef __lf_dac_hpp__
+#define __lf_dac_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::dac {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "dac";
+
+using configure = function<0, int()>;
+
+} // namespace flipper::dac
+
+#endif
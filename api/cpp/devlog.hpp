@@ -0,0 +1,21 @@
+/* devlog.hpp - Typed calls to the functions of the 'devlog' module. */
+
+#ifndef __lf_devlog_hpp__
+#define __lf_devlog_hpp__
+
+#include <flipper/flipper.hpp>
+#include <flipper/devlog.h>
+
+namespace flipper::devlog {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "devlog";
+
+using configure = function<0, int()>;
+using read = function<1, uint32_t(void *dst, uint32_t size)>;
+using dropped = function<2, uint32_t()>;
+using clock = function<3, uint32_t()>;
+
+} // namespace flipper::devlog
+
+#endif
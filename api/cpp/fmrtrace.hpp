@@ -0,0 +1,22 @@
+/* fmrtrace.hpp - Typed calls to the functions of the 'fmrtrace' module. */
+
+#ifndef __lf_fmrtrace_hpp__
+#define __lf_fmrtrace_hpp__
+
+#include <flipper/flipper.hpp>
+#include <flipper/fmrtrace.h>
+
+namespace flipper::fmrtrace {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "fmrtrace";
+
+using configure = function<0, int()>;
+using enable = function<1, int(uint8_t enable)>;
+using read = function<2, uint32_t(struct _fmrtrace_record *dst, uint32_t count)>;
+using dropped = function<3, uint32_t()>;
+using clock = function<4, uint32_t()>;
+
+} // namespace flipper::fmrtrace
+
+#endif
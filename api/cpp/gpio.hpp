@@ -0,0 +1,20 @@
+/* gpio.hpp - Typed calls to the functions of the 'gpio' module. */
+
+#ifndef __lf_gpio_hpp__
+#define __lf_gpio_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::gpio {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "gpio";
+
+using read = function<0, uint32_t(uint32_t mask)>;
+using write = function<1, void(uint32_t set, uint32_t clear)>;
+using enable = function<2, void(uint32_t enable, uint32_t disable)>;
+using configure = function<3, int()>;
+
+} // namespace flipper::gpio
+
+#endif
@@ -0,0 +1,21 @@
+/* i2c.hpp - Typed calls to the functions of the 'i2c' module. */
+
+#ifndef __lf_i2c_hpp__
+#define __lf_i2c_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::i2c {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "i2c";
+
+using stop = function<0, void()>;
+using write = function<1, void(uint8_t byte)>;
+using read = function<2, uint8_t()>;
+using configure = function<3, int()>;
+using start_read = function<4, void(uint8_t address, uint8_t length)>;
+
+} // namespace flipper::i2c
+
+#endif
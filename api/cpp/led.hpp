@@ -0,0 +1,18 @@
+/* led.hpp - Typed calls to the functions of the 'led' module. */
+
+#ifndef __lf_led_hpp__
+#define __lf_led_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::led {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "led";
+
+using rgb = function<0, void(uint8_t r, uint8_t g, uint8_t b)>;
+using configure = function<1, int()>;
+
+} // namespace flipper::led
+
+#endif
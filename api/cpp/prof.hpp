@@ -0,0 +1,22 @@
+/* prof.hpp - Typed calls to the functions of the 'prof' module. */
+
+#ifndef __lf_prof_hpp__
+#define __lf_prof_hpp__
+
+#include <flipper/flipper.hpp>
+#include <flipper/prof.h>
+
+namespace flipper::prof {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "prof";
+
+using configure = function<0, int()>;
+using start = function<1, int(uint32_t hz)>;
+using stop = function<2, int()>;
+using read = function<3, uint32_t(struct _prof_sample *dst, uint32_t count)>;
+using dropped = function<4, uint32_t()>;
+
+} // namespace flipper::prof
+
+#endif
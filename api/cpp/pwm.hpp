@@ -0,0 +1,17 @@
+/* pwm.hpp - Typed calls to the functions of the 'pwm' module. */
+
+#ifndef __lf_pwm_hpp__
+#define __lf_pwm_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::pwm {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "pwm";
+
+using configure = function<0, int()>;
+
+} // namespace flipper::pwm
+
+#endif
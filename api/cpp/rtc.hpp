@@ -0,0 +1,17 @@
+/* rtc.hpp - Typed calls to the functions of the 'rtc' module. */
+
+#ifndef __lf_rtc_hpp__
+#define __lf_rtc_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::rtc {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "rtc";
+
+using configure = function<0, int()>;
+
+} // namespace flipper::rtc
+
+#endif
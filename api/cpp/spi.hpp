@@ -0,0 +1,25 @@
+/* spi.hpp - Typed calls to the functions of the 'spi' module. */
+
+#ifndef __lf_spi_hpp__
+#define __lf_spi_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::spi {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "spi";
+
+using read = function<0, int(void *dst, uint32_t length)>;
+using write = function<1, int(void *src, uint32_t length)>;
+using get = function<2, uint8_t()>;
+using put = function<3, void(uint8_t byte)>;
+using end = function<4, void()>;
+using ready = function<5, uint8_t()>;
+using disable = function<6, void()>;
+using enable = function<7, void()>;
+using configure = function<8, int()>;
+
+} // namespace flipper::spi
+
+#endif
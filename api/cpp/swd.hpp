@@ -0,0 +1,17 @@
+/* swd.hpp - Typed calls to the functions of the 'swd' module. */
+
+#ifndef __lf_swd_hpp__
+#define __lf_swd_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::swd {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "swd";
+
+using configure = function<0, int()>;
+
+} // namespace flipper::swd
+
+#endif
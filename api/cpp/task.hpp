@@ -0,0 +1,22 @@
+/* task.hpp - Typed calls to the functions of the 'task' module. */
+
+#ifndef __lf_task_hpp__
+#define __lf_task_hpp__
+
+#include <flipper/flipper.hpp>
+#include <flipper/task.h>
+
+namespace flipper::task {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "task";
+
+using configure = function<0, int()>;
+using count = function<1, uint32_t()>;
+using stats = function<2, uint32_t(struct _task_stats *dst, uint32_t count)>;
+using switches = function<3, uint32_t()>;
+using clock = function<4, uint32_t()>;
+
+} // namespace flipper::task
+
+#endif
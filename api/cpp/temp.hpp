@@ -0,0 +1,17 @@
+/* temp.hpp - Typed calls to the functions of the 'temp' module. */
+
+#ifndef __lf_temp_hpp__
+#define __lf_temp_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::temp {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "temp";
+
+using configure = function<0, int()>;
+
+} // namespace flipper::temp
+
+#endif
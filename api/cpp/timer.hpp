@@ -0,0 +1,22 @@
+/* timer.hpp - Typed calls to the functions of the 'timer' module. */
+
+#ifndef __lf_timer_hpp__
+#define __lf_timer_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::timer {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "timer";
+
+using register_ = function<0, int(uint32_t ticks, void *callback)>;
+using configure = function<1, int()>;
+using start = function<2, uint32_t(uint32_t ticks, uint32_t period, void *callback, void *arg)>;
+using cancel = function<3, int(uint32_t id)>;
+using active = function<4, uint32_t()>;
+using ticks = function<5, uint32_t()>;
+
+} // namespace flipper::timer
+
+#endif
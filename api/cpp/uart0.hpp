@@ -0,0 +1,25 @@
+/* uart0.hpp - Typed calls to the functions of the 'uart0' module. */
+
+#ifndef __lf_uart0_hpp__
+#define __lf_uart0_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::uart0 {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "uart0";
+
+using read = function<0, int(void *destination, uint32_t length)>;
+using write = function<1, int(void *source, uint32_t length)>;
+using get = function<2, uint8_t()>;
+using put = function<3, void(uint8_t byte)>;
+using ready = function<4, int()>;
+using reset = function<5, int()>;
+using setbaud = function<6, int(uint32_t baud)>;
+using configure = function<7, int()>;
+using enable = function<8, void()>;
+
+} // namespace flipper::uart0
+
+#endif
@@ -0,0 +1,24 @@
+/* usart.hpp - Typed calls to the functions of the 'usart' module. */
+
+#ifndef __lf_usart_hpp__
+#define __lf_usart_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::usart {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "usart";
+
+using read = function<0, int(void *dst, uint32_t length)>;
+using write = function<1, int(void *src, uint32_t length)>;
+using get = function<2, uint8_t()>;
+using put = function<3, void(uint8_t byte)>;
+using ready = function<4, int()>;
+using disable = function<5, void()>;
+using enable = function<6, void()>;
+using configure = function<7, int()>;
+
+} // namespace flipper::usart
+
+#endif
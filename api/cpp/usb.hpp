@@ -0,0 +1,17 @@
+/* usb.hpp - Typed calls to the functions of the 'usb' module. */
+
+#ifndef __lf_usb_hpp__
+#define __lf_usb_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::usb {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "usb";
+
+using configure = function<0, int()>;
+
+} // namespace flipper::usb
+
+#endif
@@ -0,0 +1,18 @@
+/* wdt.hpp - Typed calls to the functions of the 'wdt' module. */
+
+#ifndef __lf_wdt_hpp__
+#define __lf_wdt_hpp__
+
+#include <flipper/flipper.hpp>
+
+namespace flipper::wdt {
+
+/* The name the module is loaded under on the device. */
+constexpr const char *name = "wdt";
+
+using fire = function<0, void()>;
+using configure = function<1, int()>;
+
+} // namespace flipper::wdt
+
+#endif
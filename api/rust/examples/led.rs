@@ -2,12 +2,12 @@ extern crate flipper;
 
 use flipper::{
     Flipper,
-    led::Led,
+    FMR_UDP_PORT,
+    led::{Led, LedModule},
 };
 
 fn main() {
-    let flipper = Flipper::attach().expect("should attach to Flipper");
-    flipper.select_u2();
-    let led = Led::new(&flipper);
-    led.rgb(10, 0, 10);
+    let mut flipper = Flipper::attach_network(("localhost", FMR_UDP_PORT)).expect("should attach to Flipper");
+    let mut led = LedModule::bind(&mut flipper).expect("should resolve the led module");
+    led.rgb(10, 0, 10).expect("should set the led");
 }
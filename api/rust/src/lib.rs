@@ -1,13 +1,19 @@
 //! The Rust API for Flipper's common peripherals.
 
-#[macro_use]
 extern crate flipper_core;
+// Lets code generated by `#[flipper_module]` name the core library as `::flipper` from inside this crate
+extern crate flipper_core as flipper;
 
-pub use flipper_core::Flipper;
+pub use flipper_core::{Flipper, FMR_UDP_PORT};
+pub use flipper_core::{Args, Client, LfType, Route};
+pub use flipper_core::{replay, trace};
+pub use flipper_core::{flipper_module, LfArgType, LfPointer, LfReturnable, ModuleHandle, Result};
+#[doc(hidden)]
+pub use flipper_core::__private;
 
-/// The home of macro-generated Flipper module bindings.
+/// The home of attribute-generated Flipper module bindings.
 ///
-/// These modules are thin wrappers around the generated C-like API. Simple Flipper modules that
+/// Each module is described by a trait declaring its functions. Simple Flipper modules that
 /// don't need any manual code written to make them idiomatic to Rust live here. More advanced
 /// Flipper modules with a manually-written Rust api can be found in the `api` module.
 mod sys;
@@ -1,11 +1,31 @@
-flipper_module!(Led, led,
-    0, fn rgb(red: u8, green: u8, blue: u8) -> (),
-    1, fn configure() -> (),
-);
+/// The RGB LED on the board.
+pub mod led {
+    use flipper_core::flipper_module;
 
-flipper_module! (Gpio, gpio,
-    0, fn configure() -> (),
-    1, fn enable(enable: u32, disable: u32) -> (),
-    2, fn write(set: u32, clear: u32) -> (),
-    3, fn read(mask: u32) -> u32,
-);
+    /// The functions of the `led` module, in the order of its interface table.
+    #[flipper_module("led")]
+    pub trait Led {
+        /// Sets the brightness of each of the LED's colors.
+        fn rgb(&mut self, red: u8, green: u8, blue: u8);
+        /// Prepares the LED for use.
+        fn configure(&mut self) -> u32;
+    }
+}
+
+/// The general purpose IO pins, each selected by its bit in a mask.
+pub mod gpio {
+    use flipper_core::flipper_module;
+
+    /// The functions of the `gpio` module, in the order of its interface table.
+    #[flipper_module("gpio")]
+    pub trait Gpio {
+        /// Returns the levels of the pins in `mask`.
+        fn read(&mut self, mask: u32) -> u32;
+        /// Drives the pins in `set` high and those in `clear` low.
+        fn write(&mut self, set: u32, clear: u32);
+        /// Enables the pins in `enable` and disables those in `disable`.
+        fn enable(&mut self, enable: u32, disable: u32);
+        /// Prepares the pins for use.
+        fn configure(&mut self) -> u32;
+    }
+}
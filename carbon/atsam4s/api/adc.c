@@ -1,7 +1,201 @@
 #include "libflipper.h"
 #include "adc.h"
+#include "atsam4s.h"
 #include <adc/adc.h>
 
+/* Conversions are triggered by TIOA of channel 1 of TC0, which the timer module and profiler leave free. */
+#define ADC_TRIGGER_CHANNEL 1
+
+/* The number of blocks in the ring. */
+#define ADC_BLOCKS 16
+
+/* The most conversions per second the ADC is run at. */
+#define ADC_MAX_RATE 500000
+
+/*
+   A ring of blocks. The PDC fills the samples of up to two blocks at a time, the one it is writing and the one queued
+   after it, which 'adc_isr' publishes in turn. 'adc_stream_read' drains the blocks that have been published. When
+   the host falls behind, the PDC is given a scratch block instead, whose samples are counted as dropped.
+*/
+static struct {
+    struct _adc_block headers[ADC_BLOCKS];
+    uint16_t samples[ADC_BLOCKS][ADC_BLOCK_SAMPLES];
+    /* The number of blocks published. Only the interrupt moves it. */
+    volatile uint32_t head;
+    /* The number of blocks read. Only 'adc_stream_read' moves it. */
+    volatile uint32_t tail;
+    /* The number of blocks of the ring given to the PDC and not yet published. They follow 'head', in order. */
+    uint32_t inflight;
+    /* Whether the buffers the PDC is writing and the one queued after it are blocks of the ring, or scratch. */
+    bool filling, queued;
+    /* Whether conversions were lost since the last block published. */
+    bool gap;
+    /* The number of samples in each block, a whole number of sequences. */
+    uint16_t count;
+    /* The number of samples converted into the blocks completed so far. */
+    uint32_t converted;
+    /* The number of blocks written to scratch. */
+    volatile uint32_t dropped;
+} adc_ring;
+
+/* Where the PDC writes when the ring is full. */
+static uint16_t adc_scratch[ADC_BLOCK_SAMPLES];
+
+/* The cycles between triggers of the running stream, or zero if it is stopped. */
+static uint32_t adc_period;
+
 LF_FUNC("adc") int adc_configure(void) {
+    adc_stream_stop();
+    memset(&adc_ring, 0, sizeof(adc_ring));
+    return lf_success;
+}
+
+/* Picks a buffer for the PDC to write next: a block of the ring if the host has left room for one, else scratch. */
+static uint16_t *adc_buffer(bool *ring) {
+    if (adc_ring.head - adc_ring.tail + adc_ring.inflight < ADC_BLOCKS) {
+        *ring = true;
+        return adc_ring.samples[(adc_ring.head + adc_ring.inflight++) % ADC_BLOCKS];
+    }
+    *ring = false;
+    return adc_scratch;
+}
+
+/* Publishes the buffer the PDC filled, if it was a block of the ring, and moves on to the one queued after it. */
+static void adc_complete(uint32_t now) {
+    if (adc_ring.filling) {
+        struct _adc_block *header = &adc_ring.headers[adc_ring.head % ADC_BLOCKS];
+        header->first = adc_ring.converted;
+        header->cycles = now;
+        header->count = adc_ring.count;
+        header->flags = (adc_ring.gap) ? ADC_BLOCK_GAP : 0;
+        adc_ring.gap = false;
+        /* Finish writing the block before handing it to 'adc_stream_read'. */
+        __DMB();
+        adc_ring.head++;
+        adc_ring.inflight--;
+    } else {
+        /* The block went to scratch, so the next one published does not follow on from the last. */
+        adc_ring.dropped++;
+        adc_ring.gap = true;
+    }
+    adc_ring.converted += adc_ring.count;
+    adc_ring.filling = adc_ring.queued;
+    adc_ring.queued = false;
+}
+
+/*
+   Starts converting the channels of 'sequence' 'hz' times per second, discarding any blocks not yet read. The sequence
+   holds 'length' channel numbers, four bits each, converted from the lowest bits up. Each sample is stored with the
+   number of its channel in its top four bits.
+*/
+LF_FUNC("adc") int adc_stream_start(uint32_t hz, uint32_t sequence, uint8_t length) {
+    uint32_t clock = 0, rc = 0;
+
+    lf_assert(length && length <= ADC_SEQUENCE_MAX, E_CONFIGURATION, "invalid sequence length");
+    lf_assert(hz && hz <= ADC_MAX_RATE / length, E_CONFIGURATION, "invalid sampling rate");
+
+    lf_assert(tc_select_clock(hz, &clock, &rc), E_CONFIGURATION, "sampling rate out of range");
+
+    adc_stream_stop();
+    memset(&adc_ring, 0, sizeof(adc_ring));
+    adc_ring.count = (ADC_BLOCK_SAMPLES / length) * length;
+
+    /* Enable the clocks to the ADC and the trigger's channel. */
+    PMC->PMC_PCER0 = (1 << ID_ADC) | (1 << ID_TC1);
+
+    ADC->ADC_CR = ADC_CR_SWRST;
+    /* Run the ADC at MCK / 6, converting the user sequence on each rising edge of TIOA1. */
+    ADC->ADC_MR = ADC_MR_TRGEN | ADC_MR_TRGSEL_ADC_TRIG2 | ADC_MR_PRESCAL(2) | ADC_MR_STARTUP_SUT64 |
+                  ADC_MR_SETTLING_AST3 | ADC_MR_TRACKTIM(3) | ADC_MR_TRANSFER(1) | ADC_MR_USEQ_REG_ORDER;
+    /* Tag each result with its channel. */
+    ADC->ADC_EMR = ADC_EMR_TAG;
+    ADC->ADC_SEQR1 = sequence;
+    /* In sequence mode, the enabled channels select how many entries of the sequence are converted. */
+    ADC->ADC_CHDR = 0xFFFF;
+    ADC->ADC_CHER = (1 << length) - 1;
+
+    /* Give the PDC the first block, and queue the next. */
+    ADC->ADC_RPR = (uintptr_t)adc_buffer(&adc_ring.filling);
+    ADC->ADC_RCR = adc_ring.count;
+    ADC->ADC_RNPR = (uintptr_t)adc_buffer(&adc_ring.queued);
+    ADC->ADC_RNCR = adc_ring.count;
+
+    ADC->ADC_IER = ADC_IER_ENDRX | ADC_IER_RXBUFF;
+    NVIC_ClearPendingIRQ(ADC_IRQn);
+    NVIC_SetPriority(ADC_IRQn, ADC_PRIORITY);
+    NVIC_EnableIRQ(ADC_IRQn);
+    ADC->ADC_PTCR = ADC_PTCR_RXTEN;
+
+    TcChannel *channel = &TC0->TC_CHANNEL[ADC_TRIGGER_CHANNEL];
+    /* Count up to RC, raising TIOA at RC and lowering it halfway through the period. */
+    channel->TC_CMR = ((clock << TC_CMR_TCCLKS_Pos) & TC_CMR_TCCLKS_Msk) | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC |
+                      TC_CMR_ACPA_CLEAR | TC_CMR_ACPC_SET;
+    channel->TC_RA = rc / 2;
+    channel->TC_RC = rc;
+    adc_period = TC_DIVIDER(clock) * rc;
+    channel->TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+
     return lf_success;
+fail:
+    return lf_error;
+}
+
+/* Stops converting. Blocks already published may still be read. */
+LF_FUNC("adc") int adc_stream_stop(void) {
+    TC0->TC_CHANNEL[ADC_TRIGGER_CHANNEL].TC_CCR = TC_CCR_CLKDIS;
+    ADC->ADC_PTCR = ADC_PTCR_RXTDIS;
+    ADC->ADC_IDR = ADC_IDR_ENDRX | ADC_IDR_RXBUFF;
+    NVIC_DisableIRQ(ADC_IRQn);
+    adc_period = 0;
+    return lf_success;
+}
+
+/* Copies published blocks to 'dst' as ADC_BLOCK_SIZE bytes each, at most 'count' of them. Returns the number copied. */
+LF_FUNC("adc") uint32_t adc_stream_read(void *dst, uint32_t count) {
+    uint8_t *out = dst;
+    uint32_t moved = 0;
+    while (moved < count && adc_ring.tail != adc_ring.head) {
+        uint32_t block = adc_ring.tail % ADC_BLOCKS;
+        memcpy(out, &adc_ring.headers[block], sizeof(struct _adc_block));
+        memcpy(out + sizeof(struct _adc_block), adc_ring.samples[block], sizeof(adc_ring.samples[block]));
+        out += ADC_BLOCK_SIZE;
+        moved++;
+        /* Finish copying the block before handing it back to the interrupt. */
+        __DMB();
+        adc_ring.tail++;
+    }
+    return moved;
+}
+
+/* Returns the number of blocks converted while the host had left no room for them. */
+LF_FUNC("adc") uint32_t adc_stream_dropped(void) {
+    return adc_ring.dropped;
+}
+
+/* Returns the cycles between the triggers of the running stream, each of which converts the whole sequence. */
+LF_FUNC("adc") uint32_t adc_stream_period(void) {
+    return adc_period;
+}
+
+void adc_isr(void) {
+    uint32_t now = DWT->CYCCNT;
+    uint32_t status = ADC->ADC_ISR;
+
+    if (status & ADC_ISR_RXBUFF) {
+        /* Both buffers filled before the interrupt was taken, so the PDC stopped and conversions were lost. */
+        adc_complete(now);
+        adc_complete(now);
+        adc_ring.gap = true;
+        /* Restart the PDC on fresh buffers. */
+        ADC->ADC_RPR = (uintptr_t)adc_buffer(&adc_ring.filling);
+        ADC->ADC_RCR = adc_ring.count;
+        ADC->ADC_RNPR = (uintptr_t)adc_buffer(&adc_ring.queued);
+        ADC->ADC_RNCR = adc_ring.count;
+    } else if (status & ADC_ISR_ENDRX) {
+        /* The PDC has moved on to the queued buffer. Publish the one it filled, and queue another. */
+        adc_complete(now);
+        /* Writing the next counter also clears ENDRX. */
+        ADC->ADC_RNPR = (uintptr_t)adc_buffer(&adc_ring.queued);
+        ADC->ADC_RNCR = adc_ring.count;
+    }
 }
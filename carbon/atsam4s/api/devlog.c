@@ -0,0 +1,96 @@
+#include "libflipper.h"
+#include "devlog.h"
+#include "atsam4s.h"
+#include "os/scheduler.h"
+
+extern struct _os_task *os_current_task;
+
+/* The size of the ring in bytes. This must be a power of two. */
+#define DEVLOG_SIZE 4096
+
+/*
+   A ring of records, each a header followed by its text, filled by 'devlog_write' and drained by 'devlog_read'.
+   The indices run freely and are masked on access, so the ring can be filled completely.
+*/
+static struct {
+    uint8_t data[DEVLOG_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+} devlog_ring;
+
+/* Copies 'length' bytes into the ring at 'index', wrapping around its end. */
+static void devlog_put(uint32_t index, const void *src, uint32_t length) {
+    const uint8_t *bytes = src;
+    for (uint32_t i = 0; i < length; i++) devlog_ring.data[(index + i) & (DEVLOG_SIZE - 1)] = bytes[i];
+}
+
+/* Copies 'length' bytes out of the ring at 'index', wrapping around its end. */
+static void devlog_get(uint32_t index, void *dst, uint32_t length) {
+    uint8_t *bytes = dst;
+    for (uint32_t i = 0; i < length; i++) bytes[i] = devlog_ring.data[(index + i) & (DEVLOG_SIZE - 1)];
+}
+
+LF_FUNC("devlog") int devlog_configure(void) {
+    devlog_ring.head = devlog_ring.tail = devlog_ring.dropped = 0;
+    return lf_success;
+}
+
+/* Moves as many of the oldest whole records as fit in 'size' bytes to 'dst', returning the number of bytes moved. */
+LF_FUNC("devlog") uint32_t devlog_read(void *dst, uint32_t size) {
+    uint8_t *out = dst;
+    uint32_t moved = 0;
+
+    /* A task or interrupt may be writing, unless this is called from the FMR interrupt, which already masks them. */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    while (devlog_ring.tail != devlog_ring.head) {
+        struct _devlog_record record;
+        devlog_get(devlog_ring.tail, &record, sizeof(record));
+        uint32_t length = sizeof(record) + record.length;
+        if (moved + length > size) break;
+        devlog_get(devlog_ring.tail, out + moved, length);
+        devlog_ring.tail += length;
+        moved += length;
+    }
+    __set_PRIMASK(primask);
+
+    return moved;
+}
+
+/* Returns the number of records lost because the ring was full. */
+LF_FUNC("devlog") uint32_t devlog_dropped(void) {
+    return devlog_ring.dropped;
+}
+
+/*
+   Appends text to the log, split into records of at most DEVLOG_TEXT_MAX bytes. Records that don't fit are dropped
+   rather than waited on, so this may be called from any task or interrupt. Returns the number of bytes logged.
+*/
+uint32_t devlog_write(const void *text, uint32_t length) {
+    const uint8_t *bytes = text;
+    uint32_t consumed = 0, logged = 0;
+
+    while (consumed < length) {
+        struct _devlog_record record;
+        record.cycles = DWT->CYCCNT;
+        record.pid = (os_current_task) ? os_current_task->pid : UINT8_MAX;
+        record.length = (length - consumed < DEVLOG_TEXT_MAX) ? length - consumed : DEVLOG_TEXT_MAX;
+
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        if (DEVLOG_SIZE - (devlog_ring.head - devlog_ring.tail) < sizeof(record) + record.length) {
+            devlog_ring.dropped++;
+        } else {
+            devlog_put(devlog_ring.head, &record, sizeof(record));
+            devlog_put(devlog_ring.head + sizeof(record), bytes + consumed, record.length);
+            devlog_ring.head += sizeof(record) + record.length;
+            logged += record.length;
+        }
+        __set_PRIMASK(primask);
+
+        consumed += record.length;
+    }
+
+    return logged;
+}
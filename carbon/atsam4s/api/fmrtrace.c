@@ -0,0 +1,78 @@
+#include "libflipper.h"
+#include "fmrtrace.h"
+#include "atsam4s.h"
+#include "queue.h"
+
+/* The number of records of handled packets kept for the host. */
+#define FMRTRACE_RECORDS 64
+
+/* Records of handled packets, pushed by 'fmr_trace' and popped by 'fmrtrace_read'. */
+static struct _lf_spsc fmrtrace_queue;
+static struct _fmrtrace_record fmrtrace_storage[FMRTRACE_RECORDS];
+/* The number of packets handled while the queue was full. */
+static uint32_t fmrtrace_overflows;
+
+/* The record of the packet being handled. */
+static struct _fmrtrace_record fmrtrace_current;
+/* Whether packets are being traced, and whether the packet being handled is. */
+static bool fmrtrace_enabled, fmrtrace_active;
+/* The sequence number of the next packet traced. */
+static uint32_t fmrtrace_seq;
+
+LF_FUNC("fmrtrace") int fmrtrace_configure(void) {
+    fmrtrace_enabled = false;
+    lf_spsc_init(&fmrtrace_queue, fmrtrace_storage, sizeof(struct _fmrtrace_record), FMRTRACE_RECORDS);
+    return lf_success;
+}
+
+/* Starts or stops tracing. Starting discards any records not yet read. */
+LF_FUNC("fmrtrace") int fmrtrace_enable(uint8_t enable) {
+    if (enable) {
+        lf_spsc_init(&fmrtrace_queue, fmrtrace_storage, sizeof(struct _fmrtrace_record), FMRTRACE_RECORDS);
+        fmrtrace_overflows = 0;
+        fmrtrace_seq = 0;
+    }
+    /* The packet that changes this is never recorded, as it was not traced from start to finish. */
+    fmrtrace_enabled = enable;
+    return lf_success;
+}
+
+/* Pops at most 'count' records into 'dst', in the order their packets were handled. Returns the number popped. */
+LF_FUNC("fmrtrace") uint32_t fmrtrace_read(struct _fmrtrace_record *dst, uint32_t count) {
+    uint32_t popped = 0;
+    while (popped < count && lf_spsc_pop(&fmrtrace_queue, &dst[popped])) popped++;
+    return popped;
+}
+
+/* Returns the number of traced packets whose records were discarded, since tracing was started. */
+LF_FUNC("fmrtrace") uint32_t fmrtrace_dropped(void) {
+    return fmrtrace_overflows;
+}
+
+void fmr_trace(uint8_t phase, struct _fmr_packet *packet) {
+    uint32_t now = DWT->CYCCNT;
+
+    if (phase == fmr_phase_received) {
+        fmrtrace_active = fmrtrace_enabled;
+        if (!fmrtrace_active) return;
+
+        struct _fmr_call_packet *call = (struct _fmr_call_packet *)packet;
+        memset(&fmrtrace_current, 0, sizeof(fmrtrace_current));
+        fmrtrace_current.seq = fmrtrace_seq++;
+        fmrtrace_current.type = packet->hdr.type;
+        fmrtrace_current.module = (packet->hdr.type == fmr_rpc_class) ? call->call.module : UINT8_MAX;
+        fmrtrace_current.function = (packet->hdr.type == fmr_rpc_class) ? call->call.function : UINT8_MAX;
+    }
+
+    if (!fmrtrace_active) return;
+
+    fmrtrace_current.cycles[phase] = now;
+    fmrtrace_current.phases |= (1 << phase);
+
+    if (phase == fmr_phase_sent) {
+        fmrtrace_active = false;
+        if (!fmrtrace_enabled) return;
+
+        if (!lf_spsc_push(&fmrtrace_queue, &fmrtrace_current)) fmrtrace_overflows++;
+    }
+}
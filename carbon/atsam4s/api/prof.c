@@ -0,0 +1,103 @@
+#include "libflipper.h"
+#include "prof.h"
+#include "atsam4s.h"
+#include "os/scheduler.h"
+#include "queue.h"
+
+/* The profiler samples on channel 2 of TC0, which the timer module leaves free. */
+#define PROF_CHANNEL 2
+
+/* The number of samples that may wait for 'prof_read'. */
+#define PROF_SAMPLES 256
+
+extern struct _os_task *os_current_task;
+
+/* Samples, pushed by the timer interrupt and popped by 'prof_read'. */
+static struct _lf_spsc prof_queue;
+static struct _prof_sample prof_storage[PROF_SAMPLES];
+/* The number of samples taken while the queue was full. */
+static volatile uint32_t prof_overflows;
+
+LF_FUNC("prof") int prof_configure(void) {
+    prof_stop();
+    lf_spsc_init(&prof_queue, prof_storage, sizeof(struct _prof_sample), PROF_SAMPLES);
+    prof_overflows = 0;
+    return lf_success;
+}
+
+/* Starts sampling 'hz' times per second, discarding any samples not yet read. */
+LF_FUNC("prof") int prof_start(uint32_t hz) {
+    uint32_t clock = 0, rc = 0;
+
+    lf_assert(hz, E_CONFIGURATION, "invalid sampling rate");
+
+    lf_assert(tc_select_clock(hz, &clock, &rc), E_CONFIGURATION, "sampling rate out of range");
+
+    prof_stop();
+    lf_spsc_init(&prof_queue, prof_storage, sizeof(struct _prof_sample), PROF_SAMPLES);
+    prof_overflows = 0;
+
+    /* Enable the clock to the channel's peripheral. */
+    PMC->PMC_PCER0 = (1 << ID_TC2);
+
+    TcChannel *channel = &TC0->TC_CHANNEL[PROF_CHANNEL];
+    /* Count up to RC, restarting and interrupting on each compare. */
+    channel->TC_CMR = ((clock << TC_CMR_TCCLKS_Pos) & TC_CMR_TCCLKS_Msk) | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC;
+    channel->TC_RC = rc;
+    channel->TC_IER = TC_IER_CPCS;
+
+    /* Preempt the other interrupts, so that time spent in their handlers is sampled too. */
+    NVIC_ClearPendingIRQ(TC2_IRQn);
+    NVIC_SetPriority(TC2_IRQn, PROF_PRIORITY);
+    NVIC_EnableIRQ(TC2_IRQn);
+
+    channel->TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+LF_FUNC("prof") int prof_stop(void) {
+    TcChannel *channel = &TC0->TC_CHANNEL[PROF_CHANNEL];
+    channel->TC_CCR = TC_CCR_CLKDIS;
+    channel->TC_IDR = TC_IDR_CPCS;
+    NVIC_DisableIRQ(TC2_IRQn);
+    return lf_success;
+}
+
+/* Pops samples into 'dst' in the order they were taken, stopping after 'count'. Returns the number popped. */
+LF_FUNC("prof") uint32_t prof_read(struct _prof_sample *dst, uint32_t count) {
+    uint32_t popped = 0;
+    while (popped < count && lf_spsc_pop(&prof_queue, &dst[popped])) popped++;
+    return popped;
+}
+
+/* Returns the number of samples lost since sampling was started. */
+LF_FUNC("prof") uint32_t prof_dropped(void) {
+    return prof_overflows;
+}
+
+/* Records the interrupted context, given the exception frame the NVIC stacked for it. */
+void __attribute__((used)) prof_sample(struct _stack_ctx *frame) {
+    /* Reading the status register acknowledges the compare. */
+    (void)TC0->TC_CHANNEL[PROF_CHANNEL].TC_SR;
+
+    struct _prof_sample sample;
+    sample.pc = frame->pc;
+    sample.lr = frame->lr;
+    sample.pid = (os_current_task) ? os_current_task->pid : UINT8_MAX;
+    /* The IPSR field of the stacked xPSR holds the exception that was interrupted, if any. */
+    sample.exception = frame->psr & 0xFF;
+    sample.reserved = 0;
+    if (!lf_spsc_push(&prof_queue, &sample)) prof_overflows++;
+}
+
+/* Finds the exception frame on whichever stack was in use when the interrupt fired, and hands it to 'prof_sample'. */
+__attribute__((naked)) void tc2_isr(void) {
+    __asm__ __volatile__("tst lr, #4    \n"
+                         "ite eq        \n"
+                         "mrseq r0, msp \n"
+                         "mrsne r0, psp \n"
+                         "b prof_sample \n");
+}
@@ -0,0 +1,44 @@
+#include "libflipper.h"
+#include "task.h"
+#include "atsam4s.h"
+#include "os/scheduler.h"
+
+extern struct _os_schedule schedule;
+
+LF_FUNC("task") int task_configure(void) {
+    return lf_success;
+}
+
+/* Returns the number of tasks. */
+LF_FUNC("task") uint32_t task_count(void) {
+    return schedule.count;
+}
+
+/* Fills 'dst' with the statistics of up to 'count' tasks, in schedule order, returning how many were filled. */
+LF_FUNC("task") uint32_t task_stats(struct _task_stats *dst, uint32_t count) {
+    struct _os_task *task = schedule.head;
+    uint32_t filled = 0;
+    while (filled < count && filled < schedule.count) {
+        struct _task_stats *stats = &dst[filled++];
+        stats->pid = task->pid;
+        stats->status = task->status;
+        stats->overflowed = task->overflowed;
+        stats->reserved = 0;
+        stats->stack_size = task->stack_size;
+        stats->stack_used = os_task_stack_used(task);
+        stats->switches = task->switches;
+        stats->runtime = os_task_runtime(task);
+        task = task->next;
+    }
+    return filled;
+}
+
+/* Returns the number of context switches between tasks. */
+LF_FUNC("task") uint32_t task_switches(void) {
+    return schedule.switches;
+}
+
+/* Returns the rate of the cycle counter, which task run times and every timestamp the device reports count. */
+LF_FUNC("task") uint32_t task_clock(void) {
+    return F_CPU;
+}
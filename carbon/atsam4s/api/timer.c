@@ -1,17 +1,331 @@
 #include "libflipper.h"
 #include "timer.h"
-#include <tc/tc.h>
+#include "atsam4s.h"
+#include "os/scheduler.h"
+
+/*
+ * Software timers, kept in a hierarchical timer wheel driven by channel 0 of TC0.
+ *
+ * The wheel has TIMER_LEVELS levels of TIMER_SLOTS slots. A slot of the lowest level holds the timers
+ * expiring on one tick, and a slot of each level above holds the timers expiring within a span as long as a
+ * whole turn of the level below. Arming or cancelling a timer links it into or out of a slot's list, so both
+ * take constant time. Each time a level completes a turn, the next slot of the level above is emptied into
+ * the levels below. Timers further out than the wheel reaches wait in its top level, and are placed again
+ * each time their slot is emptied.
+ *
+ * The interrupt only advances the wheel. Expired timers are queued for the timer task, which runs their
+ * callbacks, so callbacks may take as long as they need and block like any other task.
+ */
+
+/* The wheel ticks once per millisecond. */
+#define TIMER_CHANNEL 0
+#define TIMER_HZ 1000
+
+/* The most timers that may be armed at once. */
+#define TIMER_MAX 1024
+
+/* The shape of the wheel, which reaches 2^24 ticks, or about four and a half hours. */
+#define TIMER_LEVEL_BITS 6
+#define TIMER_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_LEVELS 4
+#define TIMER_REACH (1UL << (TIMER_LEVEL_BITS * TIMER_LEVELS))
+
+/* Marks the end of a list of timers. */
+#define TIMER_NONE 0xFFFF
+
+/* The number of expirations that may wait for the timer task. */
+#define TIMER_PENDING 64
+
+/* The event flag set when expirations are waiting. */
+#define TIMER_EXPIRED (1 << 0)
+
+/* The stack of the task that runs callbacks. */
+#define TIMER_TASK_STACK_SIZE_WORDS 256
+
+enum { timer_state_free, timer_state_armed, timer_state_fired };
+
+struct _timer {
+    /* The timer's neighbours in its slot's list, or in the free list. */
+    uint16_t next;
+    uint16_t prev;
+    /* Bumped each time the timer is freed, so that a stale ID or expiration can be told apart. */
+    uint16_t generation;
+    /* The slot the timer is linked into, counting across levels. */
+    uint8_t slot;
+    uint8_t state;
+    /* The tick the timer expires on. */
+    uint32_t expires;
+    /* The ticks between expirations, or zero if the timer only expires once. */
+    uint32_t period;
+    void (*callback)(void *arg);
+    void *arg;
+};
+
+/* An expiration waiting for the timer task. */
+struct _timer_expiration {
+    uint16_t index;
+    uint16_t generation;
+};
+
+static struct {
+    struct _timer timers[TIMER_MAX];
+    /* The first timer of each slot's list. */
+    uint16_t slots[TIMER_LEVELS * TIMER_SLOTS];
+    /* The first free timer. */
+    uint16_t free;
+    /* The next tick to be processed. */
+    volatile uint32_t next;
+    /* The number of timers armed. */
+    uint32_t armed;
+    /* The number of expirations dropped because the timer task fell behind. */
+    uint32_t overruns;
+} timer_wheel;
+
+static struct _lf_spsc timer_pending;
+static struct _timer_expiration timer_pending_storage[TIMER_PENDING];
+static struct _lf_event timer_event;
+static struct _os_task *timer_task;
+
+/* Links a timer into the slot that covers its expiry. */
+static void timer_link(uint16_t index) {
+    struct _timer *timer = &timer_wheel.timers[index];
+    uint32_t base = timer_wheel.next;
+    uint32_t ticks = timer->expires - base;
+    uint32_t level = 0, slot;
+
+    /* A timer that is already due is processed on the next tick. */
+    if ((int32_t)ticks < 0) ticks = 0;
+    /* A timer beyond the reach of the wheel waits in its top level, and is placed again when cascaded. */
+    if (ticks >= TIMER_REACH) ticks = TIMER_REACH - 1;
+
+    while (level < TIMER_LEVELS - 1 && ticks >= (1UL << (TIMER_LEVEL_BITS * (level + 1)))) level++;
+    slot = level * TIMER_SLOTS + (((base + ticks) >> (TIMER_LEVEL_BITS * level)) & (TIMER_SLOTS - 1));
+
+    timer->slot = slot;
+    timer->prev = TIMER_NONE;
+    timer->next = timer_wheel.slots[slot];
+    if (timer->next != TIMER_NONE) timer_wheel.timers[timer->next].prev = index;
+    timer_wheel.slots[slot] = index;
+}
+
+/* Unlinks a timer from its slot. */
+static void timer_unlink(uint16_t index) {
+    struct _timer *timer = &timer_wheel.timers[index];
+    if (timer->prev != TIMER_NONE) {
+        timer_wheel.timers[timer->prev].next = timer->next;
+    } else {
+        timer_wheel.slots[timer->slot] = timer->next;
+    }
+    if (timer->next != TIMER_NONE) timer_wheel.timers[timer->next].prev = timer->prev;
+}
+
+/* Returns a timer to the free list. */
+static void timer_free(uint16_t index) {
+    struct _timer *timer = &timer_wheel.timers[index];
+    timer->state = timer_state_free;
+    timer->generation++;
+    timer->next = timer_wheel.free;
+    timer_wheel.free = index;
+    timer_wheel.armed--;
+}
+
+/* Empties a slot, placing each of its timers again. Returns the index of the slot within its level. */
+static uint32_t timer_cascade(uint32_t level) {
+    uint32_t index = (timer_wheel.next >> (TIMER_LEVEL_BITS * level)) & (TIMER_SLOTS - 1);
+    uint32_t slot = level * TIMER_SLOTS + index;
+    uint16_t timer = timer_wheel.slots[slot];
+    timer_wheel.slots[slot] = TIMER_NONE;
+    while (timer != TIMER_NONE) {
+        uint16_t next = timer_wheel.timers[timer].next;
+        timer_link(timer);
+        timer = next;
+    }
+    return index;
+}
+
+/* Hands an expired timer to the timer task, and re-arms it if it is periodic. */
+static void timer_expire(uint16_t index) {
+    struct _timer *timer = &timer_wheel.timers[index];
+    struct _timer_expiration expiration = { index, timer->generation };
+
+    if (timer->period) {
+        timer->expires += timer->period;
+        timer_link(index);
+    } else {
+        timer->state = timer_state_fired;
+    }
+
+    if (!lf_spsc_push(&timer_pending, &expiration)) {
+        timer_wheel.overruns++;
+        /* Nothing would ever free a one-shot timer whose expiration was dropped. */
+        if (!timer->period) timer_free(index);
+    }
+}
+
+/* Processes one tick of the wheel. */
+static void timer_advance(void) {
+    uint32_t index = timer_wheel.next & (TIMER_SLOTS - 1);
+
+    /* Each time a level completes a turn, refill it from the level above. */
+    for (uint32_t level = 1; !index && level < TIMER_LEVELS; level++) index = timer_cascade(level);
+
+    uint32_t slot = timer_wheel.next & (TIMER_SLOTS - 1);
+    uint16_t timer = timer_wheel.slots[slot];
+    timer_wheel.slots[slot] = TIMER_NONE;
+    timer_wheel.next++;
+
+    while (timer != TIMER_NONE) {
+        uint16_t next = timer_wheel.timers[timer].next;
+        timer_expire(timer);
+        timer = next;
+    }
+}
+
+/* Runs the callbacks of expired timers. */
+static void timer_task_main(void) {
+    struct _timer_expiration expiration;
+    while (1) {
+        os_event_wait(&timer_event, TIMER_EXPIRED, false);
+        while (lf_spsc_pop(&timer_pending, &expiration)) {
+            void (*callback)(void *) = NULL;
+            void *arg = NULL;
+
+            __disable_irq();
+            struct _timer *timer = &timer_wheel.timers[expiration.index];
+            /* Skip timers cancelled since they expired. */
+            if (timer->generation == expiration.generation && timer->state != timer_state_free) {
+                callback = timer->callback;
+                arg = timer->arg;
+                if (timer->state == timer_state_fired) timer_free(expiration.index);
+            }
+            __enable_irq();
+
+            if (callback) callback(arg);
+        }
+    }
+}
+
+/* Picks the fastest clock of a TC channel whose counter can reach a period of 1/'hz' seconds, and that period. */
+int tc_select_clock(uint32_t hz, uint32_t *clock, uint32_t *rc) {
+    for (uint32_t i = 0; i < TC_CLOCKS; i++) {
+        uint32_t period = F_CPU / TC_DIVIDER(i) / hz;
+        if (period > 0xFFFF) continue;
+        if (period < 2) return lf_error;
+        *clock = i;
+        *rc = period;
+        return lf_success;
+    }
+    return lf_error;
+}
 
 LF_FUNC("timer") int timer_configure(void) {
+    memset(&timer_wheel, 0, sizeof(timer_wheel));
+    for (uint32_t i = 0; i < TIMER_LEVELS * TIMER_SLOTS; i++) timer_wheel.slots[i] = TIMER_NONE;
+    for (uint32_t i = 0; i < TIMER_MAX; i++) timer_wheel.timers[i].next = (i + 1 < TIMER_MAX) ? i + 1 : TIMER_NONE;
+    lf_spsc_init(&timer_pending, timer_pending_storage, sizeof(struct _timer_expiration), TIMER_PENDING);
+    lf_event_clear(&timer_event, TIMER_EXPIRED);
+
+    /* Enable the clock to the channel's peripheral. */
+    PMC->PMC_PCER0 = (1 << ID_TC0);
+
+    TcChannel *channel = &TC0->TC_CHANNEL[TIMER_CHANNEL];
+    /* Count MCK/128 up to RC, restarting and interrupting on each compare. */
+    channel->TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK4 | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC;
+    channel->TC_RC = F_CPU / 128 / TIMER_HZ;
+    channel->TC_IER = TC_IER_CPCS;
+
+    NVIC_ClearPendingIRQ(TC0_IRQn);
+    NVIC_SetPriority(TC0_IRQn, TIMER_PRIORITY);
+    NVIC_EnableIRQ(TC0_IRQn);
+
+    channel->TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+
     return lf_success;
 }
 
-/* Registers a callback with the next available timer. */
+/* Calls 'callback' once, after 'ticks' milliseconds. */
 LF_FUNC("timer") int timer_register(uint32_t ticks, void *callback) {
+    return timer_start(ticks, 0, callback, NULL) ? lf_success : lf_error;
+}
+
+/* Calls 'callback' with 'arg' after 'ticks' milliseconds, then every 'period' milliseconds if 'period' is
+   nonzero. Returns an ID for cancelling the timer, or zero if it could not be armed. */
+LF_FUNC("timer") uint32_t timer_start(uint32_t ticks, uint32_t period, void *callback, void *arg) {
+    lf_assert(callback, E_NULL, "invalid timer callback");
+    lf_assert(ticks && ticks < INT32_MAX && period < INT32_MAX, E_TIMER, "timer interval out of range");
+
+    /* Callbacks run in their own task, created once the scheduler is running. */
+    if (!timer_task) {
+        timer_task = os_task_create(timer_task_main, NULL, NULL, TIMER_TASK_STACK_SIZE_WORDS * sizeof(uint32_t));
+        lf_assert(timer_task, E_NULL, "failed to create the timer task");
+        os_task_add(timer_task);
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint16_t index = timer_wheel.free;
+    if (index == TIMER_NONE) {
+        __set_PRIMASK(primask);
+        lf_assert(false, E_OVERFLOW, "all %d timers are armed", TIMER_MAX);
+    }
+    struct _timer *timer = &timer_wheel.timers[index];
+    timer_wheel.free = timer->next;
+    timer_wheel.armed++;
+    timer->state = timer_state_armed;
+    timer->expires = timer_wheel.next + ticks - 1;
+    timer->period = period;
+    timer->callback = callback;
+    timer->arg = arg;
+    timer_link(index);
+    uint32_t id = ((uint32_t)timer->generation << 16) | (index + 1);
+    __set_PRIMASK(primask);
+
+    return id;
+fail:
+    return 0;
+}
+
+/* Disarms a timer. A callback already running is not interrupted. */
+LF_FUNC("timer") int timer_cancel(uint32_t id) {
+    uint32_t index = (id & 0xFFFF) - 1;
+    lf_assert(index < TIMER_MAX, E_TIMER, "invalid timer");
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    struct _timer *timer = &timer_wheel.timers[index];
+    if (timer->generation != (id >> 16) || timer->state == timer_state_free) {
+        __set_PRIMASK(primask);
+        lf_assert(false, E_TIMER, "timer already expired or cancelled");
+    }
+    if (timer->state == timer_state_armed) timer_unlink(index);
+    timer_free(index);
+    __set_PRIMASK(primask);
+
+    return lf_success;
+fail:
     return lf_error;
 }
 
+/* Returns the number of timers armed. */
+LF_FUNC("timer") uint32_t timer_active(void) {
+    return timer_wheel.armed;
+}
+
+/* Returns the number of ticks since the timers were configured. */
+LF_FUNC("timer") uint32_t timer_ticks(void) {
+    return timer_wheel.next;
+}
+
 void tcx_isr(uint8_t timer) {
+    /* Reading the status register acknowledges the interrupt. */
+    if (timer != TIMER_CHANNEL || !(TC0->TC_CHANNEL[TIMER_CHANNEL].TC_SR & TC_SR_CPCS)) return;
+
+    /* The wheel is also changed by calls from higher priority interrupts. */
+    __disable_irq();
+    timer_advance();
+    __enable_irq();
+
+    if (lf_spsc_count(&timer_pending)) os_event_signal(&timer_event, TIMER_EXPIRED);
 }
 
 /* timer0 isr */
@@ -24,10 +338,7 @@ void tc1_isr(void) {
     tcx_isr(1);
 }
 
-/* timer2 isr */
-void tc2_isr(void) {
-    tcx_isr(2);
-}
+/* Channel 2 is reserved for the sampling profiler, which defines its own isr. */
 
 /* timer3 isr */
 void tc3_isr(void) {
@@ -17,6 +17,7 @@ ATSAM4S_CFLAGS   := -mcpu=cortex-m4        \
                     -mtune=cortex-m4       \
                     -mfloat-abi=soft       \
                     -DATSAM4S              \
+                    -DLF_CONFIG_FMR_TRACE  \
 					-D__SAM4S16B__         \
 
 ATSAM4S_LDFLAGS  := -nostartfiles          \
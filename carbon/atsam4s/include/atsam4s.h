@@ -61,9 +61,19 @@
 
 /* Define interrupt priorities, from highest (0) to lowest (15) priority. */
 #define SYSTICK_PRIORITY 0
+#define PROF_PRIORITY 0
 #define UART0_PRIORITY 1
+#define ADC_PRIORITY 1
+#define TIMER_PRIORITY 2
 #define PENDSV_PRIORITY 15
 
+/* The clocks a TC channel can count, TIMER_CLOCK1 through TIMER_CLOCK4, and the divider of MCK each selects. */
+#define TC_CLOCKS 4
+#define TC_DIVIDER(clock) (2UL << (2 * (clock)))
+
+/* Picks the clock and RC of a TC channel for a period of 1/'hz' seconds. Fails if none can count it. */
+int tc_select_clock(uint32_t hz, uint32_t *clock, uint32_t *rc);
+
 /* Communicate at 1 megabaud. */
 #define PLATFORM_BAUDRATE 1000000
 
@@ -9,13 +9,6 @@
 static struct _fmr_packet packet;
 static struct _lf_device *_4s;
 
-extern void uart0_put(uint8_t byte);
-
-int debug_putchar(char c, FILE *stream) {
-    uart0_put(c);
-    return 0;
-}
-
 void os_kernel_task(void) {
     gpio_enable(IO_1, 0);
     while (1) {
@@ -97,6 +90,14 @@ int main(void) {
     dyld_register(_4s, &dac);
     dac_configure();
 
+    extern struct _lf_module devlog;
+    dyld_register(_4s, &devlog);
+    devlog_configure();
+
+    extern struct _lf_module fmrtrace;
+    dyld_register(_4s, &fmrtrace);
+    fmrtrace_configure();
+
     extern struct _lf_module gpio;
     dyld_register(_4s, &gpio);
     gpio_configure();
@@ -109,6 +110,10 @@ int main(void) {
     dyld_register(_4s, &led);
     led_configure();
 
+    extern struct _lf_module prof;
+    dyld_register(_4s, &prof);
+    prof_configure();
+
     extern struct _lf_module pwm;
     dyld_register(_4s, &pwm);
     pwm_configure();
@@ -125,6 +130,10 @@ int main(void) {
     dyld_register(_4s, &swd);
     swd_configure();
 
+    extern struct _lf_module task;
+    dyld_register(_4s, &task);
+    task_configure();
+
     extern struct _lf_module temp;
     dyld_register(_4s, &temp);
     temp_configure();
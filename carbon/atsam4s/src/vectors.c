@@ -47,6 +47,14 @@ void reset_exception(void) {
     /* Clear the zero segment */
     for (pDest = &_szero; pDest < &_ezero;) { *pDest++ = 0; }
 
+#if (__FPU_USED == 1)
+    /* Grant access to the FPU, with lazy stacking of its registers on exceptions. */
+    SCB->CPACR |= (0xF << 20);
+    FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+    __DSB();
+    __ISB();
+#endif
+
     /* Set the vector table base address */
     // pSrc = (uint32_t *)&_sfixed;
     // SCB->VTOR = ( (uint32_t)pSrc & SCB_VTOR_TBLOFF_Msk ) ;
@@ -23,6 +23,7 @@
 #include "libflipper.h"
 #include "carbon.h"
 
+#include "posix/linkemu.h"
 #include "posix/network.h"
 #include "posix/usb.h"
 
@@ -209,6 +210,10 @@ struct _lf_device *carbon_attach_hostname(char *hostname) {
     struct _lf_device *device = lf_network_device_for_hostname(hostname);
     lf_assert(device, E_NO_DEVICE, "Failed to find Carbon device with hostname '%s'.", hostname);
 
+    /* Without hardware, a slower link can be emulated in front of the networked device. */
+    device = lf_link_device_from_env(device);
+    lf_assert(device, E_CONFIGURATION, "Failed to emulate link to '%s'.", hostname);
+
     lf_attach(device);
     return device;
 
@@ -0,0 +1,238 @@
+//! Streams samples from the ATSAM4S's ADC to the host.
+//!
+//! While streaming, a timer triggers the ADC at a fixed rate, and each
+//! trigger converts a sequence of up to eight channels. The PDC moves the
+//! results into blocks of 256 samples without the processor's help, and the
+//! device keeps the filled blocks in a ring until the host reads them. The
+//! host pulls several whole blocks per round trip, so the rate it can keep
+//! up with is set by the link to the device rather than by the cost of a call.
+//!
+//! Each block records the index of its first sample, so the time of every
+//! sample follows from the timer's period. Blocks the device had to drop
+//! because the host fell behind leave a gap in the indices. A block is
+//! flagged when conversions were lost before it because the device was too
+//! busy to keep the PDC supplied; its timing is then only known from the
+//! cycle counter value stamped on it.
+
+use std::thread;
+use std::time::Duration;
+
+use byteorder::{ByteOrder, LittleEndian};
+use failure::Error;
+use flipper::{flipper_module, Client, LfPointer};
+use tasks;
+
+/// The number of samples in a block.
+pub const BLOCK_SAMPLES: usize = 256;
+
+/// The size of a `struct _adc_block` header on the device.
+pub const HEADER_SIZE: usize = 12;
+
+/// The size of a block as the device writes it, header and samples.
+pub const BLOCK_SIZE: usize = HEADER_SIZE + 2 * BLOCK_SAMPLES;
+
+/// The most channels a sequence may convert on each trigger.
+pub const SEQUENCE_MAX: usize = 8;
+
+/// Set in a block's flags if conversions were lost before it.
+const BLOCK_GAP: u16 = 1 << 0;
+
+/// The device's `adc` module.
+#[flipper_module("adc")]
+trait Adc {
+    fn adc_configure(&mut self) -> u32;
+    fn adc_stream_start(&mut self, hz: u32, sequence: u32, length: u8) -> u32;
+    fn adc_stream_stop(&mut self) -> u32;
+    fn adc_stream_read(&mut self, dst: LfPointer, count: u32) -> u32;
+    fn adc_stream_dropped(&mut self) -> u32;
+    fn adc_stream_period(&mut self) -> u32;
+}
+
+/// The most blocks moved from the device per pull.
+const READ_BATCH: u32 = 4;
+
+/// How long to wait before checking an empty ring again, in milliseconds.
+/// A ring with blocks in it is drained without waiting.
+const POLL_INTERVAL_MS: u64 = 10;
+
+#[derive(Debug, Fail)]
+enum AdcError {
+    #[fail(display = "a sequence holds between 1 and {} channels, each below 16", _0)]
+    Sequence(usize),
+    #[fail(display = "the device could not convert {} channels at {} Hz", _0, _1)]
+    Start(usize, u32),
+}
+
+/// A sample converted by the ADC.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Sample {
+    /// The channel converted.
+    pub channel: u8,
+    /// The 12-bit result.
+    pub value: u16,
+}
+
+/// A block of samples filled by the device.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Block {
+    /// The index of the block's first sample among all of those converted
+    /// since the stream started.
+    pub first: u32,
+    /// The cycle counter when the block was filled.
+    pub cycles: u32,
+    /// Whether conversions were lost between this block and the one before it.
+    pub gap: bool,
+    /// The block's samples, a whole number of sequences.
+    pub samples: Vec<Sample>,
+}
+
+impl Block {
+    /// Decodes blocks laid out back to back as the device writes them.
+    pub fn parse_all(bytes: &[u8]) -> Vec<Block> {
+        bytes.chunks(BLOCK_SIZE)
+            .filter(|chunk| chunk.len() == BLOCK_SIZE)
+            .map(|chunk| {
+                let count = (LittleEndian::read_u16(&chunk[8..10]) as usize).min(BLOCK_SAMPLES);
+                Block {
+                    first: LittleEndian::read_u32(&chunk[0..4]),
+                    cycles: LittleEndian::read_u32(&chunk[4..8]),
+                    gap: LittleEndian::read_u16(&chunk[10..12]) & BLOCK_GAP != 0,
+                    samples: chunk[HEADER_SIZE..HEADER_SIZE + 2 * count].chunks(2)
+                        .map(|sample| {
+                            let raw = LittleEndian::read_u16(sample);
+                            Sample { channel: (raw >> 12) as u8, value: raw & 0xfff }
+                        })
+                        .collect(),
+                }
+            })
+            .collect()
+    }
+}
+
+/// Packs a sequence of channels as the device expects it: four bits per
+/// channel, converted from the lowest bits up.
+pub fn sequence(channels: &[u8]) -> Option<u32> {
+    if channels.is_empty() || channels.len() > SEQUENCE_MAX || channels.iter().any(|&channel| channel > 0xf) {
+        return None;
+    }
+    Some(channels.iter().enumerate().fold(0, |packed, (i, &channel)| packed | u32::from(channel) << (4 * i)))
+}
+
+/// How the samples of a stream are spaced in time.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Timing {
+    /// The rate the device counts cycles at.
+    pub clock: u32,
+    /// The cycles between triggers, each of which converts the whole sequence.
+    pub period: u32,
+    /// The number of channels in the sequence.
+    pub sequence: usize,
+}
+
+impl Timing {
+    /// The number of times per second the sequence is converted.
+    pub fn rate(&self) -> f64 {
+        f64::from(self.clock) / f64::from(self.period.max(1))
+    }
+
+    /// The seconds from the start of the stream to the trigger that converted
+    /// the sample at `index`.
+    pub fn seconds(&self, index: u32) -> f64 {
+        (index as usize / self.sequence.max(1)) as f64 / self.rate()
+    }
+}
+
+/// Streams the channels of `channels` at `hz` conversions of the whole
+/// sequence per second. Each batch of blocks read from the device is given to
+/// `sink` as it arrives, until `sink` returns false. The blocks still on the
+/// device when the stream stops are given to `sink` too.
+///
+/// Returns the number of blocks the device had to drop.
+pub fn stream<C, F>(client: &mut C, hz: u32, channels: &[u8], mut sink: F) -> Result<u32, Error>
+    where C: Client + ?Sized, F: FnMut(&Timing, Vec<Block>) -> Result<bool, Error>
+{
+    let packed = sequence(channels).ok_or(AdcError::Sequence(SEQUENCE_MAX))?;
+    let buffer = client.malloc(READ_BATCH * BLOCK_SIZE as u32)?;
+
+    // Moves every block waiting on the device.
+    let drain = |client: &mut C| -> Result<Vec<Block>, Error> {
+        let mut blocks = Vec::new();
+        loop {
+            let count = AdcModule::bind(client)?.adc_stream_read(buffer, READ_BATCH)? as usize;
+            if count == 0 { return Ok(blocks); }
+
+            let mut bytes = vec![0; count * BLOCK_SIZE];
+            client.pull(buffer, &mut bytes)?;
+            blocks.extend(Block::parse_all(&bytes));
+            if count < READ_BATCH as usize { return Ok(blocks); }
+        }
+    };
+
+    if AdcModule::bind(client)?.adc_stream_start(hz, packed, channels.len() as u8)? == 0 {
+        client.free(buffer)?;
+        Err(AdcError::Start(channels.len(), hz))?;
+    }
+
+    let streamed: Result<Timing, Error> = (|| {
+        let timing = Timing {
+            clock: tasks::clock(client)?,
+            period: AdcModule::bind(client)?.adc_stream_period()?,
+            sequence: channels.len(),
+        };
+        loop {
+            let blocks = drain(client)?;
+            if blocks.is_empty() {
+                thread::sleep(Duration::from_millis(POLL_INTERVAL_MS));
+            } else if !sink(&timing, blocks)? {
+                return Ok(timing);
+            }
+        }
+    })();
+
+    // Stop converting even if reading failed, so the device isn't left filling its ring.
+    AdcModule::bind(client)?.adc_stream_stop()?;
+    let timing = streamed?;
+    let rest = drain(client)?;
+    if !rest.is_empty() { sink(&timing, rest)?; }
+    let dropped = AdcModule::bind(client)?.adc_stream_dropped()?;
+    client.free(buffer)?;
+
+    Ok(dropped)
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    #[test]
+    fn test_parse_all() {
+        let mut bytes = vec![0; BLOCK_SIZE + 4];
+        bytes[0..12].copy_from_slice(&[0x00, 0x02, 0, 0, 0x10, 0, 0, 0, 2, 0, 1, 0]);
+        bytes[12..16].copy_from_slice(&[0x34, 0x02, 0xff, 0x1f]);
+        // A partial block is ignored.
+        assert_eq!(Block::parse_all(&bytes), vec![Block {
+            first: 512,
+            cycles: 16,
+            gap: true,
+            samples: vec![Sample { channel: 0, value: 0x234 }, Sample { channel: 1, value: 0xfff }],
+        }]);
+    }
+
+    #[test]
+    fn test_sequence() {
+        assert_eq!(sequence(&[0, 1]), Some(0x10));
+        assert_eq!(sequence(&[3, 15, 3]), Some(0x3f3));
+        assert_eq!(sequence(&[]), None);
+        assert_eq!(sequence(&[16]), None);
+        assert_eq!(sequence(&[0; 9]), None);
+    }
+
+    #[test]
+    fn test_timing() {
+        let timing = Timing { clock: 96_000_000, period: 9600, sequence: 2 };
+        assert_eq!(timing.rate(), 10_000.0);
+        // Both samples of a sequence are converted on the same trigger.
+        assert_eq!(timing.seconds(5), 0.0002);
+        assert_eq!(timing.seconds(4), 0.0002);
+    }
+}
@@ -0,0 +1,623 @@
+//! Measures how quickly a host and a Flipper can talk to each other.
+//!
+//! Each benchmark drives a `flipper::Client` and records how long every
+//! operation took. The results are collected into a `Report`, which can
+//! be printed as a table, serialized to JSON, and compared against a
+//! report from an earlier run to qualify a new board or host.
+//!
+//! The round trip of a call can also be broken down using the ATSAM4S's
+//! `fmrtrace` module, which timestamps each phase of handling a packet with
+//! the processor's cycle counter. Matching those records against the host's
+//! own timings separates the time spent executing on the device from the
+//! time spent on the wire and waiting in the host and the bridge.
+
+use std::fmt;
+use std::time::{Duration, Instant};
+
+use byteorder::{ByteOrder, LittleEndian};
+use failure::Error;
+use flipper::{Args, Client, LfType};
+use tasks;
+
+/// A module which is served by each of Carbon's processors. Loading it
+/// makes exactly one round trip over the transport leading to that processor.
+pub const TRANSPORT_PROBES: &[(&str, &str)] = &[
+    ("atmegau2", "led"),
+    ("atsam4s", "gpio"),
+];
+
+/// The buffer sizes that push/pull throughput is measured at by default.
+pub const DEFAULT_SIZES: &[u32] = &[64, 256, 1024, 4096];
+
+fn micros(duration: Duration) -> f64 {
+    duration.as_secs() as f64 * 1e6 + f64::from(duration.subsec_nanos()) / 1e3
+}
+
+fn seconds(duration: Duration) -> f64 {
+    micros(duration) / 1e6
+}
+
+/// A summary of a set of round-trip times, in microseconds.
+#[derive(Debug, Clone, Copy, PartialEq, Serialize, Deserialize)]
+pub struct Latency {
+    /// The number of round trips measured.
+    pub samples: usize,
+    /// The fastest round trip.
+    pub min: f64,
+    /// The median round trip.
+    pub p50: f64,
+    /// The round trip which 90% of round trips were faster than.
+    pub p90: f64,
+    /// The round trip which 99% of round trips were faster than.
+    pub p99: f64,
+    /// The slowest round trip.
+    pub max: f64,
+    /// The average round trip.
+    pub mean: f64,
+}
+
+impl Latency {
+    /// Summarizes the given round-trip times. Returns `None` if there are none.
+    pub fn from_samples(samples: &[Duration]) -> Option<Latency> {
+        if samples.is_empty() { return None; }
+
+        let mut micros: Vec<f64> = samples.iter().map(|&sample| micros(sample)).collect();
+        micros.sort_by(|a, b| a.partial_cmp(b).unwrap());
+
+        // Nearest-rank percentile.
+        let percentile = |p: f64| {
+            let rank = (p / 100.0 * micros.len() as f64).ceil() as usize;
+            micros[rank.max(1) - 1]
+        };
+
+        Some(Latency {
+            samples: micros.len(),
+            min: micros[0],
+            p50: percentile(50.0),
+            p90: percentile(90.0),
+            p99: percentile(99.0),
+            max: micros[micros.len() - 1],
+            mean: micros.iter().sum::<f64>() / micros.len() as f64,
+        })
+    }
+}
+
+/// The round-trip latency over one of the device's transports.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct TransportLatency {
+    /// The processor at the end of the transport.
+    pub transport: String,
+    /// The measured round trips.
+    pub latency: Latency,
+}
+
+/// The rate at which a buffer of a given size can be moved to and from the device.
+#[derive(Debug, Clone, Copy, PartialEq, Serialize, Deserialize)]
+pub struct Throughput {
+    /// The size of each transfer, in bytes.
+    pub size: u32,
+    /// Bytes per second moved from the host to the device.
+    pub push: f64,
+    /// Bytes per second moved from the device to the host.
+    pub pull: f64,
+}
+
+/// The rate at which a single module function can be invoked.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct CallRate {
+    /// The module the function belongs to.
+    pub module: String,
+    /// The function's index within the module.
+    pub function: u8,
+    /// The number of calls made.
+    pub calls: usize,
+    /// Completed calls per second.
+    pub per_second: f64,
+    /// The round-trip time of each call.
+    pub latency: Latency,
+}
+
+/// The time taken by one part of a call's round trip.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct PhaseLatency {
+    /// What the time was spent on.
+    pub phase: String,
+    /// The time spent, over every traced call.
+    pub latency: Latency,
+}
+
+/// Where the time of a call's round trip goes.
+///
+/// The device's phases are measured by its cycle counter. The wire time is
+/// estimated from the UART's baud rate, and whatever remains of the round
+/// trip was spent queued in the host, on USB or in the bridge processor.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct Breakdown {
+    /// The module the function belongs to.
+    pub module: String,
+    /// The function's index within the module.
+    pub function: u8,
+    /// The parts of the round trip, from the whole round trip down to the
+    /// device's phases of handling the call.
+    pub phases: Vec<PhaseLatency>,
+}
+
+/// Everything measured by a single run of the benchmarks.
+#[derive(Debug, Clone, Default, PartialEq, Serialize, Deserialize)]
+pub struct Report {
+    /// Round-trip latency for each transport.
+    pub latency: Vec<TransportLatency>,
+    /// Push/pull throughput for each buffer size.
+    pub throughput: Vec<Throughput>,
+    /// The call rate of the chosen module function, if one was chosen.
+    pub calls: Option<CallRate>,
+    /// Where the round trips of the chosen function's calls went, if traced.
+    pub breakdown: Option<Breakdown>,
+}
+
+/// Measures the round trip of looking up `module` on whichever processor
+/// implements it. Each lookup goes to the device, since the client's cache
+/// of loaded modules would otherwise answer every one after the first.
+pub fn measure_latency<C: Client + ?Sized>(client: &mut C, module: &str, iterations: usize) -> Result<Latency, Error> {
+    let mut samples = Vec::with_capacity(iterations);
+    for _ in 0..iterations {
+        let start = Instant::now();
+        client.lookup(module)?;
+        samples.push(start.elapsed());
+    }
+    Latency::from_samples(&samples).ok_or_else(|| format_err!("no latency samples were taken"))
+}
+
+/// Measures push and pull throughput for a device buffer of `size` bytes.
+pub fn measure_throughput<C: Client + ?Sized>(client: &mut C, size: u32, iterations: usize) -> Result<Throughput, Error> {
+    let pointer = client.malloc(size)?;
+    let mut buffer: Vec<u8> = (0..size).map(|i| i as u8).collect();
+
+    let measured: Result<(Duration, Duration), Error> = (|| {
+        let start = Instant::now();
+        for _ in 0..iterations {
+            client.push(pointer, &buffer)?;
+        }
+        let push = start.elapsed();
+
+        let start = Instant::now();
+        for _ in 0..iterations {
+            client.pull(pointer, &mut buffer)?;
+        }
+        let pull = start.elapsed();
+        Ok((push, pull))
+    })();
+
+    // Release the buffer even if a transfer failed.
+    client.free(pointer)?;
+    let (push, pull) = measured?;
+
+    let bytes = f64::from(size) * iterations as f64;
+    Ok(Throughput {
+        size,
+        push: bytes / seconds(push),
+        pull: bytes / seconds(pull),
+    })
+}
+
+/// Measures how many calls per second can be made to a module function.
+/// The module is resolved once, so only the calls themselves are timed.
+pub fn measure_calls<C: Client + ?Sized>(
+    client: &mut C,
+    module: &str,
+    function: u8,
+    ret: LfType,
+    args: &Args,
+    iterations: usize,
+) -> Result<CallRate, Error> {
+    let handle = client.resolve(module)?;
+
+    let mut samples = Vec::with_capacity(iterations);
+    let start = Instant::now();
+    for _ in 0..iterations {
+        let call = Instant::now();
+        client.invoke_handle(handle, function, ret, args)?;
+        samples.push(call.elapsed());
+    }
+    let total = start.elapsed();
+
+    Ok(CallRate {
+        module: module.to_owned(),
+        function,
+        calls: iterations,
+        per_second: iterations as f64 / seconds(total),
+        latency: Latency::from_samples(&samples).ok_or_else(|| format_err!("no calls were made"))?,
+    })
+}
+
+/// The size of a `struct _fmrtrace_record` on the device.
+pub const TRACE_RECORD_SIZE: usize = 28;
+
+/// The phases of handling a packet that the device timestamps, as enumerated in `fmr.h`.
+const PHASES: usize = 5;
+const PHASE_RECEIVED: usize = 0;
+const PHASE_VERIFIED: usize = 1;
+const PHASE_DISPATCHED: usize = 2;
+const PHASE_RETURNED: usize = 3;
+const PHASE_SENT: usize = 4;
+
+/// The functions of the `fmrtrace` module, by index.
+const FMRTRACE_ENABLE: u8 = 1;
+const FMRTRACE_READ: u8 = 2;
+
+/// How many calls are traced before their records are read back. The
+/// device holds 64 records.
+const TRACE_ROUND: usize = 32;
+
+/// The bytes that cross the device's UART for a call: a packet, then its result.
+const CALL_WIRE_BYTES: u32 = 64 + 9;
+
+/// The device's record of handling one packet.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct HandlingRecord {
+    /// The number of packets traced before this one in the same round.
+    pub seq: u32,
+    /// The packet's class.
+    pub class: u8,
+    /// The module called, if the packet was a call.
+    pub module: u8,
+    /// The function called, if the packet was a call.
+    pub function: u8,
+    /// A bit for each phase the device reached.
+    pub phases: u8,
+    /// The device's cycle counter at each phase.
+    pub cycles: [u32; PHASES],
+}
+
+impl HandlingRecord {
+    /// Decodes records laid out back to back as the device stores them.
+    pub fn parse_all(bytes: &[u8]) -> Vec<HandlingRecord> {
+        bytes.chunks(TRACE_RECORD_SIZE)
+            .filter(|chunk| chunk.len() == TRACE_RECORD_SIZE)
+            .map(|chunk| {
+                let mut cycles = [0; PHASES];
+                LittleEndian::read_u32_into(&chunk[8..], &mut cycles);
+                HandlingRecord {
+                    seq: LittleEndian::read_u32(&chunk[0..4]),
+                    class: chunk[4],
+                    module: chunk[5],
+                    function: chunk[6],
+                    phases: chunk[7],
+                    cycles,
+                }
+            })
+            .collect()
+    }
+
+    /// Whether the device reached every phase of handling the packet.
+    pub fn complete(&self) -> bool {
+        self.phases == (1 << PHASES) - 1
+    }
+
+    /// The cycles between two phases. The counter may wrap in between.
+    fn cycles_between(&self, from: usize, to: usize) -> u32 {
+        self.cycles[to].wrapping_sub(self.cycles[from])
+    }
+}
+
+/// Splits the round trips of traced calls into their parts, given each
+/// call's round trip as measured by the host and the device's record of
+/// handling it.
+///
+/// `clock` is the rate of the device's cycle counter, and `wire` is the
+/// time a call spends crossing the device's UART. Incomplete records are
+/// skipped. Returns `None` if no call could be broken down.
+pub fn split_round_trips(calls: &[(Duration, HandlingRecord)], clock: u32, wire: Duration) -> Option<Vec<PhaseLatency>> {
+    let calls: Vec<&(Duration, HandlingRecord)> = calls.iter().filter(|&&(_, ref record)| record.complete()).collect();
+    if calls.is_empty() || clock == 0 { return None; }
+
+    let to_duration = |cycles: u32| {
+        let nanos = u64::from(cycles) * 1_000_000_000 / u64::from(clock);
+        Duration::new(nanos / 1_000_000_000, (nanos % 1_000_000_000) as u32)
+    };
+    let between = |from: usize, to: usize| -> Vec<Duration> {
+        calls.iter().map(|&&(_, ref record)| to_duration(record.cycles_between(from, to))).collect()
+    };
+
+    let round_trips: Vec<Duration> = calls.iter().map(|&&(round_trip, _)| round_trip).collect();
+    let device = between(PHASE_RECEIVED, PHASE_SENT);
+    let queued: Vec<Duration> = round_trips.iter().zip(&device)
+        .map(|(&round_trip, &device)| {
+            round_trip.checked_sub(device).and_then(|rest| rest.checked_sub(wire)).unwrap_or_default()
+        })
+        .collect();
+
+    let phase = |phase: &str, samples: &[Duration]| PhaseLatency {
+        phase: phase.to_owned(),
+        // Safe because there is at least one call.
+        latency: Latency::from_samples(samples).unwrap(),
+    };
+
+    Some(vec![
+        phase("round trip", &round_trips),
+        phase("queued in host and bridge", &queued),
+        phase("uart (estimated)", &vec![wire; calls.len()]),
+        phase("device", &device),
+        phase("  verify", &between(PHASE_RECEIVED, PHASE_VERIFIED)),
+        phase("  dispatch", &between(PHASE_VERIFIED, PHASE_DISPATCHED)),
+        phase("  execute", &between(PHASE_DISPATCHED, PHASE_RETURNED)),
+        phase("  reply", &between(PHASE_RETURNED, PHASE_SENT)),
+    ])
+}
+
+/// Calls a module function with the device's `fmrtrace` module recording how
+/// it handles each call, and breaks the calls' round trips down into parts.
+///
+/// `baud` is the rate of the UART leading to the device, used to estimate
+/// the time spent on the wire.
+pub fn measure_breakdown<C: Client + ?Sized>(
+    client: &mut C,
+    module: &str,
+    function: u8,
+    ret: LfType,
+    args: &Args,
+    iterations: usize,
+    baud: u32,
+) -> Result<Breakdown, Error> {
+    let trace = client.resolve("fmrtrace")?;
+    let handle = client.resolve(module)?;
+    let clock = tasks::clock(client)?;
+    let buffer = client.malloc((TRACE_ROUND * TRACE_RECORD_SIZE) as u32)?;
+
+    let mut calls = Vec::with_capacity(iterations);
+    let measured: Result<(), Error> = (|| {
+        let mut remaining = iterations;
+        while remaining > 0 {
+            let round = remaining.min(TRACE_ROUND);
+            remaining -= round;
+
+            let mut enable = Args::new();
+            enable.append(1u8);
+            client.invoke_handle(trace, FMRTRACE_ENABLE, LfType::lf_int, &enable)?;
+
+            let mut round_trips = Vec::with_capacity(round);
+            for _ in 0..round {
+                let start = Instant::now();
+                client.invoke_handle(handle, function, ret, args)?;
+                round_trips.push(start.elapsed());
+            }
+
+            let mut disable = Args::new();
+            disable.append(0u8);
+            client.invoke_handle(trace, FMRTRACE_ENABLE, LfType::lf_int, &disable)?;
+
+            let mut read = Args::new();
+            read.append(buffer).append(round as u32);
+            let count = client.invoke_handle(trace, FMRTRACE_READ, LfType::lf_uint32, &read)? as usize;
+            let mut bytes = vec![0; count * TRACE_RECORD_SIZE];
+            client.pull(buffer, &mut bytes)?;
+
+            // Tracing restarts the sequence, so each record's number is the index of its call in the round.
+            for record in HandlingRecord::parse_all(&bytes) {
+                if let Some(&round_trip) = round_trips.get(record.seq as usize) {
+                    calls.push((round_trip, record));
+                }
+            }
+        }
+        Ok(())
+    })();
+
+    // Release the buffer even if a call failed.
+    client.free(buffer)?;
+    measured?;
+
+    let wire = Duration::from_micros(u64::from(CALL_WIRE_BYTES) * 10 * 1_000_000 / u64::from(baud.max(1)));
+    Ok(Breakdown {
+        module: module.to_owned(),
+        function,
+        phases: split_round_trips(&calls, clock, wire).ok_or_else(|| format_err!("the device recorded none of the calls"))?,
+    })
+}
+
+/// Whether a larger or smaller value of a metric is an improvement.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub enum Better {
+    /// A smaller value is an improvement, as for latency.
+    Lower,
+    /// A larger value is an improvement, as for throughput.
+    Higher,
+}
+
+/// The change in one metric between two reports.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct Delta {
+    /// The name of the metric.
+    pub metric: String,
+    /// The value in the earlier report.
+    pub baseline: f64,
+    /// The value in the later report.
+    pub current: f64,
+    /// Whether a larger or smaller value is an improvement.
+    pub better: Better,
+}
+
+impl Delta {
+    /// The relative change from the baseline, in percent.
+    pub fn change(&self) -> f64 {
+        (self.current - self.baseline) / self.baseline * 100.0
+    }
+
+    /// Whether the current value is worse than the baseline by more than `tolerance` percent.
+    pub fn regressed(&self, tolerance: f64) -> bool {
+        match self.better {
+            Better::Lower => self.change() > tolerance,
+            Better::Higher => self.change() < -tolerance,
+        }
+    }
+}
+
+impl Report {
+    /// Lists every metric of this report, with its name and which direction is better.
+    fn metrics(&self) -> Vec<(String, f64, Better)> {
+        let mut metrics = Vec::new();
+        for entry in &self.latency {
+            metrics.push((format!("latency {} p50 (us)", entry.transport), entry.latency.p50, Better::Lower));
+            metrics.push((format!("latency {} p99 (us)", entry.transport), entry.latency.p99, Better::Lower));
+        }
+        for entry in &self.throughput {
+            metrics.push((format!("push {} B (B/s)", entry.size), entry.push, Better::Higher));
+            metrics.push((format!("pull {} B (B/s)", entry.size), entry.pull, Better::Higher));
+        }
+        if let Some(ref calls) = self.calls {
+            let name = format!("{}[{}]", calls.module, calls.function);
+            metrics.push((format!("calls {} (calls/s)", name), calls.per_second, Better::Higher));
+            metrics.push((format!("calls {} p99 (us)", name), calls.latency.p99, Better::Lower));
+        }
+        if let Some(ref breakdown) = self.breakdown {
+            let name = format!("{}[{}]", breakdown.module, breakdown.function);
+            for entry in breakdown.phases.iter().filter(|entry| entry.phase == "device") {
+                metrics.push((format!("calls {} device p50 (us)", name), entry.latency.p50, Better::Lower));
+            }
+        }
+        metrics
+    }
+
+    /// Compares this report against an earlier one. Only metrics present in both are compared.
+    pub fn compare(&self, baseline: &Report) -> Vec<Delta> {
+        let before = baseline.metrics();
+        self.metrics().into_iter()
+            .filter_map(|(metric, current, better)| {
+                before.iter()
+                    .find(|&&(ref name, _, _)| *name == metric)
+                    .map(|&(_, baseline, _)| Delta { metric, baseline, current, better })
+            })
+            .collect()
+    }
+}
+
+impl fmt::Display for Report {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        if !self.latency.is_empty() {
+            writeln!(f, "{:<12} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10}",
+                     "transport", "samples", "min (us)", "p50 (us)", "p90 (us)", "p99 (us)", "max (us)")?;
+            for entry in &self.latency {
+                let l = &entry.latency;
+                writeln!(f, "{:<12} {:>8} {:>10.1} {:>10.1} {:>10.1} {:>10.1} {:>10.1}",
+                         entry.transport, l.samples, l.min, l.p50, l.p90, l.p99, l.max)?;
+            }
+            writeln!(f)?;
+        }
+
+        if !self.throughput.is_empty() {
+            writeln!(f, "{:<12} {:>14} {:>14}", "size (B)", "push (KiB/s)", "pull (KiB/s)")?;
+            for entry in &self.throughput {
+                writeln!(f, "{:<12} {:>14.1} {:>14.1}", entry.size, entry.push / 1024.0, entry.pull / 1024.0)?;
+            }
+            writeln!(f)?;
+        }
+
+        if let Some(ref calls) = self.calls {
+            writeln!(f, "{}[{}]: {} calls, {:.1} calls/s, p50 {:.1} us, p99 {:.1} us",
+                     calls.module, calls.function, calls.calls, calls.per_second,
+                     calls.latency.p50, calls.latency.p99)?;
+        }
+
+        if let Some(ref breakdown) = self.breakdown {
+            writeln!(f)?;
+            writeln!(f, "{:<26} {:>10} {:>10} {:>10} {:>10}", "phase", "p50 (us)", "p90 (us)", "p99 (us)", "mean (us)")?;
+            for entry in &breakdown.phases {
+                let l = &entry.latency;
+                writeln!(f, "{:<26} {:>10.1} {:>10.1} {:>10.1} {:>10.1}", entry.phase, l.p50, l.p90, l.p99, l.mean)?;
+            }
+        }
+        Ok(())
+    }
+}
+
+/// Prints a comparison as a table, marking metrics that regressed by more than `tolerance` percent.
+pub fn write_comparison<W: fmt::Write>(out: &mut W, deltas: &[Delta], tolerance: f64) -> fmt::Result {
+    writeln!(out, "{:<32} {:>14} {:>14} {:>9}", "metric", "baseline", "current", "change")?;
+    for delta in deltas {
+        let flag = if delta.regressed(tolerance) { "  REGRESSED" } else { "" };
+        writeln!(out, "{:<32} {:>14.1} {:>14.1} {:>+8.1}%{}",
+                 delta.metric, delta.baseline, delta.current, delta.change(), flag)?;
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    #[test]
+    fn test_latency_percentiles() {
+        let samples: Vec<Duration> = (1..101).rev().map(|us| Duration::from_micros(us)).collect();
+        let latency = Latency::from_samples(&samples).unwrap();
+        assert_eq!(latency.samples, 100);
+        assert_eq!(latency.min, 1.0);
+        assert_eq!(latency.p50, 50.0);
+        assert_eq!(latency.p90, 90.0);
+        assert_eq!(latency.p99, 99.0);
+        assert_eq!(latency.max, 100.0);
+        assert_eq!(latency.mean, 50.5);
+        assert_eq!(Latency::from_samples(&[]), None);
+    }
+
+    #[test]
+    fn test_compare() {
+        let latency = Latency { samples: 1, min: 1.0, p50: 100.0, p90: 1.0, p99: 200.0, max: 1.0, mean: 1.0 };
+        let baseline = Report {
+            latency: vec![TransportLatency { transport: "atsam4s".to_owned(), latency }],
+            throughput: vec![Throughput { size: 64, push: 1000.0, pull: 1000.0 }],
+            calls: None,
+            breakdown: None,
+        };
+        let current = Report {
+            latency: vec![TransportLatency { transport: "atsam4s".to_owned(), latency: Latency { p50: 150.0, ..latency } }],
+            throughput: vec![
+                Throughput { size: 64, push: 1200.0, pull: 1000.0 },
+                Throughput { size: 256, push: 1.0, pull: 1.0 },
+            ],
+            calls: None,
+            breakdown: None,
+        };
+
+        let deltas = current.compare(&baseline);
+        assert_eq!(deltas.len(), 4);
+        assert_eq!(deltas[0].metric, "latency atsam4s p50 (us)");
+        assert_eq!(deltas[0].change(), 50.0);
+        assert!(deltas[0].regressed(10.0));
+        assert!(!deltas[1].regressed(10.0));
+        assert_eq!(deltas[2].change(), 20.0);
+        assert!(!deltas[2].regressed(10.0));
+    }
+
+    #[test]
+    fn test_split_round_trips() {
+        let mut bytes = vec![7, 0, 0, 0, 0, 2, 3, 0x1F];
+        for &cycles in &[1000u32, 1960, 2920, 12520, 22120] {
+            bytes.extend_from_slice(&[cycles as u8, (cycles >> 8) as u8, (cycles >> 16) as u8, (cycles >> 24) as u8]);
+        }
+        let records = HandlingRecord::parse_all(&bytes);
+        assert_eq!(records, vec![HandlingRecord {
+            seq: 7, class: 0, module: 2, function: 3, phases: 0x1F, cycles: [1000, 1960, 2920, 12520, 22120],
+        }]);
+
+        // At 96 MHz, verifying and dispatching take 10 us each, executing and replying 100 us each.
+        let record = records[0];
+        let incomplete = HandlingRecord { phases: 0x0F, ..record };
+        let calls = vec![
+            (Duration::from_micros(1000), record),
+            (Duration::from_micros(10), incomplete),
+        ];
+        let phases = split_round_trips(&calls, 96_000_000, Duration::from_micros(730)).unwrap();
+
+        let p50: Vec<(&str, f64)> = phases.iter().map(|entry| (entry.phase.as_str(), entry.latency.p50)).collect();
+        assert_eq!(p50, vec![
+            ("round trip", 1000.0),
+            ("queued in host and bridge", 50.0),
+            ("uart (estimated)", 730.0),
+            ("device", 220.0),
+            ("  verify", 10.0),
+            ("  dispatch", 10.0),
+            ("  execute", 100.0),
+            ("  reply", 100.0),
+        ]);
+        assert_eq!(split_round_trips(&calls[1..], 96_000_000, Duration::from_micros(730)), None);
+    }
+}
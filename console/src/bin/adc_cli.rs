@@ -0,0 +1,99 @@
+//! The `flipper adc` command streams samples from the ADC of the ATSAM4S.
+//!
+//! The device converts a sequence of channels at a fixed rate into blocks,
+//! which are pulled to the host several at a time. The command reports the
+//! rate it achieved and any samples lost along the way, and can write every
+//! sample, with the time it was taken, as CSV.
+//!
+//! For example:
+//! ```
+//! $ flipper adc --channels 0,1 --rate 10000 --duration 5 --output samples.csv
+//! ```
+
+use std::fs::File;
+use std::io::{BufWriter, Write};
+use std::time::{Duration, Instant};
+use clap::{App, AppSettings, Arg, ArgMatches};
+use failure::Error;
+use flipper::Flipper;
+use console::adc;
+use console::parse_value;
+
+pub fn make_subcommand<'a, 'b>() -> App<'a, 'b> {
+    App::new("adc")
+        .settings(&[
+            AppSettings::DeriveDisplayOrder,
+            AppSettings::ColoredHelp,
+        ])
+        .about("Stream samples from the ADC of the attached Flipper")
+        .arg(Arg::with_name("channels")
+            .short("c")
+            .long("channels")
+            .takes_value(true)
+            .default_value("0")
+            .help("The channels to convert on each trigger, in order, separated by commas"))
+        .arg(Arg::with_name("rate")
+            .short("r")
+            .long("rate")
+            .takes_value(true)
+            .default_value("1000")
+            .help("How many times per second to convert the channels"))
+        .arg(Arg::with_name("duration")
+            .short("d")
+            .long("duration")
+            .takes_value(true)
+            .default_value("5")
+            .help("How many seconds to stream for"))
+        .arg(Arg::with_name("output")
+            .short("o")
+            .long("output")
+            .takes_value(true)
+            .value_name("FILE")
+            .help("Write every sample to a CSV file"))
+}
+
+pub fn execute(args: &ArgMatches) -> Result<(), Error> {
+    // These are safe because each argument has a default value.
+    let channels = args.value_of("channels").unwrap().split(',')
+        .map(|channel| parse_value("--channels", channel.trim()))
+        .collect::<Result<Vec<u8>, _>>()?;
+    let rate: u32 = parse_value("--rate", args.value_of("rate").unwrap())?;
+    let duration = Duration::from_secs(parse_value("--duration", args.value_of("duration").unwrap())?);
+
+    let mut output = match args.value_of("output") {
+        Some(path) => {
+            let mut out = BufWriter::new(File::create(path)?);
+            writeln!(out, "seconds,channel,value")?;
+            Some(out)
+        }
+        None => None,
+    };
+
+    let mut flipper = Flipper::attach().map_err(Error::from)?;
+    let (mut samples, mut gaps, mut achieved) = (0usize, 0usize, 0.0);
+    let start = Instant::now();
+    let dropped = adc::stream(&mut flipper, rate, &channels, |timing, blocks| {
+        achieved = timing.rate();
+        for block in &blocks {
+            samples += block.samples.len();
+            if block.gap { gaps += 1; }
+            if let Some(ref mut out) = output {
+                for (i, sample) in block.samples.iter().enumerate() {
+                    writeln!(out, "{:.7},{},{}", timing.seconds(block.first + i as u32), sample.channel, sample.value)?;
+                }
+            }
+        }
+        Ok(start.elapsed() < duration)
+    })?;
+    let elapsed = start.elapsed();
+    if let Some(ref mut out) = output { out.flush()?; }
+    let seconds = elapsed.as_secs() as f64 + f64::from(elapsed.subsec_nanos()) / 1e9;
+
+    println!("{} samples in {:.2}s ({:.0} samples/s), triggered at {:.2} Hz",
+             samples, seconds, samples as f64 / seconds, achieved);
+    println!("{} blocks dropped, {} gaps", dropped, gaps);
+    if let Some(path) = args.value_of("output") {
+        println!("Samples written to {}", path);
+    }
+    Ok(())
+}
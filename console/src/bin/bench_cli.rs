@@ -0,0 +1,171 @@
+//! The `flipper bench` command measures the performance of an attached
+//! Flipper: round-trip latency over each transport, push/pull throughput
+//! across buffer sizes, and the call rate of a chosen module function.
+//! With `--breakdown`, the chosen function's round trips are also split into
+//! the time spent in each phase of handling it on the device.
+//!
+//! A run can be saved as JSON and later used as the baseline of another
+//! run, in which case the differences are printed and any metric that got
+//! worse by more than the tolerance fails the command.
+//!
+//! For example:
+//! ```
+//! $ flipper bench --output carbon.json
+//! $ flipper bench --call gpio 3 --arg 255 --compare carbon.json
+//! $ flipper bench --no-latency --no-throughput --call gpio 3 --arg 255 --breakdown
+//! ```
+
+use std::fs::File;
+use clap::{App, AppSettings, Arg, ArgMatches};
+use failure::Error;
+use flipper::{Args, Flipper, LfType};
+use console::bench::{self, Report, TransportLatency};
+use console::parse_value;
+
+#[derive(Debug, Fail)]
+enum BenchError {
+    #[fail(display = "{} of {} metrics regressed by more than {}%", _0, _1, _2)]
+    Regressed(usize, usize, f64),
+}
+
+pub fn make_subcommand<'a, 'b>() -> App<'a, 'b> {
+    App::new("bench")
+        .settings(&[
+            AppSettings::DeriveDisplayOrder,
+            AppSettings::ColoredHelp,
+        ])
+        .about("Measure the latency and throughput of an attached Flipper")
+        .arg(Arg::with_name("iterations")
+            .short("n")
+            .long("iterations")
+            .takes_value(true)
+            .default_value("1000")
+            .help("The number of round trips or calls to time"))
+        .arg(Arg::with_name("sizes")
+            .long("sizes")
+            .takes_value(true)
+            .use_delimiter(true)
+            .help("Buffer sizes in bytes to measure push/pull throughput at [default: 64,256,1024,4096]"))
+        .arg(Arg::with_name("call")
+            .long("call")
+            .takes_value(true)
+            .number_of_values(2)
+            .value_names(&["MODULE", "FUNCTION"])
+            .help("Measure the call rate of a module function, given by its index"))
+        .arg(Arg::with_name("arg")
+            .long("arg")
+            .takes_value(true)
+            .multiple(true)
+            .number_of_values(1)
+            .requires("call")
+            .help("A 32-bit argument to pass to the function given by --call"))
+        .arg(Arg::with_name("breakdown")
+            .long("breakdown")
+            .requires("call")
+            .help("Trace the calls on the device to show where their round trips go"))
+        .arg(Arg::with_name("baud")
+            .long("baud")
+            .takes_value(true)
+            .default_value("1000000")
+            .help("The baud rate of the device's UART, used by --breakdown to estimate time on the wire"))
+        .arg(Arg::with_name("no-latency")
+            .long("no-latency")
+            .help("Skip the transport latency benchmark"))
+        .arg(Arg::with_name("no-throughput")
+            .long("no-throughput")
+            .help("Skip the push/pull throughput benchmark"))
+        .arg(Arg::with_name("json")
+            .long("json")
+            .help("Print the results as JSON instead of tables"))
+        .arg(Arg::with_name("output")
+            .short("o")
+            .long("output")
+            .takes_value(true)
+            .help("Save the results as JSON, for use with --compare"))
+        .arg(Arg::with_name("compare")
+            .long("compare")
+            .takes_value(true)
+            .value_name("BASELINE")
+            .help("Compare the results against a report saved with --output"))
+        .arg(Arg::with_name("tolerance")
+            .long("tolerance")
+            .takes_value(true)
+            .default_value("5")
+            .help("The percentage a metric may get worse by before --compare fails"))
+}
+
+pub fn execute(args: &ArgMatches) -> Result<(), Error> {
+    // These are safe because the arguments have default values.
+    let iterations: usize = parse_value("--iterations", args.value_of("iterations").unwrap())?;
+    let tolerance: f64 = parse_value("--tolerance", args.value_of("tolerance").unwrap())?;
+    let baud: u32 = parse_value("--baud", args.value_of("baud").unwrap())?;
+
+    let sizes: Vec<u32> = match args.values_of("sizes") {
+        Some(sizes) => sizes.map(|size| parse_value("--sizes", size)).collect::<Result<_, _>>()?,
+        None => bench::DEFAULT_SIZES.to_vec(),
+    };
+
+    let mut flipper = Flipper::attach().map_err(Error::from)?;
+    let mut report = Report::default();
+
+    if !args.is_present("no-latency") {
+        for &(transport, module) in bench::TRANSPORT_PROBES {
+            let latency = bench::measure_latency(&mut flipper, module, iterations)?;
+            report.latency.push(TransportLatency { transport: transport.to_owned(), latency });
+        }
+    }
+
+    if !args.is_present("no-throughput") {
+        // Transfers are much slower than round trips, so make fewer of them.
+        let transfers = (iterations / 10).max(1);
+        for &size in &sizes {
+            report.throughput.push(bench::measure_throughput(&mut flipper, size, transfers)?);
+        }
+    }
+
+    if let Some(mut call) = args.values_of("call") {
+        // Safe because --call takes exactly two values.
+        let module = call.next().unwrap();
+        let function: u8 = parse_value("--call", call.next().unwrap())?;
+
+        let mut call_args = Args::new();
+        for arg in args.values_of("arg").into_iter().flat_map(|values| values) {
+            call_args.append(parse_value::<u32>("--arg", arg)?);
+        }
+
+        // The return value is discarded, so every function can be timed as returning a u32.
+        let rate = bench::measure_calls(&mut flipper, module, function, LfType::lf_uint32, &call_args, iterations)?;
+        report.calls = Some(rate);
+
+        if args.is_present("breakdown") {
+            let breakdown = bench::measure_breakdown(&mut flipper, module, function, LfType::lf_uint32, &call_args, iterations, baud)?;
+            report.breakdown = Some(breakdown);
+        }
+    }
+
+    if args.is_present("json") {
+        println!("{}", ::serde_json::to_string_pretty(&report)?);
+    } else {
+        print!("{}", report);
+    }
+
+    if let Some(path) = args.value_of("output") {
+        ::serde_json::to_writer_pretty(File::create(path)?, &report)?;
+    }
+
+    if let Some(path) = args.value_of("compare") {
+        let baseline: Report = ::serde_json::from_reader(File::open(path)?)?;
+        let deltas = report.compare(&baseline);
+
+        let mut table = String::new();
+        bench::write_comparison(&mut table, &deltas, tolerance)?;
+        print!("\n{}", table);
+
+        let regressed = deltas.iter().filter(|delta| delta.regressed(tolerance)).count();
+        if regressed > 0 {
+            Err(BenchError::Regressed(regressed, deltas.len(), tolerance))?;
+        }
+    }
+
+    Ok(())
+}
@@ -5,6 +5,8 @@ use std::io::Error as IoError;
 use clap::{App, AppSettings, Arg, ArgMatches};
 use failure::Error;
 use console::bindings;
+use console::bindings::cache::BindingCache;
+use console::bindings::generators::GeneratorOptions;
 
 #[derive(Debug, Fail)]
 #[fail(display = "Errors that occur while generating bindings")]
@@ -56,6 +58,12 @@ pub fn make_subcommand<'a, 'b>() -> App<'a, 'b> {
             .takes_value(true)
             .required(false)
             .help("The language to generate. Defaults to \"c\"."))
+        .arg(Arg::with_name("no-cache")
+            .long("no-cache")
+            .help("Parse the module even if it was parsed before"))
+        .arg(Arg::with_name("batched")
+            .long("batched")
+            .help("Also generate variants of each function that perform many calls at once"))
 }
 
 pub fn execute(args: &ArgMatches) -> Result<(), Error> {
@@ -83,10 +91,15 @@ pub fn execute(args: &ArgMatches) -> Result<(), Error> {
     let mut out = File::create(out_file)
         .map_err(|e| BindingError::FileError(out_file.to_owned(), e))?;
 
-    let module = bindings::Module::parse(String::from(module_name), "".to_owned(), &module_binary)?;
+    let cache = if args.is_present("no-cache") { None } else { BindingCache::default_location() };
+    let module = match cache {
+        Some(ref cache) => bindings::Module::parse_cached(String::from(module_name), "".to_owned(), &module_binary, cache)?,
+        None => bindings::Module::parse(String::from(module_name), "".to_owned(), &module_binary)?,
+    };
 
+    let options = GeneratorOptions { batched: args.is_present("batched") };
     match language {
-        OutputLanguage::C => bindings::generators::c::generate_module(module, &mut out),
-        OutputLanguage::Swift => bindings::generators::swift::generate_module(module, &mut out),
+        OutputLanguage::C => bindings::generators::c::generate_module_with_options(module, &options, &mut out),
+        OutputLanguage::Swift => bindings::generators::swift::generate_module_with_options(module, &options, &mut out),
     }
 }
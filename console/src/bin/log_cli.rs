@@ -0,0 +1,73 @@
+//! The `flipper log` command prints what the ATSAM4S writes to its standard
+//! output.
+//!
+//! The device keeps its output in a log in memory rather than writing it to
+//! the UART it talks FMR over, so printing never stalls the device or
+//! disturbs the host's calls. This command drains that log and prints each
+//! line stamped with the time it was written and the PID of the task that
+//! wrote it. It follows the log until interrupted, like `tail -f`.
+//!
+//! For example:
+//! ```
+//! $ flipper log --poll 50
+//! ```
+
+use std::io::{self, Write};
+use std::thread;
+use std::time::Duration;
+use clap::{App, AppSettings, Arg, ArgMatches};
+use failure::Error;
+use flipper::Flipper;
+use console::devlog::{self, Printer};
+use console::tasks;
+use console::parse_value;
+
+pub fn make_subcommand<'a, 'b>() -> App<'a, 'b> {
+    App::new("log")
+        .settings(&[
+            AppSettings::DeriveDisplayOrder,
+            AppSettings::ColoredHelp,
+        ])
+        .about("Print the output of the attached Flipper as it is written")
+        .arg(Arg::with_name("poll")
+            .short("p")
+            .long("poll")
+            .takes_value(true)
+            .default_value("100")
+            .value_name("MILLISECONDS")
+            .help("How long to wait before checking an empty log again"))
+        .arg(Arg::with_name("once")
+            .long("once")
+            .help("Print what the log holds, then exit"))
+}
+
+pub fn execute(args: &ArgMatches) -> Result<(), Error> {
+    // This is safe because "poll" has a default value.
+    let poll = args.value_of("poll").unwrap();
+    let millis: u64 = parse_value("--poll", poll)?;
+
+    let mut flipper = Flipper::attach().map_err(Error::from)?;
+    let mut printer = Printer::new(tasks::clock(&mut flipper)?);
+    let mut dropped = devlog::dropped(&mut flipper)?;
+
+    let stdout = io::stdout();
+    loop {
+        let records = devlog::drain(&mut flipper)?;
+        let mut out = stdout.lock();
+        for record in &records {
+            printer.write(&mut out, record)?;
+        }
+        out.flush()?;
+
+        let now = devlog::dropped(&mut flipper)?;
+        if now != dropped {
+            eprintln!("({} records dropped while the device log was full)", now.wrapping_sub(dropped));
+            dropped = now;
+        }
+
+        if args.is_present("once") { return Ok(()); }
+        if records.is_empty() {
+            thread::sleep(Duration::from_millis(millis));
+        }
+    }
+}
@@ -33,12 +33,19 @@ extern crate rustyline;
 extern crate byteorder;
 extern crate libc;
 extern crate indicatif;
+extern crate serde_json;
 extern crate flipper;
 extern crate flipper_console as console;
 
 mod modules_cli;
 mod hardware_cli;
 mod bindings_cli;
+mod bench_cli;
+mod trace_cli;
+mod profile_cli;
+mod tasks_cli;
+mod log_cli;
+mod adc_cli;
 
 use failure::Error;
 use console::CliError;
@@ -81,6 +88,12 @@ pub fn app() -> App<'static, 'static> {
         ])
         .subcommand(modules_cli::make_subcommand())
         .subcommand(bindings_cli::make_subcommand())
+        .subcommand(bench_cli::make_subcommand())
+        .subcommand(trace_cli::make_subcommand())
+        .subcommand(profile_cli::make_subcommand())
+        .subcommand(tasks_cli::make_subcommand())
+        .subcommand(log_cli::make_subcommand())
+        .subcommand(adc_cli::make_subcommand())
         .subcommands(hardware_cli::make_subcommands())
 }
 
@@ -93,6 +106,12 @@ pub fn execute(args: &ArgMatches) -> Result<()> {
     match args.subcommand() {
         ("module", Some(m)) => modules_cli::execute(m),
         ("generate", Some(m)) => bindings_cli::execute(m),
+        ("bench", Some(m)) => bench_cli::execute(m),
+        ("trace", Some(m)) => trace_cli::execute(m),
+        ("profile", Some(m)) => profile_cli::execute(m),
+        ("tasks", Some(m)) => tasks_cli::execute(m),
+        ("log", Some(m)) => log_cli::execute(m),
+        ("adc", Some(m)) => adc_cli::execute(m),
         (c @ "boot", Some(m)) => hardware_cli::execute(c, m),
         (c @ "flash", Some(m)) => hardware_cli::execute(c, m),
         (unknown, _) => Err(CliError::UnrecognizedCommand(unknown.to_owned()).into()),
@@ -0,0 +1,97 @@
+//! The `flipper profile` command shows where the ATSAM4S spends its time.
+//!
+//! While the command runs, the device's `prof` module samples the processor
+//! from a timer interrupt. The samples are pulled to the host, matched to
+//! functions using the debugging information of the firmware image that is
+//! running, and printed as a flat profile. They can also be written as folded
+//! stacks, the input format of flamegraph tools.
+//!
+//! For example:
+//! ```
+//! $ flipper profile build/atsam4s/atsam4s.elf --duration 10
+//! $ flipper profile build/atsam4s/atsam4s.elf --rate 2000 --folded atsam4s.folded
+//! $ flamegraph.pl atsam4s.folded > atsam4s.svg
+//! ```
+
+use std::fs::File;
+use std::io::{BufWriter, Read};
+use std::time::Duration;
+use clap::{App, AppSettings, Arg, ArgMatches};
+use failure::Error;
+use flipper::Flipper;
+use console::profile::{self, Profile, Symbolizer};
+use console::parse_value;
+
+#[derive(Debug, Fail)]
+enum ProfileError {
+    #[fail(display = "no functions with debugging information were found in {}", _0)]
+    NoSymbols(String),
+}
+
+pub fn make_subcommand<'a, 'b>() -> App<'a, 'b> {
+    App::new("profile")
+        .settings(&[
+            AppSettings::ArgRequiredElseHelp,
+            AppSettings::DeriveDisplayOrder,
+            AppSettings::ColoredHelp,
+        ])
+        .about("Sample where the attached Flipper spends its time")
+        .arg(Arg::with_name("image")
+            .required(true)
+            .help("The ELF image of the firmware running on the device"))
+        .arg(Arg::with_name("rate")
+            .short("r")
+            .long("rate")
+            .takes_value(true)
+            .default_value("1000")
+            .help("How many samples to take per second"))
+        .arg(Arg::with_name("duration")
+            .short("d")
+            .long("duration")
+            .takes_value(true)
+            .default_value("5")
+            .help("How many seconds to sample for"))
+        .arg(Arg::with_name("top")
+            .short("n")
+            .long("top")
+            .takes_value(true)
+            .default_value("25")
+            .help("How many of the most sampled functions to print"))
+        .arg(Arg::with_name("folded")
+            .long("folded")
+            .takes_value(true)
+            .value_name("FILE")
+            .help("Also write the samples as folded stacks, for flamegraph tools"))
+}
+
+pub fn execute(args: &ArgMatches) -> Result<(), Error> {
+    // These are safe because "image" is required and the others have default values.
+    let image = args.value_of("image").unwrap();
+    let rate: u32 = parse_value("--rate", args.value_of("rate").unwrap())?;
+    let duration: u64 = parse_value("--duration", args.value_of("duration").unwrap())?;
+    let top: usize = parse_value("--top", args.value_of("top").unwrap())?;
+
+    let mut buffer = Vec::new();
+    File::open(image)?.read_to_end(&mut buffer)?;
+    let symbols = Symbolizer::from_elf(&buffer)?;
+    if symbols.is_empty() {
+        Err(ProfileError::NoSymbols(image.to_owned()))?;
+    }
+
+    let mut flipper = Flipper::attach().map_err(Error::from)?;
+    let (samples, dropped) = profile::record(&mut flipper, rate, Duration::from_secs(duration))?;
+    let profile = Profile::new(&samples, &symbols, dropped);
+
+    println!("{} samples over {}s at {} Hz, {} dropped", profile.samples, duration, rate, profile.dropped);
+    if profile.samples > 0 {
+        let mut table = String::new();
+        profile.write_flat(&mut table, Some(top))?;
+        print!("{}", table);
+    }
+
+    if let Some(path) = args.value_of("folded") {
+        profile.write_folded(&mut BufWriter::new(File::create(path)?))?;
+        println!("Folded stacks written to {}", path);
+    }
+    Ok(())
+}
@@ -0,0 +1,51 @@
+//! The `flipper tasks` command shows the tasks running on the ATSAM4S.
+//!
+//! For each task it prints the share of the processor the task used over an
+//! interval, how often it was switched in, and the most of its stack it has
+//! ever used. This is how to find a task hogging the processor, and how to
+//! size the stacks of applications.
+//!
+//! For example:
+//! ```
+//! $ flipper tasks --interval 5
+//! ```
+
+use std::thread;
+use std::time::Duration;
+use clap::{App, AppSettings, Arg, ArgMatches};
+use failure::Error;
+use flipper::Flipper;
+use console::tasks;
+use console::parse_value;
+
+pub fn make_subcommand<'a, 'b>() -> App<'a, 'b> {
+    App::new("tasks")
+        .settings(&[
+            AppSettings::DeriveDisplayOrder,
+            AppSettings::ColoredHelp,
+        ])
+        .about("Show the CPU and stack use of the tasks on the attached Flipper")
+        .arg(Arg::with_name("interval")
+            .short("i")
+            .long("interval")
+            .takes_value(true)
+            .default_value("1")
+            .help("How many seconds to measure CPU use over"))
+}
+
+pub fn execute(args: &ArgMatches) -> Result<(), Error> {
+    // This is safe because "interval" has a default value.
+    let interval = args.value_of("interval").unwrap();
+    let seconds: u64 = parse_value("--interval", interval)?;
+
+    let mut flipper = Flipper::attach().map_err(Error::from)?;
+    let before = tasks::snapshot(&mut flipper)?;
+    thread::sleep(Duration::from_secs(seconds));
+    let after = tasks::snapshot(&mut flipper)?;
+
+    println!("{} tasks, {} context switches in {}s", after.tasks.len(), after.switches.wrapping_sub(before.switches), seconds);
+    let mut table = String::new();
+    tasks::write_table(&mut table, &tasks::usage(&before, &after))?;
+    print!("{}", table);
+    Ok(())
+}
@@ -0,0 +1,213 @@
+//! The `flipper trace` command records and inspects the FMR traffic between
+//! a host program and Flipper.
+//!
+//! Programs using the Flipper library capture their traffic when the
+//! `FLIPPER_TRACE` environment variable names a file, which is what
+//! `flipper trace record` sets up. A program that attaches several devices
+//! writes the capture of each after the first to a numbered file, such as
+//! `blink.1.trace`. Captures can then be filtered and printed,
+//! or exported to pcapng for standard packet analysis tools.
+//!
+//! A capture recorded with `--payloads` holds a complete session, which
+//! `flipper trace replay` plays back against a stand-in device, such as a
+//! host emulator, to compare its timing with the recording.
+//!
+//! For example:
+//! ```
+//! $ flipper trace record -o blink.trace -- ./blink
+//! $ flipper trace show blink.trace --module led --slower-than 500
+//! $ flipper trace export blink.trace blink.pcapng --class call
+//! $ flipper trace record --payloads -o session.trace -- ./workload
+//! $ flipper trace replay session.trace localhost
+//! ```
+
+use std::fs::File;
+use std::io::BufWriter;
+use std::process::Command;
+use clap::{App, AppSettings, Arg, ArgMatches};
+use failure::Error;
+use console::CliError;
+use console::trace::{self, Filter, ReplaySummary};
+use flipper::{Flipper, FMR_UDP_PORT};
+use flipper::replay;
+use flipper::trace::{CaptureReader, TRACE_ENV, TRACE_PAYLOADS_ENV};
+
+#[derive(Debug, Fail)]
+enum TraceError {
+    #[fail(display = "invalid latency '{}'", _0)]
+    InvalidLatency(String),
+    #[fail(display = "invalid port '{}'", _0)]
+    InvalidPort(String),
+    #[fail(display = "'{}' exited with {}", _0, _1)]
+    CommandFailed(String, ::std::process::ExitStatus),
+}
+
+pub fn make_subcommand<'a, 'b>() -> App<'a, 'b> {
+    App::new("trace")
+        .settings(&[
+            AppSettings::ArgRequiredElseHelp,
+            AppSettings::DeriveDisplayOrder,
+            AppSettings::ColoredHelp,
+        ])
+        .about("Record and inspect FMR traffic")
+        .subcommands(vec![
+            App::new("record")
+                .about("Run a program, capturing the traffic it sends to Flipper")
+                .arg(Arg::with_name("output")
+                    .short("o")
+                    .long("output")
+                    .takes_value(true)
+                    .default_value("flipper.trace")
+                    .help("The capture file to write"))
+                .arg(Arg::with_name("payloads")
+                    .long("payloads")
+                    .help("Also record pushed and pulled data, so the session can be replayed"))
+                .arg(Arg::with_name("command")
+                    .required(true)
+                    .multiple(true)
+                    .last(true)
+                    .help("The program to run, and its arguments")),
+            App::new("show")
+                .about("Print the records of a capture")
+                .arg(Arg::with_name("capture")
+                    .required(true)
+                    .help("The capture file to read"))
+                .args(&filter_args()),
+            App::new("export")
+                .about("Convert a capture to pcapng")
+                .arg(Arg::with_name("capture")
+                    .required(true)
+                    .help("The capture file to read"))
+                .arg(Arg::with_name("output")
+                    .required(true)
+                    .help("The pcapng file to write"))
+                .args(&filter_args()),
+            App::new("replay")
+                .about("Play a recorded session back against a stand-in device and compare timings")
+                .arg(Arg::with_name("capture")
+                    .required(true)
+                    .help("The capture file to replay"))
+                .arg(Arg::with_name("host")
+                    .required(true)
+                    .help("The host of a networked device or emulator to replay against"))
+                .arg(Arg::with_name("port")
+                    .long("port")
+                    .takes_value(true)
+                    .help("The UDP port the stand-in serves FMR on [default: 3258]"))
+                .arg(Arg::with_name("summary")
+                    .long("summary")
+                    .help("Only print the totals, not every operation")),
+        ])
+}
+
+fn filter_args<'a, 'b>() -> Vec<Arg<'a, 'b>> {
+    vec![
+        Arg::with_name("module")
+            .long("module")
+            .takes_value(true)
+            .help("Keep only records concerning this module"),
+        Arg::with_name("class")
+            .long("class")
+            .takes_value(true)
+            .multiple(true)
+            .number_of_values(1)
+            .possible_values(&["call", "push", "pull", "dyld", "malloc", "free", "resolve", "payload"])
+            .help("Keep only records of this class"),
+        Arg::with_name("slower-than")
+            .long("slower-than")
+            .takes_value(true)
+            .value_name("MICROSECONDS")
+            .help("Keep only records that took at least this long"),
+    ]
+}
+
+fn filter(args: &ArgMatches) -> Result<Filter, Error> {
+    let slower_than = match args.value_of("slower-than") {
+        Some(latency) => Some(latency.parse().map_err(|_| TraceError::InvalidLatency(latency.to_owned()))?),
+        None => None,
+    };
+
+    Ok(Filter {
+        module: args.value_of("module").map(|module| module.to_owned()),
+        classes: args.values_of("class").into_iter().flat_map(|classes| classes).map(|class| class.to_owned()).collect(),
+        slower_than,
+    })
+}
+
+pub fn execute(args: &ArgMatches) -> Result<(), Error> {
+    match args.subcommand() {
+        ("record", Some(m)) => record(m),
+        ("show", Some(m)) => show(m),
+        ("export", Some(m)) => export(m),
+        ("replay", Some(m)) => replay_capture(m),
+        (unknown, _) => Err(CliError::UnrecognizedCommand(unknown.to_owned()).into()),
+    }
+}
+
+fn record(args: &ArgMatches) -> Result<(), Error> {
+    // These are safe because "output" has a default and "command" is required.
+    let output = args.value_of("output").unwrap();
+    let mut command = args.values_of("command").unwrap();
+    let program = command.next().unwrap();
+
+    let mut child = Command::new(program);
+    child.args(command).env(TRACE_ENV, output);
+    if args.is_present("payloads") {
+        child.env(TRACE_PAYLOADS_ENV, "1");
+    }
+    let status = child.status()?;
+
+    info!("Trace of '{}' written to {}", program, output);
+    if !status.success() {
+        Err(TraceError::CommandFailed(program.to_owned(), status))?;
+    }
+    Ok(())
+}
+
+fn show(args: &ArgMatches) -> Result<(), Error> {
+    // This is safe because "capture" is a required argument.
+    let capture = args.value_of("capture").unwrap();
+    let (_, entries) = trace::read_capture(File::open(capture)?, &filter(args)?)?;
+
+    for entry in &entries {
+        println!("{}", entry);
+    }
+    Ok(())
+}
+
+fn export(args: &ArgMatches) -> Result<(), Error> {
+    // These are safe because "capture" and "output" are required arguments.
+    let capture = args.value_of("capture").unwrap();
+    let output = args.value_of("output").unwrap();
+    let (epoch, entries) = trace::read_capture(File::open(capture)?, &filter(args)?)?;
+
+    let mut out = BufWriter::new(File::create(output)?);
+    trace::write_pcapng(&mut out, epoch, &entries)?;
+    println!("Exported {} records to {}", entries.len(), output);
+    Ok(())
+}
+
+fn replay_capture(args: &ArgMatches) -> Result<(), Error> {
+    // These are safe because "capture" and "host" are required arguments.
+    let capture = args.value_of("capture").unwrap();
+    let host = args.value_of("host").unwrap();
+    let port = match args.value_of("port") {
+        Some(port) => port.parse().map_err(|_| TraceError::InvalidPort(port.to_owned()))?,
+        None => FMR_UDP_PORT,
+    };
+
+    let records = CaptureReader::new(File::open(capture)?)?.collect::<Result<Vec<_>, _>>()?;
+    let mut stand_in = Flipper::attach_network((host, port))?;
+    let replayed = replay::replay(&mut stand_in, records)?;
+
+    if !args.is_present("summary") {
+        let mut table = String::new();
+        trace::write_replay(&mut table, &replayed)?;
+        println!("{}", table);
+    }
+    match ReplaySummary::new(&replayed) {
+        Some(summary) => println!("{}", summary),
+        None => println!("Nothing to replay in {}", capture),
+    }
+    Ok(())
+}
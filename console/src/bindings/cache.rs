@@ -0,0 +1,97 @@
+//! Cache the module APIs parsed from Flipper binaries.
+//!
+//! Walking the DWARF information of a large module dominates the time it takes
+//! to generate its bindings, even though the result only changes when the
+//! binary does. The functions parsed from a binary are stored on disk under a
+//! hash of the binary's contents, so regenerating bindings for an unchanged
+//! module skips parsing entirely.
+//!
+//! Entries are kept in a directory per console version, so a change to the
+//! parser never reads an entry written by an older one.
+
+use std::env;
+use std::fs::{self, File};
+use std::io::{BufReader, BufWriter};
+use std::path::PathBuf;
+
+use failure::Error;
+use serde_json;
+
+use super::Function;
+
+/// Hashes the contents of a binary using 64-bit FNV-1a.
+///
+/// FNV is used rather than `DefaultHasher` because its output is fixed, so keys
+/// remain valid across toolchain upgrades.
+pub fn content_hash(binary: &[u8]) -> u64 {
+    const FNV_OFFSET_BASIS: u64 = 0xcbf2_9ce4_8422_2325;
+    const FNV_PRIME: u64 = 0x0000_0100_0000_01b3;
+
+    binary.iter().fold(FNV_OFFSET_BASIS, |hash, &byte| {
+        (hash ^ u64::from(byte)).wrapping_mul(FNV_PRIME)
+    })
+}
+
+/// A directory of parsed module APIs, keyed by the content hash of the binary
+/// they were parsed from.
+#[derive(Debug, Clone)]
+pub struct BindingCache {
+    dir: PathBuf,
+}
+
+impl BindingCache {
+    /// Creates a cache that stores its entries under `dir`.
+    pub fn new<P: Into<PathBuf>>(dir: P) -> Self {
+        BindingCache { dir: dir.into().join(env!("CARGO_PKG_VERSION")) }
+    }
+
+    /// Creates a cache in the default location.
+    ///
+    /// This is `$FLIPPER_CACHE_DIR` if it is set, otherwise `flipper/bindings`
+    /// within `$XDG_CACHE_HOME` or `$HOME/.cache`. Returns `None` if none of
+    /// these variables are set.
+    pub fn default_location() -> Option<Self> {
+        if let Some(dir) = env::var_os("FLIPPER_CACHE_DIR") {
+            return Some(BindingCache::new(dir));
+        }
+
+        env::var_os("XDG_CACHE_HOME").map(PathBuf::from)
+            .or_else(|| env::var_os("HOME").map(|home| PathBuf::from(home).join(".cache")))
+            .map(|cache| BindingCache::new(cache.join("flipper").join("bindings")))
+    }
+
+    fn entry(&self, hash: u64) -> PathBuf {
+        self.dir.join(format!("{:016x}.json", hash))
+    }
+
+    /// Returns the functions stored for the binary with the given hash, if any.
+    ///
+    /// Entries that can't be read are treated as missing.
+    pub fn load(&self, hash: u64) -> Option<Vec<Function>> {
+        let file = File::open(self.entry(hash)).ok()?;
+        match serde_json::from_reader(BufReader::new(file)) {
+            Ok(functions) => Some(functions),
+            Err(e) => {
+                warn!("ignoring unreadable binding cache entry {:016x}: {}", hash, e);
+                None
+            }
+        }
+    }
+
+    /// Stores the functions parsed from the binary with the given hash.
+    ///
+    /// The entry is written to a temporary file first and then renamed into
+    /// place, so concurrent runs never observe a partial entry.
+    pub fn store(&self, hash: u64, functions: &[Function]) -> Result<(), Error> {
+        fs::create_dir_all(&self.dir)?;
+
+        let entry = self.entry(hash);
+        let partial = entry.with_extension(format!("json.{}", std::process::id()));
+        {
+            let file = File::create(&partial)?;
+            serde_json::to_writer(BufWriter::new(file), functions)?;
+        }
+        fs::rename(&partial, &entry)?;
+        Ok(())
+    }
+}
@@ -10,6 +10,10 @@
 //! the start. All other types (which will eventually be represented as
 //! `Type::Reference`s) are parsed into an "Unresolved" struct. The unresolved types
 //! are later resolved into references after the entire dwarf tree has been parsed.
+//!
+//! Offsets within the DIE tree are relative to the compilation unit they
+//! appear in, so each unit is parsed and resolved on its own. Units don't
+//! depend on one another, which lets us walk them in parallel.
 
 #![allow(non_snake_case)]
 
@@ -29,11 +33,13 @@ use gimli::{
     Reader,
     ReaderOffset,
     AttributeValue,
+    CompilationUnitHeader,
     DebugInfo,
     DebugAbbrev,
     DebugStr,
     DebuggingInformationEntry,
 };
+use rayon::prelude::*;
 
 use super::{
     Type,
@@ -42,6 +48,16 @@ use super::{
     BindingError,
 };
 
+/// Represents base types. These are fully known once parsed, but are kept apart from
+/// `Type` until resolution so that parsed units can be sent between threads.
+#[derive(Debug)]
+struct BaseType {
+    /// The name of the base type, e.g. `int` or `char`.
+    name: String,
+    /// The memory footprint of the type, e.g. 4 for `int`.
+    size: u64,
+}
+
 /// Represents reference types, which cannot be immediately resolved.
 #[derive(Debug)]
 struct UnresolvedReference {
@@ -154,7 +170,7 @@ impl UnresolvedSubprogram {
 }
 
 /// Parses a base type from a `DW_TAG_base_type` entry in the DIE tree.
-fn parse_base_type<'a, R: Reader>(entry: &'a DebuggingInformationEntry<R, R::Offset>, strings: &'a DebugStr<R>) -> Result<(u64, Type), Error> {
+fn parse_base_type<'a, R: Reader>(entry: &'a DebuggingInformationEntry<R, R::Offset>, strings: &'a DebugStr<R>) -> Result<(u64, BaseType), Error> {
     entry.attrs()
 
         // Iterate over the attributes of the entry to collect the name, encoding, and size
@@ -195,7 +211,7 @@ fn parse_base_type<'a, R: Reader>(entry: &'a DebuggingInformationEntry<R, R::Off
         })
 
         // Use the name, encoding, and size to build a DwarfType representation of this entry.
-        .map(|(name, size)| (entry.offset().0.into_u64(), Type::Base { name, size }))
+        .map(|(name, size)| (entry.offset().0.into_u64(), BaseType { name, size }))
 }
 
 /// Parses a pointer type from a `DW_TAG_pointer_type` entry in the DIE tree.
@@ -494,11 +510,98 @@ impl TypeRegistry {
     }
 }
 
+/// The entries read from a single compilation unit, before any of them are resolved.
+#[derive(Debug, Default)]
+struct ParsedUnit {
+    base_types: HashMap<u64, BaseType>,
+    aliases: HashMap<u64, UnresolvedAlias>,
+    references: HashMap<u64, UnresolvedReference>,
+    subprograms: Vec<UnresolvedSubprogram>,
+}
+
+impl ParsedUnit {
+    /// Resolves the types and subprograms of this unit into `Function`s.
+    fn into_resolved(self) -> Result<Vec<Function>, Error> {
+        let mut resolved_types = TypeRegistry::new();
+        for (offset, BaseType { name, size }) in self.base_types.into_iter() {
+            resolved_types.insert(offset, Rc::new(Type::Base { name, size }));
+        }
+
+        // Resolve all typedefs/aliases
+        for (offset, unresolved_alias) in self.aliases.into_iter() {
+            let resolved_alias = unresolved_alias.into_resolved(&resolved_types)?;
+            resolved_types.insert(offset, Rc::new(resolved_alias));
+        }
+
+        // Resolve all pointers/references
+        for (offset, unresolved_type) in self.references.into_iter() {
+            let resolved_type = unresolved_type.into_resolved(&resolved_types)?;
+            resolved_types.insert(offset, Rc::new(resolved_type));
+        }
+
+        // Resolve all subprograms
+        let mut resolved_subprograms = Vec::<Function>::with_capacity(self.subprograms.len());
+        for subprogram in self.subprograms.into_iter() {
+            resolved_subprograms.push(subprogram.into_resolved(&resolved_types)?)
+        }
+
+        Ok(resolved_subprograms)
+    }
+}
+
+/// Walks the DIE tree of a single compilation unit.
+fn parse_unit<R: Reader>(unit: &CompilationUnitHeader<R, R::Offset>, debug_abbrev: &DebugAbbrev<R>, debug_strings: &DebugStr<R>) -> Result<ParsedUnit, Error> {
+    let mut parsed = ParsedUnit::default();
+    let mut parser = DwarfParser::new();
+
+    let abbrevs = unit.abbreviations(debug_abbrev)?;
+    let mut entries = unit.entries(&abbrevs);
+    let mut depth = 0;
+
+    while let Some((delta, entry)) = entries.next_dfs()? {
+        depth += delta;
+        match (depth, entry.tag()) {
+            (_, gimli::DW_TAG_base_type) => {
+                let (offset, typ) = parse_base_type(&entry, debug_strings)?;
+                parsed.base_types.insert(offset, typ);
+            },
+            (_, gimli::DW_TAG_pointer_type) => {
+                let reference = parse_pointer_type(&entry)?;
+                let offset = reference.offset;
+                parsed.references.insert(offset, reference);
+            },
+            (_, gimli::DW_TAG_typedef) => {
+                let alias = parse_typedef(&entry, debug_strings)?;
+                let offset = alias.offset;
+                parsed.aliases.insert(offset, alias);
+            },
+            (_, gimli::DW_TAG_formal_parameter) => {
+                parser.step(Event::NewParameter, &entry, debug_strings)?;
+            },
+            (depth, gimli::DW_TAG_subprogram) => {
+                parser.step(Event::NewSubprogram(depth), &entry, debug_strings)?;
+            },
+            (depth, _) => parser.step(Event::Step(depth), &entry, debug_strings)?,
+        }
+    }
+    parser.step_zero();
+
+    parsed.subprograms = parser.subprograms;
+    Ok(parsed)
+}
+
 /// Parses the buffer of a DWARF binary to extract the debugging information.
 pub fn parse(buffer: &[u8]) -> Result<Vec<Function>, Error> {
     let bin = object::File::parse(buffer)
         .map_err(|_| BindingError::DwarfReadError("binary file".to_owned()))?;
+    parse_object(&bin)
+}
 
+/// Extracts the debugging information from an already-parsed binary.
+///
+/// Compilation units are walked in parallel, then resolved in the order they
+/// appear in the binary.
+pub fn parse_object(bin: &object::File) -> Result<Vec<Function>, Error> {
     let endian = if bin.is_little_endian() {
         gimli::RunTimeEndian::Little
     } else {
@@ -517,67 +620,132 @@ pub fn parse(buffer: &[u8]) -> Result<Vec<Function>, Error> {
         .map(|strings| DebugStr::new(strings, endian))
         .ok_or(BindingError::DwarfReadError(".debug_str".to_owned()))?;
 
-    let mut resolved_types = TypeRegistry::new();
-    let mut unresolved_aliases: HashMap<u64, UnresolvedAlias> = HashMap::new();
-    let mut unresolved_references: HashMap<u64, UnresolvedReference> = HashMap::new();
+    let units: Vec<_> = debug_info.units().collect()?;
 
-    let mut parser = DwarfParser::new();
-    let mut units = debug_info.units();
-
-    while let Some(unit) = units.next()? {
-        let abbrevs = unit.abbreviations(&debug_abbrev)?;
-        let mut entries = unit.entries(&abbrevs);
-        let mut depth = 0;
-
-        while let Some((delta, entry)) = entries.next_dfs()? {
-            depth += delta;
-            match (depth, entry.tag()) {
-                (_, gimli::DW_TAG_base_type) => {
-                    let (offset, typ) = parse_base_type(&entry, &debug_strings)?;
-                    resolved_types.insert(offset, Rc::new(typ));
-                },
-                (_, gimli::DW_TAG_pointer_type) => {
-                    let reference = parse_pointer_type(&entry)?;
-                    let offset = reference.offset;
-                    unresolved_references.insert(offset, reference);
-                },
-                (_, gimli::DW_TAG_typedef) => {
-                    let alias = parse_typedef(&entry, &debug_strings)?;
-                    let offset = alias.offset;
-                    unresolved_aliases.insert(offset, alias);
-                },
-                (_, gimli::DW_TAG_formal_parameter) => {
-                    parser.step(Event::NewParameter, &entry, &debug_strings)?;
-                },
-                (depth, gimli::DW_TAG_subprogram) => {
-                    parser.step(Event::NewSubprogram(depth), &entry, &debug_strings)?;
-                },
-                (depth, _) => parser.step(Event::Step(depth), &entry, &debug_strings)?,
-            }
-        }
-        parser.step_zero();
-    }
+    let parsed_units = units.par_iter()
+        .map(|unit| parse_unit(unit, &debug_abbrev, &debug_strings))
+        .collect::<Result<Vec<ParsedUnit>, Error>>()?;
 
-    // Resolve all typedefs/aliases
-    for (offset, unresolved_alias) in unresolved_aliases.into_iter() {
-        let resolved_alias = unresolved_alias.into_resolved(&resolved_types)?;
-        resolved_types.insert(offset, Rc::new(resolved_alias));
+    let mut functions = Vec::new();
+    for parsed_unit in parsed_units.into_iter() {
+        functions.extend(parsed_unit.into_resolved()?);
     }
 
-    // Resolve all pointers/references
-    for (offset, unresolved_type) in unresolved_references.into_iter() {
-        let resolved_type = unresolved_type.into_resolved(&resolved_types)?;
-        resolved_types.insert(offset, Rc::new(resolved_type));
+    Ok(functions)
+}
+
+/// The range of addresses a function's code occupies, used to map sampled
+/// program counters back to functions.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Symbol {
+    /// The name of the function.
+    pub name: String,
+    /// The address of the function's first instruction.
+    pub low: u64,
+    /// The address just past the function's last instruction.
+    pub high: u64,
+}
+
+/// A subprogram whose code range is known but whose name may be held by the
+/// entry it is an instance of.
+struct UnnamedSymbol {
+    low: u64,
+    high: u64,
+    /// The offset of the entry given by `DW_AT_abstract_origin` or `DW_AT_specification`.
+    origin: Option<u64>,
+}
+
+/// Reads the name and code range of a `DW_TAG_subprogram` entry, if it has them.
+///
+/// `DW_AT_high_pc` is either an address or, since DWARF 4, the length of the
+/// function's code.
+fn parse_symbol<'a, R: Reader>(entry: &'a DebuggingInformationEntry<R, R::Offset>, strings: &'a DebugStr<R>) -> Result<(Option<String>, UnnamedSymbol), Error> {
+    let mut name = None;
+    let mut low = None;
+    let mut high = None;
+    let mut length = None;
+    let mut origin = None;
+
+    let mut attrs = entry.attrs();
+    while let Some(attr) = attrs.next()? {
+        match (attr.name(), attr.value()) {
+            (gimli::DW_AT_name, AttributeValue::DebugStrRef(offset)) => name = strings.get_str(offset).ok(), // Used for elf files
+            (gimli::DW_AT_name, AttributeValue::String(string)) => name = Some(string), // Used for macho files
+            (gimli::DW_AT_low_pc, AttributeValue::Addr(address)) => low = Some(address),
+            (gimli::DW_AT_high_pc, AttributeValue::Addr(address)) => high = Some(address),
+            (gimli::DW_AT_high_pc, _) => length = attr.udata_value(),
+            (gimli::DW_AT_abstract_origin, AttributeValue::UnitRef(offset)) |
+            (gimli::DW_AT_specification, AttributeValue::UnitRef(offset)) => origin = Some(offset.0.into_u64()),
+            _ => {},
+        }
     }
 
-    // Resolve all subprograms
-    let unresolved_subprograms = parser.subprograms;
-    let mut resolved_subprograms = Vec::<Function>::new();
-    for subprogram in unresolved_subprograms.into_iter() {
-        resolved_subprograms.push(subprogram.into_resolved(&resolved_types)?)
+    let name = name.and_then(|name| name.to_string().map(|name| (*name).to_owned()).ok());
+    let low = low.unwrap_or(0);
+    let high = high.or(length.map(|length| low + length)).unwrap_or(low);
+    Ok((name, UnnamedSymbol { low, high, origin }))
+}
+
+/// Collects the code ranges of the functions defined in a single compilation unit.
+fn parse_unit_symbols<R: Reader>(unit: &CompilationUnitHeader<R, R::Offset>, debug_abbrev: &DebugAbbrev<R>, debug_strings: &DebugStr<R>) -> Result<Vec<Symbol>, Error> {
+    let abbrevs = unit.abbreviations(debug_abbrev)?;
+    let mut entries = unit.entries(&abbrevs);
+
+    // Out-of-line copies of inline functions, and definitions of functions
+    // declared elsewhere in the unit, take their names from another entry.
+    let mut names = HashMap::new();
+    let mut ranges = Vec::new();
+    while let Some((_, entry)) = entries.next_dfs()? {
+        if entry.tag() != gimli::DW_TAG_subprogram { continue; }
+        let (name, symbol) = parse_symbol(&entry, debug_strings)?;
+        if let Some(ref name) = name {
+            names.insert(entry.offset().0.into_u64(), name.clone());
+        }
+        if symbol.high > symbol.low {
+            ranges.push((name, symbol));
+        }
     }
 
-    Ok(resolved_subprograms)
+    Ok(ranges.into_iter()
+        .filter_map(|(name, symbol)| {
+            name.or_else(|| symbol.origin.and_then(|origin| names.get(&origin).cloned()))
+                .map(|name| Symbol { name, low: symbol.low, high: symbol.high })
+        })
+        .collect())
+}
+
+/// Extracts the code range of every function defined in a binary, sorted by address.
+///
+/// Functions without debugging information, or which were inlined
+/// everywhere they were used, have no range and are not included.
+pub fn parse_symbols(bin: &object::File) -> Result<Vec<Symbol>, Error> {
+    let endian = if bin.is_little_endian() {
+        gimli::RunTimeEndian::Little
+    } else {
+        gimli::RunTimeEndian::Big
+    };
+
+    let debug_info = bin.section_data_by_name(".debug_info")
+        .map(|info| DebugInfo::new(info, endian))
+        .ok_or(BindingError::DwarfReadError(".debug_info".to_owned()))?;
+
+    let debug_abbrev = bin.section_data_by_name(".debug_abbrev")
+        .map(|abbrev| DebugAbbrev::new(abbrev, endian))
+        .ok_or(BindingError::DwarfReadError(".debug_abbrev".to_owned()))?;
+
+    let debug_strings = bin.section_data_by_name(".debug_str")
+        .map(|strings| DebugStr::new(strings, endian))
+        .ok_or(BindingError::DwarfReadError(".debug_str".to_owned()))?;
+
+    let units: Vec<_> = debug_info.units().collect()?;
+
+    let unit_symbols = units.par_iter()
+        .map(|unit| parse_unit_symbols(unit, &debug_abbrev, &debug_strings))
+        .collect::<Result<Vec<Vec<Symbol>>, Error>>()?;
+
+    let mut symbols: Vec<Symbol> = unit_symbols.into_iter().flat_map(|symbols| symbols).collect();
+    symbols.sort_by_key(|symbol| symbol.low);
+    Ok(symbols)
 }
 
 /// Test the dwarf parser for correctness.
@@ -636,6 +804,24 @@ mod test {
         assert_eq!(actual_subprograms, expected_subprograms);
     }
 
+    #[test]
+    fn test_symbols() {
+        let dwarf: &[u8] = include_bytes!("./test_resources/dwarf_parse_test");
+        let bin = object::File::parse(dwarf).unwrap();
+        let symbols = parse_symbols(&bin).unwrap();
+
+        let names: Vec<&str> = symbols.iter().map(|symbol| symbol.name.as_str()).collect();
+        assert_eq!(names, vec!["test_one", "test_two", "test_three", "test_four", "main"]);
+        assert_eq!(symbols[0].low, 1632);
+        assert_eq!(symbols[4].low, 1692);
+
+        // Each function ends where the next one begins, or before.
+        for pair in symbols.windows(2) {
+            assert!(pair[0].low < pair[0].high);
+            assert!(pair[0].high <= pair[1].low);
+        }
+    }
+
     #[test]
     fn test_parser_macho() {
         let dwarf: &[u8] = include_bytes!("./test_resources/dwarf_parse_test_macho");
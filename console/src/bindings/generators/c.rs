@@ -18,7 +18,13 @@ use handlebars::{
     RenderError,
 };
 
-use bindings::generators::GeneratorError;
+use bindings::generators::{
+    GeneratorError,
+    GeneratorOptions,
+    WireType,
+    call_layout,
+    wire_type,
+};
 use bindings::{
     Parameter,
     Function,
@@ -36,16 +42,33 @@ use bindings::{
 pub(crate) struct CParameter {
     name: String,
     typ: String,
+    /// The C type the value is converted to before it's copied into the packet.
+    wire: String,
+    /// A cast applied to the value before converting it to `wire`.
+    cast: String,
+    /// The offset of the value within the packet's argument area.
+    offset: u64,
 }
 
 /// A serializable representation of a Function in C.
 /// This is used by handlebars to populate the C template.
 #[derive(Debug, Serialize, PartialOrd, PartialEq, Ord, Eq)]
 pub(crate) struct CFunction {
+    module: String,
     name: String,
     params: Vec<CParameter>,
     ret: String,
     ret_fmr: String,
+    /// A cast from `lf_return_t` to `ret`.
+    ret_cast: String,
+    returns: bool,
+    /// Whether the call layout below is known, in which case the stub packs its
+    /// arguments itself. Otherwise, the stub falls back to `lf_invoke`.
+    packed: bool,
+    batched: bool,
+    argt: String,
+    argc: usize,
+    argv_len: u64,
 }
 
 /// A serializable representation of a Module in C.
@@ -57,71 +80,111 @@ pub(crate) struct CModule {
     funcs: Vec<CFunction>,
 }
 
+/// The C name of the `lf_type` with the given code.
+fn fmr_type_name(kind: u8) -> &'static str {
+    match kind {
+        0 => "lf_uint8_t",
+        1 => "lf_uint16_t",
+        3 => "lf_uint32_t",
+        4 => "lf_int_t",
+        6 => "lf_ptr_t",
+        7 => "lf_uint64_t",
+        8 => "lf_int8_t",
+        9 => "lf_int16_t",
+        11 => "lf_int32_t",
+        15 => "lf_int64_t",
+        _ => "lf_void_t",
+    }
+}
+
+/// The fixed-width C type that holds a value with the given encoding.
+fn wire_c_type(wire: WireType) -> String {
+    let bits = wire.size * 8;
+    if wire.signed() { format!("int{}_t", bits) } else { format!("uint{}_t", bits) }
+}
+
 impl From<Parameter> for CParameter {
     fn from(param: Parameter) -> Self {
+        let wire = wire_type(&param.typ);
         CParameter {
             name: param.name,
             typ: param.typ.name(),
+            wire: wire.map(wire_c_type).unwrap_or_default(),
+            cast: match wire {
+                Some(WireType { pointer: true, .. }) => "(uintptr_t)".to_owned(),
+                _ => String::new(),
+            },
+            offset: 0,
         }
     }
 }
 
-impl From<Function> for CFunction {
-    fn from(func: Function) -> Self {
-        let params: Vec<CParameter> = func.parameters.into_iter().map(|param| param.into()).collect();
+impl CFunction {
+    fn new(module: &str, func: Function, options: &GeneratorOptions) -> Self {
+        let layout = call_layout(&func.parameters);
+        let mut params: Vec<CParameter> = func.parameters.into_iter().map(|param| param.into()).collect();
+        if let Some(ref layout) = layout {
+            for (param, &(_, offset)) in params.iter_mut().zip(layout.params.iter()) {
+                param.offset = offset;
+            }
+        }
 
         let ret = func.ret.name();
-        let ret_size = func.ret.size();
-
-        let lf_type = match ret_size {
-            0 => "lf_void_t".to_owned(),
-            1 => "lf_uint8_t".to_owned(),
-            2 => "lf_uint16_t".to_owned(),
-            4 => "lf_uint32_t".to_owned(),
-            8 => "lf_uint64_t".to_owned(),
-            _ => "lf_void_t".to_owned(),
+        let ret_wire = wire_type(&func.ret);
+        let ret_cast = match ret_wire {
+            Some(WireType { pointer: true, .. }) => format!("({})(uintptr_t)", ret),
+            _ => format!("({})", ret),
         };
 
         CFunction {
+            module: module.to_owned(),
             name: func.name,
+            argc: params.len(),
             params,
+            ret_fmr: fmr_type_name(ret_wire.map_or(2, |wire| wire.kind)).to_owned(),
+            returns: ret_wire.is_some(),
             ret,
-            ret_fmr: lf_type,
+            ret_cast,
+            packed: layout.is_some(),
+            batched: options.batched && layout.is_some(),
+            argt: format!("{:#x}", layout.as_ref().map_or(0, |layout| layout.argt)),
+            argv_len: layout.as_ref().map_or(0, |layout| layout.len),
         }
     }
 }
 
-impl From<Module> for CModule {
-    fn from(module: Module) -> Self {
+impl CModule {
+    fn new(module: Module, options: &GeneratorOptions) -> Self {
+        let name = module.name;
         CModule {
-            name: module.name,
+            funcs: module.functions.into_iter().map(|func| CFunction::new(&name, func, options)).collect(),
+            name,
             description: module.description,
-            funcs: module.functions.into_iter().map(|s| s.into()).collect(),
         }
     }
 }
 
-/// C does not allow trailing commas in struct definitions, so we need
-/// a custom handlebars helper which takes the appropriate struct contents
-/// and appends them to the template, omitting the last comma of each entry.
-fn struct_helper(h: &Helper, _: &Handlebars, rc: &mut RenderContext) -> Result<(), RenderError> {
+/// Joins the names of a module's functions, each wrapped in `prefix` and
+/// `suffix`, into a comma-separated list.
+fn join_functions(h: &Helper, helper: &str, prefix: &str, rc: &mut RenderContext) -> Result<(), RenderError> {
     let values = h.param(0).map(|p| p.value())
         .and_then(|value| value.as_array())
-        .ok_or(RenderError::new("struct_expansion requires an array as the first argument"))?;
+        .ok_or(RenderError::new(format!("{} requires an array as the first argument", helper)))?;
 
     let module_name = h.param(1).map(|p| p.value())
         .and_then(|value| value.as_str())
-        .ok_or(RenderError::new("struct_expansion requires a string as the second argument"))?;
+        .ok_or(RenderError::new(format!("{} requires a string as the second argument", helper)))?;
 
     let mut funcs = String::new();
     for (i, value) in values.iter().enumerate() {
-        if i > 0 { funcs.push_str(",\n    "); }
+        if i > 0 { funcs.push_str(", "); }
+        funcs.push_str(prefix);
         funcs.push_str(module_name);
         funcs.push('_');
         funcs.push_str(value.as_object()
             .and_then(|obj| obj.get("name"))
             .and_then(|name| name.as_str())
-            .ok_or(RenderError::new("struct_expansion failed to print 'name'"))?
+            .ok_or(RenderError::new(format!("{} failed to print 'name'", helper)))?
         );
     }
 
@@ -130,6 +193,17 @@ fn struct_helper(h: &Helper, _: &Handlebars, rc: &mut RenderContext) -> Result<(
     Ok(())
 }
 
+/// C does not allow trailing commas in enums, so the function index enum is
+/// expanded by a helper.
+fn enum_helper(h: &Helper, _: &Handlebars, rc: &mut RenderContext) -> Result<(), RenderError> {
+    join_functions(h, "enum_expansion", "_", rc)
+}
+
+/// Expands the entries of the module's interface array.
+fn interface_helper(h: &Helper, _: &Handlebars, rc: &mut RenderContext) -> Result<(), RenderError> {
+    join_functions(h, "interface_expansion", "&", rc)
+}
+
 /// C does not allow trailing commas in parameter lists, so we need
 /// a custom handlebars helper which takes the appropriate arguments
 /// and appends them to the template, omitting the last comma of each entry.
@@ -139,6 +213,7 @@ fn param_helper(h: &Helper, _: &Handlebars, rc: &mut RenderContext) -> Result<()
         .ok_or(RenderError::new("param_expansion requires an array as the first argument"))?;
 
     let mut params = String::new();
+    if values.is_empty() { params.push_str("void"); }
     for (i, value) in values.iter().enumerate() {
         if i > 0 { params.push_str(", "); }
         params.push_str(value.as_object()
@@ -184,12 +259,52 @@ fn fmr_expansion_helper(h: &Helper, _: &Handlebars, rc: &mut RenderContext) -> R
     Ok(())
 }
 
+/// Expands the parameters of a batched variant, each of which is an array
+/// holding one value per call. The list begins with a comma, since it follows
+/// the call count.
+fn batch_param_helper(h: &Helper, _: &Handlebars, rc: &mut RenderContext) -> Result<(), RenderError> {
+    let values = h.param(0).map(|p| p.value())
+        .and_then(|value| value.as_array())
+        .ok_or(RenderError::new("batch_param_expansion requires an array as the first argument"))?;
+
+    let mut params = String::new();
+    for value in values.iter() {
+        params.push_str(", ");
+        params.push_str(value.as_object()
+            .and_then(|obj| obj.get("typ"))
+            .and_then(|typ| typ.as_str())
+            .ok_or(RenderError::new("batch_param_expansion failed to print 'typ'"))?
+        );
+        params.push_str(" const *");
+        params.push_str(value.as_object()
+            .and_then(|obj| obj.get("name"))
+            .and_then(|name| name.as_str())
+            .ok_or(RenderError::new("batch_param_expansion failed to print 'name'"))?
+        );
+    }
+
+    rc.writer.write(params.into_bytes().as_ref())?;
+
+    Ok(())
+}
+
 /// Configures handlebars, serializes the given `CModule`, and writes it
 /// to the given output.
 pub fn generate_module<W: Write>(module: Module, out: &mut W) -> Result<(), Error> {
+    generate_module_with_options(module, &GeneratorOptions::default(), out)
+}
+
+/// Like `generate_module`, with control over what is emitted.
+///
+/// Each function whose arguments can be passed by value gets a stub that
+/// resolves the module once per device and copies its arguments straight into
+/// a packet on the stack, using an `argt` word and offsets computed here.
+pub fn generate_module_with_options<W: Write>(module: Module, options: &GeneratorOptions, out: &mut W) -> Result<(), Error> {
     let mut reg = Handlebars::new();
     reg.register_helper("param_expansion", Box::new(param_helper));
-    reg.register_helper("struct_expansion", Box::new(struct_helper));
+    reg.register_helper("batch_param_expansion", Box::new(batch_param_helper));
+    reg.register_helper("enum_expansion", Box::new(enum_helper));
+    reg.register_helper("interface_expansion", Box::new(interface_helper));
     reg.register_helper("fmr_expansion", Box::new(fmr_expansion_helper));
 
     let template_bytes: &[u8] = include_bytes!("./templates/c.hbs");
@@ -197,7 +312,7 @@ pub fn generate_module<W: Write>(module: Module, out: &mut W) -> Result<(), Erro
     reg.register_template_source("c", &mut template)
         .map_err(|_| GeneratorError::CRenderError("missing or malformed template file 'c.hbs'".to_owned()))?;
 
-    let module: CModule = module.into();
+    let module = CModule::new(module, options);
 
     let _ = write!(out, "{}", reg.render("c", &module)
         .map_err(|e| GeneratorError::CRenderError(e.desc))?
@@ -242,16 +357,25 @@ mod test {
         let expected_cp0 = CParameter {
             name: "first".to_owned(),
             typ: "char*".to_owned(),
+            wire: "uint64_t".to_owned(),
+            cast: "(uintptr_t)".to_owned(),
+            offset: 0,
         };
 
         let expected_cp1 = CParameter {
             name: "second".to_owned(),
             typ: "uint16_t".to_owned(),
+            wire: "uint16_t".to_owned(),
+            cast: "".to_owned(),
+            offset: 0,
         };
 
         let expected_cp2 = CParameter {
             name: "third".to_owned(),
             typ: "uint32_t".to_owned(),
+            wire: "uint32_t".to_owned(),
+            cast: "".to_owned(),
+            offset: 0,
         };
 
         // Compare
@@ -8,6 +8,91 @@
 pub mod c;
 pub mod swift;
 
+use bindings::{Parameter, Type};
+
+/// The number of argument types that fit in a call's `argt` word.
+const FMR_MAX_ARGC: usize = 8;
+/// The number of bytes of argument values that fit in a call packet.
+const FMR_MAX_ARGV: u64 = 64 - 6 - 8;
+
+/// Options that change what the generators emit.
+#[derive(Debug, Default, Clone, Copy)]
+pub struct GeneratorOptions {
+    /// Also emit a variant of each function that performs many calls at once,
+    /// sending them to the device back to back.
+    pub batched: bool,
+}
+
+/// How a value is encoded in a call packet.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) struct WireType {
+    /// The FMR type code, as placed in the `argt` word.
+    pub(crate) kind: u8,
+    /// The number of bytes the value occupies in the packet.
+    pub(crate) size: u64,
+    /// Whether the value is an address on the device.
+    pub(crate) pointer: bool,
+}
+
+impl WireType {
+    /// Whether the value is a signed integer.
+    pub(crate) fn signed(&self) -> bool {
+        self.kind & (1 << 3) != 0
+    }
+}
+
+/// Finds how a value of the given type is encoded, if it can be passed by value.
+///
+/// Pointers travel as 64-bit addresses. Integers keep their size, and are signed
+/// unless their base type is unsigned, a plain `char`, or a boolean. This
+/// matches `lf_infer`, which treats `char` as unsigned.
+pub(crate) fn wire_type(typ: &Type) -> Option<WireType> {
+    match *typ {
+        Type::Reference { .. } => Some(WireType { kind: 6, size: 8, pointer: true }),
+        Type::Alias { ref typ, .. } => wire_type(typ),
+        Type::Base { ref name, size } => {
+            let unsigned = name.contains("unsigned") || name == "char" || name == "_Bool" || name == "bool";
+            let width = match size {
+                1 | 2 | 4 | 8 => size as u8 - 1,
+                _ => return None,
+            };
+            let kind = if unsigned { width } else { (1 << 3) | width };
+            Some(WireType { kind, size, pointer: false })
+        }
+        Type::Unsupported => None,
+    }
+}
+
+/// The packet layout of a call to a function, computed once at generation time.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub(crate) struct CallLayout {
+    /// The `argt` word of the call.
+    pub(crate) argt: u32,
+    /// The encoding and offset within the argument area of each parameter.
+    pub(crate) params: Vec<(WireType, u64)>,
+    /// The number of bytes of argument values.
+    pub(crate) len: u64,
+}
+
+/// Lays out the arguments of a call to a function with the given parameters.
+///
+/// Returns `None` if a parameter can't be passed by value or the arguments
+/// don't fit in a single packet, in which case bindings fall back to `lf_invoke`.
+pub(crate) fn call_layout(parameters: &[Parameter]) -> Option<CallLayout> {
+    if parameters.len() > FMR_MAX_ARGC { return None; }
+
+    let mut layout = CallLayout { argt: 0, params: Vec::with_capacity(parameters.len()), len: 0 };
+    for (i, parameter) in parameters.iter().enumerate() {
+        let wire = wire_type(&parameter.typ)?;
+        layout.argt |= u32::from(wire.kind) << (i * 4);
+        layout.params.push((wire, layout.len));
+        layout.len += wire.size;
+    }
+
+    if layout.len > FMR_MAX_ARGV { return None; }
+    Some(layout)
+}
+
 #[derive(Debug, Fail)]
 pub enum GeneratorError {
     #[fail(display = "failed to generate C binding: {}", _0)]
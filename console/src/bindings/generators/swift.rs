@@ -18,7 +18,7 @@ use handlebars::{
     RenderError,
 };
 
-use bindings::generators::GeneratorError;
+use bindings::generators::{GeneratorError, GeneratorOptions, WireType, call_layout};
 use bindings::{
     Parameter,
     Function,
@@ -36,6 +36,12 @@ use bindings::{
 pub(crate) struct SwiftParameter {
     name: String,
     typ: String,
+    /// The expression that converts the argument to its wire type.
+    value: String,
+    /// The same conversion, applied to one element of the batched argument array.
+    batch_value: String,
+    /// The argument's offset into the packet's argument area.
+    offset: u64,
 }
 
 /// A serializable representation of a Function in Swift.
@@ -43,8 +49,16 @@ pub(crate) struct SwiftParameter {
 #[derive(Debug, Serialize, PartialOrd, PartialEq, Ord, Eq)]
 pub(crate) struct SwiftFunction {
     name: String,
+    index: usize,
     params: Vec<SwiftParameter>,
     ret: String,
+    returns: bool,
+    /// Whether the arguments can be packed at offsets known ahead of time.
+    packed: bool,
+    batched: bool,
+    argt: String,
+    argc: usize,
+    argv_len: u64,
 }
 
 /// A serializable representation of a Module in C.
@@ -66,13 +80,14 @@ fn convert_to_swift(type_name: &str) -> String {
     "int16_t" => "Int16",
     "int32_t" => "Int32",
     "int64_t" => "Int64",
-    "char" => "Character",
+    "char" => "CChar",
     "bool" => "Bool",
     "int" => "Int",
     "unsigned int" => "UInt",
     "short" => "Int16",
     "unsigned short int" => "UInt16",
     "long int" => "Int64",
+    "void" => "Void",
     _ => panic!("Unknown type {}", type_name)
   }.to_owned()
 }
@@ -89,33 +104,91 @@ fn swift_name(typ: Rc<Type>) -> String {
   }
 }
 
-impl From<Parameter> for SwiftParameter {
-    fn from(param: Parameter) -> Self {
+/// The Swift type a value is converted to before it is copied into a packet.
+fn wire_name(wire: &WireType) -> &'static str {
+    match (wire.signed(), wire.size) {
+        (false, 1) => "UInt8",
+        (false, 2) => "UInt16",
+        (false, 4) => "UInt32",
+        (true, 1) => "Int8",
+        (true, 2) => "Int16",
+        (true, 4) => "Int32",
+        (true, 8) => "Int64",
+        _ => "UInt64",
+    }
+}
+
+/// The expression that converts `expr`, of Swift type `typ`, to its wire type.
+fn wire_value(expr: &str, typ: &str, wire: &WireType) -> String {
+    let wire_name = wire_name(wire);
+    if wire.pointer {
+        format!("UInt64(UInt(bitPattern: {}))", expr)
+    } else if typ == "Bool" {
+        format!("{}({} ? 1 : 0)", wire_name, expr)
+    } else if typ == wire_name {
+        expr.to_owned()
+    } else {
+        format!("{}(truncatingIfNeeded: {})", wire_name, expr)
+    }
+}
+
+impl SwiftParameter {
+    fn new(param: Parameter, wire: Option<&(WireType, u64)>) -> Self {
+        let typ = swift_name(param.typ);
+        let (value, batch_value, offset) = match wire {
+            Some(&(ref wire, offset)) => (
+                wire_value(&param.name, &typ, wire),
+                wire_value(&format!("{}[i]", param.name), &typ, wire),
+                offset,
+            ),
+            None => (param.name.clone(), param.name.clone(), 0),
+        };
+
         SwiftParameter {
             name: param.name,
-            typ: swift_name(param.typ),
+            typ,
+            value,
+            batch_value,
+            offset,
         }
     }
 }
 
-impl From<Function> for SwiftFunction {
-    fn from(func: Function) -> Self {
-        let params: Vec<SwiftParameter> = func.parameters.into_iter().map(|param| param.into()).collect();
+impl SwiftFunction {
+    fn new(index: usize, func: Function, options: &GeneratorOptions) -> Self {
+        let layout = call_layout(&func.parameters);
+        let argc = func.parameters.len();
+        let params = func.parameters.into_iter().enumerate()
+            .map(|(i, param)| {
+                let wire = layout.as_ref().map(|layout| &layout.params[i]);
+                SwiftParameter::new(param, wire)
+            })
+            .collect();
+        let ret = swift_name(func.ret);
 
         SwiftFunction {
             name: func.name,
-            params: params,
-            ret: swift_name(func.ret),
+            index,
+            params,
+            returns: ret != "Void",
+            ret,
+            packed: layout.is_some(),
+            batched: options.batched && layout.is_some(),
+            argt: format!("{:#x}", layout.as_ref().map_or(0, |layout| layout.argt)),
+            argc,
+            argv_len: layout.as_ref().map_or(0, |layout| layout.len),
         }
     }
 }
 
-impl From<Module> for SwiftModule {
-    fn from(module: Module) -> Self {
+impl SwiftModule {
+    fn new(module: Module, options: &GeneratorOptions) -> Self {
         SwiftModule {
             name: module.name,
             description: module.description,
-            funcs: module.functions.into_iter().map(|s| s.into()).collect(),
+            funcs: module.functions.into_iter().enumerate()
+                .map(|(index, func)| SwiftFunction::new(index, func, options))
+                .collect(),
         }
     }
 }
@@ -166,19 +239,52 @@ fn args_expansion_helper(h: &Helper, _: &Handlebars, rc: &mut RenderContext) ->
     Ok(())
 }
 
+/// Expands the parameters of a batched function, each of which takes an array
+/// holding that argument for every call.
+fn batch_param_helper(h: &Helper, _: &Handlebars, rc: &mut RenderContext) -> Result<(), RenderError> {
+    let values = h.param(0).map(|p| p.value())
+        .and_then(|value| value.as_array())
+        .ok_or(RenderError::new("batch_param_expansion requires an array as the first argument"))?;
+
+    let mut params: Vec<String> = Vec::new();
+    for value in values {
+      let obj = value.as_object().unwrap();
+      let name = obj.get("name")
+        .and_then(|name| name.as_str())
+        .ok_or(RenderError::new("batch_param_expansion failed to print 'name'"))?;
+      let typ = obj.get("typ")
+        .and_then(|name| name.as_str())
+        .ok_or(RenderError::new("batch_param_expansion failed to print 'typ'"))?;
+      params.push(", ".to_owned() + name + ": [" + typ + "]");
+    }
+
+    rc.writer.write(params.concat().into_bytes().as_ref())?;
+
+    Ok(())
+}
+
 /// Configures handlebars, serializes the given `SwiftModule`, and writes it
 /// to the given output.
 pub fn generate_module<W: Write>(module: Module, out: &mut W) -> Result<(), Error> {
+    generate_module_with_options(module, &GeneratorOptions::default(), out)
+}
+
+/// Like `generate_module`, with control over what is generated.
+///
+/// Functions whose arguments all travel by value copy them straight into
+/// a packet, using an `argt` word and offsets computed here.
+pub fn generate_module_with_options<W: Write>(module: Module, options: &GeneratorOptions, out: &mut W) -> Result<(), Error> {
     let mut reg = Handlebars::new();
     reg.register_helper("param_expansion", Box::new(param_helper));
     reg.register_helper("args_expansion", Box::new(args_expansion_helper));
+    reg.register_helper("batch_param_expansion", Box::new(batch_param_helper));
 
     let template_bytes: &[u8] = include_bytes!("./templates/swift.hbs");
     let mut template = Cursor::new(template_bytes);
     reg.register_template_source("swift", &mut template)
         .map_err(|_| GeneratorError::SwiftRenderError("missing or malformed template file 'swift.hbs'".to_owned()))?;
 
-    let module: SwiftModule = module.into();
+    let module = SwiftModule::new(module, options);
 
     let _ = write!(out, "{}", reg.render("swift", &module)
         .map_err(|e| GeneratorError::SwiftRenderError(e.desc))?
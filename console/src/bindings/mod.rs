@@ -33,6 +33,7 @@
 
 #![allow(missing_docs)]
 
+pub mod cache;
 pub mod dwarf;
 pub mod generators;
 
@@ -45,6 +46,8 @@ use object::{
 };
 use failure::Error;
 
+use self::cache::BindingCache;
+
 /// Represents errors that can occur when parsing ELF and/or DWARF files.
 #[derive(Debug, Fail)]
 pub enum BindingError {
@@ -68,7 +71,7 @@ pub enum BindingError {
 /// as `uint8_t`, pointers such as `char *`, or other types which are
 /// currently unsupported in a concrete sense but which can be referenced
 /// as generic data (such as structs).
-#[derive(Debug, PartialOrd, PartialEq, Ord, Eq)]
+#[derive(Debug, PartialOrd, PartialEq, Ord, Eq, Serialize, Deserialize)]
 pub enum Type {
     /// Base types encapsulate all of the information necessary to represent
     /// a value in the program they were parsed from. This is used to
@@ -159,7 +162,7 @@ impl Type {
 ///
 /// The parameters would be named `letter` and `count`, and the types would refer
 /// to `Type`s named `char` and `uint8_t`.
-#[derive(Debug, PartialOrd, PartialEq, Ord, Eq)]
+#[derive(Debug, PartialOrd, PartialEq, Ord, Eq, Serialize, Deserialize)]
 pub struct Parameter {
     /// The name of the formal parameter as defined in the original program,
     /// e.g. "greeting" in `void say_hello(char *greeting);`.
@@ -174,7 +177,7 @@ pub struct Parameter {
 /// The name and parameters are used for generating FFI bindings to this function.
 /// The address is captured so it's possible to tell if the function belongs to a
 /// certain binary section.
-#[derive(Debug, PartialOrd, PartialEq, Ord, Eq)]
+#[derive(Debug, PartialOrd, PartialEq, Ord, Eq, Serialize, Deserialize)]
 pub struct Function {
     /// The name of the function as defined in the original program,
     /// e.g. "say_hello" in `void say_hello(char *greeting);`.
@@ -198,9 +201,30 @@ pub struct Module {
 impl Module {
     /// Parse Flipper module metadata from a debug-enabled binary.
     pub fn parse(name: String, description: String, binary: &[u8]) -> Result<Self, Error> {
-        let functions = dwarf::parse(binary)?;
-        let range = read_section_address(binary, ".lf.funcs")?;
-        let functions: Vec<_> = functions.into_iter().filter(|f| range.start <= f.address && f.address < range.end).collect();
+        let functions = parse_functions(binary)?;
+
+        Ok(Module {
+            name,
+            description,
+            functions,
+        })
+    }
+
+    /// Parse Flipper module metadata from a debug-enabled binary, reusing the
+    /// result of an earlier parse of the same binary if `cache` has one.
+    pub fn parse_cached(name: String, description: String, binary: &[u8], cache: &BindingCache) -> Result<Self, Error> {
+        let hash = cache::content_hash(binary);
+
+        let functions = match cache.load(hash) {
+            Some(functions) => functions,
+            None => {
+                let functions = parse_functions(binary)?;
+                if let Err(e) = cache.store(hash, &functions) {
+                    warn!("failed to cache bindings for {}: {}", name, e);
+                }
+                functions
+            }
+        };
 
         Ok(Module {
             name,
@@ -210,10 +234,17 @@ impl Module {
     }
 }
 
-fn read_section_address(data: &[u8], section_name: &str) -> Result<Range<u64>, Error> {
-    let bin = object::File::parse(data)
-        .map_err(|_| BindingError::SectionReadError(section_name.to_owned()))?;
+/// Reads the functions exported in the `.lf.funcs` section of a binary.
+fn parse_functions(binary: &[u8]) -> Result<Vec<Function>, Error> {
+    let bin = object::File::parse(binary)
+        .map_err(|_| BindingError::DwarfReadError("binary file".to_owned()))?;
 
+    let functions = dwarf::parse_object(&bin)?;
+    let range = read_section_address(&bin, ".lf.funcs")?;
+    Ok(functions.into_iter().filter(|f| range.start <= f.address && f.address < range.end).collect())
+}
+
+fn read_section_address(bin: &object::File, section_name: &str) -> Result<Range<u64>, Error> {
     for section in bin.sections() {
         if let Some(name) = section.name() {
             if name == section_name {
@@ -262,4 +293,20 @@ mod test {
 
         assert_eq!(&*binding.into_inner(), expected);
     }
+
+    #[test]
+    fn test_parse_cached() {
+        let dwarf: &[u8] = include_bytes!("./test_resources/module_binding_test");
+        let dir = std::env::temp_dir().join(format!("flipper-binding-cache-{}", std::process::id()));
+        let cache = BindingCache::new(&dir);
+
+        let parsed = Module::parse("user".to_owned(), "".to_owned(), dwarf).unwrap();
+        let first = Module::parse_cached("user".to_owned(), "".to_owned(), dwarf, &cache).unwrap();
+        assert!(cache.load(cache::content_hash(dwarf)).is_some());
+        let second = Module::parse_cached("user".to_owned(), "".to_owned(), dwarf, &cache).unwrap();
+
+        assert_eq!(first, parsed);
+        assert_eq!(second, parsed);
+        let _ = std::fs::remove_dir_all(&dir);
+    }
 }
@@ -1,10 +1,28 @@
 #include <flipper/flipper.h>
 
-LF_MODULE(_user, "user", "User module description", NULL, NULL);
+/* User module description */
 
-const struct _user_interface user { user_test };
+enum { _user_test };
+
+int user_test(int a, char b, long int c);
+
+void *user_interface[] = { &user_test };
+
+LF_MODULE(user, "user", user_interface);
+
+/* The index of the module on the device it was last resolved on. */
+static struct _lf_handle _user_handle;
 
 LF_WEAK int user_test(int a, char b, long int c) {
-    int result =
-        lf_invoke(lf_get_selected(), &_user, _user_test, lf_uint32_t, lf_args(lf_infer(a), lf_infer(b), lf_infer(c)));
+    struct _lf_device *device = lf_get_selected();
+    struct _fmr_packet packet;
+    lf_return_t retval = 0;
+    uint8_t *argv = lf_call_init(&packet, _user_test, lf_int32_t, 0xf0b, 3, 13);
+    lf_pack(argv, 0, int32_t, a);
+    lf_pack(argv, 4, uint8_t, b);
+    lf_pack(argv, 5, int64_t, c);
+    if (lf_resolve(device, "user", &_user_handle)) {
+        lf_invoke_packet(device, &_user_handle, &packet, &retval);
+    }
+    return (int)retval;
 }
@@ -1,18 +1,52 @@
 #include <flipper/flipper.h>
 
-LF_MODULE(_user, "user", "User module description", NULL, NULL);
+/* User module description */
 
-const struct _user_interface user { user_test_four, user_test_three, user_test_one };
+enum { _user_test_four, _user_test_three, _user_test_one };
+
+char* user_test_four(uint8_t first, uint16_t second, uint32_t third);
+int user_test_three(char letter);
+void user_test_one(void);
+
+void *user_interface[] = { &user_test_four, &user_test_three, &user_test_one };
+
+LF_MODULE(user, "user", user_interface);
+
+/* The index of the module on the device it was last resolved on. */
+static struct _lf_handle _user_handle;
 
 LF_WEAK char* user_test_four(uint8_t first, uint16_t second, uint32_t third) {
-    char* result = lf_invoke(lf_get_selected(), &_user, _user_test_four, lf_uint8_t,
-                             lf_args(lf_infer(first), lf_infer(second), lf_infer(third)));
+    struct _lf_device *device = lf_get_selected();
+    struct _fmr_packet packet;
+    lf_return_t retval = 0;
+    uint8_t *argv = lf_call_init(&packet, _user_test_four, lf_ptr_t, 0x310, 3, 7);
+    lf_pack(argv, 0, uint8_t, first);
+    lf_pack(argv, 1, uint16_t, second);
+    lf_pack(argv, 3, uint32_t, third);
+    if (lf_resolve(device, "user", &_user_handle)) {
+        lf_invoke_packet(device, &_user_handle, &packet, &retval);
+    }
+    return (char*)(uintptr_t)retval;
 }
 
 LF_WEAK int user_test_three(char letter) {
-    int result = lf_invoke(lf_get_selected(), &_user, _user_test_three, lf_uint32_t, lf_args(lf_infer(letter)));
+    struct _lf_device *device = lf_get_selected();
+    struct _fmr_packet packet;
+    lf_return_t retval = 0;
+    uint8_t *argv = lf_call_init(&packet, _user_test_three, lf_int32_t, 0x0, 1, 1);
+    lf_pack(argv, 0, uint8_t, letter);
+    if (lf_resolve(device, "user", &_user_handle)) {
+        lf_invoke_packet(device, &_user_handle, &packet, &retval);
+    }
+    return (int)retval;
 }
 
-LF_WEAK void user_test_one() {
-    void result = lf_invoke(lf_get_selected(), &_user, _user_test_one, lf_void_t, lf_args());
+LF_WEAK void user_test_one(void) {
+    struct _lf_device *device = lf_get_selected();
+    struct _fmr_packet packet;
+    lf_return_t retval = 0;
+    lf_call_init(&packet, _user_test_one, lf_void_t, 0x0, 0, 0);
+    if (lf_resolve(device, "user", &_user_handle)) {
+        lf_invoke_packet(device, &_user_handle, &packet, &retval);
+    }
 }
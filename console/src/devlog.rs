@@ -0,0 +1,204 @@
+//! Drains the log the ATSAM4S keeps of its standard output.
+//!
+//! Text the device prints is appended to a ring in its memory instead of
+//! being written to the UART, which carries FMR. Each write is stamped with
+//! the cycle counter and the PID of the task that made it. The device's
+//! `devlog` module hands over as many whole records as fit in a buffer at a
+//! time, so the host can move the log in bulk between its own calls.
+
+use std::io::{self, Write};
+
+use byteorder::{ByteOrder, LittleEndian};
+use failure::Error;
+use flipper::{flipper_module, Client, LfPointer};
+
+/// The size of a `struct _devlog_record` header on the device.
+pub const HEADER_SIZE: usize = 6;
+
+/// How many bytes of records to move per call.
+pub const DRAIN_SIZE: u32 = 1024;
+
+/// The device's `devlog` module.
+#[flipper_module("devlog")]
+trait Devlog {
+    fn devlog_configure(&mut self) -> u32;
+    fn devlog_read(&mut self, dst: LfPointer, size: u32) -> u32;
+    fn devlog_dropped(&mut self) -> u32;
+}
+
+/// The PID recorded for text written while no task was running.
+const NO_TASK: u8 = 0xff;
+
+/// A piece of text written to the device log.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Record {
+    /// The cycle counter when the text was written.
+    pub cycles: u32,
+    /// The PID of the task that wrote the text, if a task was running.
+    pub pid: Option<u8>,
+    /// The text, which need not be a whole line.
+    pub text: Vec<u8>,
+}
+
+impl Record {
+    /// Decodes records laid out back to back as the device writes them,
+    /// ignoring a truncated record at the end.
+    pub fn parse_all(bytes: &[u8]) -> Vec<Record> {
+        let mut records = Vec::new();
+        let mut rest = bytes;
+        while rest.len() >= HEADER_SIZE {
+            let length = HEADER_SIZE + rest[5] as usize;
+            if rest.len() < length { break; }
+            records.push(Record {
+                cycles: LittleEndian::read_u32(&rest[0..4]),
+                pid: if rest[4] == NO_TASK { None } else { Some(rest[4]) },
+                text: rest[HEADER_SIZE..length].to_vec(),
+            });
+            rest = &rest[length..];
+        }
+        records
+    }
+}
+
+/// Extends the device's 32-bit cycle counter into a running time.
+///
+/// The counter wraps every 2^32 cycles, about 45 seconds at 96 MHz, so the
+/// log must be drained at least that often for times to stay right.
+#[derive(Debug, Clone, Copy)]
+pub struct Clock {
+    rate: u32,
+    last: Option<u32>,
+    wraps: u64,
+}
+
+impl Clock {
+    /// A clock counting at `rate` cycles per second.
+    pub fn new(rate: u32) -> Clock {
+        Clock { rate, last: None, wraps: 0 }
+    }
+
+    /// The seconds the counter has run for, given the cycles of the next
+    /// record. Wraps are counted from the first record seen.
+    pub fn seconds(&mut self, cycles: u32) -> f64 {
+        if let Some(last) = self.last {
+            if cycles < last { self.wraps += 1; }
+        }
+        self.last = Some(cycles);
+        ((self.wraps << 32) + u64::from(cycles)) as f64 / f64::from(self.rate.max(1))
+    }
+}
+
+/// Prints records as lines, stamping each line with the time and task of the
+/// record that started it. Text that doesn't end a line is continued by the
+/// next record.
+#[derive(Debug)]
+pub struct Printer {
+    clock: Clock,
+    line_start: bool,
+}
+
+impl Printer {
+    /// A printer for records timed at `rate` cycles per second.
+    pub fn new(rate: u32) -> Printer {
+        Printer { clock: Clock::new(rate), line_start: true }
+    }
+
+    /// Writes a record's text, prefixing the lines it starts.
+    pub fn write<W: Write>(&mut self, out: &mut W, record: &Record) -> io::Result<()> {
+        let seconds = self.clock.seconds(record.cycles);
+        for line in lines(&record.text) {
+            if self.line_start {
+                match record.pid {
+                    Some(pid) => write!(out, "[{:>12.6}] {:>3}: ", seconds, pid)?,
+                    None => write!(out, "[{:>12.6}]   -: ", seconds)?,
+                }
+            }
+            out.write_all(line)?;
+            self.line_start = line.last() == Some(&b'\n');
+        }
+        Ok(())
+    }
+}
+
+/// Splits text after each newline, keeping the newlines.
+fn lines(text: &[u8]) -> Vec<&[u8]> {
+    let mut lines = Vec::new();
+    let mut start = 0;
+    for (i, &byte) in text.iter().enumerate() {
+        if byte == b'\n' {
+            lines.push(&text[start..i + 1]);
+            start = i + 1;
+        }
+    }
+    if start < text.len() { lines.push(&text[start..]); }
+    lines
+}
+
+/// Returns the number of records the device has dropped because its log was full.
+pub fn dropped<C: Client + ?Sized>(client: &mut C) -> Result<u32, Error> {
+    Ok(DevlogModule::bind(client)?.devlog_dropped()?)
+}
+
+/// Moves every record from the device's log, `DRAIN_SIZE` bytes at a time.
+pub fn drain<C: Client + ?Sized>(client: &mut C) -> Result<Vec<Record>, Error> {
+    let buffer = client.malloc(DRAIN_SIZE)?;
+
+    let read: Result<Vec<u8>, Error> = (|| {
+        let mut bytes = Vec::new();
+        loop {
+            let moved = DevlogModule::bind(client)?.devlog_read(buffer, DRAIN_SIZE)? as usize;
+            if moved == 0 { return Ok(bytes); }
+            let start = bytes.len();
+            bytes.resize(start + moved, 0);
+            client.pull(buffer, &mut bytes[start..])?;
+        }
+    })();
+
+    // Release the buffer even if a call failed.
+    client.free(buffer)?;
+    Ok(Record::parse_all(&read?))
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    #[test]
+    fn test_parse_all() {
+        let mut bytes = vec![0x10, 0, 0, 0, 2, 3, b'a', b'b', b'\n'];
+        bytes.extend_from_slice(&[0x20, 0, 0, 1, 0xff, 2, b'c', b'd']);
+        // A truncated record is ignored.
+        bytes.extend_from_slice(&[0x30, 0, 0, 0, 1, 4, b'e']);
+        assert_eq!(Record::parse_all(&bytes), vec![
+            Record { cycles: 0x10, pid: Some(2), text: b"ab\n".to_vec() },
+            Record { cycles: 0x0100_0020, pid: None, text: b"cd".to_vec() },
+        ]);
+    }
+
+    #[test]
+    fn test_clock_wraps() {
+        let mut clock = Clock::new(1000);
+        assert_eq!(clock.seconds(500), 0.5);
+        assert_eq!(clock.seconds(0xffff_ff00), 4294967.04);
+        // The counter wrapped between these records.
+        assert_eq!(clock.seconds(1000), 4294968.296);
+    }
+
+    #[test]
+    fn test_printer() {
+        let mut printer = Printer::new(1_000_000);
+        let mut out = Vec::new();
+        for record in &[
+            Record { cycles: 1_500_000, pid: Some(1), text: b"hello, ".to_vec() },
+            Record { cycles: 1_600_000, pid: Some(1), text: b"world\nsecond\n".to_vec() },
+            Record { cycles: 2_000_000, pid: None, text: b"isr\n".to_vec() },
+        ] {
+            printer.write(&mut out, record).unwrap();
+        }
+        assert_eq!(String::from_utf8(out).unwrap(), concat!(
+            "[    1.500000]   1: hello, world\n",
+            "[    1.600000]   1: second\n",
+            "[    2.000000]   -: isr\n",
+        ));
+    }
+}
@@ -22,11 +22,13 @@ extern crate failure;
 extern crate byteorder;
 extern crate xmodem;
 extern crate serde;
+extern crate serde_json;
 extern crate toml;
 extern crate gimli;
 extern crate object;
 extern crate handlebars;
 extern crate fallible_iterator;
+extern crate rayon;
 extern crate libc;
 
 // This crate interacts directly with Flipper.
@@ -35,6 +37,12 @@ extern crate flipper;
 
 pub mod hardware;
 pub mod bindings;
+pub mod bench;
+pub mod trace;
+pub mod profile;
+pub mod tasks;
+pub mod devlog;
+pub mod adc;
 
 /// Defines the errors that may be encountered while parsing and executing commands.
 #[derive(Debug, Fail)]
@@ -43,4 +51,12 @@ pub enum CliError {
     /// An error that indicates that a command or its arguments was invalid.
     #[fail(display = "flipper: '{}' is not a flipper command. See 'flipper --help'.", _0)]
     UnrecognizedCommand(String),
+    /// An error that indicates that an argument was given a value it can't take.
+    #[fail(display = "invalid value '{}' for {}", _1, _0)]
+    InvalidValue(&'static str, String),
+}
+
+/// Parses the value given for the command line argument `name`.
+pub fn parse_value<T: ::std::str::FromStr>(name: &'static str, value: &str) -> Result<T, CliError> {
+    value.parse().map_err(|_| CliError::InvalidValue(name, value.to_owned()))
 }
@@ -0,0 +1,367 @@
+//! Builds profiles from the samples taken by the device's `prof` module.
+//!
+//! While sampling, the `prof` module interrupts the ATSAM4S at a fixed rate
+//! from a timer and records the program counter, link register and task it
+//! interrupted. This module drains those samples from the device, maps their
+//! addresses to functions using the DWARF information of the firmware image,
+//! and summarizes them as a flat profile, or as folded stacks for flamegraph
+//! tools.
+//!
+//! Only the interrupted function is known for certain. When the link register
+//! points into some other function, that function is reported as the caller,
+//! which is exact for leaf functions. Functions that have made calls of their
+//! own have a stale link register pointing back into themselves, and are
+//! reported without a caller.
+
+use std::collections::HashMap;
+use std::fmt;
+use std::io::{self, Write};
+use std::thread;
+use std::time::{Duration, Instant};
+
+use byteorder::{ByteOrder, LittleEndian};
+use failure::Error;
+use object;
+use flipper::{flipper_module, Client, LfPointer};
+
+use bindings::BindingError;
+use bindings::dwarf::{self, Symbol};
+
+/// The size of a `struct _prof_sample` on the device.
+pub const SAMPLE_SIZE: usize = 12;
+
+/// The PID recorded for samples taken while no task was current.
+pub const NO_TASK: u8 = 0xFF;
+
+/// The device's `prof` module.
+#[flipper_module("prof")]
+trait Prof {
+    fn prof_configure(&mut self) -> u32;
+    fn prof_start(&mut self, hz: u32) -> u32;
+    fn prof_stop(&mut self) -> u32;
+    fn prof_read(&mut self, dst: LfPointer, count: u32) -> u32;
+    fn prof_dropped(&mut self) -> u32;
+}
+
+/// The most samples moved from the device per pull.
+const READ_BATCH: u32 = 64;
+
+/// How often the device's sample buffer is drained, in milliseconds. It
+/// holds 256 samples, so this keeps up with sampling rates of a few kHz.
+const POLL_INTERVAL_MS: u64 = 50;
+
+#[derive(Debug, Fail)]
+enum ProfileError {
+    #[fail(display = "the device could not sample at {} Hz", _0)]
+    Start(u32),
+}
+
+/// A sample taken by the profiler.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Sample {
+    /// The address of the interrupted instruction.
+    pub pc: u32,
+    /// The link register of the interrupted code.
+    pub lr: u32,
+    /// The PID of the task that was running, or `NO_TASK`.
+    pub pid: u8,
+    /// The exception that was being handled, or zero if none was.
+    pub exception: u8,
+}
+
+impl Sample {
+    /// Decodes samples laid out back to back as the device stores them.
+    /// Trailing bytes which don't make up a whole sample are ignored.
+    pub fn parse_all(bytes: &[u8]) -> Vec<Sample> {
+        bytes.chunks(SAMPLE_SIZE)
+            .filter(|chunk| chunk.len() == SAMPLE_SIZE)
+            .map(|chunk| Sample {
+                pc: LittleEndian::read_u32(&chunk[0..4]),
+                lr: LittleEndian::read_u32(&chunk[4..8]),
+                pid: chunk[8],
+                exception: chunk[9],
+            })
+            .collect()
+    }
+
+    /// Names what the device was doing when the sample was taken: running a
+    /// task, or handling an exception.
+    pub fn context(&self) -> String {
+        match (self.exception, self.pid) {
+            (0, 0) => "kernel".to_owned(),
+            (0, NO_TASK) => "[no task]".to_owned(),
+            (0, pid) => format!("task {}", pid),
+            (11, _) => "svcall".to_owned(),
+            (14, _) => "pendsv".to_owned(),
+            (15, _) => "systick".to_owned(),
+            (exception, _) if exception >= 16 => format!("irq {}", exception - 16),
+            (exception, _) => format!("exception {}", exception),
+        }
+    }
+}
+
+/// Maps code addresses to the functions containing them.
+#[derive(Debug, Default)]
+pub struct Symbolizer {
+    /// Sorted by address.
+    symbols: Vec<Symbol>,
+}
+
+impl Symbolizer {
+    /// Creates a symbolizer over the given function ranges.
+    pub fn new(mut symbols: Vec<Symbol>) -> Symbolizer {
+        symbols.sort_by_key(|symbol| symbol.low);
+        Symbolizer { symbols }
+    }
+
+    /// Creates a symbolizer from the debugging information of a firmware image.
+    pub fn from_elf(buffer: &[u8]) -> Result<Symbolizer, Error> {
+        let bin = object::File::parse(buffer)
+            .map_err(|_| BindingError::DwarfReadError("binary file".to_owned()))?;
+        Ok(Symbolizer::new(dwarf::parse_symbols(&bin)?))
+    }
+
+    /// The number of functions known to the symbolizer.
+    pub fn len(&self) -> usize {
+        self.symbols.len()
+    }
+
+    /// Whether the symbolizer knows of no functions at all.
+    pub fn is_empty(&self) -> bool {
+        self.symbols.is_empty()
+    }
+
+    /// Finds the name of the function containing `address`.
+    pub fn lookup(&self, address: u64) -> Option<&str> {
+        let index = match self.symbols.binary_search_by_key(&address, |symbol| symbol.low) {
+            Ok(index) => index,
+            Err(0) => return None,
+            Err(index) => index - 1,
+        };
+        let symbol = &self.symbols[index];
+        if address < symbol.high { Some(&symbol.name) } else { None }
+    }
+
+    /// Names the function containing `address`, or the address itself if it isn't known.
+    fn name(&self, address: u64) -> String {
+        match self.lookup(address) {
+            Some(name) => name.to_owned(),
+            None => format!("{:#010x}", address),
+        }
+    }
+
+    /// Names the function a sample's link register returns to, if it is known
+    /// and differs from the sampled function.
+    fn caller(&self, sample: &Sample, function: &str) -> Option<&str> {
+        // EXC_RETURN values mean the interrupted code was itself an exception handler's entry.
+        if sample.lr >= 0xFFFF_FFF0 || sample.lr < 2 { return None; }
+        // Clear the Thumb bit, then step back into the call instruction, which
+        // may be the last of its function.
+        let call = u64::from(sample.lr & !1) - 1;
+        self.lookup(call).filter(|&caller| caller != function)
+    }
+}
+
+/// Sample counts by function and by stack.
+#[derive(Debug, Default)]
+pub struct Profile {
+    /// The number of samples taken.
+    pub samples: usize,
+    /// The number of samples lost because the device's buffer was full.
+    pub dropped: u32,
+    functions: HashMap<String, usize>,
+    stacks: HashMap<String, usize>,
+}
+
+impl Profile {
+    /// Symbolizes and counts the given samples.
+    pub fn new(samples: &[Sample], symbols: &Symbolizer, dropped: u32) -> Profile {
+        let mut profile = Profile { samples: samples.len(), dropped, ..Profile::default() };
+        for sample in samples {
+            let function = symbols.name(u64::from(sample.pc));
+
+            let mut stack = sample.context();
+            if let Some(caller) = symbols.caller(sample, &function) {
+                stack.push(';');
+                stack.push_str(caller);
+            }
+            stack.push(';');
+            stack.push_str(&function);
+
+            *profile.functions.entry(function).or_insert(0) += 1;
+            *profile.stacks.entry(stack).or_insert(0) += 1;
+        }
+        profile
+    }
+
+    /// Each sampled function with its number of samples, most sampled first.
+    pub fn flat(&self) -> Vec<(&str, usize)> {
+        let mut flat: Vec<(&str, usize)> = self.functions.iter()
+            .map(|(function, &count)| (function.as_str(), count))
+            .collect();
+        flat.sort_by(|a, b| b.1.cmp(&a.1).then_with(|| a.0.cmp(b.0)));
+        flat
+    }
+
+    /// Writes the flat profile as a table, limited to the `top` most sampled
+    /// functions if given.
+    pub fn write_flat<W: fmt::Write>(&self, out: &mut W, top: Option<usize>) -> fmt::Result {
+        writeln!(out, "{:>9} {:>7}  {}", "samples", "%", "function")?;
+        let flat = self.flat();
+        let shown = top.unwrap_or(flat.len()).min(flat.len());
+        for &(function, count) in &flat[..shown] {
+            let percent = 100.0 * count as f64 / self.samples as f64;
+            writeln!(out, "{:>9} {:>6.2}%  {}", count, percent, function)?;
+        }
+        if shown < flat.len() {
+            writeln!(out, "{:>9} {:>7}  ({} more functions)", "", "", flat.len() - shown)?;
+        }
+        Ok(())
+    }
+
+    /// Writes the samples as folded stacks, one `frame;frame;... count` line
+    /// per distinct stack, as read by flamegraph tools.
+    pub fn write_folded<W: Write>(&self, out: &mut W) -> io::Result<()> {
+        let mut stacks: Vec<(&String, &usize)> = self.stacks.iter().collect();
+        stacks.sort();
+        for (stack, count) in stacks {
+            writeln!(out, "{} {}", stack, count)?;
+        }
+        Ok(())
+    }
+}
+
+/// Samples a device at `hz` for the given duration, returning the samples
+/// taken and the number of samples the device had to drop.
+pub fn record<C: Client + ?Sized>(client: &mut C, hz: u32, duration: Duration) -> Result<(Vec<Sample>, u32), Error> {
+    let buffer = client.malloc(READ_BATCH * SAMPLE_SIZE as u32)?;
+
+    // Moves every sample waiting on the device into `samples`.
+    let drain = |client: &mut C, samples: &mut Vec<Sample>| -> Result<(), Error> {
+        loop {
+            let count = ProfModule::bind(client)?.prof_read(buffer, READ_BATCH)? as usize;
+            if count == 0 { return Ok(()); }
+
+            let mut bytes = vec![0; count * SAMPLE_SIZE];
+            client.pull(buffer, &mut bytes)?;
+            samples.extend(Sample::parse_all(&bytes));
+            if count < READ_BATCH as usize { return Ok(()); }
+        }
+    };
+
+    if ProfModule::bind(client)?.prof_start(hz)? == 0 {
+        client.free(buffer)?;
+        Err(ProfileError::Start(hz))?;
+    }
+
+    let mut samples = Vec::new();
+    let start = Instant::now();
+    let sampled: Result<(), Error> = (|| {
+        while start.elapsed() < duration {
+            thread::sleep(Duration::from_millis(POLL_INTERVAL_MS));
+            drain(client, &mut samples)?;
+        }
+        Ok(())
+    })();
+
+    // Stop sampling even if draining failed, so the device isn't left interrupting itself.
+    ProfModule::bind(client)?.prof_stop()?;
+    sampled?;
+    drain(client, &mut samples)?;
+    let dropped = ProfModule::bind(client)?.prof_dropped()?;
+    client.free(buffer)?;
+
+    Ok((samples, dropped))
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    fn symbols() -> Symbolizer {
+        Symbolizer::new(vec![
+            Symbol { name: "gpio_write".to_owned(), low: 0x400, high: 0x420 },
+            Symbol { name: "os_kernel_task".to_owned(), low: 0x100, high: 0x180 },
+            Symbol { name: "uart0_isr".to_owned(), low: 0x200, high: 0x240 },
+        ])
+    }
+
+    fn sample(pc: u32, lr: u32, pid: u8, exception: u8) -> Sample {
+        Sample { pc, lr, pid, exception }
+    }
+
+    #[test]
+    fn test_parse_samples() {
+        let bytes = [
+            0x10, 0x01, 0x00, 0x00, 0x05, 0x04, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+            0x00, 0x02, 0x00, 0x00, 0xFD, 0xFF, 0xFF, 0xFF, 0x00, 0x18, 0x00, 0x00,
+            0xAA, 0xBB,
+        ];
+        assert_eq!(Sample::parse_all(&bytes), vec![
+            sample(0x110, 0x405, 2, 0),
+            sample(0x200, 0xFFFF_FFFD, 0, 24),
+        ]);
+    }
+
+    #[test]
+    fn test_lookup() {
+        let symbols = symbols();
+        assert_eq!(symbols.lookup(0x0FF), None);
+        assert_eq!(symbols.lookup(0x100), Some("os_kernel_task"));
+        assert_eq!(symbols.lookup(0x17F), Some("os_kernel_task"));
+        assert_eq!(symbols.lookup(0x180), None);
+        assert_eq!(symbols.lookup(0x41E), Some("gpio_write"));
+        assert_eq!(symbols.lookup(0x1000), None);
+    }
+
+    #[test]
+    fn test_context() {
+        assert_eq!(sample(0, 0, 0, 0).context(), "kernel");
+        assert_eq!(sample(0, 0, 3, 0).context(), "task 3");
+        assert_eq!(sample(0, 0, NO_TASK, 0).context(), "[no task]");
+        assert_eq!(sample(0, 0, 3, 15).context(), "systick");
+        assert_eq!(sample(0, 0, 3, 24).context(), "irq 8");
+    }
+
+    #[test]
+    fn test_profile() {
+        let samples = vec![
+            // A leaf function, called from the kernel task.
+            sample(0x404, 0x151, 0, 0),
+            sample(0x408, 0x151, 0, 0),
+            // The kernel task itself, with a stale link register.
+            sample(0x120, 0x10F, 0, 0),
+            // An interrupt, entered from thread mode.
+            sample(0x210, 0xFFFF_FFFD, 0, 24),
+            // Somewhere without debugging information.
+            sample(0x800, 0x0, 1, 0),
+        ];
+        let profile = Profile::new(&samples, &symbols(), 7);
+
+        assert_eq!(profile.samples, 5);
+        assert_eq!(profile.dropped, 7);
+        assert_eq!(profile.flat(), vec![
+            ("gpio_write", 2),
+            ("0x00000800", 1),
+            ("os_kernel_task", 1),
+            ("uart0_isr", 1),
+        ]);
+
+        let mut folded = Vec::new();
+        profile.write_folded(&mut folded).unwrap();
+        assert_eq!(String::from_utf8(folded).unwrap(), "\
+irq 8;uart0_isr 1
+kernel;os_kernel_task 1
+kernel;os_kernel_task;gpio_write 2
+task 1;0x00000800 1
+");
+
+        let mut table = String::new();
+        profile.write_flat(&mut table, Some(1)).unwrap();
+        assert_eq!(table, concat!(
+            "  samples       %  function\n",
+            "        2  40.00%  gpio_write\n",
+            "                   (3 more functions)\n",
+        ));
+    }
+}
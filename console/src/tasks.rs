@@ -0,0 +1,211 @@
+//! Reads the run-time statistics the Osmium scheduler keeps for each task.
+//!
+//! The scheduler charges each task for the cycles it runs between context
+//! switches, counts how often it is switched in, and fills its stack with a
+//! known pattern when it is created. The device's `task` module reports
+//! these, along with how much of each stack has been overwritten. CPU usage
+//! is found by comparing two snapshots taken some time apart.
+
+use std::fmt;
+
+use byteorder::{ByteOrder, LittleEndian};
+use failure::Error;
+use flipper::{flipper_module, Client, LfPointer};
+
+/// The size of a `struct _task_stats` on the device.
+pub const STATS_SIZE: usize = 28;
+
+/// The device's `task` module.
+#[flipper_module("task")]
+trait Task {
+    fn task_configure(&mut self) -> u32;
+    fn task_count(&mut self) -> u32;
+    fn task_stats(&mut self, dst: LfPointer, count: u32) -> u32;
+    fn task_switches(&mut self) -> u32;
+    fn task_clock(&mut self) -> u32;
+}
+
+/// The statistics of one task.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct TaskStats {
+    /// The task's PID. The system task is PID 0.
+    pub pid: u32,
+    /// The task's status, as enumerated by `os_task_status`.
+    pub status: u8,
+    /// Whether the task has been found to have overflowed its stack.
+    pub overflowed: bool,
+    /// The size of the task's stack in bytes.
+    pub stack_size: u32,
+    /// The most of its stack the task has used, in bytes.
+    pub stack_used: u32,
+    /// The number of times the task has been switched in.
+    pub switches: u32,
+    /// The cycles the task has spent running.
+    pub runtime: u64,
+}
+
+impl TaskStats {
+    /// Decodes statistics laid out back to back as the device writes them.
+    pub fn parse_all(bytes: &[u8]) -> Vec<TaskStats> {
+        bytes.chunks(STATS_SIZE)
+            .filter(|chunk| chunk.len() == STATS_SIZE)
+            .map(|chunk| TaskStats {
+                pid: LittleEndian::read_u32(&chunk[0..4]),
+                status: chunk[4],
+                overflowed: chunk[5] != 0,
+                stack_size: LittleEndian::read_u32(&chunk[8..12]),
+                stack_used: LittleEndian::read_u32(&chunk[12..16]),
+                switches: LittleEndian::read_u32(&chunk[16..20]),
+                runtime: LittleEndian::read_u64(&chunk[20..28]),
+            })
+            .collect()
+    }
+
+    /// The name of the task's status.
+    pub fn status_name(&self) -> &'static str {
+        match self.status {
+            0 => "unallocated",
+            1 => "idle",
+            2 => "active",
+            3 => "paused",
+            4 => "blocked",
+            _ => "unknown",
+        }
+    }
+}
+
+/// The statistics of every task at one moment.
+#[derive(Debug, Clone, PartialEq)]
+pub struct Snapshot {
+    /// The rate task run times are counted at.
+    pub clock: u32,
+    /// The number of context switches between tasks.
+    pub switches: u32,
+    /// Each task's statistics, in schedule order.
+    pub tasks: Vec<TaskStats>,
+}
+
+/// Returns the rate of the device's cycle counter. Task run times, and the
+/// timestamps of the device log, ADC stream and FMR trace, all count it.
+pub fn clock<C: Client + ?Sized>(client: &mut C) -> Result<u32, Error> {
+    Ok(TaskModule::bind(client)?.task_clock()?)
+}
+
+/// Reads the statistics of every task on the device.
+pub fn snapshot<C: Client + ?Sized>(client: &mut C) -> Result<Snapshot, Error> {
+    let rate = clock(client)?;
+    let count = TaskModule::bind(client)?.task_count()?;
+    let buffer = client.malloc(count.max(1) * STATS_SIZE as u32)?;
+
+    let read: Result<(Vec<TaskStats>, u32), Error> = (|| {
+        let filled = TaskModule::bind(client)?.task_stats(buffer, count)? as usize;
+        let mut bytes = vec![0; filled * STATS_SIZE];
+        client.pull(buffer, &mut bytes)?;
+        let switches = TaskModule::bind(client)?.task_switches()?;
+        Ok((TaskStats::parse_all(&bytes), switches))
+    })();
+
+    // Release the buffer even if a call failed.
+    client.free(buffer)?;
+    let (tasks, switches) = read?;
+    Ok(Snapshot { clock: rate, switches, tasks })
+}
+
+/// What a task did between two snapshots.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct TaskUsage {
+    /// The task's statistics in the later snapshot.
+    pub stats: TaskStats,
+    /// The share of the processor the task used, as a percentage.
+    pub cpu: f64,
+    /// The number of times the task was switched in.
+    pub switches: u32,
+}
+
+/// Finds what each task in `after` did since `before`. Tasks created in
+/// between are charged for everything they have done.
+pub fn usage(before: &Snapshot, after: &Snapshot) -> Vec<TaskUsage> {
+    let deltas: Vec<(TaskStats, u64, u32)> = after.tasks.iter()
+        .map(|task| {
+            match before.tasks.iter().find(|earlier| earlier.pid == task.pid) {
+                Some(earlier) => (*task, task.runtime.saturating_sub(earlier.runtime), task.switches.wrapping_sub(earlier.switches)),
+                None => (*task, task.runtime, task.switches),
+            }
+        })
+        .collect();
+
+    // Interrupts are charged to the task they interrupt, so together the tasks account for all of the time.
+    let total: u64 = deltas.iter().map(|&(_, runtime, _)| runtime).sum();
+    deltas.into_iter()
+        .map(|(stats, runtime, switches)| TaskUsage {
+            stats,
+            cpu: if total > 0 { 100.0 * runtime as f64 / total as f64 } else { 0.0 },
+            switches,
+        })
+        .collect()
+}
+
+/// Writes a table of each task's CPU usage, context switches and stack use.
+pub fn write_table<W: fmt::Write>(out: &mut W, usage: &[TaskUsage]) -> fmt::Result {
+    writeln!(out, "{:>5} {:<8} {:>7} {:>9} {:>15} {:>6}", "pid", "status", "cpu %", "switches", "stack (bytes)", "high")?;
+    for task in usage {
+        let stats = &task.stats;
+        let high = if stats.stack_size > 0 { 100.0 * f64::from(stats.stack_used) / f64::from(stats.stack_size) } else { 0.0 };
+        writeln!(out, "{:>5} {:<8} {:>7.2} {:>9} {:>15} {:>5.0}%{}",
+                 stats.pid, stats.status_name(), task.cpu, task.switches,
+                 format!("{}/{}", stats.stack_used, stats.stack_size), high,
+                 if stats.overflowed { "  OVERFLOWED" } else { "" })?;
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    fn stats(pid: u32, runtime: u64, switches: u32) -> TaskStats {
+        TaskStats { pid, status: 1, overflowed: false, stack_size: 1024, stack_used: 256, switches, runtime }
+    }
+
+    #[test]
+    fn test_parse_all() {
+        let mut bytes = vec![
+            1, 0, 0, 0, 2, 1, 0, 0,
+            0, 4, 0, 0, 0x40, 1, 0, 0,
+            5, 0, 0, 0, 0, 0x10, 0, 0, 1, 0, 0, 0,
+        ];
+        // A partial record is ignored.
+        bytes.extend_from_slice(&[0; 4]);
+        assert_eq!(TaskStats::parse_all(&bytes), vec![TaskStats {
+            pid: 1,
+            status: 2,
+            overflowed: true,
+            stack_size: 1024,
+            stack_used: 320,
+            switches: 5,
+            runtime: 0x1_0000_1000,
+        }]);
+    }
+
+    #[test]
+    fn test_usage() {
+        let before = Snapshot { clock: 96_000_000, switches: 10, tasks: vec![stats(0, 1000, 5), stats(1, 500, 5)] };
+        let after = Snapshot {
+            clock: 96_000_000,
+            switches: 30,
+            tasks: vec![stats(0, 4000, 12), stats(1, 1500, 12), stats(2, 1000, 3)],
+        };
+
+        let usage: Vec<(u32, f64, u32)> = usage(&before, &after).iter()
+            .map(|task| (task.stats.pid, task.cpu, task.switches))
+            .collect();
+        assert_eq!(usage, vec![(0, 60.0, 7), (1, 20.0, 7), (2, 20.0, 3)]);
+
+        let mut table = String::new();
+        write_table(&mut table, &super::usage(&before, &after)[2..]).unwrap();
+        assert_eq!(table, concat!(
+            "  pid status     cpu %  switches   stack (bytes)   high\n",
+            "    2 idle       20.00         3        256/1024    25%\n",
+        ));
+    }
+}
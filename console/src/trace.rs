@@ -0,0 +1,360 @@
+//! Inspects captures of FMR traffic recorded by the Flipper library.
+//!
+//! Any program using the library records its traffic when the `FLIPPER_TRACE`
+//! environment variable names a capture file. This module filters the records
+//! of a capture, gives call packets the names of the modules they were sent
+//! to, and exports records to pcapng so that standard tools can read them.
+//!
+//! Exported packets use the `LINKTYPE_USER0` link type. Each packet starts
+//! with a 16-byte little-endian pseudo-header, followed by the record's data:
+//!
+//! | offset | size | field                                                   |
+//! |--------|------|---------------------------------------------------------|
+//! | 0      | 1    | the pseudo-header version, currently 1                  |
+//! | 1      | 1    | the kind of record: 0 for a packet, 1 for a resolve, 2 for a payload |
+//! | 2      | 1    | the route: 0 for the primary processor, 1 for the co-processor |
+//! | 3      | 1    | 1 if the operation succeeded, 0 otherwise               |
+//! | 4      | 4    | how long the operation took, in µs                      |
+//! | 8      | 8    | the value returned, or the module index of a resolve    |
+//! | 16     | len  | the FMR packet as sent, or the name of the resolved module |
+
+use std::collections::HashMap;
+use std::fmt;
+use std::io::{self, Read, Write};
+
+use byteorder::{LittleEndian, WriteBytesExt};
+use flipper::replay::Replayed;
+use flipper::trace::{CaptureReader, Record, RecordKind};
+use flipper::Route;
+
+/// The pcapng link type for FMR records: `LINKTYPE_USER0`.
+pub const LINKTYPE_FMR: u16 = 147;
+
+const PSEUDO_HEADER_VERSION: u8 = 1;
+const PSEUDO_HEADER_SIZE: usize = 16;
+
+/// The name of a record's class, as accepted by `Filter::classes`.
+pub fn class_name(record: &Record) -> &'static str {
+    match record.kind {
+        RecordKind::Resolve => "resolve",
+        RecordKind::Payload => "payload",
+        RecordKind::Packet => match record.data.get(5) {
+            Some(0) => "call",
+            Some(1) => "push",
+            Some(2) => "pull",
+            Some(3) => "dyld",
+            Some(4) => "malloc",
+            Some(5) => "free",
+            _ => "unknown",
+        },
+    }
+}
+
+/// A record of a capture, along with the module it concerns, if known.
+#[derive(Debug, Clone)]
+pub struct Entry {
+    /// The captured record.
+    pub record: Record,
+    /// The name of the module that was resolved, or that a call was sent to.
+    pub module: Option<String>,
+}
+
+impl fmt::Display for Entry {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        let record = &self.record;
+        let route = match record.route {
+            Route::Primary => "primary",
+            Route::Coprocessor => "coprocessor",
+        };
+        let target = match (self.module.as_ref(), record.call()) {
+            (Some(module), Some((_, function))) => format!("{}[{}]", module, function),
+            (None, Some((index, function))) => format!("#{}[{}]", index, function),
+            (Some(module), None) => module.clone(),
+            (None, None) => String::new(),
+        };
+        let outcome = if record.ok { format!("-> {:#x}", record.value) } else { "failed".to_owned() };
+
+        write!(f, "{:>14.6}s {:<11} {:<7} {:<20} {:>8} us  {}",
+               record.timestamp as f64 / 1e6, route, class_name(record), target, record.latency, outcome)
+    }
+}
+
+/// Which records of a capture to keep. Empty criteria keep every record.
+#[derive(Debug, Clone, Default)]
+pub struct Filter {
+    /// Keep only records concerning this module.
+    pub module: Option<String>,
+    /// Keep only records of these classes, by `class_name`.
+    pub classes: Vec<String>,
+    /// Keep only records that took at least this many µs.
+    pub slower_than: Option<u32>,
+}
+
+impl Filter {
+    /// Whether the given entry passes the filter.
+    pub fn matches(&self, entry: &Entry) -> bool {
+        if let Some(ref module) = self.module {
+            if entry.module.as_ref() != Some(module) { return false; }
+        }
+        if !self.classes.is_empty() && !self.classes.iter().any(|class| class == class_name(&entry.record)) {
+            return false;
+        }
+        if let Some(latency) = self.slower_than {
+            if entry.record.latency < latency { return false; }
+        }
+        true
+    }
+}
+
+/// Reads a capture, naming the module of every call after the resolve that
+/// preceded it, and returns the entries that pass `filter`.
+///
+/// Returns the time the capture started, in µs since the Unix epoch, along
+/// with the entries.
+pub fn read_capture<R: Read>(capture: R, filter: &Filter) -> io::Result<(u64, Vec<Entry>)> {
+    let reader = CaptureReader::new(capture)?;
+    let epoch = reader.epoch();
+
+    let mut names: HashMap<(Route, u64), String> = HashMap::new();
+    let mut entries = Vec::new();
+    for record in reader {
+        let record = record?;
+        let module = match record.kind {
+            RecordKind::Resolve => {
+                let name = record.name().map(|name| name.to_owned());
+                if let (true, Some(name)) = (record.ok, name.as_ref()) {
+                    names.insert((record.route, record.value), name.clone());
+                }
+                name
+            }
+            RecordKind::Packet => record.call()
+                .and_then(|(index, _)| names.get(&(record.route, u64::from(index))))
+                .cloned(),
+            RecordKind::Payload => None,
+        };
+
+        let entry = Entry { record, module };
+        if filter.matches(&entry) {
+            entries.push(entry);
+        }
+    }
+    Ok((epoch, entries))
+}
+
+/// Totals over a replayed session.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct ReplaySummary {
+    /// The number of operations replayed.
+    pub operations: usize,
+    /// The number of operations the stand-in answered differently.
+    pub mismatches: usize,
+    /// The sum of the recorded latencies, in µs.
+    pub recorded: u64,
+    /// The sum of the replayed latencies, in µs.
+    pub replayed: u64,
+    /// The median change in latency, in µs.
+    pub p50_delta: i64,
+    /// The change in latency which 99% of operations did better than, in µs.
+    pub p99_delta: i64,
+}
+
+impl ReplaySummary {
+    /// Totals the outcomes of a replay. Returns `None` if nothing was replayed.
+    pub fn new(replayed: &[Replayed]) -> Option<ReplaySummary> {
+        if replayed.is_empty() { return None; }
+
+        let mut deltas: Vec<i64> = replayed.iter().map(|call| call.delta()).collect();
+        deltas.sort();
+        let percentile = |p: usize| deltas[((p * deltas.len() + 99) / 100).max(1) - 1];
+
+        Some(ReplaySummary {
+            operations: replayed.len(),
+            mismatches: replayed.iter().filter(|call| !call.matches()).count(),
+            recorded: replayed.iter().map(|call| u64::from(call.record.latency)).sum(),
+            replayed: replayed.iter().map(|call| u64::from(call.latency)).sum(),
+            p50_delta: percentile(50),
+            p99_delta: percentile(99),
+        })
+    }
+}
+
+impl fmt::Display for ReplaySummary {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        writeln!(f, "{} operations, {} answered differently", self.operations, self.mismatches)?;
+        writeln!(f, "total: recorded {} us, replayed {} us", self.recorded, self.replayed)?;
+        write!(f, "change per operation: p50 {:+} us, p99 {:+} us", self.p50_delta, self.p99_delta)
+    }
+}
+
+/// Prints the outcome of each replayed operation, naming modules as in `read_capture`.
+pub fn write_replay<W: fmt::Write>(out: &mut W, replayed: &[Replayed]) -> fmt::Result {
+    let mut names: HashMap<(Route, u64), String> = HashMap::new();
+
+    writeln!(out, "{:>6} {:<7} {:<20} {:>10} {:>10} {:>9}  {}",
+             "#", "class", "target", "recorded", "replayed", "change", "result")?;
+    for (i, call) in replayed.iter().enumerate() {
+        let record = &call.record;
+        if let (RecordKind::Resolve, true, Some(name)) = (record.kind, record.ok, record.name()) {
+            names.insert((record.route, record.value), name.to_owned());
+        }
+        let target = match (record.name(), record.call()) {
+            (Some(name), _) => name.to_owned(),
+            (None, Some((index, function))) => match names.get(&(record.route, u64::from(index))) {
+                Some(module) => format!("{}[{}]", module, function),
+                None => format!("#{}[{}]", index, function),
+            },
+            (None, None) => String::new(),
+        };
+        let result = if call.matches() { "same" } else { "DIFFERENT" };
+
+        writeln!(out, "{:>6} {:<7} {:<20} {:>7} us {:>7} us {:>+6} us  {}",
+                 i, class_name(record), target, record.latency, call.latency, call.delta(), result)?;
+    }
+    Ok(())
+}
+
+fn pad(len: usize) -> usize {
+    (4 - len % 4) % 4
+}
+
+/// Writes entries as a pcapng capture with a single interface of type `LINKTYPE_FMR`.
+/// `epoch` is the time the capture started, in µs since the Unix epoch.
+pub fn write_pcapng<W: Write>(out: &mut W, epoch: u64, entries: &[Entry]) -> io::Result<()> {
+    // Section header block.
+    out.write_u32::<LittleEndian>(0x0A0D_0D0A)?;
+    out.write_u32::<LittleEndian>(28)?;
+    out.write_u32::<LittleEndian>(0x1A2B_3C4D)?;
+    out.write_u16::<LittleEndian>(1)?;
+    out.write_u16::<LittleEndian>(0)?;
+    out.write_i64::<LittleEndian>(-1)?;
+    out.write_u32::<LittleEndian>(28)?;
+
+    // Interface description block. Timestamps default to microsecond resolution.
+    out.write_u32::<LittleEndian>(1)?;
+    out.write_u32::<LittleEndian>(20)?;
+    out.write_u16::<LittleEndian>(LINKTYPE_FMR)?;
+    out.write_u16::<LittleEndian>(0)?;
+    out.write_u32::<LittleEndian>(0)?;
+    out.write_u32::<LittleEndian>(20)?;
+
+    // An enhanced packet block for each entry.
+    for entry in entries {
+        let record = &entry.record;
+        let len = PSEUDO_HEADER_SIZE + record.data.len();
+        let block_len = (32 + len + pad(len)) as u32;
+        let timestamp = epoch + record.timestamp;
+
+        out.write_u32::<LittleEndian>(6)?;
+        out.write_u32::<LittleEndian>(block_len)?;
+        out.write_u32::<LittleEndian>(0)?;
+        out.write_u32::<LittleEndian>((timestamp >> 32) as u32)?;
+        out.write_u32::<LittleEndian>(timestamp as u32)?;
+        out.write_u32::<LittleEndian>(len as u32)?;
+        out.write_u32::<LittleEndian>(len as u32)?;
+
+        out.write_u8(PSEUDO_HEADER_VERSION)?;
+        out.write_u8(match record.kind {
+            RecordKind::Packet => 0,
+            RecordKind::Resolve => 1,
+            RecordKind::Payload => 2,
+        })?;
+        out.write_u8(match record.route { Route::Primary => 0, Route::Coprocessor => 1 })?;
+        out.write_u8(record.ok as u8)?;
+        out.write_u32::<LittleEndian>(record.latency)?;
+        out.write_u64::<LittleEndian>(record.value)?;
+        out.write_all(&record.data)?;
+        out.write_all(&[0u8; 3][..pad(len)])?;
+
+        out.write_u32::<LittleEndian>(block_len)?;
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+
+    fn capture(records: &[(u8, u8, u8, u32, u64, &[u8])]) -> Vec<u8> {
+        let mut bytes = b"FMRTRACE\x01\x00\x00\x00".to_vec();
+        bytes.write_u64::<LittleEndian>(1_000_000).unwrap();
+        for (i, &(kind, route, ok, latency, value, data)) in records.iter().enumerate() {
+            bytes.extend_from_slice(&[kind, route, ok, data.len() as u8]);
+            bytes.write_u64::<LittleEndian>(i as u64 * 10).unwrap();
+            bytes.write_u32::<LittleEndian>(latency).unwrap();
+            bytes.write_u64::<LittleEndian>(value).unwrap();
+            bytes.extend_from_slice(data);
+        }
+        bytes
+    }
+
+    /// The first eight bytes of a call packet to function 2 of module 5.
+    const CALL: &[u8] = &[0xFE, 0, 0, 8, 0, 0, 5, 2];
+    const PUSH: &[u8] = &[0xFE, 0, 0, 6, 0, 1];
+
+    #[test]
+    fn test_read_capture() {
+        let bytes = capture(&[
+            (1, 1, 1, 40, 5, b"led"),
+            (0, 1, 1, 100, 0, CALL),
+            (0, 0, 1, 900, 0, CALL),
+            (0, 0, 1, 2000, 0, PUSH),
+        ]);
+
+        let (epoch, entries) = read_capture(&bytes[..], &Filter::default()).unwrap();
+        assert_eq!(epoch, 1_000_000);
+        assert_eq!(entries.len(), 4);
+        assert_eq!(entries[0].module, Some("led".to_owned()));
+        assert_eq!(entries[1].module, Some("led".to_owned()));
+        // The same index on the other processor is a different module.
+        assert_eq!(entries[2].module, None);
+        assert_eq!(class_name(&entries[3].record), "push");
+
+        let filter = Filter { module: Some("led".to_owned()), classes: vec!["call".to_owned()], slower_than: None };
+        let (_, entries) = read_capture(&bytes[..], &filter).unwrap();
+        assert_eq!(entries.len(), 1);
+        assert_eq!(entries[0].record.latency, 100);
+
+        let filter = Filter { slower_than: Some(900), ..Filter::default() };
+        let (_, entries) = read_capture(&bytes[..], &filter).unwrap();
+        assert_eq!(entries.len(), 2);
+    }
+
+    #[test]
+    fn test_replay_summary() {
+        let bytes = capture(&[(0, 0, 1, 100, 7, CALL), (0, 0, 1, 200, 7, CALL), (0, 0, 1, 300, 7, CALL)]);
+        let (_, entries) = read_capture(&bytes[..], &Filter::default()).unwrap();
+        let replayed: Vec<Replayed> = entries.into_iter().zip(&[150, 150, 900])
+            .map(|(entry, &latency)| Replayed { record: entry.record, latency, outcome: Some(7) })
+            .collect();
+
+        let summary = ReplaySummary::new(&replayed).unwrap();
+        assert_eq!(summary.operations, 3);
+        assert_eq!(summary.mismatches, 0);
+        assert_eq!((summary.recorded, summary.replayed), (600, 1200));
+        assert_eq!((summary.p50_delta, summary.p99_delta), (50, 600));
+        assert_eq!(ReplaySummary::new(&[]), None);
+    }
+
+    #[test]
+    fn test_write_pcapng() {
+        let bytes = capture(&[(0, 0, 1, 100, 7, CALL)]);
+        let (epoch, entries) = read_capture(&bytes[..], &Filter::default()).unwrap();
+
+        let mut pcap = Vec::new();
+        write_pcapng(&mut pcap, epoch, &entries).unwrap();
+
+        // Section header, interface description, and one 56-byte packet block.
+        assert_eq!(pcap.len(), 28 + 20 + 56);
+        assert_eq!(&pcap[28..32], &[1, 0, 0, 0]);
+        assert_eq!(&pcap[36..38], &[147, 0]);
+
+        let block = &pcap[48..];
+        assert_eq!(&block[0..4], &[6, 0, 0, 0]);
+        assert_eq!(&block[4..8], &[56, 0, 0, 0]);
+        assert_eq!(&block[16..20], &1_000_000u32.to_le_bytes());
+        assert_eq!(&block[20..24], &[24, 0, 0, 0]);
+        assert_eq!(&block[28..32], &[1, 0, 0, 1]);
+        assert_eq!(&block[44..52], CALL);
+        assert_eq!(&block[52..56], &[56, 0, 0, 0]);
+    }
+}
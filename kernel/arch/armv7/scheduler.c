@@ -29,6 +29,10 @@ void os_scheduler_init(void) {
     /* Configure the NVIC SysTick exception with the highest possible priority. */
     NVIC_SetPriority(SysTick_IRQn, SYSTICK_PRIORITY);
 
+    /* Enable the DWT cycle counter. Task run times and device timestamps are deltas of it, so it is never reset. */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
     /* Clear the schedule. */
     memset(&schedule, 0, sizeof(struct _os_schedule));
 
@@ -40,6 +44,9 @@ void os_scheduler_init(void) {
     os_current_task = schedule.head = task;
     /* Make the system task's next task point back to the system task. */
     task->next = task;
+    /* The system task is switched in now. */
+    task->started = DWT->CYCCNT;
+    task->switches = 1;
 
     /* Configure the SysTick to fire once every millisecond. */
     SysTick_Config(F_CPU / 1000);
@@ -84,6 +91,9 @@ struct _os_task *os_task_create(void *_entry, void (*_exit)(struct _lf_abi_heade
     os_stack_t *stack = malloc(stack_size);
     lf_assert(stack, E_NULL, "Failed to allocate memory to create stack.");
 
+    /* Paint the stack, so that how much of it the task uses can be measured. */
+    for (uint32_t i = 0; i < stack_size / sizeof(os_stack_t); i++) stack[i] = OS_STACK_PAINT;
+
     /* Set the task's stack pointer to the top of the task's stack. */
     task->sp = (uintptr_t)stack + stack_size;
     /* Set the PID of the task. */
@@ -94,6 +104,13 @@ struct _os_task *os_task_create(void *_entry, void (*_exit)(struct _lf_abi_heade
     task->status = os_task_status_idle;
     /* Store the address of the task's stack. */
     task->stack = stack;
+    task->stack_size = stack_size;
+    /* The task has not run yet. */
+    task->overflowed = false;
+    task->runtime = 0;
+    task->started = 0;
+    task->switches = 0;
+    task->waiting = NULL;
     /* Set the task's exit function. */
     task->exit = _exit;
     /* Set the task's exit context. */
@@ -124,6 +141,8 @@ struct _os_task *os_task_create(void *_entry, void (*_exit)(struct _lf_abi_heade
     _tsk->r9 = 9;
     _tsk->r10 = 10;
     _tsk->r11 = 11;
+    /* The task starts out without FPU state. */
+    _tsk->exc_return = OS_EXC_RETURN_THREAD_PSP;
 
     return task;
 fail:
@@ -164,20 +183,29 @@ fail:
     return lf_error;
 }
 
+/* Whether a task can be switched to. */
+static bool os_task_runnable(struct _os_task *task) {
+    if (task->status == os_task_status_paused) return false;
+    /* A blocked task can run again once the flags it waits for are ready. */
+    if (task->status == os_task_status_blocked) return lf_event_ready(task->waiting, task->wait_mask, task->wait_all);
+    return true;
+}
+
 /* Schedules the next task for exeuction. */
 void os_task_next(void) {
     if (os_current_task) {
-        /* Mark the current task as idle. */
-        os_current_task->status = os_task_status_idle;
+        /* Mark the current task as idle, unless it is pausing or blocking. */
+        if (os_current_task->status == os_task_status_active) os_current_task->status = os_task_status_idle;
         /* Prepare to context switch to the active task. */
         os_next_task = os_current_task->next;
     }
-check:
-    /* If the next task is paused, skip it. */
-    if (os_next_task->status == os_task_status_paused) {
+    /* Skip tasks that can't run. If none can, fall back to the system task, which waits out its own block. */
+    for (int i = 0; !os_task_runnable(os_next_task); i++) {
+        if (i == schedule.count) {
+            os_next_task = schedule.head;
+            break;
+        }
         os_next_task = os_next_task->next;
-        /* Check if the next next task was paused, so on and so fourth. */
-        goto check;
     }
     /* Mark the next task as active. */
     os_next_task->status = os_task_status_active;
@@ -187,10 +215,44 @@ check:
 
 /* Called at the end of the PendSV exception to cycle the task pointers. */
 void os_update_task_pointers(void) {
+    uint32_t now = DWT->CYCCNT;
+
+    if (os_current_task) {
+        /* Charge the outgoing task for the time since it was switched in. The counter may wrap in between. */
+        os_current_task->runtime += (uint32_t)(now - os_current_task->started);
+        /* The bottom of a stack keeps its paint unless the task has run past it. */
+        if (*(os_stack_t *)os_current_task->stack != OS_STACK_PAINT) os_current_task->overflowed = true;
+    }
+
+    if (os_next_task != os_current_task) {
+        os_next_task->switches++;
+        schedule.switches++;
+    }
+    os_next_task->started = now;
+
     /* Make the current task the next task. */
     os_current_task = os_next_task;
 }
 
+/* Returns the deepest a task has used its stack, in bytes, by finding the lowest word that is no longer painted. */
+uint32_t os_task_stack_used(struct _os_task *task) {
+    const os_stack_t *stack = task->stack;
+    uint32_t words = task->stack_size / sizeof(os_stack_t), untouched = 0;
+    while (untouched < words && stack[untouched] == OS_STACK_PAINT) untouched++;
+    return task->stack_size - untouched * sizeof(os_stack_t);
+}
+
+/* Returns the cycles a task has spent running, including the time since it was last switched in. */
+uint64_t os_task_runtime(struct _os_task *task) {
+    /* Keep a context switch from landing between the reads. This may be called with interrupts already disabled. */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t runtime = task->runtime;
+    if (task == os_current_task) runtime += (uint32_t)(DWT->CYCCNT - task->started);
+    __set_PRIMASK(primask);
+    return runtime;
+}
+
 /* Gets the task pointer for a given PID. */
 struct _os_task *os_task_from_pid(int pid) {
     struct _os_task *task = schedule.head;
@@ -254,6 +316,51 @@ fail:
     return lf_error;
 }
 
+/* Blocks the current task until the flags of 'mask' are ready, then takes them and returns them. */
+uint32_t os_event_wait(struct _lf_event *event, uint32_t mask, bool all) {
+    lf_assert(event, E_NULL, "invalid event");
+    lf_assert(mask, E_BOUNDARY, "no flags to wait for");
+
+    uint32_t taken;
+    while (1) {
+        /* Check and block with interrupts disabled, so that a signal landing in between isn't missed. */
+        __disable_irq();
+        if ((taken = lf_event_take(event, mask, all))) break;
+        os_current_task->waiting = event;
+        os_current_task->wait_mask = mask;
+        os_current_task->wait_all = all;
+        os_current_task->status = os_task_status_blocked;
+        os_task_next();
+        /* The context switch happens here, once interrupts are enabled. */
+        __enable_irq();
+    }
+    os_current_task->waiting = NULL;
+    __enable_irq();
+
+    return taken;
+fail:
+    return 0;
+}
+
+/* Sets flags of an event. When called from an interrupt, a task that was waiting for them runs as soon as the
+   interrupt returns, rather than at its next turn. */
+void os_event_signal(struct _lf_event *event, uint32_t mask) {
+    lf_event_set(event, mask);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    struct _os_task *task = schedule.head;
+    for (int i = 0; i < schedule.count; i++, task = task->next) {
+        if (task->status != os_task_status_blocked || task->waiting != event || !os_task_runnable(task)) continue;
+        if (os_current_task && os_current_task->status == os_task_status_active) os_current_task->status = os_task_status_idle;
+        os_next_task = task;
+        os_next_task->status = os_task_status_active;
+        SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
+        break;
+    }
+    __set_PRIMASK(primask);
+}
+
 /* This function is called once per millisecond and triggers a context switch. */
 void systick_exception(void) {
     /* Queue the execution of the next task. */
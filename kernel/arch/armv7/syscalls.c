@@ -1,4 +1,5 @@
 #include "libflipper.h"
+#include "devlog.h"
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -18,8 +19,6 @@ extern caddr_t _sbrk(int increment) {
     return (caddr_t)(previous);
 }
 
-extern void uart0_put(uint8_t c);
-
 extern int _close(int file) {
     return -1;
 }
@@ -41,7 +40,10 @@ extern int _read(int file, char *ptr, int len) {
 }
 
 extern int _write(int file, char *ptr, int len) {
-    return 0;
+    /* Output goes to the device log rather than the UART, which carries FMR. The host drains the log. */
+    devlog_write(ptr, len);
+    /* Text the log has no room for is dropped, not retried. */
+    return len;
 }
 
 extern void _exit(int status) {
@@ -8,7 +8,8 @@ typedef enum {
     os_task_status_unallocated,
     os_task_status_idle,
     os_task_status_active,
-    os_task_status_paused
+    os_task_status_paused,
+    os_task_status_blocked
 } os_task_status;
 
 typedef uint32_t os_stack_t;
@@ -24,6 +25,21 @@ struct _os_task {
     volatile os_task_status status;
     /* The base address of the task's stack, stored for task deallocation. */
     void *stack;
+    /* The size of the task's stack in bytes. */
+    uint32_t stack_size;
+    /* Set once the task has been found to have overflowed its stack. */
+    volatile bool overflowed;
+    /* The cycles the task has spent running, up to its last switch out. */
+    volatile uint64_t runtime;
+    /* The cycle count when the task was last switched in. */
+    volatile uint32_t started;
+    /* The number of times the task has been switched in. */
+    volatile uint32_t switches;
+    /* The event a blocked task is waiting for, and the flags it is waiting for. */
+    struct _lf_event *waiting;
+    uint32_t wait_mask;
+    /* Whether a blocked task is waiting for all of its flags, rather than any of them. */
+    bool wait_all;
     /* The task's exit function. */
     void (*exit)(struct _lf_abi_header *header);
     /* The task's header. */
@@ -41,12 +57,16 @@ struct _os_schedule {
     volatile uint8_t active;
     /* The number of active tasks. */
     uint8_t count;
+    /* The number of context switches between tasks. */
+    volatile uint32_t switches;
 };
 
 /* The PID of the system task. */
 #define os_kernel_task_PID 0
 /* System task stack size. */
 #define KERNEL_TASK_STACK_SIZE_WORDS 128
+/* The value stacks are filled with when created, so the deepest use of a stack can be found later. */
+#define OS_STACK_PAINT 0xA5A5A5A5
 
 /* Data structure to represent registers saved by the hardware. */
 struct _stack_ctx {
@@ -70,8 +90,13 @@ struct _task_ctx {
     uint32_t r9;
     uint32_t r10;
     uint32_t r11;
+    /* The EXC_RETURN value the task was switched out with, which records whether its frame holds FPU state. */
+    uint32_t exc_return;
 };
 
+/* The EXC_RETURN value that returns to thread mode on the PSP, restoring a frame without FPU state. */
+#define OS_EXC_RETURN_THREAD_PSP 0xFFFFFFFD
+
 void os_kernel_task(void);
 void os_scheduler_init(void);
 
@@ -80,5 +105,9 @@ struct _os_task *os_task_create(void *_entry, void (*_exit)(struct _lf_abi_heade
 int os_task_add(struct _os_task *task);
 int os_task_release(struct _os_task *task);
 void os_task_next(void);
+uint32_t os_task_stack_used(struct _os_task *task);
+uint64_t os_task_runtime(struct _os_task *task);
+uint32_t os_event_wait(struct _lf_event *event, uint32_t mask, bool all);
+void os_event_signal(struct _lf_event *event, uint32_t mask);
 
 #endif
@@ -0,0 +1,112 @@
+#ifndef __lf_atomic_h__
+#define __lf_atomic_h__
+
+/*
+ * Atomic operations on 32-bit words, safe between tasks and the interrupts that preempt them.
+ *
+ * On ARMv7-M these are built from LDREX/STREX. Taking an exception clears the exclusive monitor, so a
+ * read-modify-write that an interrupt lands in the middle of fails its store and is retried, without
+ * interrupts ever being masked. The AVR has no such instructions and masks interrupts instead. The host
+ * uses the compiler's builtins, so that code built on these can be tested there.
+ */
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+
+/* Orders the memory accesses before the barrier ahead of those after it. */
+static inline void lf_atomic_barrier(void) {
+    __asm__ __volatile__("dmb" ::: "memory");
+}
+
+/* Stores 'desired' to 'ptr' if it still holds 'expected'. Returns whether it did. */
+static inline bool lf_atomic_cas(volatile uint32_t *ptr, uint32_t expected, uint32_t desired) {
+    uint32_t value, failed;
+    do {
+        __asm__ __volatile__("ldrex %0, [%1]" : "=r"(value) : "r"(ptr) : "memory");
+        if (value != expected) {
+            __asm__ __volatile__("clrex" ::: "memory");
+            return false;
+        }
+        __asm__ __volatile__("strex %0, %2, [%1]" : "=&r"(failed) : "r"(ptr), "r"(desired) : "memory");
+    } while (failed);
+    lf_atomic_barrier();
+    return true;
+}
+
+/* Sets 'bits' in the word at 'ptr'. Returns the word's previous value. */
+static inline uint32_t lf_atomic_fetch_or(volatile uint32_t *ptr, uint32_t bits) {
+    uint32_t value, failed;
+    do {
+        __asm__ __volatile__("ldrex %0, [%1]" : "=r"(value) : "r"(ptr) : "memory");
+        __asm__ __volatile__("strex %0, %2, [%1]" : "=&r"(failed) : "r"(ptr), "r"(value | bits) : "memory");
+    } while (failed);
+    lf_atomic_barrier();
+    return value;
+}
+
+/* Keeps only 'bits' in the word at 'ptr'. Returns the word's previous value. */
+static inline uint32_t lf_atomic_fetch_and(volatile uint32_t *ptr, uint32_t bits) {
+    uint32_t value, failed;
+    do {
+        __asm__ __volatile__("ldrex %0, [%1]" : "=r"(value) : "r"(ptr) : "memory");
+        __asm__ __volatile__("strex %0, %2, [%1]" : "=&r"(failed) : "r"(ptr), "r"(value & bits) : "memory");
+    } while (failed);
+    lf_atomic_barrier();
+    return value;
+}
+
+#elif defined(__AVR__)
+
+#include <avr/interrupt.h>
+
+static inline void lf_atomic_barrier(void) {
+    __asm__ __volatile__("" ::: "memory");
+}
+
+static inline bool lf_atomic_cas(volatile uint32_t *ptr, uint32_t expected, uint32_t desired) {
+    uint8_t sreg = SREG;
+    cli();
+    bool swapped = (*ptr == expected);
+    if (swapped) *ptr = desired;
+    SREG = sreg;
+    return swapped;
+}
+
+static inline uint32_t lf_atomic_fetch_or(volatile uint32_t *ptr, uint32_t bits) {
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t value = *ptr;
+    *ptr = value | bits;
+    SREG = sreg;
+    return value;
+}
+
+static inline uint32_t lf_atomic_fetch_and(volatile uint32_t *ptr, uint32_t bits) {
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t value = *ptr;
+    *ptr = value & bits;
+    SREG = sreg;
+    return value;
+}
+
+#else
+
+static inline void lf_atomic_barrier(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline bool lf_atomic_cas(volatile uint32_t *ptr, uint32_t expected, uint32_t desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t lf_atomic_fetch_or(volatile uint32_t *ptr, uint32_t bits) {
+    return __atomic_fetch_or(ptr, bits, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t lf_atomic_fetch_and(volatile uint32_t *ptr, uint32_t bits) {
+    return __atomic_fetch_and(ptr, bits, __ATOMIC_SEQ_CST);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#include "libflipper.h"
+#include "atomic.h"
+
+uint32_t lf_event_set(struct _lf_event *event, uint32_t mask) {
+    return lf_atomic_fetch_or(&event->flags, mask);
+}
+
+uint32_t lf_event_clear(struct _lf_event *event, uint32_t mask) {
+    return lf_atomic_fetch_and(&event->flags, ~mask);
+}
+
+/* Whether the flags of 'mask' that are set satisfy a wait. */
+static bool lf_event_satisfies(uint32_t flags, uint32_t mask, bool all) {
+    return (all) ? ((flags & mask) == mask) : (flags & mask) != 0;
+}
+
+bool lf_event_ready(struct _lf_event *event, uint32_t mask, bool all) {
+    return mask && lf_event_satisfies(event->flags, mask, all);
+}
+
+uint32_t lf_event_take(struct _lf_event *event, uint32_t mask, bool all) {
+    uint32_t flags;
+    /* Retry if a flag changed between reading and clearing, so that flags are never taken in part. */
+    do {
+        flags = event->flags;
+        if (!mask || !lf_event_satisfies(flags, mask, all)) return 0;
+    } while (!lf_atomic_cas(&event->flags, flags, flags & ~mask));
+    return flags & mask;
+}
@@ -0,0 +1,25 @@
+#ifndef __lf_event_h__
+#define __lf_event_h__
+
+/*
+ * A word of event flags. Interrupts set flags to signal that something happened, and a task takes them
+ * to consume the signal. Setting, clearing and taking flags are atomic, so they are safe from interrupts.
+ */
+struct _lf_event {
+    volatile uint32_t flags;
+};
+
+/* Sets the flags in 'mask'. Returns the flags that were set before. */
+uint32_t lf_event_set(struct _lf_event *event, uint32_t mask);
+
+/* Clears the flags in 'mask'. Returns the flags that were set before. */
+uint32_t lf_event_clear(struct _lf_event *event, uint32_t mask);
+
+/* Whether any of the flags in 'mask' are set, or if 'all' is true, whether every one of them is. */
+bool lf_event_ready(struct _lf_event *event, uint32_t mask, bool all);
+
+/* Clears and returns the flags of 'mask' that are set, if 'lf_event_ready' would be true. Otherwise leaves
+   the flags as they are and returns zero. */
+uint32_t lf_event_take(struct _lf_event *event, uint32_t mask, bool all);
+
+#endif
@@ -11,13 +11,17 @@
 #include <flipper/adc.h>
 #include <flipper/button.h>
 #include <flipper/dac.h>
+#include <flipper/devlog.h>
+#include <flipper/fmrtrace.h>
 #include <flipper/gpio.h>
 #include <flipper/i2c.h>
 #include <flipper/led.h>
+#include <flipper/prof.h>
 #include <flipper/pwm.h>
 #include <flipper/rtc.h>
 #include <flipper/spi.h>
 #include <flipper/swd.h>
+#include <flipper/task.h>
 #include <flipper/temp.h>
 #include <flipper/timer.h>
 #include <flipper/uart0.h>
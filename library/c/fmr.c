@@ -127,6 +127,32 @@ fail:
     return lf_error;
 }
 
+uint8_t *lf_call_init(struct _fmr_packet *packet, lf_function function, lf_type ret, lf_types argt, lf_argc argc,
+                      uint8_t argv_len) {
+
+    struct _fmr_call_packet *call_packet = (struct _fmr_call_packet *)packet;
+    struct _fmr_call *call = &call_packet->call;
+
+    lf_assert(packet, E_NULL, "invalid packet");
+    lf_assert(argv_len <= sizeof(struct _fmr_packet) - sizeof(struct _fmr_call_packet), E_FMR_OVERFLOW,
+              "Arguments of %i bytes do not fit in a call packet.", argv_len);
+
+    memset(packet, 0, sizeof(*packet));
+    packet->hdr.magic = FMR_MAGIC_NUMBER;
+    packet->hdr.len = sizeof(struct _fmr_header) + argv_len;
+    packet->hdr.type = fmr_rpc_class;
+
+    /* The module index is filled in when the packet is sent. */
+    call->function = function;
+    call->ret = ret;
+    call->argt = argt;
+    call->argc = argc;
+
+    return call->argv;
+fail:
+    return NULL;
+}
+
 int fmr_rpc(struct _lf_device *device, struct _fmr_call_packet *packet, lf_return_t *retval) {
 
     struct _lf_module *m;
@@ -142,6 +168,7 @@ int fmr_rpc(struct _lf_device *device, struct _fmr_call_packet *packet, lf_retur
 
     lf_debug("performing in module %s", m->name);
 
+    fmr_trace(fmr_phase_dispatched, (struct _fmr_packet *)packet);
     *retval = fmr_call(f, call->ret, call->argc, call->argt, &call->argv);
 
     return lf_success;
@@ -215,6 +242,8 @@ int fmr_perform(struct _lf_device *device, struct _fmr_packet *packet) {
     lf_crc_t _crc, crc;
     int e = E_UNIMPLEMENTED;
 
+    fmr_trace(fmr_phase_received, packet);
+
     /* Check that the magic number matches. */
     lf_assert(hdr->magic == FMR_MAGIC_NUMBER, E_CHECKSUM, "invalid magic number");
 
@@ -224,6 +253,8 @@ int fmr_perform(struct _lf_device *device, struct _fmr_packet *packet) {
     lf_crc(packet, hdr->len, &crc);
     lf_assert(!memcmp(&_crc, &crc, sizeof(crc)), E_CHECKSUM, "checksums do not match (0x%04x/0x%04x)", _crc, crc);
 
+    fmr_trace(fmr_phase_verified, packet);
+
     /* clear error state */
     lf_error_set(E_OK);
 
@@ -235,22 +266,27 @@ int fmr_perform(struct _lf_device *device, struct _fmr_packet *packet) {
             break;
         /* push */
         case fmr_push_class:
+            fmr_trace(fmr_phase_dispatched, packet);
             fmr_push(device, (struct _fmr_push_pull_packet *)packet);
             break;
         /* pull */
         case fmr_pull_class:
+            fmr_trace(fmr_phase_dispatched, packet);
             fmr_pull(device, (struct _fmr_push_pull_packet *)packet);
             break;
         /* dyld */
         case fmr_dyld_class:
+            fmr_trace(fmr_phase_dispatched, packet);
             fmr_dyld(device, (struct _fmr_dyld_packet *)packet, &retval);
             break;
         /* malloc */
         case fmr_malloc_class:
+            fmr_trace(fmr_phase_dispatched, packet);
             fmr_malloc((struct _fmr_memory_packet *)packet, &retval);
             break;
         /* free */
         case fmr_free_class:
+            fmr_trace(fmr_phase_dispatched, packet);
             fmr_free((struct _fmr_memory_packet *)packet);
             break;
         /* default */
@@ -261,11 +297,15 @@ int fmr_perform(struct _lf_device *device, struct _fmr_packet *packet) {
 
 fail:
 
+    fmr_trace(fmr_phase_returned, packet);
+
     result.error = lf_error_get();
     result.value = retval;
 
     e = device->write(device, &result, sizeof(struct _fmr_result));
 
+    fmr_trace(fmr_phase_sent, packet);
+
     lf_debug_result(&result);
 
     return e;
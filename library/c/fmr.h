@@ -97,6 +97,13 @@ int lf_sizeof(lf_type type);
 /* Creates an 'lf_va' from a C variable. */
 #define lf_infer(variable) lf_intx(lf_utype(variable), variable)
 
+/* Copies 'value', converted to 'type', into a call's argument area at a fixed offset. */
+#define lf_pack(argv, offset, type, value) \
+    do {                                   \
+        type __lf_packed = (type)(value);  \
+        memcpy((argv) + (offset), &__lf_packed, sizeof(type)); \
+    } while (0)
+
 /* Exposes all message runtime packet classes. */
 enum {
     /* executes a function on the device */
@@ -205,6 +212,29 @@ struct LF_PACKED _fmr_result {
     /* NOTE: Add bitfield indicating the need to poll for updates. */
 };
 
+/* The phases of handling a packet, in order, as marked by 'fmr_perform'. */
+enum {
+    /* handling of the packet has begun */
+    fmr_phase_received,
+    /* the packet's checksum has been verified */
+    fmr_phase_verified,
+    /* the packet's handler is about to run */
+    fmr_phase_dispatched,
+    /* the packet's handler has returned */
+    fmr_phase_returned,
+    /* the result has been sent */
+    fmr_phase_sent,
+    /* the number of phases */
+    fmr_phase_count
+};
+
+#ifdef LF_CONFIG_FMR_TRACE
+/* Marks the time at which the packet being handled reached 'phase'. Implemented by the platform. */
+void fmr_trace(uint8_t phase, struct _fmr_packet *packet);
+#else
+#define fmr_trace(phase, packet)
+#endif
+
 /* Appends an argument to the linked list. */
 int lf_append(struct _lf_ll *list, lf_type type, lf_arg value);
 
@@ -212,6 +242,10 @@ int lf_append(struct _lf_ll *list, lf_type type, lf_arg value);
 int lf_create_call(lf_module module, lf_function function, lf_type ret, struct _lf_ll *args, struct _fmr_header *header,
                    struct _fmr_call *call);
 
+/* Prepares a call packet and returns the start of its argument area, which can hold 'argv_len' bytes. */
+uint8_t *lf_call_init(struct _fmr_packet *packet, lf_function function, lf_type ret, lf_types argt, lf_argc argc,
+                      uint8_t argv_len);
+
 /* Creates a struct _lf_arg * type. */
 struct _lf_arg *lf_arg_create(lf_type type, lf_arg value);
 
@@ -100,6 +100,113 @@ fail:
     return lf_error;
 }
 
+int lf_resolve(struct _lf_device *device, const char *module, struct _lf_handle *handle) {
+
+    struct _lf_module *m = NULL;
+
+    lf_assert(device, E_NULL, "invalid device");
+    lf_assert(module, E_NULL, "invalid module");
+    lf_assert(handle, E_NULL, "invalid handle");
+
+    if (handle->device == device) return lf_success;
+
+    m = dyld_module(device, module);
+    lf_assert(m, E_MODULE, "No counterpart found for module '%s'.", module);
+
+    handle->idx = m->idx;
+    handle->device = device;
+
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+int lf_invoke_packet(struct _lf_device *device, const struct _lf_handle *handle, struct _fmr_packet *packet,
+                     lf_return_t *retval) {
+
+    struct _fmr_call_packet *call_packet = (struct _fmr_call_packet *)packet;
+    struct _fmr_result result;
+    int e;
+    lf_crc_t crc;
+
+    lf_assert(device, E_NULL, "invalid device");
+    lf_assert(handle && handle->device == device, E_MODULE, "module handle was not resolved on device '%s'.",
+              device->name);
+    lf_assert(packet, E_NULL, "invalid packet");
+
+    call_packet->call.module = handle->idx;
+    packet->hdr.crc = 0;
+    lf_crc(packet, packet->hdr.len, &crc);
+    packet->hdr.crc = crc;
+    lf_debug_packet(packet);
+
+    e = device->write(device, packet, sizeof(*packet));
+    lf_assert(e, E_ENDPOINT, "Failed to send message to device '%s'.", device->name);
+
+    e = device->read(device, &result, sizeof(struct _fmr_result));
+    lf_assert(e, E_ENDPOINT, "Failed to receive message from the device '%s'.", device->name);
+
+    lf_debug_result(&result);
+    lf_assert(result.error == E_OK, result.error, "An error occured on the device '%s':", device->name);
+
+    if (retval) *retval = result.value;
+
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+int lf_invoke_packed(struct _lf_device *device, const struct _lf_handle *handle, struct _fmr_packet *packets,
+                     lf_return_t *retvals, size_t count) {
+
+    struct _fmr_result result;
+    int e;
+    lf_crc_t crc;
+    size_t sent = 0, received = 0;
+    int status = lf_success;
+
+    lf_assert(device, E_NULL, "invalid device");
+    lf_assert(handle && handle->device == device, E_MODULE, "module handle was not resolved on device '%s'.",
+              device->name);
+    lf_assert(packets, E_NULL, "invalid packets");
+
+    /* Keep up to LF_BATCH_MAX calls in flight, sending the next as each result arrives. */
+    while (received < count) {
+        while (sent < count && sent - received < LF_BATCH_MAX) {
+            struct _fmr_call_packet *call_packet = (struct _fmr_call_packet *)&packets[sent];
+            call_packet->call.module = handle->idx;
+            packets[sent].hdr.crc = 0;
+            lf_crc(&packets[sent], packets[sent].hdr.len, &crc);
+            packets[sent].hdr.crc = crc;
+            lf_debug_packet(&packets[sent]);
+
+            e = device->write(device, &packets[sent], sizeof(packets[sent]));
+            if (!e) {
+                /* Collect the results of the calls already sent, so the stream stays in step for later calls. */
+                while (received < sent && device->read(device, &result, sizeof(struct _fmr_result))) received++;
+            }
+            lf_assert(e, E_ENDPOINT, "Failed to send message to device '%s'.", device->name);
+            sent++;
+        }
+
+        /* Every result must be read to keep the stream in step, even if an earlier call failed. */
+        e = device->read(device, &result, sizeof(struct _fmr_result));
+        lf_assert(e, E_ENDPOINT, "Failed to receive message from the device '%s'.", device->name);
+
+        lf_debug_result(&result);
+        if (result.error != E_OK) {
+            lf_error_set(result.error);
+            status = lf_error;
+        }
+        if (retvals) retvals[received] = result.value;
+        received++;
+    }
+
+    return status;
+fail:
+    return lf_error;
+}
+
 int lf_push(struct _lf_device *device, void *dst, void *src, uint32_t len) {
 
     struct _fmr_push_pull_packet packet;
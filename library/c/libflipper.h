@@ -21,9 +21,11 @@
 #include "device.h"
 #include "dyld.h"
 #include "error.h"
+#include "event.h"
 #include "fmr.h"
 #include "ll.h"
 #include "module.h"
+#include "queue.h"
 
 /* ---------- STATE ---------- */
 
@@ -48,6 +50,20 @@ int lf_exit(void);
 int lf_invoke(struct _lf_device *device, const char *module, lf_function function, lf_type ret, lf_return_t *retval,
               struct _lf_ll *args);
 
+/* The largest number of calls that 'lf_invoke_packed' keeps in flight at once. */
+#define LF_BATCH_MAX 16
+
+/* Resolves a module's index on a device, unless the handle was already resolved on that device. */
+int lf_resolve(struct _lf_device *device, const char *module, struct _lf_handle *handle);
+
+/* Performs a call prepared with 'lf_call_init' on the module referred to by a resolved handle. */
+int lf_invoke_packet(struct _lf_device *device, const struct _lf_handle *handle, struct _fmr_packet *packet,
+                     lf_return_t *retval);
+
+/* Sends a set of calls prepared with 'lf_call_init' back to back, collecting each of their results. */
+int lf_invoke_packed(struct _lf_device *device, const struct _lf_handle *handle, struct _fmr_packet *packets,
+                     lf_return_t *retvals, size_t count);
+
 /* Moves data from the address space of the host to that of the device. */
 int lf_push(struct _lf_device *device, void *dst, void *src, uint32_t len);
 
@@ -12,6 +12,14 @@ struct _lf_module {
     void **interface;
 };
 
+/* A module's index on the device it was last resolved on. Zero-initialized handles are unresolved. */
+struct _lf_handle {
+    /* The device the index was resolved on. */
+    struct _lf_device *device;
+    /* The loaded index of the module on that device. */
+    uint16_t idx;
+};
+
 #define LF_MODULE(sym, name, interface) struct _lf_module sym = { name, 0, UINT16_MAX, interface };
 
 struct _lf_module *lf_module_create(const char *name, uint16_t idx);
@@ -0,0 +1,104 @@
+#include "libflipper.h"
+#include "atomic.h"
+
+int lf_spsc_init(struct _lf_spsc *queue, void *storage, uint32_t size, uint32_t capacity) {
+    lf_assert(queue && storage, E_NULL, "invalid queue or storage");
+    lf_assert(size && capacity && !(capacity & (capacity - 1)), E_BOUNDARY, "queue capacity must be a power of two");
+
+    queue->items = storage;
+    queue->size = size;
+    queue->capacity = capacity;
+    queue->head = queue->tail = 0;
+
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+int lf_spsc_push(struct _lf_spsc *queue, const void *item) {
+    uint32_t head = queue->head;
+    if (head - queue->tail == queue->capacity) return lf_error;
+
+    memcpy(queue->items + (head & (queue->capacity - 1)) * queue->size, item, queue->size);
+    /* Publish the item only once it has been written. */
+    lf_atomic_barrier();
+    queue->head = head + 1;
+
+    return lf_success;
+}
+
+int lf_spsc_pop(struct _lf_spsc *queue, void *item) {
+    uint32_t tail = queue->tail;
+    if (queue->head == tail) return lf_error;
+
+    /* Read the item only after seeing it published. */
+    lf_atomic_barrier();
+    memcpy(item, queue->items + (tail & (queue->capacity - 1)) * queue->size, queue->size);
+    /* Free the slot only once the item has been read. */
+    lf_atomic_barrier();
+    queue->tail = tail + 1;
+
+    return lf_success;
+}
+
+uint32_t lf_spsc_count(struct _lf_spsc *queue) {
+    return queue->head - queue->tail;
+}
+
+/* Returns the sequence number of a slot, which is followed by the slot's item. */
+static volatile uint32_t *lf_mpsc_slot(struct _lf_mpsc *queue, uint32_t position) {
+    return (volatile uint32_t *)(queue->slots + (position & (queue->capacity - 1)) * queue->stride);
+}
+
+int lf_mpsc_init(struct _lf_mpsc *queue, void *storage, uint32_t size, uint32_t capacity) {
+    lf_assert(queue && storage, E_NULL, "invalid queue or storage");
+    lf_assert(size && capacity && !(capacity & (capacity - 1)), E_BOUNDARY, "queue capacity must be a power of two");
+
+    queue->slots = storage;
+    queue->size = size;
+    queue->stride = LF_MPSC_STORAGE(1, size);
+    queue->capacity = capacity;
+    queue->head = queue->tail = 0;
+
+    /* A slot is free for the push at position 'n' when its sequence number is 'n'. */
+    for (uint32_t i = 0; i < capacity; i++) *lf_mpsc_slot(queue, i) = i;
+
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+int lf_mpsc_push(struct _lf_mpsc *queue, const void *item) {
+    uint32_t head;
+    volatile uint32_t *slot;
+
+    /* Claim the next position, unless its slot still holds an item a lap behind. */
+    do {
+        head = queue->head;
+        slot = lf_mpsc_slot(queue, head);
+        if ((int32_t)(*slot - head) < 0) return lf_error;
+    } while (!lf_atomic_cas(&queue->head, head, head + 1));
+
+    memcpy((uint8_t *)(slot + 1), item, queue->size);
+    /* Publish the item only once it has been written. */
+    lf_atomic_barrier();
+    *slot = head + 1;
+
+    return lf_success;
+}
+
+int lf_mpsc_pop(struct _lf_mpsc *queue, void *item) {
+    uint32_t tail = queue->tail;
+    volatile uint32_t *slot = lf_mpsc_slot(queue, tail);
+    if (*slot != tail + 1) return lf_error;
+
+    /* Read the item only after seeing it published. */
+    lf_atomic_barrier();
+    memcpy(item, (uint8_t *)(slot + 1), queue->size);
+    /* Free the slot for the push a lap ahead only once the item has been read. */
+    lf_atomic_barrier();
+    *slot = tail + queue->capacity;
+    queue->tail = tail + 1;
+
+    return lf_success;
+}
@@ -0,0 +1,75 @@
+#ifndef __lf_queue_h__
+#define __lf_queue_h__
+
+/*
+ * Bounded, lock-free queues of fixed-size items, for handing work from interrupts to tasks.
+ *
+ * Neither queue allocates or masks interrupts: their storage is given when they are initialized, and pushing
+ * or popping takes a bounded number of steps. The capacity of either must be a power of two.
+ *
+ * An SPSC queue has a single producer and a single consumer, such as one interrupt handing received data
+ * to one task. An MPSC queue may be pushed to by any number of producers, such as interrupts of different
+ * priorities, while a single consumer pops from it. The consumer of an MPSC queue sees each item once its
+ * producer has finished writing it, so an item pushed by an interrupt that preempted another push may wait
+ * for that push to complete.
+ */
+
+/* A single-producer, single-consumer queue. */
+struct _lf_spsc {
+    /* The items, 'capacity' of 'size' bytes each. */
+    uint8_t *items;
+    /* The size of an item in bytes. */
+    uint32_t size;
+    /* The number of items the queue holds, a power of two. */
+    uint32_t capacity;
+    /* The number of items ever pushed. Only written by the producer. */
+    volatile uint32_t head;
+    /* The number of items ever popped. Only written by the consumer. */
+    volatile uint32_t tail;
+};
+
+/* The storage an SPSC queue needs, in bytes. */
+#define LF_SPSC_STORAGE(capacity, size) ((capacity) * (size))
+
+/* Prepares a queue of 'capacity' items of 'size' bytes, kept in 'storage'. */
+int lf_spsc_init(struct _lf_spsc *queue, void *storage, uint32_t size, uint32_t capacity);
+
+/* Copies an item into the queue. Fails without setting an error if the queue is full. */
+int lf_spsc_push(struct _lf_spsc *queue, const void *item);
+
+/* Moves the oldest item out of the queue. Fails without setting an error if the queue is empty. */
+int lf_spsc_pop(struct _lf_spsc *queue, void *item);
+
+/* Returns the number of items waiting in the queue. */
+uint32_t lf_spsc_count(struct _lf_spsc *queue);
+
+/* A multiple-producer, single-consumer queue. */
+struct _lf_mpsc {
+    /* The slots, each a sequence number followed by an item padded to a word. */
+    uint8_t *slots;
+    /* The size of an item in bytes. */
+    uint32_t size;
+    /* The distance between slots in bytes. */
+    uint32_t stride;
+    /* The number of items the queue holds, a power of two. */
+    uint32_t capacity;
+    /* The number of pushes ever claimed. Claimed by producers with compare-and-swap. */
+    volatile uint32_t head;
+    /* The number of items ever popped. Only written by the consumer. */
+    volatile uint32_t tail;
+};
+
+/* The storage an MPSC queue needs, in bytes. */
+#define LF_MPSC_STORAGE(capacity, size) ((capacity) * (sizeof(uint32_t) + (((size) + 3) & ~3)))
+
+/* Prepares a queue of 'capacity' items of 'size' bytes, kept in 'storage', which must be word aligned. */
+int lf_mpsc_init(struct _lf_mpsc *queue, void *storage, uint32_t size, uint32_t capacity);
+
+/* Copies an item into the queue. Fails without setting an error if the queue is full. */
+int lf_mpsc_push(struct _lf_mpsc *queue, const void *item);
+
+/* Moves the oldest item out of the queue. Fails without setting an error if the queue is empty, or if the
+   oldest item is still being pushed. */
+int lf_mpsc_pop(struct _lf_mpsc *queue, void *item);
+
+#endif
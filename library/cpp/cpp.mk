@@ -0,0 +1,12 @@
+# --- C++ --- #
+
+# The C++ API is header-only. Its headers are installed alongside libflipper's.
+
+.PHONY: libflipper-cpp
+
+libflipper-cpp: libflipper
+	$(_v)cp library/cpp/*.hpp api/cpp/*.hpp $(BUILD)/include/flipper
+
+all:: libflipper-cpp
+
+install-libflipper: libflipper-cpp
@@ -0,0 +1,261 @@
+/* flipper.hpp - A header-only C++17 interface to libflipper with compile-time argument encoding. */
+
+#ifndef __lf_flipper_hpp__
+#define __lf_flipper_hpp__
+
+extern "C" {
+#include <flipper/libflipper.h>
+#include <flipper/carbon.h>
+}
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace flipper {
+
+/* Thrown when libflipper or the device reports an error. */
+class error : public std::runtime_error {
+public:
+    explicit error(const std::string &what, lf_err_t code = lf_error_get())
+        : std::runtime_error(what + ": " + lf_error_string(code)), code(code) {}
+
+    const lf_err_t code;
+};
+
+namespace detail {
+
+/* The FMR type of a C++ argument or return type. */
+template <typename T> constexpr lf_type type_of() {
+    using U = std::remove_cv_t<T>;
+    if constexpr (std::is_void_v<U>) {
+        return lf_void_t;
+    } else if constexpr (std::is_pointer_v<U>) {
+        return lf_ptr_t;
+    } else if constexpr (std::is_same_v<U, bool>) {
+        return lf_uint8_t;
+    } else {
+        static_assert(std::is_integral_v<U> || std::is_enum_v<U>, "FMR arguments must be integers or pointers.");
+        static_assert(sizeof(U) == 1 || sizeof(U) == 2 || sizeof(U) == 4 || sizeof(U) == 8, "Unsupported width.");
+        constexpr lf_type unsigned_type = sizeof(U) - 1;
+        if constexpr (std::is_signed_v<U>) {
+            return (1 << 3) | unsigned_type;
+        } else {
+            return unsigned_type;
+        }
+    }
+}
+
+/* The encoded width of an argument, as 'lf_sizeof' gives it. */
+template <typename T> constexpr size_t size_of() {
+    return (type_of<T>() == lf_ptr_t) ? 8 : (type_of<T>() & 7) + 1;
+}
+
+/* The room a call packet has for arguments. */
+constexpr size_t argv_max = sizeof(struct _fmr_packet) - sizeof(struct _fmr_call_packet);
+
+/* The encoding of a call's argument types and the layout of its arguments, computed at compile time. */
+template <typename... Args> struct layout {
+    static constexpr size_t argc = sizeof...(Args);
+    static constexpr size_t argv_len = (size_t{ 0 } + ... + size_of<Args>());
+    static constexpr std::array<size_t, argc> offsets = [] {
+        std::array<size_t, argc> result{};
+        size_t offset = 0, i = 0;
+        ((result[i++] = offset, offset += size_of<Args>()), ...);
+        return result;
+    }();
+    static constexpr lf_types argt = [] {
+        lf_types result = 0;
+        size_t i = 0;
+        ((result |= (lf_types)(type_of<Args>() & lf_max_t) << (4 * i++)), ...);
+        return result;
+    }();
+
+    static_assert(argc <= sizeof(lf_types) * 2, "Too many arguments for one call.");
+    static_assert(argv_len <= argv_max, "Arguments do not fit in a call packet.");
+};
+
+/* Copies a value's low 'size_of<T>' bytes into the packet, as the device expects them. */
+template <typename T> inline void pack(uint8_t *argv, size_t offset, T value) {
+    if constexpr (std::is_pointer_v<T>) {
+        uint64_t address = (uintptr_t)value;
+        std::memcpy(argv + offset, &address, sizeof(address));
+    } else {
+        std::memcpy(argv + offset, &value, size_of<T>());
+    }
+}
+
+} // namespace detail
+
+/* Describes a function of a module: its index within the module and its signature. */
+template <lf_function Index, typename Signature> struct function;
+
+template <lf_function Index, typename Ret, typename... Args> struct function<Index, Ret(Args...)> {
+    using return_type = Ret;
+    using layout = detail::layout<Args...>;
+
+    static constexpr lf_function index = Index;
+    static constexpr lf_type ret = detail::type_of<Ret>();
+
+    /* Serializes a call straight into 'packet', which the caller typically keeps on its stack. */
+    template <typename... Given> static void encode(struct _fmr_packet &packet, Given &&... args) {
+        static_assert(sizeof...(Given) == sizeof...(Args), "Wrong number of arguments.");
+        uint8_t *argv = lf_call_init(&packet, Index, ret, layout::argt, layout::argc, layout::argv_len);
+        if (!argv) throw error(std::string("Failed to encode call to function ") + std::to_string(Index));
+        encode_args(argv, std::index_sequence_for<Args...>{}, std::forward<Given>(args)...);
+    }
+
+    /* Converts a raw call result to the function's return type. */
+    static Ret result(lf_return_t value) {
+        if constexpr (std::is_void_v<Ret>) {
+            (void)value;
+        } else if constexpr (std::is_pointer_v<Ret>) {
+            return (Ret)(uintptr_t)value;
+        } else {
+            return (Ret)value;
+        }
+    }
+
+private:
+    template <size_t... I, typename... Given>
+    static void encode_args(uint8_t *argv, std::index_sequence<I...>, Given &&... args) {
+        (detail::pack<Args>(argv, layout::offsets[I], static_cast<Args>(args)), ...);
+    }
+};
+
+/* An attached device. The device is detached, and released, when this is destroyed. */
+class device {
+public:
+    /* Attaches to the first Carbon device over USB. */
+    static device attach() {
+        struct _lf_device *raw = carbon_attach();
+        if (!raw) throw error("Failed to attach to a Carbon device");
+        return device(raw);
+    }
+
+    /* Attaches to a Carbon device over the network. */
+    static device attach(const std::string &hostname) {
+        struct _lf_device *raw = carbon_attach_hostname(const_cast<char *>(hostname.c_str()));
+        if (!raw) throw error("Failed to attach to '" + hostname + "'");
+        return device(raw);
+    }
+
+    /* Takes ownership of an attached device. */
+    explicit device(struct _lf_device *raw) : raw_(raw) {}
+
+    device(const device &) = delete;
+    device &operator=(const device &) = delete;
+    device(device &&other) noexcept : raw_(std::exchange(other.raw_, nullptr)) {}
+    device &operator=(device &&other) noexcept {
+        if (this != &other) {
+            reset();
+            raw_ = std::exchange(other.raw_, nullptr);
+        }
+        return *this;
+    }
+    ~device() { reset(); }
+
+    struct _lf_device *get() const { return raw_; }
+
+    void select() const {
+        if (!lf_select(raw_)) throw error("Failed to select device");
+    }
+
+    /* Moves data from host memory to device memory. */
+    void push(void *dst, const void *src, uint32_t len) const {
+        if (!lf_push(raw_, dst, const_cast<void *>(src), len)) throw error("Failed to push");
+    }
+
+    /* Moves data from device memory to host memory. */
+    void pull(void *dst, const void *src, uint32_t len) const {
+        if (!lf_pull(raw_, dst, const_cast<void *>(src), len)) throw error("Failed to pull");
+    }
+
+private:
+    void reset() {
+        if (raw_) lf_detach(raw_);
+        raw_ = nullptr;
+    }
+
+    struct _lf_device *raw_;
+};
+
+/* A module resolved on a device. The module must not outlive the device. */
+class module {
+public:
+    module(const flipper::device &owner, const char *name) : device_(owner.get()), name_(name), handle_{} {
+        if (!lf_resolve(device_, name_, &handle_)) throw error(std::string("Failed to resolve module '") + name_ + "'");
+    }
+
+    /* Calls a function of the module, encoding its arguments into a packet on the stack. */
+    template <typename F, typename... Given> typename F::return_type call(Given &&... args) const {
+        struct _fmr_packet packet;
+        lf_return_t retval = 0;
+        F::encode(packet, std::forward<Given>(args)...);
+        if (!lf_invoke_packet(device_, &handle_, &packet, &retval)) {
+            throw error(std::string("Failed to call function ") + std::to_string(F::index) + " of '" + name_ + "'");
+        }
+        return F::result(retval);
+    }
+
+    struct _lf_device *owner() const { return device_; }
+    const struct _lf_handle &handle() const { return handle_; }
+    const char *name() const { return name_; }
+
+private:
+    struct _lf_device *device_;
+    const char *name_;
+    struct _lf_handle handle_;
+};
+
+/* Refers to the result of a call added to a batch. */
+template <typename T> struct pending { size_t index; };
+
+/*
+   Collects calls to a module and sends them back to back, so that they cost a single round trip:
+
+       flipper::batch batch(gpio);
+       auto level = batch.add<flipper::gpio::read>(1 << 4);
+       batch.add<flipper::gpio::write>(1 << 5, 0);
+       batch.send();
+       uint32_t value = batch[level];
+*/
+class batch {
+public:
+    explicit batch(const module &module) : module_(module) {}
+
+    template <typename F, typename... Given> pending<typename F::return_type> add(Given &&... args) {
+        if (count_ == packets_.size()) throw std::length_error("A batch holds at most LF_BATCH_MAX calls.");
+        F::encode(packets_[count_], std::forward<Given>(args)...);
+        return pending<typename F::return_type>{ count_++ };
+    }
+
+    /* Sends every call added since the last send. */
+    void send() {
+        if (!count_) return;
+        if (!lf_invoke_packed(module_.owner(), &module_.handle(), packets_.data(), retvals_.data(), count_)) {
+            count_ = 0;
+            throw error(std::string("Failed to send batch to '") + module_.name() + "'");
+        }
+        count_ = 0;
+    }
+
+    template <typename T> T operator[](pending<T> call) const {
+        if constexpr (!std::is_void_v<T>) return (T)retvals_[call.index];
+    }
+
+    size_t size() const { return count_; }
+
+private:
+    const module &module_;
+    std::array<struct _fmr_packet, LF_BATCH_MAX> packets_;
+    std::array<lf_return_t, LF_BATCH_MAX> retvals_{};
+    size_t count_ = 0;
+};
+
+} // namespace flipper
+
+#endif
@@ -0,0 +1,296 @@
+{-|
+Module      : Flipper.Call
+Description : Remote procedure calls and call batching.
+Copyright   : George Morgan, Travis Whitaker 2016
+License     : All rights reserved.
+Maintainer  : travis@flipper.io
+Stability   : Provisional
+Portability : Windows, POSIX
+
+This module provides direct access to the functions of modules loaded on the
+device. A module is first resolved to a 'Handle', after which its functions may
+be called by index:
+
+> gpio <- resolve "gpio"
+> invoke gpio (Call 2 TVoid [ArgWord32 1, ArgWord32 0])
+
+Each call costs a round trip to the device. Calls that don't depend on each
+other's results may instead be collected into a 'Batch', which sends them all
+before waiting for any of their results. 'Batch' is an 'Applicative', so with
+@ApplicativeDo@ an ordinary @do@ block of independent calls can be batched
+without restructuring it. Here @adc_stream_dropped@ (function 4 of @adc@) and
+@gpio_read@ (function 0 of @gpio@) are read in a single batch:
+
+> {-# LANGUAGE ApplicativeDo #-}
+>
+> pollBoth :: MonadFlipper m => Handle -> Handle -> m (Word64, Word64)
+> pollBoth adc gpio = batch $ do
+>     dropped <- call adc  (Call 4 TWord32 [])
+>     pins    <- call gpio (Call 0 TWord32 [ArgWord32 maxBound])
+>     pure (dropped, pins)
+
+Packets are encoded with a strict 'Builder' directly into a buffer allocated
+once for the whole batch, which is then handed to @libflipper@ as-is.
+
+This module, like all others in this package, is intended to be imported
+@qualified@, e.g.
+
+> import qualified Flipper.Call as Call
+-}
+
+module Flipper.Call (
+    -- * Calls
+    Type(..)
+  , Arg(..)
+  , Call(..)
+  , encodeCall
+    -- * Module Handles
+  , Handle()
+  , resolve
+    -- * Invoking Calls
+  , invoke
+  , Batch()
+  , call
+  , batch
+  ) where
+
+import qualified Data.ByteString.Builder       as BB
+import qualified Data.ByteString.Builder.Extra as BB
+
+import Data.Bits
+import Data.Int
+import Data.Word
+
+import Flipper.MonadFlipper
+
+import Foreign.C.String
+import Foreign.C.Types
+import Foreign.ForeignPtr
+import Foreign.Marshal.Alloc
+import Foreign.Marshal.Array
+import Foreign.Marshal.Utils
+import Foreign.Ptr
+
+-- | The FMR types a function may take or return, as enumerated in @fmr.h@.
+data Type = TWord8
+          | TWord16
+          | TVoid
+          | TWord32
+          | TInt
+          | TPtr
+          | TWord64
+          | TInt8
+          | TInt16
+          | TInt32
+          | TInt64
+          deriving (Eq, Ord, Show, Read, Enum, Bounded)
+
+typeCode :: Type -> Word8
+typeCode TWord8  = 0
+typeCode TWord16 = 1
+typeCode TVoid   = 2
+typeCode TWord32 = 3
+typeCode TInt    = 4
+typeCode TPtr    = 6
+typeCode TWord64 = 7
+typeCode TInt8   = 8
+typeCode TInt16  = 9
+typeCode TInt32  = 11
+typeCode TInt64  = 15
+
+-- | An argument to a call, tagged with its FMR type.
+data Arg = ArgWord8  !Word8
+         | ArgWord16 !Word16
+         | ArgWord32 !Word32
+         | ArgWord64 !Word64
+         | ArgInt8   !Int8
+         | ArgInt16  !Int16
+         | ArgInt32  !Int32
+         | ArgInt64  !Int64
+         deriving (Eq, Ord, Show, Read)
+
+argType :: Arg -> Type
+argType (ArgWord8 _)  = TWord8
+argType (ArgWord16 _) = TWord16
+argType (ArgWord32 _) = TWord32
+argType (ArgWord64 _) = TWord64
+argType (ArgInt8 _)   = TInt8
+argType (ArgInt16 _)  = TInt16
+argType (ArgInt32 _)  = TInt32
+argType (ArgInt64 _)  = TInt64
+
+argSize :: Arg -> Int
+argSize (ArgWord8 _)  = 1
+argSize (ArgWord16 _) = 2
+argSize (ArgWord32 _) = 4
+argSize (ArgWord64 _) = 8
+argSize (ArgInt8 _)   = 1
+argSize (ArgInt16 _)  = 2
+argSize (ArgInt32 _)  = 4
+argSize (ArgInt64 _)  = 8
+
+-- | The device is little endian.
+argBuilder :: Arg -> BB.Builder
+argBuilder (ArgWord8 x)  = BB.word8 x
+argBuilder (ArgWord16 x) = BB.word16LE x
+argBuilder (ArgWord32 x) = BB.word32LE x
+argBuilder (ArgWord64 x) = BB.word64LE x
+argBuilder (ArgInt8 x)   = BB.int8 x
+argBuilder (ArgInt16 x)  = BB.int16LE x
+argBuilder (ArgInt32 x)  = BB.int32LE x
+argBuilder (ArgInt64 x)  = BB.int64LE x
+
+-- | A call to a function of some module.
+data Call = Call {
+    -- | The index of the function within its module.
+    callFunction :: !Word8
+    -- | The function's return type.
+  , callReturn   :: !Type
+    -- | The function's arguments.
+  , callArgs     :: [Arg]
+  } deriving (Eq, Ord, Show, Read)
+
+-- | The size of an FMR packet in bytes.
+packetSize :: Int
+packetSize = 64
+
+-- | The size of the packet header and call metadata preceeding the arguments.
+callHeaderSize :: Int
+callHeaderSize = 14
+
+-- | Encode a call packet, as @lf_call_init@ would. The module index and
+--   checksum are left zero, since @libflipper@ fills them in when the packet
+--   is sent. Returns 'Nothing' if the arguments don't fit in one packet.
+encodeCall :: Call -> Maybe BB.Builder
+encodeCall (Call f r as)
+    | argvLen > packetSize - callHeaderSize = Nothing
+    | length as > 8                         = Nothing
+    | otherwise                             = Just $ mconcat
+        [ BB.word8 0xfe                                  -- Magic number.
+        , BB.word16LE 0                                  -- Checksum.
+        , BB.word16LE (fromIntegral (6 + argvLen))       -- Length.
+        , BB.word8 0                                     -- Packet class.
+        , BB.word8 0                                     -- Module index.
+        , BB.word8 f
+        , BB.word8 (typeCode r)
+        , BB.word32LE argt
+        , BB.word8 (fromIntegral (length as))
+        , foldMap argBuilder as
+        ]
+    where argvLen = sum (map argSize as)
+          argt    = foldr (.|.) 0 (zipWith encodeType [0..] as)
+          encodeType i a = fromIntegral (typeCode (argType a)) `shiftL` (i * 4)
+
+-- | Run a packet 'BB.Builder' into a zeroed packet-sized slot of a buffer.
+writePacket :: Ptr Word8 -> BB.Builder -> IO ()
+writePacket p b = do
+    fillBytes p 0 packetSize
+    (_, next) <- BB.runBuilder b p packetSize
+    case next of BB.Done -> return ()
+                 _       -> ioError (userError "writePacket: packet overflow.")
+
+data Device
+
+data LfHandle
+
+-- | A module resolved on the active device.
+data Handle = Handle String (ForeignPtr LfHandle)
+
+instance Eq Handle where
+    (Handle _ x) == (Handle _ y) = x == y
+
+instance Show Handle where
+    show (Handle n _) = "Handle " ++ show n
+
+foreign import ccall safe "lf_get_selected"
+    c_lf_get_selected :: IO (Ptr Device)
+
+foreign import ccall safe "lf_resolve"
+    c_lf_resolve :: Ptr Device -> CString -> Ptr LfHandle -> IO CInt
+
+foreign import ccall safe "lf_invoke_packed"
+    c_lf_invoke_packed :: Ptr Device
+                       -> Ptr LfHandle
+                       -> Ptr Word8
+                       -> Ptr Word64
+                       -> CSize
+                       -> IO CInt
+
+-- | The size of a @struct _lf_handle@, rounded up.
+handleSize :: Int
+handleSize = 16
+
+-- | The most calls @lf_invoke_packed@ is expected to send at once, given by
+--   @LF_BATCH_MAX@.
+batchMax :: Int
+batchMax = 16
+
+-- | Resolve a module by name on the active device.
+resolve :: MonadFlipper m => String -> m Handle
+resolve n = bracketIO $ do
+    h <- mallocForeignPtrBytes handleSize
+    withForeignPtr h $ \hp -> do
+        fillBytes hp 0 handleSize
+        d <- c_lf_get_selected
+        withCString n $ \np -> c_lf_resolve d np (castPtr hp)
+    return (Handle n h)
+
+-- | A set of calls that don't depend on each other's results, to be sent
+--   together. The calls are kept as a difference list, so that collecting a
+--   large batch stays linear.
+data Batch a = Batch !Int ([(Handle, Call)] -> [(Handle, Call)]) ([Word64] -> a)
+
+instance Functor Batch where
+    fmap f (Batch n cs k) = Batch n cs (f . k)
+
+instance Applicative Batch where
+    pure x = Batch 0 id (const x)
+    (Batch n cs f) <*> (Batch m ds x) =
+        Batch (n + m) (cs . ds) $ \rs -> let (fs, xs) = splitAt n rs
+                                         in f fs (x xs)
+
+-- | A call whose result is only available once its batch has run.
+call :: Handle -> Call -> Batch Word64
+call h c = Batch 1 ((h, c) :) head
+
+-- | Send every call of a batch, then collect their results. Consecutive calls
+--   to the same module are sent with a single @lf_invoke_packed@.
+batch :: MonadFlipper m => Batch a -> m a
+batch (Batch n cs k) = k <$> bracketIO (runCalls n (cs []))
+
+-- | Call a single function.
+invoke :: MonadFlipper m => Handle -> Call -> m Word64
+invoke h = batch . call h
+
+runCalls :: Int -> [(Handle, Call)] -> IO [Word64]
+runCalls 0 _  = return []
+runCalls n cs =
+    allocaBytes (n * packetSize) $ \packets ->
+    allocaArray n $ \retvals -> do
+        sequence_ [ encode (packets `plusPtr` (i * packetSize)) c
+                  | (i, (_, c)) <- zip [0..] cs ]
+        d <- c_lf_get_selected
+        send d packets retvals (runs (map fst cs))
+        peekArray n retvals
+    where encode p c = maybe overflow (writePacket p) (encodeCall c)
+          overflow   = ioError (userError "batch: call arguments overflow a packet.")
+          -- Stop at the first failing run, leaving its error for bracketIO.
+          send _ _ _ [] = return ()
+          send d p r ((Handle _ h, l):rs) = do
+              e <- withForeignPtr h $ \hp ->
+                  c_lf_invoke_packed d (castPtr hp) p r (fromIntegral l)
+              if e == 0
+                 then return ()
+                 else send d (p `plusPtr` (l * packetSize))
+                             (r `advancePtr` l)
+                             rs
+
+-- | Split a sequence of handles into runs of at most 'batchMax' consecutive
+--   calls to the same module.
+runs :: [Handle] -> [(Handle, Int)]
+runs []     = []
+runs (h:hs) = (h, length same) : runs rest
+    where (same, rest) = spanMax (h:hs)
+          spanMax xs   = let (s, r) = span (== h) xs
+                             (s', r') = splitAt batchMax s
+                         in (s', r' ++ r)
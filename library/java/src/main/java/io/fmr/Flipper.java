@@ -1,10 +1,11 @@
 package io.flipper;
 
-import io.flipper.fmr._lf_module;
 import jnr.ffi.LibraryLoader;
+import jnr.ffi.Memory;
 import jnr.ffi.Pointer;
 import jnr.ffi.Runtime;
-import jnr.ffi.Struct;
+import jnr.ffi.annotations.In;
+import jnr.ffi.annotations.Out;
 
 import java.lang.reflect.Proxy;
 
@@ -17,15 +18,13 @@ public class Flipper {
 
     public interface _libflipper {
 
-        // Flipper attach/select bindings.
-        Pointer flipper_attach();
+        // Flipper attach bindings.
+        Pointer carbon_attach();
 
         // FMR bindings
-        int lf_invoke(lf_get_selected(), _lf_module module, byte function, Pointer parameters);
-        int lf_bind(Pointer module);
-
-        Pointer fmr_build(byte argc);
-        int fmr_append(Pointer list, byte type, int value);
+        int lf_resolve(Pointer device, String module, Pointer handle);
+        Pointer lf_call_init(@Out byte[] packet, byte function, byte ret, int argt, byte argc, byte argv_len);
+        int lf_invoke_packet(Pointer device, Pointer handle, @In byte[] packet, @Out long[] retval);
     }
 
     public static final _libflipper libflipper = LibraryLoader.create(_libflipper.class).load("flipper");
@@ -34,28 +33,28 @@ public class Flipper {
         return Runtime.getRuntime(libflipper);
     }
 
-    public interface FMRInvoker {
-        int invoke(byte function, Pointer params);
-    }
+    /* The size of a struct _lf_handle, rounded up. */
+    private static final int LF_HANDLE_SIZE = 16;
 
     public Flipper() {
-        device = libflipper.flipper_attach();
+        device = libflipper.carbon_attach();
+        if (device == null) {
+            throw new FlipperModuleException("Failed to attach to a Flipper");
+        }
     }
 
     public <T> T bindModule(Class<T> moduleInterface, String name) {
 
-        _lf_module module = new _lf_module(getRuntime());
-
-        module.setName(name);
-
-        int success = libflipper.lf_bind(Struct.getMemory(module));
+        Pointer handle = Memory.allocateDirect(getRuntime(), LF_HANDLE_SIZE, true);
+        if (libflipper.lf_resolve(device, name, handle) == 0) {
+            throw new FlipperModuleException("No counterpart found for module '" + name + "'");
+        }
 
         /*
          * Whenever a user executes a function from their module interface, this ModuleInvocationHandler gets triggered.
-         * Upon receiving an invoke call, the ModuleInvocationHandler constructs a _fmr_list parameter list from the
-         * function call and uses this FMRInvoker to deliver it back to us, where we can pass it to lf_invoke.
+         * It packs the call into a packet and sends it to the module through the resolved handle.
          */
-        ModuleInvocationHandler invoker = new ModuleInvocationHandler(moduleInterface, (func, params) -> libflipper.lf_invoke(lf_get_selected(), module, func, params));
+        ModuleInvocationHandler<T> invoker = new ModuleInvocationHandler<>(moduleInterface, device, handle);
 
         return moduleInterface.cast(Proxy.newProxyInstance(moduleInterface.getClassLoader(), new Class[] { moduleInterface }, invoker));
     }
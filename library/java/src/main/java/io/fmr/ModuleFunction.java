@@ -6,6 +6,9 @@ import java.lang.annotation.RetentionPolicy;
 import java.lang.annotation.Target;
 
 /**
+ * Gives the index of a module interface method's function on the device. Every method of a module interface
+ * needs one.
+ *
  * @author Nick Mosher <nicholastmosher@gmail.com>
  */
 @Retention(RetentionPolicy.RUNTIME)
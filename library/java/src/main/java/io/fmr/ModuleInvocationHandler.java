@@ -4,51 +4,171 @@ import jnr.ffi.Pointer;
 
 import java.lang.reflect.InvocationHandler;
 import java.lang.reflect.Method;
-import java.lang.reflect.Parameter;
-import java.util.Arrays;
-import java.util.HashMap;
-import java.util.List;
-import java.util.Map;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.function.LongFunction;
 
 /**
+ * Dispatches calls on a module interface's proxy to the device.
+ *
+ * Everything that can be known about a method ahead of time is worked out the first time it is called and kept
+ * in a {@link Plan}: its function index, a call packet with every field but the arguments already filled in,
+ * and how to write each argument and read the result. A call then only copies the packet, writes its arguments
+ * into it, and hands it to libflipper in a single native call.
+ *
  * @author Nick Mosher <nicholastmosher@gmail.com>
  */
 public class ModuleInvocationHandler <T> implements InvocationHandler {
 
-    private final Class<T> moduleInterface;
-    private final Flipper.FMRInvoker invoker;
+    /* FMR type codes, as in fmr.h. */
+    private static final byte lf_uint8_t = 0;
+    private static final byte lf_uint16_t = 1;
+    private static final byte lf_void_t = 2;
+    private static final byte lf_uint32_t = 3;
+    private static final byte lf_uint64_t = 7;
+
+    /* Layout of a call packet, as in fmr.h. */
+    private static final int FMR_PACKET_SIZE = 64;
+    private static final int FMR_ARGV_OFFSET = 14;
+
+    /** Writes one argument into a packet at the given offset. */
+    private interface ArgWriter {
+        void write(byte[] packet, int offset, Object value);
+    }
+
+    /** How to call one method of the module. */
+    private static final class Plan {
+        /* A call packet for the method, complete except for the argument values. */
+        final byte[] template;
+        final int[] offsets;
+        final ArgWriter[] writers;
+        final LongFunction<Object> result;
 
-    private final Map<String, Byte> lf_types = new HashMap<String, Byte>(){{
-        put("byte",  (byte) 0);
-        put("short", (byte) 1);
-        put("int",   (byte) 2);
-    }};
+        Plan(byte[] template, int[] offsets, ArgWriter[] writers, LongFunction<Object> result) {
+            this.template = template;
+            this.offsets = offsets;
+            this.writers = writers;
+            this.result = result;
+        }
+    }
 
-    ModuleInvocationHandler(Class<T> iface, Flipper.FMRInvoker invoker) {
+    private final Class<T> moduleInterface;
+    private final Pointer device;
+    private final Pointer handle;
+    private final ConcurrentHashMap<Method, Plan> plans = new ConcurrentHashMap<>();
+
+    ModuleInvocationHandler(Class<T> iface, Pointer device, Pointer handle) {
         moduleInterface = iface;
-        this.invoker = invoker;
+        this.device = device;
+        this.handle = handle;
     }
 
     @Override
     public Object invoke(Object proxy, Method method, Object[] args) throws Throwable {
 
-        Class interfaceClass = Class.forName(moduleInterface.getTypeName());
-        List<Method> iFaceMethods = Arrays.asList(interfaceClass.getDeclaredMethods());
+        if (method.getDeclaringClass() == Object.class) {
+            return invokeObjectMethod(proxy, method, args);
+        }
+
+        Plan plan = plans.get(method);
+        if (plan == null) {
+            plan = plans.computeIfAbsent(method, this::plan);
+        }
+
+        byte[] packet = plan.template.clone();
+        for (int i = 0; i < plan.writers.length; i++) {
+            plan.writers[i].write(packet, plan.offsets[i], args[i]);
+        }
+
+        long[] retval = new long[1];
+        if (Flipper.libflipper.lf_invoke_packet(device, handle, packet, retval) == 0) {
+            throw new FlipperModuleException("Failed to invoke " + moduleInterface.getSimpleName() + "." + method.getName());
+        }
+        return plan.result.apply(retval[0]);
+    }
+
+    private Plan plan(Method method) {
+
+        // Reflection doesn't report methods in declaration order, so every function names its index.
+        ModuleFunction id = method.getAnnotation(ModuleFunction.class);
+        if (id == null) {
+            throw new FlipperModuleException(method.getName() + " has no @ModuleFunction id");
+        }
+        byte function = id.functionId();
+
+        Class<?>[] parameters = method.getParameterTypes();
+        int[] offsets = new int[parameters.length];
+        ArgWriter[] writers = new ArgWriter[parameters.length];
+        int argt = 0;
+        int offset = 0;
+        for (int i = 0; i < parameters.length; i++) {
+            byte type = typeOf(parameters[i], method);
+            argt |= (type & 0xf) << (i * 4);
+            offsets[i] = FMR_ARGV_OFFSET + offset;
+            writers[i] = writerFor(type);
+            offset += sizeOf(type);
+        }
+
+        byte ret = (method.getReturnType() == void.class) ? lf_void_t : typeOf(method.getReturnType(), method);
+
+        byte[] template = new byte[FMR_PACKET_SIZE];
+        if (Flipper.libflipper.lf_call_init(template, function, ret, argt, (byte) parameters.length, (byte) offset) == null) {
+            throw new FlipperModuleException("Arguments of " + method.getName() + " do not fit in a call packet");
+        }
+        return new Plan(template, offsets, writers, resultFor(method.getReturnType()));
+    }
 
-        Parameter[] parameters = method.getParameters();
-        Pointer list = Flipper.libflipper.fmr_build((byte) 0);
-        if (args != null) {
-            Parameter param;
-            String pName;
-            for (int i = 0; i < args.length; i++) {
-                param = parameters[i];
-                if (!lf_types.containsKey(pName = param.getType().getName())) {
-                    throw new IllegalArgumentException("Illegal fmr argument type: " + pName);
-                }
-                Flipper.libflipper.lf_append(list, lf_types.get(pName), (Integer) args[i]);
-            }
+    private static byte typeOf(Class<?> type, Method method) {
+        if (type == byte.class || type == boolean.class) return lf_uint8_t;
+        if (type == short.class || type == char.class) return lf_uint16_t;
+        if (type == int.class) return lf_uint32_t;
+        if (type == long.class) return lf_uint64_t;
+        throw new IllegalArgumentException("Illegal fmr type " + type.getName() + " in " + method.getName());
+    }
+
+    private static int sizeOf(byte type) {
+        switch (type) {
+            case lf_uint8_t: return 1;
+            case lf_uint16_t: return 2;
+            case lf_uint32_t: return 4;
+            default: return 8;
         }
+    }
 
-        return invoker.invoke((byte) iFaceMethods.indexOf(method), list);
+    /* Arguments are written little-endian, as the device expects them. */
+    private static void putLE(byte[] packet, int offset, long value, int size) {
+        for (int i = 0; i < size; i++) {
+            packet[offset + i] = (byte) (value >>> (i * 8));
+        }
+    }
+
+    private static ArgWriter writerFor(byte type) {
+        switch (type) {
+            case lf_uint8_t:
+                return (p, o, v) -> p[o] = (v instanceof Boolean) ? (byte) ((Boolean) v ? 1 : 0) : (Byte) v;
+            case lf_uint16_t:
+                return (p, o, v) -> putLE(p, o, (v instanceof Character) ? (Character) v : (Short) v, 2);
+            case lf_uint32_t:
+                return (p, o, v) -> putLE(p, o, (Integer) v, 4);
+            default:
+                return (p, o, v) -> putLE(p, o, (Long) v, 8);
+        }
+    }
+
+    private static LongFunction<Object> resultFor(Class<?> type) {
+        if (type == void.class) return v -> null;
+        if (type == boolean.class) return v -> v != 0;
+        if (type == byte.class) return v -> (byte) v;
+        if (type == short.class) return v -> (short) v;
+        if (type == char.class) return v -> (char) v;
+        if (type == int.class) return v -> (int) v;
+        return v -> v;
+    }
+
+    private Object invokeObjectMethod(Object proxy, Method method, Object[] args) {
+        switch (method.getName()) {
+            case "equals": return proxy == args[0];
+            case "hashCode": return System.identityHashCode(proxy);
+            default: return moduleInterface.getSimpleName() + " module on " + device;
+        }
     }
 }
@@ -0,0 +1,11 @@
+{
+  "targets": [
+    {
+      "target_name": "flipper",
+      "sources": [ "src/flipper.c" ],
+      "defines": [ "NAPI_VERSION=6" ],
+      "cflags": [ "-std=gnu99", "<!@(pkg-config --cflags libflipper)" ],
+      "libraries": [ "<!@(pkg-config --libs libflipper)" ]
+    }
+  ]
+}
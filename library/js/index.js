@@ -1,110 +1,116 @@
-var ffi = require('ffi');
-var ref = require('ref');
-var Struct = require('ref-struct');
-
-// typedefs
-const lf_version_t = ref.types.uint16;
-const lf_crc_t = ref.types.uint16;
-
-const lf_arg = ref.types.uint32;
-const lf_function = ref.types.uint8;
-const lf_argc = ref.types.uint8;
-const lf_return_t = ref.types.uint32;
-
-const _lf_type = [
-  ref.types.uint8,
-  ref.types.uint16,
-  ref.types.uint32
-];
-
-const lf_type = ref.types.uint8;
-
-const _lf_module = Struct({
-  'name': 'string',
-  'description': 'string',
-  'version' lf_version_t,
-  'identifier': lf_crc_t,
-  'index': ref.types.uint16,
-  'device': 'pointer'
-});
-
-const libflipper = ffi.Library('libflipper', {
-
-  // _lf_device *flipper_attach()
-  'flipper_attach': [ 'pointer', [ ] ],
-
-  'flipper_select': [ 'int', [ 'pointer' ] ],
-
-  // lf_return_t lf_invoke(lf_get_selected(), struct _lf_module *module, lf_function function, struct _fmr_parameters *parameters)
-  'lf_invoke': [ lf_return_t, [ ref.refType(_lf_module), lf_function, 'pointer' ] ],
-
-  // int lf_bind(struct _lf_module *module, String name)
-  'lf_bind': [ 'int', [ ref.refType(_lf_module), 'string' ] ],
-
-  'fmr_build': [ 'pointer', [ lf_argc ] ],
-
-  'lf_append': [ ref.types.void, [ 'pointer', lf_type, lf_arg ] ],
-
-  // led_configure()
-  'led_configure': [ ref.types.void, [ ] ],
-
-  // led_rgb(uint8_t red, uint8_t green, uint8_t blue)
-  'led_rgb': [ ref.types.void, [ref.types.uint8, ref.types.uint8, ref.types.uint8 ] ]
-});
-
-const _create_fmr_parameters = function (paramTypes, args) {
-  var list = libflipper.fmr_build(0);
-
-  var i, arg, argType;
-  for (i = 0; i < args.length; i++) {
-    arg = args[i];
-    argType = paramTypes[i];
-    libflipper.lf_append(list, _lf_type.indexOf(argType), arg);
-  }
+const native = require('./build/Release/flipper.node');
+
+// The FMR type codes of each type name an interface can use.
+const lf_type = {
+    'uint8': 0,
+    'uint16': 1,
+    'uint32': 3,
+    'uint64': 7,
+    'int8': 8,
+    'int16': 9,
+    'int32': 11,
+    'int64': 15,
+    'void': 2,
+    'int': 4,
+    'ptr': 6
+};
 
-  return list;
+const _typeOf = function (name) {
+    if (!(name in lf_type)) {
+        throw new TypeError("Unknown type '" + name + "'.");
+    }
+    return lf_type[name];
 };
 
-function Flipper ( ) {
-  this.device = libflipper.flipper_attach();
+// Every call into the device returns a Promise. The device I/O happens on a libuv worker thread,
+// so the event loop keeps running for the whole round trip.
+function Flipper (device) {
+    this.device = device;
 }
 
-// Using a node-ffi style interface declaration, bind the given interface to Flipper.
-Flipper.prototype.bindModule = function(iface, name) {
-
-  // Hold a reference to this flipper for inner functions to use.
-  var self = this;
-
-  var module = new _lf_module();
-
-  // Populates the above module object with metadata.
-  var success = libflipper.lf_bind(module.ref(), name);
-
-  var bindings = {};
-
-  // For each function in the given interface, generate a proxy for it and attach it to the bindings.
-  Object.keys(iface || {}).forEach(function (func, i) {
-
-    // Get interface metadata for the current function definition.
-    var info = iface[func];
-    var resultType = info[0];
-    var paramTypes = info[1];
+// Attaches to a Carbon device over USB, or over the network if a hostname is given.
+Flipper.attach = function (hostname) {
+    return native.attach(hostname).then(function (device) {
+        return new Flipper(device);
+    });
+};
 
-    // Generate a proxy function and assign it to the bindings.
-    bindings[func] = function() {
-      libflipper.flipper_select(self.device);
+// Using an interface declaration of the form { name: [ resultType, [ paramTypes ] ] }, bind the given
+// module. Functions are numbered in the order they are declared, as on the device.
+Flipper.prototype.bindModule = function (iface, name) {
+
+    var functions = Object.keys(iface || {}).map(function (func, i) {
+        var info = iface[func];
+        return {
+            name: func,
+            index: i,
+            ret: _typeOf(info[0]),
+            types: info[1].map(_typeOf)
+        };
+    });
+
+    var handle = native.resolve(this.device, name);
+    var bindings = {};
+
+    functions.forEach(function (func) {
+        // Generate a proxy function and assign it to the bindings. The arguments cross into the addon in one call.
+        bindings[func.name] = function () {
+            var args = Array.prototype.slice.call(arguments);
+            if (args.length !== func.types.length) {
+                return Promise.reject(new TypeError("Expected " + func.types.length + " args, got " + args.length));
+            }
+            return handle.then(function (h) {
+                return native.invoke(h, func.index, func.ret, func.types, args);
+            });
+        };
+    });
+
+    // Sends several calls back to back and collects their results in one round trip, as in:
+    //   gpio.$batch([ [ 'gpio_enable', 1, 0 ], [ 'gpio_write', 1, 0 ] ])
+    Object.defineProperty(bindings, '$batch', {
+        value: function (calls) {
+            var packed;
+            try {
+                packed = calls.map(function (call) {
+                    var func = functions.find(function (f) { return f.name === call[0]; });
+                    if (!func) throw new TypeError("No function '" + call[0] + "' in module '" + name + "'.");
+                    var args = call.slice(1);
+                    if (args.length !== func.types.length) {
+                        throw new TypeError("Expected " + func.types.length + " args to '" + func.name + "', got " + args.length);
+                    }
+                    return [ func.index, func.ret, func.types, args ];
+                });
+            } catch (e) {
+                return Promise.reject(e);
+            }
+            return handle.then(function (h) {
+                return native.invokeBatch(h, packed);
+            });
+        }
+    });
+
+    return bindings;
+};
 
-      if (arguments.length !== paramTypes.length) {
-        console.log("Expected " + paramTypes.length + " args, got " + arguments.length);
-      }
+// Allocates memory on the device, resolving to its address as a BigInt.
+Flipper.prototype.malloc = function (size) {
+    return native.malloc(this.device, size);
+};
 
-      var params = _create_fmr_parameters(paramTypes, arguments);
+Flipper.prototype.free = function (address) {
+    return native.free(this.device, address);
+};
 
-      return libflipper.lf_invoke(lf_get_selected(), module.ref(), i, params);
-    }
-  });
+// Copies a Buffer or TypedArray to a device address. The buffer must not be modified until the Promise settles.
+Flipper.prototype.push = function (address, buffer) {
+    return native.push(this.device, address, buffer);
+};
 
-  return bindings;
+// Fills a Buffer or TypedArray from a device address.
+Flipper.prototype.pull = function (buffer, address) {
+    return native.pull(this.device, buffer, address);
 };
 
+Flipper.types = Object.keys(lf_type);
+
 module.exports = Flipper;
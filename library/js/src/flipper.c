@@ -0,0 +1,537 @@
+/* flipper.c - A Node.js addon that performs device I/O on libuv worker threads and settles promises. */
+
+#include <node_api.h>
+#include <uv.h>
+
+#include <flipper/libflipper.h>
+#include <flipper/carbon.h>
+
+/* libflipper keeps its error and selection state globally, so only one worker may use it at a time. */
+static uv_mutex_t lf_node_lock;
+
+/* The largest module name that can be resolved. */
+#define LF_NODE_NAME_MAX 64
+
+/* One asynchronous operation, from the JavaScript call that starts it to the promise it settles. */
+struct lf_node_work {
+    napi_async_work work;
+    napi_deferred deferred;
+    /* Runs on a worker thread with the lock held. */
+    int (*execute)(struct lf_node_work *op);
+    /* Runs on the main thread to produce the value the promise resolves to. */
+    napi_value (*complete)(napi_env env, struct lf_node_work *op);
+    /* Keeps the buffer or handle being worked on alive until the operation settles. */
+    napi_ref keep;
+    int status;
+    char error[128];
+
+    struct _lf_device *device;
+    struct _lf_handle *handle;
+    char name[LF_NODE_NAME_MAX];
+    uint64_t address;
+    void *buffer;
+    size_t length;
+    struct _fmr_packet *packets;
+    lf_type *rets;
+    lf_return_t *retvals;
+    size_t count;
+};
+
+/* Throws the pending N-API error, if 'call' failed, and jumps to 'fail'. */
+#define lf_node_check(env, call)                                                                    \
+    if ((call) != napi_ok) {                                                                        \
+        const napi_extended_error_info *info = NULL;                                                \
+        napi_get_last_error_info((env), &info);                                                     \
+        napi_throw_error((env), NULL, (info && info->error_message) ? info->error_message : #call); \
+        goto fail;                                                                                  \
+    }
+
+/* Throws 'message' if 'cond' holds, and jumps to 'fail'. */
+#define lf_node_throw_if(env, cond, message)    \
+    if (cond) {                                 \
+        napi_throw_error((env), NULL, message); \
+        goto fail;                              \
+    }
+
+static void lf_node_execute(napi_env env, void *data) {
+    struct lf_node_work *op = data;
+
+    uv_mutex_lock(&lf_node_lock);
+    lf_error_set(E_OK);
+    op->status = op->execute(op);
+    if (op->status != lf_success) {
+        snprintf(op->error, sizeof(op->error), "%s", lf_error_string(lf_error_get()));
+    }
+    uv_mutex_unlock(&lf_node_lock);
+}
+
+static void lf_node_release_work(napi_env env, struct lf_node_work *op) {
+    if (op->keep) napi_delete_reference(env, op->keep);
+    if (op->work) napi_delete_async_work(env, op->work);
+    free(op->packets);
+    free(op->rets);
+    free(op->retvals);
+    free(op);
+}
+
+static void lf_node_complete(napi_env env, napi_status status, void *data) {
+    struct lf_node_work *op = data;
+    napi_value value = NULL;
+
+    if (status == napi_ok && op->status == lf_success) {
+        value = op->complete ? op->complete(env, op) : NULL;
+        if (!value) napi_get_undefined(env, &value);
+        napi_resolve_deferred(env, op->deferred, value);
+    } else {
+        napi_value message;
+        napi_create_string_utf8(env, (status == napi_cancelled) ? "cancelled" : op->error, NAPI_AUTO_LENGTH, &message);
+        napi_create_error(env, NULL, message, &value);
+        napi_reject_deferred(env, op->deferred, value);
+    }
+    lf_node_release_work(env, op);
+}
+
+/* Queues an operation, returning the promise it will settle. The operation is released either way. */
+static napi_value lf_node_queue(napi_env env, struct lf_node_work *op, const char *name) {
+    napi_value promise = NULL, resource;
+
+    lf_node_check(env, napi_create_promise(env, &op->deferred, &promise));
+    lf_node_check(env, napi_create_string_utf8(env, name, NAPI_AUTO_LENGTH, &resource));
+    lf_node_check(env, napi_create_async_work(env, NULL, resource, lf_node_execute, lf_node_complete, op, &op->work));
+    lf_node_check(env, napi_queue_async_work(env, op->work));
+    return promise;
+fail:
+    lf_node_release_work(env, op);
+    return NULL;
+}
+
+/* Values are taken from either numbers or BigInts. Negative numbers are stored in two's complement. */
+static int lf_node_get_u64(napi_env env, napi_value value, uint64_t *result) {
+    napi_valuetype type;
+    lf_node_check(env, napi_typeof(env, value, &type));
+    if (type == napi_bigint) {
+        bool lossless;
+        lf_node_check(env, napi_get_value_bigint_uint64(env, value, result, &lossless));
+    } else {
+        int64_t number;
+        lf_node_check(env, napi_get_value_int64(env, value, &number));
+        *result = (uint64_t)number;
+    }
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+/* The size in bytes of each element of a TypedArray. */
+static size_t lf_node_element_size(napi_typedarray_type type) {
+    switch (type) {
+        case napi_int8_array:
+        case napi_uint8_array:
+        case napi_uint8_clamped_array: return 1;
+        case napi_int16_array:
+        case napi_uint16_array: return 2;
+        case napi_int32_array:
+        case napi_uint32_array:
+        case napi_float32_array: return 4;
+        default: return 8;
+    }
+}
+
+/* Views only cover part of their ArrayBuffer, so their length is taken from the view rather than the buffer. */
+static int lf_node_get_buffer(napi_env env, napi_value value, void **data, size_t *length) {
+    bool is_buffer = false, is_typedarray = false;
+    lf_node_check(env, napi_is_buffer(env, value, &is_buffer));
+    if (is_buffer) {
+        lf_node_check(env, napi_get_buffer_info(env, value, data, length));
+        return lf_success;
+    }
+    lf_node_check(env, napi_is_typedarray(env, value, &is_typedarray));
+    lf_node_throw_if(env, !is_typedarray, "Expected a Buffer or TypedArray.");
+
+    napi_typedarray_type type;
+    size_t elements;
+    lf_node_check(env, napi_get_typedarray_info(env, value, &type, &elements, data, NULL, NULL));
+    *length = elements * lf_node_element_size(type);
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+/* Converts a call's result to a number, or a BigInt for 64-bit and pointer results. */
+static napi_value lf_node_result(napi_env env, lf_type ret, lf_return_t value) {
+    napi_value result = NULL;
+    switch (ret) {
+        case lf_void_t: napi_get_undefined(env, &result); break;
+        case lf_uint8_t: napi_create_uint32(env, (uint8_t)value, &result); break;
+        case lf_uint16_t: napi_create_uint32(env, (uint16_t)value, &result); break;
+        case lf_uint32_t: napi_create_uint32(env, (uint32_t)value, &result); break;
+        case lf_int8_t: napi_create_int32(env, (int8_t)value, &result); break;
+        case lf_int16_t: napi_create_int32(env, (int16_t)value, &result); break;
+        case lf_int_t:
+        case lf_int32_t: napi_create_int32(env, (int32_t)value, &result); break;
+        case lf_int64_t: napi_create_bigint_int64(env, (int64_t)value, &result); break;
+        default: napi_create_bigint_uint64(env, value, &result); break;
+    }
+    return result;
+}
+
+/* Packs a call to 'function' with the parallel arrays 'types' and 'values' into a packet, in one crossing. */
+static int lf_node_pack_call(napi_env env, napi_value function, napi_value ret, napi_value types, napi_value values,
+                             struct _fmr_packet *packet, lf_type *rettype) {
+    uint32_t index, type, argc, count;
+    lf_types argt = 0;
+    uint8_t argv[FMR_PACKET_SIZE];
+    uint8_t argv_len = 0;
+
+    lf_node_check(env, napi_get_value_uint32(env, function, &index));
+    lf_node_check(env, napi_get_value_uint32(env, ret, &type));
+    lf_node_check(env, napi_get_array_length(env, types, &argc));
+    lf_node_check(env, napi_get_array_length(env, values, &count));
+    lf_node_throw_if(env, argc != count, "Expected a value for every argument type.");
+    lf_node_throw_if(env, argc > sizeof(lf_types) * 2, "Too many arguments for one call.");
+    *rettype = (lf_type)type;
+
+    for (uint32_t i = 0; i < argc; i++) {
+        napi_value element;
+        uint32_t argtype;
+        uint64_t value;
+
+        lf_node_check(env, napi_get_element(env, types, i, &element));
+        lf_node_check(env, napi_get_value_uint32(env, element, &argtype));
+        lf_node_throw_if(env, argtype > lf_max_t || !lf_sizeof(argtype), "Invalid argument type.");
+        lf_node_check(env, napi_get_element(env, values, i, &element));
+        if (!lf_node_get_u64(env, element, &value)) goto fail;
+
+        int size = lf_sizeof(argtype);
+        lf_node_throw_if(env, argv_len + size > sizeof(argv), "Arguments do not fit in a call packet.");
+        argt |= (lf_types)(argtype & lf_max_t) << (i * 4);
+        memcpy(argv + argv_len, &value, size);
+        argv_len += size;
+    }
+
+    uint8_t *dst = lf_call_init(packet, index, (lf_type)type, argt, argc, argv_len);
+    lf_node_throw_if(env, !dst, "Arguments do not fit in a call packet.");
+    memcpy(dst, argv, argv_len);
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+static struct lf_node_work *lf_node_work_create(napi_env env) {
+    struct lf_node_work *op = calloc(1, sizeof(struct lf_node_work));
+    if (!op) napi_throw_error(env, NULL, "Failed to allocate memory for operation.");
+    return op;
+}
+
+/* Gets the arguments of a native function, requiring at least 'min' of them. */
+static int lf_node_args(napi_env env, napi_callback_info info, size_t min, size_t max, napi_value *argv) {
+    size_t argc = max;
+    lf_node_check(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    lf_node_throw_if(env, argc < min, "Not enough arguments.");
+    for (size_t i = argc; i < max; i++) napi_get_undefined(env, &argv[i]);
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+static int lf_node_get_external(napi_env env, napi_value value, void **result) {
+    napi_valuetype type;
+    lf_node_check(env, napi_typeof(env, value, &type));
+    lf_node_throw_if(env, type != napi_external, "Expected a device or module handle.");
+    lf_node_check(env, napi_get_value_external(env, value, result));
+    lf_node_throw_if(env, !*result, "Invalid device or module handle.");
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+/* ---------- ATTACH ---------- */
+
+static int lf_node_attach_execute(struct lf_node_work *op) {
+    op->device = op->name[0] ? carbon_attach_hostname(op->name) : carbon_attach();
+    return op->device ? lf_success : lf_error;
+}
+
+static napi_value lf_node_attach_complete(napi_env env, struct lf_node_work *op) {
+    napi_value device = NULL;
+    /* The device belongs to libflipper, which releases it on exit. */
+    napi_create_external(env, op->device, NULL, NULL, &device);
+    return device;
+}
+
+/* attach([hostname]) -> Promise<device> */
+static napi_value lf_node_attach(napi_env env, napi_callback_info info) {
+    napi_value argv[1];
+    napi_valuetype type;
+    struct lf_node_work *op = NULL;
+
+    if (!lf_node_args(env, info, 0, 1, argv)) goto fail;
+    op = lf_node_work_create(env);
+    if (!op) goto fail;
+    lf_node_check(env, napi_typeof(env, argv[0], &type));
+    if (type == napi_string) {
+        lf_node_check(env, napi_get_value_string_utf8(env, argv[0], op->name, sizeof(op->name), NULL));
+    }
+    op->execute = lf_node_attach_execute;
+    op->complete = lf_node_attach_complete;
+    return lf_node_queue(env, op, "flipper.attach");
+fail:
+    free(op);
+    return NULL;
+}
+
+/* ---------- RESOLVE ---------- */
+
+static void lf_node_handle_finalize(napi_env env, void *handle, void *hint) {
+    free(handle);
+}
+
+static int lf_node_resolve_execute(struct lf_node_work *op) {
+    return lf_resolve(op->device, op->name, op->handle);
+}
+
+static napi_value lf_node_resolve_complete(napi_env env, struct lf_node_work *op) {
+    napi_value handle = NULL;
+    napi_get_reference_value(env, op->keep, &handle);
+    return handle;
+}
+
+/* resolve(device, module) -> Promise<handle> */
+static napi_value lf_node_resolve(napi_env env, napi_callback_info info) {
+    napi_value argv[2], handle;
+    struct _lf_handle *raw = NULL;
+    struct lf_node_work *op = NULL;
+
+    if (!lf_node_args(env, info, 2, 2, argv)) goto fail;
+    op = lf_node_work_create(env);
+    if (!op) goto fail;
+    if (!lf_node_get_external(env, argv[0], (void **)&op->device)) goto fail;
+    lf_node_check(env, napi_get_value_string_utf8(env, argv[1], op->name, sizeof(op->name), NULL));
+
+    raw = calloc(1, sizeof(struct _lf_handle));
+    lf_node_throw_if(env, !raw, "Failed to allocate memory for module handle.");
+    lf_node_check(env, napi_create_external(env, raw, lf_node_handle_finalize, NULL, &handle));
+    raw = NULL;
+    lf_node_check(env, napi_get_value_external(env, handle, (void **)&op->handle));
+    lf_node_check(env, napi_create_reference(env, handle, 1, &op->keep));
+
+    op->execute = lf_node_resolve_execute;
+    op->complete = lf_node_resolve_complete;
+    return lf_node_queue(env, op, "flipper.resolve");
+fail:
+    free(raw);
+    if (op) lf_node_release_work(env, op);
+    return NULL;
+}
+
+/* ---------- INVOKE ---------- */
+
+static int lf_node_invoke_execute(struct lf_node_work *op) {
+    struct _lf_device *device = op->handle->device;
+
+    /* Calls beyond what one batch is expected to hold are sent a batch at a time. */
+    for (size_t i = 0; i < op->count; i += LF_BATCH_MAX) {
+        size_t count = (op->count - i < LF_BATCH_MAX) ? op->count - i : LF_BATCH_MAX;
+        int e = (count == 1) ? lf_invoke_packet(device, op->handle, &op->packets[i], &op->retvals[i])
+                             : lf_invoke_packed(device, op->handle, &op->packets[i], &op->retvals[i], count);
+        if (e != lf_success) return lf_error;
+    }
+    return lf_success;
+}
+
+static napi_value lf_node_invoke_complete(napi_env env, struct lf_node_work *op) {
+    return lf_node_result(env, op->rets[0], op->retvals[0]);
+}
+
+static napi_value lf_node_batch_complete(napi_env env, struct lf_node_work *op) {
+    napi_value results = NULL;
+    napi_create_array_with_length(env, op->count, &results);
+    for (size_t i = 0; i < op->count; i++) {
+        napi_set_element(env, results, i, lf_node_result(env, op->rets[i], op->retvals[i]));
+    }
+    return results;
+}
+
+static int lf_node_calls_create(napi_env env, struct lf_node_work *op, napi_value handle, size_t count) {
+    if (!lf_node_get_external(env, handle, (void **)&op->handle)) goto fail;
+    lf_node_throw_if(env, !op->handle->device, "Module handle has not been resolved.");
+    lf_node_check(env, napi_create_reference(env, handle, 1, &op->keep));
+
+    op->count = count;
+    op->packets = calloc(count ? count : 1, sizeof(struct _fmr_packet));
+    op->rets = calloc(count ? count : 1, sizeof(lf_type));
+    op->retvals = calloc(count ? count : 1, sizeof(lf_return_t));
+    lf_node_throw_if(env, !op->packets || !op->rets || !op->retvals, "Failed to allocate memory for calls.");
+    op->execute = lf_node_invoke_execute;
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+/* invoke(handle, function, ret, types, values) -> Promise<result> */
+static napi_value lf_node_invoke(napi_env env, napi_callback_info info) {
+    napi_value argv[5];
+    struct lf_node_work *op = NULL;
+
+    if (!lf_node_args(env, info, 5, 5, argv)) goto fail;
+    op = lf_node_work_create(env);
+    if (!op) goto fail;
+    if (!lf_node_calls_create(env, op, argv[0], 1)) goto fail;
+    if (!lf_node_pack_call(env, argv[1], argv[2], argv[3], argv[4], op->packets, op->rets)) goto fail;
+
+    op->complete = lf_node_invoke_complete;
+    return lf_node_queue(env, op, "flipper.invoke");
+fail:
+    if (op) lf_node_release_work(env, op);
+    return NULL;
+}
+
+/* invokeBatch(handle, [[function, ret, types, values], ...]) -> Promise<[result, ...]> */
+static napi_value lf_node_invoke_batch(napi_env env, napi_callback_info info) {
+    napi_value argv[2];
+    uint32_t count;
+    struct lf_node_work *op = NULL;
+
+    if (!lf_node_args(env, info, 2, 2, argv)) goto fail;
+    lf_node_check(env, napi_get_array_length(env, argv[1], &count));
+    op = lf_node_work_create(env);
+    if (!op) goto fail;
+    if (!lf_node_calls_create(env, op, argv[0], count)) goto fail;
+
+    for (uint32_t i = 0; i < count; i++) {
+        napi_value call, fields[4];
+        uint32_t length;
+        lf_node_check(env, napi_get_element(env, argv[1], i, &call));
+        lf_node_check(env, napi_get_array_length(env, call, &length));
+        lf_node_throw_if(env, length != 4, "Expected each call as [function, ret, types, values].");
+        for (uint32_t j = 0; j < 4; j++) lf_node_check(env, napi_get_element(env, call, j, &fields[j]));
+        if (!lf_node_pack_call(env, fields[0], fields[1], fields[2], fields[3], &op->packets[i], &op->rets[i]))
+            goto fail;
+    }
+
+    op->complete = lf_node_batch_complete;
+    return lf_node_queue(env, op, "flipper.invokeBatch");
+fail:
+    if (op) lf_node_release_work(env, op);
+    return NULL;
+}
+
+/* ---------- MEMORY ---------- */
+
+static int lf_node_push_execute(struct lf_node_work *op) {
+    return lf_push(op->device, (void *)(uintptr_t)op->address, op->buffer, op->length);
+}
+
+static int lf_node_pull_execute(struct lf_node_work *op) {
+    return lf_pull(op->device, op->buffer, (void *)(uintptr_t)op->address, op->length);
+}
+
+static int lf_node_malloc_execute(struct lf_node_work *op) {
+    void *pointer = NULL;
+    int e = lf_malloc(op->device, op->length, &pointer);
+    op->address = (uintptr_t)pointer;
+    return e;
+}
+
+static int lf_node_free_execute(struct lf_node_work *op) {
+    return lf_free(op->device, (void *)(uintptr_t)op->address);
+}
+
+static napi_value lf_node_address_complete(napi_env env, struct lf_node_work *op) {
+    napi_value address = NULL;
+    napi_create_bigint_uint64(env, op->address, &address);
+    return address;
+}
+
+/* Starts a transfer between a device address and a buffer, which is kept alive until the transfer settles. */
+static napi_value lf_node_transfer(napi_env env, napi_callback_info info, bool push) {
+    napi_value argv[3];
+    struct lf_node_work *op = NULL;
+
+    if (!lf_node_args(env, info, 3, 3, argv)) goto fail;
+    op = lf_node_work_create(env);
+    if (!op) goto fail;
+    if (!lf_node_get_external(env, argv[0], (void **)&op->device)) goto fail;
+    if (!lf_node_get_u64(env, argv[push ? 1 : 2], &op->address)) goto fail;
+    if (!lf_node_get_buffer(env, argv[push ? 2 : 1], &op->buffer, &op->length)) goto fail;
+    lf_node_throw_if(env, op->length > UINT32_MAX, "Buffer is too large for one transfer.");
+    lf_node_check(env, napi_create_reference(env, argv[push ? 2 : 1], 1, &op->keep));
+
+    op->execute = push ? lf_node_push_execute : lf_node_pull_execute;
+    return lf_node_queue(env, op, push ? "flipper.push" : "flipper.pull");
+fail:
+    if (op) lf_node_release_work(env, op);
+    return NULL;
+}
+
+/* push(device, address, buffer) -> Promise<undefined> */
+static napi_value lf_node_push(napi_env env, napi_callback_info info) {
+    return lf_node_transfer(env, info, true);
+}
+
+/* pull(device, buffer, address) -> Promise<undefined> */
+static napi_value lf_node_pull(napi_env env, napi_callback_info info) {
+    return lf_node_transfer(env, info, false);
+}
+
+/* malloc(device, size) -> Promise<address> */
+static napi_value lf_node_malloc(napi_env env, napi_callback_info info) {
+    napi_value argv[2];
+    uint32_t size;
+    struct lf_node_work *op = NULL;
+
+    if (!lf_node_args(env, info, 2, 2, argv)) goto fail;
+    op = lf_node_work_create(env);
+    if (!op) goto fail;
+    if (!lf_node_get_external(env, argv[0], (void **)&op->device)) goto fail;
+    lf_node_check(env, napi_get_value_uint32(env, argv[1], &size));
+    op->length = size;
+    op->execute = lf_node_malloc_execute;
+    op->complete = lf_node_address_complete;
+    return lf_node_queue(env, op, "flipper.malloc");
+fail:
+    if (op) lf_node_release_work(env, op);
+    return NULL;
+}
+
+/* free(device, address) -> Promise<undefined> */
+static napi_value lf_node_free(napi_env env, napi_callback_info info) {
+    napi_value argv[2];
+    struct lf_node_work *op = NULL;
+
+    if (!lf_node_args(env, info, 2, 2, argv)) goto fail;
+    op = lf_node_work_create(env);
+    if (!op) goto fail;
+    if (!lf_node_get_external(env, argv[0], (void **)&op->device)) goto fail;
+    if (!lf_node_get_u64(env, argv[1], &op->address)) goto fail;
+    op->execute = lf_node_free_execute;
+    return lf_node_queue(env, op, "flipper.free");
+fail:
+    if (op) lf_node_release_work(env, op);
+    return NULL;
+}
+
+static napi_value lf_node_init(napi_env env, napi_value exports) {
+    static bool initialized = false;
+    napi_property_descriptor properties[] = {
+        { "attach", NULL, lf_node_attach, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "resolve", NULL, lf_node_resolve, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "invoke", NULL, lf_node_invoke, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "invokeBatch", NULL, lf_node_invoke_batch, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "push", NULL, lf_node_push, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "pull", NULL, lf_node_pull, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "malloc", NULL, lf_node_malloc, NULL, NULL, NULL, napi_enumerable, NULL },
+        { "free", NULL, lf_node_free, NULL, NULL, NULL, napi_enumerable, NULL },
+    };
+
+    if (!initialized) {
+        lf_node_throw_if(env, uv_mutex_init(&lf_node_lock), "Failed to create the libflipper lock.");
+        initialized = true;
+    }
+    lf_node_check(env, napi_define_properties(env, exports, sizeof(properties) / sizeof(*properties), properties));
+    return exports;
+fail:
+    return NULL;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, lf_node_init)
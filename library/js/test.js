@@ -1,19 +1,25 @@
 /**
  * @author Nick Mosher <nicholastmosher@gmail.com>
  */
-ref = require('ref');
 Flipper = require('./index.js');
 
-var flipper = new Flipper();
-
 const gpioModuleDef = {
   'gpio_configure': [ 'int', [ ] ],
-  'gpio_enable': [ ref.types.void, [ ref.types.uint32, ref.types.uint32 ] ],
-  'gpio_write': [ ref.types.void, [ ref.types.uint32, ref.types.uint32 ] ]
+  'gpio_enable': [ 'void', [ 'uint32', 'uint32' ] ],
+  'gpio_write': [ 'void', [ 'uint32', 'uint32' ] ]
 };
 
-var gpioModule = flipper.bindModule(gpioModuleDef, "gpio");
+Flipper.attach().then(function (flipper) {
+  var gpioModule = flipper.bindModule(gpioModuleDef, "gpio");
 
-gpioModule.gpio_configure();
-gpioModule.gpio_enable(1, 0);
-gpioModule.gpio_write(1, 0);
+  return gpioModule.gpio_configure()
+    .then(function () {
+      return gpioModule.$batch([
+        [ 'gpio_enable', 1, 0 ],
+        [ 'gpio_write', 1, 0 ]
+      ]);
+    });
+}).catch(function (e) {
+  console.error(e);
+  process.exitCode = 1;
+});
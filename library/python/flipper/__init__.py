@@ -0,0 +1 @@
+from .lf import *
@@ -0,0 +1,173 @@
+"""Bindings to libflipper.
+
+Bulk transfers accept any object supporting the buffer protocol, such as
+bytes, bytearray, memoryview or a contiguous numpy array. The object's own
+memory is handed to libflipper, so no data is copied on the Python side, and
+ctypes releases the GIL for the duration of each transfer.
+
+    import flipper
+    device = flipper.attach()
+    buffer = device.malloc(1 << 20)
+    device.push(buffer, samples)
+    device.pull(result, buffer)
+    for chunk in device.stream(buffer, 1 << 20):
+        process(chunk)
+"""
+
+import ctypes
+import ctypes.util
+
+__all__ = ['FlipperError', 'Device', 'attach']
+
+_lib = ctypes.CDLL(ctypes.util.find_library('flipper') or 'libflipper.so')
+
+_lib.carbon_attach.restype = ctypes.c_void_p
+_lib.carbon_attach.argtypes = []
+_lib.carbon_attach_hostname.restype = ctypes.c_void_p
+_lib.carbon_attach_hostname.argtypes = [ctypes.c_char_p]
+_lib.lf_select.argtypes = [ctypes.c_void_p]
+_lib.lf_push.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint32]
+_lib.lf_pull.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint32]
+_lib.lf_malloc.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.c_void_p)]
+_lib.lf_free.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_lib.lf_error_get.restype = ctypes.c_int
+_lib.lf_error_string.restype = ctypes.c_char_p
+_lib.lf_error_string.argtypes = [ctypes.c_int]
+
+# The most a single push or pull packet can describe.
+_MAX_TRANSFER = 0xffffffff
+
+
+class FlipperError(Exception):
+    """Raised when libflipper reports an error."""
+
+    def __init__(self, operation):
+        self.code = _lib.lf_error_get()
+        message = _lib.lf_error_string(self.code).decode()
+        super().__init__('{} failed: {}'.format(operation, message))
+
+
+def _check(operation, result):
+    if not result:
+        raise FlipperError(operation)
+
+
+class _Py_buffer(ctypes.Structure):
+    _fields_ = [
+        ('buf', ctypes.c_void_p),
+        ('obj', ctypes.py_object),
+        ('len', ctypes.c_ssize_t),
+        ('itemsize', ctypes.c_ssize_t),
+        ('readonly', ctypes.c_int),
+        ('ndim', ctypes.c_int),
+        ('format', ctypes.c_char_p),
+        ('shape', ctypes.POINTER(ctypes.c_ssize_t)),
+        ('strides', ctypes.POINTER(ctypes.c_ssize_t)),
+        ('suboffsets', ctypes.POINTER(ctypes.c_ssize_t)),
+        ('internal', ctypes.c_void_p),
+    ]
+
+
+_PyBUF_SIMPLE = 0
+_PyBUF_WRITABLE = 1
+
+_get_buffer = ctypes.pythonapi.PyObject_GetBuffer
+_get_buffer.argtypes = [ctypes.py_object, ctypes.POINTER(_Py_buffer), ctypes.c_int]
+_release_buffer = ctypes.pythonapi.PyBuffer_Release
+_release_buffer.argtypes = [ctypes.POINTER(_Py_buffer)]
+_release_buffer.restype = None
+
+
+class _Buffer(object):
+    """Exports the memory of a contiguous buffer for as long as the context is open.
+
+    Holding the export keeps the memory in place: a bytearray can't be resized
+    and a numpy array can't be reallocated while libflipper is using it.
+    """
+
+    def __init__(self, obj, writable):
+        self.view = _Py_buffer()
+        # Raises BufferError for read-only buffers when writable, and for non-contiguous ones.
+        _get_buffer(obj, ctypes.byref(self.view), _PyBUF_WRITABLE if writable else _PyBUF_SIMPLE)
+
+    def __enter__(self):
+        return self.view.buf, self.view.len
+
+    def __exit__(self, *exc):
+        _release_buffer(ctypes.byref(self.view))
+
+
+class Device(object):
+    """A device attached through libflipper."""
+
+    def __init__(self, handle):
+        self._handle = handle
+
+    def select(self):
+        """Makes this the device that module calls are sent to."""
+        _check('select', _lib.lf_select(self._handle))
+
+    def malloc(self, size):
+        """Allocates `size` bytes on the device, returning their address."""
+        pointer = ctypes.c_void_p()
+        _check('malloc', _lib.lf_malloc(self._handle, size, ctypes.byref(pointer)))
+        return pointer.value
+
+    def free(self, pointer):
+        """Frees memory allocated on the device with `malloc`."""
+        _check('free', _lib.lf_free(self._handle, pointer))
+
+    def push(self, dst, src):
+        """Copies all of the buffer `src` to the device address `dst`."""
+        with _Buffer(src, writable=False) as (buf, length):
+            offset = 0
+            while offset < length:
+                size = min(length - offset, _MAX_TRANSFER)
+                _check('push', _lib.lf_push(self._handle, dst + offset, buf + offset, size))
+                offset += size
+
+    def pull(self, dst, src, length=None):
+        """Fills the writable buffer `dst` from the device address `src`.
+
+        Only the first `length` bytes of `dst` are filled if it's given.
+        Returns the number of bytes pulled.
+        """
+        with _Buffer(dst, writable=True) as (buf, available):
+            length = available if length is None else length
+            if length > available:
+                raise ValueError('cannot pull {} bytes into a buffer of {}'.format(length, available))
+            offset = 0
+            while offset < length:
+                size = min(length - offset, _MAX_TRANSFER)
+                _check('pull', _lib.lf_pull(self._handle, buf + offset, src + offset, size))
+                offset += size
+        return length
+
+    def stream(self, src, length, chunk=64 * 1024, into=None):
+        """Pulls `length` bytes from the device address `src`, `chunk` bytes at a time.
+
+        Yields a memoryview of each chunk. The views share one buffer, `into` if
+        given, so each must be consumed or copied before the next is requested.
+        """
+        buffer = into if into is not None else bytearray(min(chunk, length))
+        view = memoryview(buffer).cast('B')
+        chunk = min(chunk, len(view))
+        if chunk == 0 and length:
+            raise ValueError('cannot stream into an empty buffer')
+        offset = 0
+        while offset < length:
+            size = min(chunk, length - offset)
+            self.pull(view, src + offset, size)
+            yield view[:size]
+            offset += size
+
+
+def attach(hostname=None):
+    """Attaches to a Carbon device over USB, or over the network if `hostname` is given."""
+    if hostname is None:
+        handle = _lib.carbon_attach()
+    else:
+        handle = _lib.carbon_attach_hostname(hostname.encode())
+    if not handle:
+        raise FlipperError('attach')
+    return Device(handle)
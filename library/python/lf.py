@@ -1,3 +0,0 @@
-from .lf import *
-from .led import *
-from .gpio import *
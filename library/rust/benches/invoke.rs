@@ -0,0 +1,64 @@
+//! Measures the host-side cost of a remote call by invoking against a transport that
+//! answers every packet immediately with a successful result.
+
+#[macro_use]
+extern crate criterion;
+extern crate flipper;
+
+use std::io::{self, Read, Write};
+use criterion::{Benchmark, Criterion, Throughput};
+use flipper::{Args, Client, LfType, Modules};
+
+/// A transport that swallows every write and answers every read with zeroes, which
+/// decodes as a successful `FmrReturn` with a value of 0.
+struct MockClient {
+    modules: Modules,
+}
+
+impl Read for MockClient {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        for byte in buf.iter_mut() { *byte = 0; }
+        Ok(buf.len())
+    }
+}
+
+impl Write for MockClient {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
+    }
+}
+
+impl Client for MockClient {
+    fn modules(&mut self) -> &mut Modules { &mut self.modules }
+
+    fn reader(&mut self) -> &mut Read { self }
+
+    fn writer(&mut self) -> &mut Write { self }
+}
+
+fn invoke(c: &mut Criterion) {
+    c.bench("invoke", Benchmark::new("led_rgb", |b| {
+        let mut client = MockClient { modules: Modules::new() };
+        b.iter(|| {
+            let mut args = Args::new();
+            args.append(10u8).append(20u8).append(30u8);
+            client.invoke("led", 0, LfType::lf_void, &args).unwrap()
+        })
+    }).throughput(Throughput::Elements(1)));
+
+    c.bench("invoke", Benchmark::new("eight_u32_args", |b| {
+        let mut client = MockClient { modules: Modules::new() };
+        b.iter(|| {
+            let mut args = Args::new();
+            for i in 0..8u32 { args.append(i); }
+            client.invoke("gpio", 1, LfType::lf_uint32, &args).unwrap()
+        })
+    }).throughput(Throughput::Elements(1)));
+}
+
+criterion_group!(benches, invoke);
+criterion_main!(benches);
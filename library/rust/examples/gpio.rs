@@ -1,22 +1,20 @@
-#[macro_use]
-extern crate flipper;
-
 use libusb::Context;
-use flipper::Flipper;
+use flipper::{Flipper, flipper_module};
 
-flipper_module!(gpio::Gpio: [
-    3 => fn gpio_configure() -> LfType::lf_void,
-    2 => fn gpio_enable(enabled: u32, disabled: u32) -> LfType::lf_void,
-    1 => fn gpio_write(high: u32, low: u32) -> LfType::lf_void,
-    0 => fn gpio_read(pins: u32) -> LfType::lf_uint32,
-]);
+/// Functions are declared in the same order as `gpio_interface` on the device.
+#[flipper_module("gpio")]
+pub trait Gpio {
+    fn gpio_read(&mut self, pins: u32) -> u32;
+    fn gpio_write(&mut self, high: u32, low: u32);
+    fn gpio_enable(&mut self, enabled: u32, disabled: u32);
+    fn gpio_configure(&mut self);
+}
 
 fn main() {
-    use gpio::Gpio;
-
     let mut context = Context::new().expect("should get usb context");
     let mut flippers = Flipper::attach_usb(&mut context);
     let flipper = flippers.first_mut().expect("should find one Flipper");
 
-    let _ = flipper.gpio_write(1 << 22, 0);
-}
\ No newline at end of file
+    let mut gpio = GpioModule::bind(flipper).expect("should load the gpio module");
+    let _ = gpio.gpio_write(1 << 22, 0);
+}
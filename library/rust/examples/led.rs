@@ -1,19 +1,16 @@
-#[macro_use]
-extern crate flipper;
-
 use libusb::Context;
-use flipper::Flipper;
+use flipper::{Flipper, flipper_module};
 
-flipper_module!(led::Led: [
-    0 => fn led_rgb(red: u8, green: u8, blue: u8) -> LfType::lf_void,
-]);
+#[flipper_module("led")]
+pub trait Led {
+    fn led_rgb(&mut self, red: u8, green: u8, blue: u8);
+}
 
 fn main() {
-    use led::Led;
-
     let mut context = Context::new().expect("should get usb context");
     let mut flippers = Flipper::attach_usb(&mut context);
     let flipper = flippers.first_mut().expect("should find one flipper");
 
-    let _ = flipper.led_rgb(10, 05, 10);
-}
\ No newline at end of file
+    let mut led = LedModule::bind(flipper).expect("should load the led module");
+    let _ = led.led_rgb(10, 05, 10);
+}
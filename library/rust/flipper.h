@@ -2,6 +2,12 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+/*
+ * The most calls `lf_invoke_batch` keeps in flight to a device at once. This is the
+ * runtime's `BATCH_WINDOW`, and matches `LF_BATCH_MAX` in libflipper.
+ */
+#define LF_BATCH_MAX 16
+
 enum LfResult {
   lf_success = 0,
   lf_null_pointer = 1,
@@ -34,6 +40,32 @@ typedef uint64_t LfValue;
 
 typedef uint8_t LfFunction;
 
+typedef uint32_t LfTypes;
+
+/*
+ * Describes a single remote call for `lf_invoke_batch` and `lf_submit`.
+ *
+ * Arguments are given the way they travel on the wire: `argt` holds the type of argument
+ * `i` in bits `4 * i` through `4 * i + 3`, and `argv` points to `argc` values, each cast
+ * to `LfValue`. `argv` may be NULL when `argc` is 0.
+ */
+typedef struct {
+  const char *module;
+  LfFunction function;
+  LfType return_type;
+  uint8_t argc;
+  LfTypes argt;
+  const LfValue *argv;
+} LfCall;
+
+/*
+ * The outcome of one call made with `lf_invoke_batch` or `lf_submit`.
+ */
+typedef struct {
+  LfValue value;
+  LfResult result;
+} LfCallResult;
+
 /*
  * Appends a new argument (value and type) onto an existing argument list.
  *
@@ -168,6 +200,46 @@ LfResult lf_invoke(void *device,
                    LfType return_type,
                    LfValue *return_value);
 
+/*
+ * Executes `count` remote calls on the given device as a single batch, storing the outcome
+ * of `calls[i]` in `results[i]`.
+ *
+ * A batch costs one trip across the FFI boundary. Up to `LF_BATCH_MAX` calls are in flight
+ * to the device at once, so a batch no larger than that costs one round trip to the device
+ * where the transport allows it, and a larger one keeps the device busy without overrunning
+ * it.
+ *
+ * Returns `lf_success` if every call was sent and answered. Calls that could not be encoded,
+ * or that failed on the device, have their own `result` set and don't affect the others.
+ * If the transport fails, every result is `lf_invocation_error`.
+ */
+LfResult lf_invoke_batch(void *device, const LfCall *calls, uint32_t count, LfCallResult *results);
+
+/*
+ * Queues a remote call on the given device without waiting for it, returning a ticket that
+ * identifies it in `ticket`.
+ *
+ * Submitted calls are held until the device is flushed, either explicitly with `lf_flush`
+ * or by polling for one of them with `lf_poll`. Every call queued at that point is then
+ * sent as a single batch, so a host can submit many calls and pay for one round trip.
+ */
+LfResult lf_submit(void *device, const LfCall *call, uint64_t *ticket);
+
+/*
+ * Sends every call submitted to the given device with `lf_submit` and collects their
+ * results, which can then be retrieved with `lf_poll`.
+ */
+LfResult lf_flush(void *device);
+
+/*
+ * Retrieves the outcome of a call submitted with `lf_submit`, flushing the device first if
+ * the call hasn't been sent yet.
+ *
+ * Each result can be retrieved once. Polling for a ticket that was never issued, or that has
+ * already been retrieved, returns `lf_index_out_of_bounds`.
+ */
+LfResult lf_poll(void *device, uint64_t ticket, LfCallResult *result);
+
 LfResult lf_release(void *argv);
 
 /*
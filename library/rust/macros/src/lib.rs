@@ -0,0 +1,216 @@
+//! Procedural macros for the `flipper` crate.
+
+extern crate proc_macro;
+
+use proc_macro::TokenStream;
+use proc_macro2::{Span, TokenStream as TokenStream2};
+use quote::quote;
+use syn::{
+    parse_macro_input,
+    spanned::Spanned,
+    AttributeArgs,
+    FnArg,
+    Ident,
+    ItemTrait,
+    Lit,
+    NestedMeta,
+    Pat,
+    ReturnType,
+    TraitItem,
+    TraitItemMethod,
+    Type,
+};
+
+/// The number of argument types that fit in a call's `argt` word.
+const FMR_MAX_ARGC: usize = 8;
+
+/// Generates typed bindings for a Flipper module from a trait describing its interface.
+///
+/// Each method of the trait describes one function of the module, in the same order as the
+/// module's interface table on the device: the first method is function 0, the second is
+/// function 1, and so on. Every method must take `&mut self`, and its arguments and return
+/// type must implement `LfArgType` and `LfReturnable` respectively.
+///
+/// ```rust-norun
+/// #[flipper_module("led")]
+/// pub trait Led {
+///     fn led_rgb(&mut self, red: u8, green: u8, blue: u8);
+///     fn led_configure(&mut self) -> u32;
+/// }
+/// ```
+///
+/// The trait is emitted with each method returning a `flipper::Result`, along with a
+/// `LedModule` struct that implements it. `LedModule::bind(&mut client)` resolves the module
+/// once; every call after that packs its arguments straight into a packet using a function
+/// index, `argt` word and argument layout that were all computed at compile time.
+///
+/// ```rust-norun
+/// let mut led = LedModule::bind(&mut flipper)?;
+/// led.led_rgb(10, 0, 10)?;
+/// ```
+#[proc_macro_attribute]
+pub fn flipper_module(attr: TokenStream, item: TokenStream) -> TokenStream {
+    let args = parse_macro_input!(attr as AttributeArgs);
+    let item = parse_macro_input!(item as ItemTrait);
+
+    match expand(args, item) {
+        Ok(tokens) => tokens.into(),
+        Err(error) => error.to_compile_error().into(),
+    }
+}
+
+fn expand(args: AttributeArgs, item: ItemTrait) -> syn::Result<TokenStream2> {
+    let module = match args.as_slice() {
+        [NestedMeta::Lit(Lit::Str(name))] => name.clone(),
+        _ => return Err(syn::Error::new(
+            Span::call_site(),
+            "expected the module name, as in #[flipper_module(\"led\")]",
+        )),
+    };
+
+    let vis = &item.vis;
+    let attrs = &item.attrs;
+    let name = &item.ident;
+    let bound = Ident::new(&format!("{}Module", name), name.span());
+
+    let mut signatures = Vec::new();
+    let mut methods = Vec::new();
+    let mut function = 0usize;
+    for trait_item in &item.items {
+        match trait_item {
+            TraitItem::Method(method) => {
+                if function > u8::max_value() as usize {
+                    return Err(syn::Error::new(method.span(), "a module can have at most 256 functions"));
+                }
+                let (signature, body) = expand_method(method, function as u8)?;
+                signatures.push(signature);
+                methods.push(body);
+                function += 1;
+            }
+            other => return Err(syn::Error::new(other.span(), "module traits may only contain methods")),
+        }
+    }
+
+    let bound_doc = format!("The `{}` module, resolved on a particular client.", module.value());
+
+    Ok(quote! {
+        #(#attrs)*
+        #vis trait #name {
+            #(#signatures)*
+        }
+
+        #[doc = #bound_doc]
+        #vis struct #bound<'a, C: ::flipper::Client + ?Sized + 'a> {
+            client: &'a mut C,
+            module: ::flipper::ModuleHandle,
+        }
+
+        impl<'a, C: ::flipper::Client + ?Sized + 'a> #bound<'a, C> {
+            /// Resolves the module on `client`. Calls made through the returned value skip
+            /// any module lookup.
+            pub fn bind(client: &'a mut C) -> ::flipper::Result<Self> {
+                let module = client.resolve(#module)?;
+                Ok(#bound { client, module })
+            }
+        }
+
+        impl<'a, C: ::flipper::Client + ?Sized + 'a> #name for #bound<'a, C> {
+            #(#methods)*
+        }
+    })
+}
+
+/// Returns the trait signature and the implementation of a single module function.
+fn expand_method(method: &TraitItemMethod, function: u8) -> syn::Result<(TokenStream2, TokenStream2)> {
+    let sig = &method.sig;
+    let attrs = &method.attrs;
+    let ident = &sig.ident;
+
+    if method.default.is_some() {
+        return Err(syn::Error::new(method.span(), "module functions can't have a default body"));
+    }
+    if !sig.generics.params.is_empty() || sig.asyncness.is_some() || sig.variadic.is_some() {
+        return Err(syn::Error::new(sig.span(), "module functions must be plain, non-generic functions"));
+    }
+
+    let mut inputs = sig.inputs.iter();
+    match inputs.next() {
+        Some(FnArg::Receiver(receiver)) if receiver.reference.is_some() && receiver.mutability.is_some() => (),
+        _ => return Err(syn::Error::new(sig.span(), "module functions must take `&mut self`")),
+    }
+
+    let mut names = Vec::new();
+    let mut types: Vec<Type> = Vec::new();
+    for input in inputs {
+        match input {
+            FnArg::Typed(typed) => match &*typed.pat {
+                Pat::Ident(pat) => {
+                    names.push(pat.ident.clone());
+                    types.push((*typed.ty).clone());
+                }
+                pat => return Err(syn::Error::new(pat.span(), "arguments must be plain identifiers")),
+            },
+            other => return Err(syn::Error::new(other.span(), "unexpected receiver")),
+        }
+    }
+
+    if types.len() > FMR_MAX_ARGC {
+        return Err(syn::Error::new(
+            sig.inputs.span(),
+            format!("module functions can take at most {} arguments", FMR_MAX_ARGC),
+        ));
+    }
+
+    let ret: Type = match &sig.output {
+        ReturnType::Default => syn::parse_quote!(()),
+        ReturnType::Type(_, ty) => (**ty).clone(),
+    };
+
+    let argc = types.len() as u8;
+    let shifts: Vec<u32> = (0..types.len() as u32).map(|i| i * 4).collect();
+
+    // The offset of each argument within the packet's argument list, and the end of the list
+    let offsets: Vec<TokenStream2> = (0..types.len()).map(|i| {
+        let before = &types[..i];
+        quote!(0 #(+ <#before as ::flipper::LfArgType>::SIZE)*)
+    }).collect();
+    let argv_len = quote!(0 #(+ <#types as ::flipper::LfArgType>::SIZE)*);
+
+    let signature = quote! {
+        #(#attrs)*
+        fn #ident(&mut self #(, #names: #types)*) -> ::flipper::Result<#ret>;
+    };
+
+    let body = quote! {
+        fn #ident(&mut self #(, #names: #types)*) -> ::flipper::Result<#ret> {
+            use ::flipper::__private as fmr;
+
+            const FUNCTION: u8 = #function;
+            const ARGC: u8 = #argc;
+            const ARGT: fmr::LfTypes = 0 #(| ((<#types as ::flipper::LfArgType>::KIND as fmr::LfTypes) << #shifts))*;
+            const ARGV_LEN: usize = #argv_len;
+
+            // Fails to compile if the arguments can't fit in a single packet
+            let _: [(); 0] = [(); (ARGV_LEN > fmr::FMR_MAX_ARGV) as usize];
+
+            let mut packet = fmr::call_packet(
+                FUNCTION,
+                <#ret as ::flipper::LfReturnable>::lf_type(),
+                ARGT,
+                ARGC,
+                ARGV_LEN,
+            );
+            {
+                let argv = fmr::argv(&mut packet);
+                #(
+                    ::flipper::LfArgType::pack(#names, &mut argv[(#offsets)..]);
+                )*
+            }
+
+            let value = self.client.invoke_packet(self.module, &mut packet)?;
+            Ok(fmr::returned::<#ret>(value))
+        }
+    };
+
+    Ok((signature, body))
+}
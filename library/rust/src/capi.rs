@@ -2,8 +2,9 @@ use std::mem;
 use std::ptr;
 use std::ffi::CStr;
 use std::os::raw::{c_void, c_char};
+use std::collections::HashMap;
 
-use crate::runtime::{Client, Args};
+use crate::runtime::{Client, Args, ModuleHandle, create_call};
 use crate::runtime::protocol::*;
 use crate::device::Flipper;
 
@@ -12,6 +13,7 @@ use libusb::Context;
 use std::pin::Pin;
 
 #[repr(u32)]
+#[derive(Debug, Copy, Clone, PartialEq)]
 pub enum LfResult {
     lf_success = 0,
     lf_null_pointer = 1,
@@ -50,8 +52,48 @@ impl<'a> UsbDevices<'a> {
     }
 }
 
+/// A selected device, along with the calls submitted to it with `lf_submit` that haven't
+/// been collected yet.
+struct Device<'a> {
+    client: &'a mut Client,
+    next_ticket: u64,
+    submitted: Vec<(u64, ModuleHandle, FmrPacket)>,
+    completed: HashMap<u64, LfCallResult>,
+}
+
+impl<'a> Device<'a> {
+    fn new(client: &'a mut Client) -> Device<'a> {
+        Device { client, next_ticket: 0, submitted: vec![], completed: HashMap::new() }
+    }
+
+    /// Sends every submitted call as one batch and stores the results by ticket.
+    fn flush(&mut self) -> LfResult {
+        if self.submitted.is_empty() { return LfResult::lf_success; }
+
+        let (tickets, mut calls): (Vec<u64>, Vec<(ModuleHandle, FmrPacket)>) = self.submitted
+            .drain(..)
+            .map(|(ticket, module, packet)| (ticket, (module, packet)))
+            .unzip();
+        let mut results = vec![FmrReturn::new(); calls.len()];
+
+        let status = self.client.invoke_batch(&mut calls, &mut results);
+        for (ticket, result) in tickets.into_iter().zip(results.iter()) {
+            let result = match status {
+                Ok(()) => LfCallResult::from(*result),
+                Err(_) => LfCallResult::error(LfResult::lf_invocation_error),
+            };
+            self.completed.insert(ticket, result);
+        }
+
+        match status {
+            Ok(()) => LfResult::lf_success,
+            Err(_) => LfResult::lf_invocation_error,
+        }
+    }
+}
+
 enum FFIContainer<'a> {
-    Flipper(&'a mut Client),
+    Flipper(Device<'a>),
     UsbDevices(Pin<Box<UsbDevices<'a>>>),
     ArgsList(Args),
 }
@@ -110,7 +152,7 @@ pub extern "C" fn lf_select(devices: *mut c_void, index: u32, device: *mut *mut
             };
 
             let ffi_pointer: *mut c_void = client
-                .map(|client| FFIContainer::Flipper(client))
+                .map(|client| FFIContainer::Flipper(Device::new(client)))
                 .map(|ffi_container| Box::new(ffi_container))
                 .map(|boxed| Box::into_raw(boxed) as *mut c_void)
                 .unwrap_or(ptr::null_mut());
@@ -259,7 +301,7 @@ pub extern "C" fn lf_invoke(
     // Reconstruct the device trait object from the raw pointer given
     let mut ffi_device_container: Box<FFIContainer> = unsafe { Box::from_raw(device as *mut _) };
     let device = match *ffi_device_container {
-        FFIContainer::Flipper(ref mut client) => client,
+        FFIContainer::Flipper(ref mut device) => &mut device.client,
         _ => return LfResult::lf_illegal_handle,
     };
 
@@ -302,6 +344,223 @@ pub extern "C" fn lf_invoke(
     LfResult::lf_success
 }
 
+/// Describes a single remote call for `lf_invoke_batch` and `lf_submit`.
+///
+/// Arguments are given the way they travel on the wire: `argt` holds the type of argument
+/// `i` in bits `4 * i` through `4 * i + 3`, and `argv` points to `argc` values, each cast
+/// to `LfValue`. `argv` may be NULL when `argc` is 0.
+#[repr(C)]
+pub struct LfCall {
+    pub module: *const c_char,
+    pub function: LfFunction,
+    pub return_type: LfType,
+    pub argc: u8,
+    pub argt: LfTypes,
+    pub argv: *const LfValue,
+}
+
+/// The outcome of one call made with `lf_invoke_batch` or `lf_submit`.
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub struct LfCallResult {
+    pub value: LfValue,
+    pub result: LfResult,
+}
+
+impl LfCallResult {
+    fn error(result: LfResult) -> LfCallResult {
+        LfCallResult { value: 0, result }
+    }
+}
+
+impl From<FmrReturn> for LfCallResult {
+    fn from(ret: FmrReturn) -> LfCallResult {
+        match ret.error {
+            0 => LfCallResult { value: ret.value, result: LfResult::lf_success },
+            _ => LfCallResult::error(LfResult::lf_invocation_error),
+        }
+    }
+}
+
+/// Resolves the module named by `call` and encodes the call into a packet.
+fn encode_call(client: &mut Client, call: &LfCall) -> Result<(ModuleHandle, FmrPacket), LfResult> {
+    if call.module == ptr::null() { return Err(LfResult::lf_null_pointer); }
+    if call.argc as usize > FMR_MAX_ARGC { return Err(LfResult::lf_index_out_of_bounds); }
+    if call.argc > 0 && call.argv == ptr::null() { return Err(LfResult::lf_null_pointer); }
+
+    let module_cstr = unsafe { CStr::from_ptr(call.module) };
+    let module_string = module_cstr.to_str().map_err(|_| LfResult::lf_invalid_string)?;
+    let module = client.resolve(module_string).map_err(|_| LfResult::lf_package_not_loaded)?;
+
+    let mut args = Args::new();
+    for i in 0..call.argc as usize {
+        let kind = LfType::from(((call.argt >> (i * 4)) as u8) & LfType::MAX)
+            .ok_or(LfResult::lf_illegal_type)?;
+        let value = unsafe { *call.argv.add(i) };
+        args.append_value(kind, value);
+    }
+
+    let mut packet = FmrPacket::new(FmrClass::call);
+    create_call(&mut packet, module.index(), call.function, call.return_type, &args)
+        .ok_or(LfResult::lf_invocation_error)?;
+    Ok((module, packet))
+}
+
+/// The most calls `lf_invoke_batch` keeps in flight to a device at once. This is the
+/// runtime's `BATCH_WINDOW`, and matches `LF_BATCH_MAX` in libflipper.
+pub const LF_BATCH_MAX: u32 = 16;
+
+/// Executes `count` remote calls on the given device as a single batch, storing the outcome
+/// of `calls[i]` in `results[i]`.
+///
+/// A batch costs one trip across the FFI boundary. Up to `LF_BATCH_MAX` calls are in flight
+/// to the device at once, so a batch no larger than that costs one round trip to the device
+/// where the transport allows it, and a larger one keeps the device busy without overrunning
+/// it.
+///
+/// ```c
+/// LfValue rgb[] = { 10, 20, 30 };
+/// LfCall calls[] = {
+///     { "led", 0, lf_void, 3, lf_uint8 | lf_uint8 << 4 | lf_uint8 << 8, rgb },
+///     { "gpio", 0, lf_uint32, 1, lf_uint32, &pins },
+/// };
+/// LfCallResult results[2];
+/// lf_invoke_batch(flipper, calls, 2, results);
+/// ```
+///
+/// Returns `lf_success` if every call was sent and answered. Calls that could not be encoded,
+/// or that failed on the device, have their own `result` set and don't affect the others.
+/// If the transport fails, every result is `lf_invocation_error`.
+#[no_mangle]
+pub extern "C" fn lf_invoke_batch(
+    device: *mut c_void,
+    calls: *const LfCall,
+    count: u32,
+    results: *mut LfCallResult,
+) -> LfResult {
+    if device == ptr::null_mut() { return LfResult::lf_null_pointer; }
+    if count == 0 { return LfResult::lf_success; }
+    if calls == ptr::null() || results == ptr::null_mut() { return LfResult::lf_null_pointer; }
+
+    let calls = unsafe { std::slice::from_raw_parts(calls, count as usize) };
+    let results = unsafe { std::slice::from_raw_parts_mut(results, count as usize) };
+
+    let mut ffi_device_container: Box<FFIContainer> = unsafe { Box::from_raw(device as *mut _) };
+    let status = match *ffi_device_container {
+        FFIContainer::Flipper(ref mut device) => {
+            // Encode every call up front, remembering where each packet's result belongs
+            let mut indices = Vec::with_capacity(calls.len());
+            let mut packets = Vec::with_capacity(calls.len());
+            for (i, call) in calls.iter().enumerate() {
+                match encode_call(device.client, call) {
+                    Ok(packet) => {
+                        indices.push(i);
+                        packets.push(packet);
+                    }
+                    Err(result) => results[i] = LfCallResult::error(result),
+                }
+            }
+
+            let mut replies = vec![FmrReturn::new(); packets.len()];
+            let status = device.client.invoke_batch(&mut packets, &mut replies);
+            for (&i, reply) in indices.iter().zip(replies.iter()) {
+                results[i] = match status {
+                    Ok(()) => LfCallResult::from(*reply),
+                    Err(_) => LfCallResult::error(LfResult::lf_invocation_error),
+                };
+            }
+
+            match status {
+                Ok(()) => LfResult::lf_success,
+                Err(_) => LfResult::lf_invocation_error,
+            }
+        }
+        _ => LfResult::lf_illegal_handle,
+    };
+
+    mem::forget(ffi_device_container);
+    status
+}
+
+/// Queues a remote call on the given device without waiting for it, returning a ticket that
+/// identifies it in `ticket`.
+///
+/// Submitted calls are held until the device is flushed, either explicitly with `lf_flush`
+/// or by polling for one of them with `lf_poll`. Every call queued at that point is then
+/// sent as a single batch, so a host can submit many calls and pay for one round trip.
+#[no_mangle]
+pub extern "C" fn lf_submit(device: *mut c_void, call: *const LfCall, ticket: *mut u64) -> LfResult {
+    if device == ptr::null_mut() { return LfResult::lf_null_pointer; }
+    if call == ptr::null() || ticket == ptr::null_mut() { return LfResult::lf_null_pointer; }
+
+    let mut ffi_device_container: Box<FFIContainer> = unsafe { Box::from_raw(device as *mut _) };
+    let status = match *ffi_device_container {
+        FFIContainer::Flipper(ref mut device) => {
+            match encode_call(device.client, unsafe { &*call }) {
+                Ok((module, packet)) => {
+                    let id = device.next_ticket;
+                    device.next_ticket += 1;
+                    device.submitted.push((id, module, packet));
+                    unsafe { *ticket = id; }
+                    LfResult::lf_success
+                }
+                Err(result) => result,
+            }
+        }
+        _ => LfResult::lf_illegal_handle,
+    };
+
+    mem::forget(ffi_device_container);
+    status
+}
+
+/// Sends every call submitted to the given device with `lf_submit` and collects their
+/// results, which can then be retrieved with `lf_poll`.
+#[no_mangle]
+pub extern "C" fn lf_flush(device: *mut c_void) -> LfResult {
+    if device == ptr::null_mut() { return LfResult::lf_null_pointer; }
+
+    let mut ffi_device_container: Box<FFIContainer> = unsafe { Box::from_raw(device as *mut _) };
+    let status = match *ffi_device_container {
+        FFIContainer::Flipper(ref mut device) => device.flush(),
+        _ => LfResult::lf_illegal_handle,
+    };
+
+    mem::forget(ffi_device_container);
+    status
+}
+
+/// Retrieves the outcome of a call submitted with `lf_submit`, flushing the device first if
+/// the call hasn't been sent yet.
+///
+/// Each result can be retrieved once. Polling for a ticket that was never issued, or that has
+/// already been retrieved, returns `lf_index_out_of_bounds`.
+#[no_mangle]
+pub extern "C" fn lf_poll(device: *mut c_void, ticket: u64, result: *mut LfCallResult) -> LfResult {
+    if device == ptr::null_mut() { return LfResult::lf_null_pointer; }
+    if result == ptr::null_mut() { return LfResult::lf_null_pointer; }
+
+    let mut ffi_device_container: Box<FFIContainer> = unsafe { Box::from_raw(device as *mut _) };
+    let status = match *ffi_device_container {
+        FFIContainer::Flipper(ref mut device) => {
+            if device.submitted.iter().any(|(id, _, _)| *id == ticket) {
+                device.flush();
+            }
+            match device.completed.remove(&ticket) {
+                Some(completed) => {
+                    unsafe { *result = completed; }
+                    LfResult::lf_success
+                }
+                None => LfResult::lf_index_out_of_bounds,
+            }
+        }
+        _ => LfResult::lf_illegal_handle,
+    };
+
+    mem::forget(ffi_device_container);
+    status
+}
+
 #[no_mangle]
 pub extern "C" fn lf_release(argv: *mut c_void) -> LfResult {
     if argv == ptr::null_mut() { return LfResult::lf_null_pointer; }
@@ -309,3 +568,129 @@ pub extern "C" fn lf_release(argv: *mut c_void) -> LfResult {
     drop(boxed);
     LfResult::lf_success
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::{self, Read, Write};
+    use crate::runtime::{Module, Modules, BATCH_WINDOW};
+
+    /// Answers every packet written to it with a result holding the packet's function index.
+    struct MockClient {
+        modules: Modules,
+        replies: Vec<u8>,
+        writes: usize,
+        /// The most packets that were written but not yet answered.
+        max_pending: usize,
+    }
+
+    impl Write for MockClient {
+        fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+            let packet = unsafe { &*(buf.as_ptr() as *const FmrPacket) };
+            let mut reply = FmrReturn::new();
+            reply.value = unsafe { packet.body.call.function } as LfValue;
+            self.replies.extend_from_slice(unsafe { reply.as_bytes_mut() });
+            self.writes += 1;
+            self.max_pending = self.max_pending.max(self.replies.len() / mem::size_of::<FmrReturn>());
+            Ok(buf.len())
+        }
+        fn flush(&mut self) -> io::Result<()> { Ok(()) }
+    }
+
+    impl Read for MockClient {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            let len = buf.len().min(self.replies.len());
+            buf[..len].copy_from_slice(&self.replies[..len]);
+            self.replies.drain(..len);
+            Ok(len)
+        }
+    }
+
+    impl Client for MockClient {
+        fn modules(&mut self) -> &mut Modules { &mut self.modules }
+        fn reader(&mut self) -> &mut Read { self }
+        fn writer(&mut self) -> &mut Write { self }
+    }
+
+    fn mock_client() -> MockClient {
+        let mut modules = Modules::new();
+        modules.register(Module::new("led".to_string(), 1, 0));
+        MockClient { modules, replies: vec![], writes: 0, max_pending: 0 }
+    }
+
+    fn call(function: LfFunction, argv: &[LfValue]) -> LfCall {
+        LfCall {
+            module: b"led\0".as_ptr() as *const c_char,
+            function,
+            return_type: LfType::lf_uint32,
+            argc: argv.len() as u8,
+            argt: 0x333,
+            argv: argv.as_ptr(),
+        }
+    }
+
+    #[test]
+    fn test_invoke_batch() {
+        let mut client = mock_client();
+        let device = Box::into_raw(Box::new(FFIContainer::Flipper(Device::new(&mut client)))) as *mut c_void;
+
+        let argv = [1, 2, 3];
+        let mut bad = call(3, &argv);
+        bad.argt = 0xFFF5;
+        let calls = [call(0, &argv), bad, call(2, &argv)];
+        let mut results = [LfCallResult::error(LfResult::lf_null_pointer); 3];
+
+        assert_eq!(lf_invoke_batch(device, calls.as_ptr(), 3, results.as_mut_ptr()), LfResult::lf_success);
+        assert_eq!(results[0].result, LfResult::lf_success);
+        assert_eq!(results[0].value, 0);
+        assert_eq!(results[1].result, LfResult::lf_illegal_type);
+        assert_eq!(results[2].result, LfResult::lf_success);
+        assert_eq!(results[2].value, 2);
+
+        lf_release(device);
+        assert_eq!(client.writes, 2);
+    }
+
+    #[test]
+    fn test_invoke_batch_window() {
+        let mut client = mock_client();
+        let device = Box::into_raw(Box::new(FFIContainer::Flipper(Device::new(&mut client)))) as *mut c_void;
+
+        let argv = [1, 2, 3];
+        let calls: Vec<LfCall> = (0..40).map(|function| call(function, &argv)).collect();
+        let mut results = vec![LfCallResult::error(LfResult::lf_null_pointer); calls.len()];
+
+        assert_eq!(lf_invoke_batch(device, calls.as_ptr(), 40, results.as_mut_ptr()), LfResult::lf_success);
+        for (function, result) in results.iter().enumerate() {
+            assert_eq!(result.value, function as LfValue);
+        }
+
+        lf_release(device);
+        assert_eq!(client.writes, 40);
+        assert_eq!(client.max_pending, BATCH_WINDOW);
+        assert_eq!(LF_BATCH_MAX as usize, BATCH_WINDOW);
+    }
+
+    #[test]
+    fn test_submit_poll() {
+        let mut client = mock_client();
+        let device = Box::into_raw(Box::new(FFIContainer::Flipper(Device::new(&mut client)))) as *mut c_void;
+
+        let argv = [1, 2, 3];
+        let mut tickets = [0u64; 4];
+        for (function, ticket) in tickets.iter_mut().enumerate() {
+            let call = call(function as LfFunction, &argv);
+            assert_eq!(lf_submit(device, &call, ticket), LfResult::lf_success);
+        }
+
+        let mut result = LfCallResult::error(LfResult::lf_null_pointer);
+        for (function, ticket) in tickets.iter().enumerate().rev() {
+            assert_eq!(lf_poll(device, *ticket, &mut result), LfResult::lf_success);
+            assert_eq!(result.value, function as LfValue);
+        }
+        assert_eq!(lf_poll(device, tickets[0], &mut result), LfResult::lf_index_out_of_bounds);
+
+        lf_release(device);
+        assert_eq!(client.writes, 4);
+    }
+}
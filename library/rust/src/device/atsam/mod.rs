@@ -6,7 +6,7 @@ use crate::runtime::{
 
 pub mod uart0;
 
-use self::uart0::Uart0;
+use self::uart0::{Uart0, STAGING_SIZE};
 
 pub struct AtsamClient<'a, T: Client> {
     modules: Modules,
@@ -16,7 +16,7 @@ pub struct AtsamClient<'a, T: Client> {
 impl<'a, T: Client> Read for AtsamClient<'a, T> {
     fn read(&mut self, buf: &mut [u8]) -> Result<usize, io::Error> {
         let mut total_read = 0;
-        for chunk in buf.chunks_mut(128) {
+        for chunk in buf.chunks_mut(STAGING_SIZE) {
             let read = self.uart.read(chunk)?;
             total_read += read;
         }
@@ -27,7 +27,7 @@ impl<'a, T: Client> Read for AtsamClient<'a, T> {
 impl<'a, T: Client> Write for AtsamClient<'a, T> {
     fn write(&mut self, buf: &[u8]) -> Result<usize, io::Error> {
         let mut total_sent = 0;
-        for chunk in buf.chunks(128) {
+        for chunk in buf.chunks(STAGING_SIZE) {
             let sent = self.uart.write(chunk)?;
             total_sent += sent;
         }
@@ -1,9 +1,21 @@
 #![allow(unused)]
 
 use std::io::{self as io, Read, Write};
-use crate::error::Result;
-use crate::runtime::{Client, Args};
-use crate::runtime::protocol::LfType;
+use crate::error::{Result, FlipperError};
+use crate::runtime::{Client, Args, create_call};
+use crate::runtime::protocol::{FmrClass, FmrPacket, LfPointer, LfType};
+
+/// The size of the staging buffer kept on the AtmegaU2 for moving data to and from the 4S.
+pub const STAGING_SIZE: usize = 128;
+
+/// Function indices of the AtmegaU2's uart0 module, as laid out in `api/c/uart0.c`.
+mod functions {
+    pub const READ: u8 = 0;
+    pub const WRITE: u8 = 1;
+    pub const READY: u8 = 4;
+    pub const SETBAUD: u8 = 6;
+    pub const CONFIGURE: u8 = 7;
+}
 
 pub enum UartBaud {
     FMR,
@@ -11,51 +23,135 @@ pub enum UartBaud {
 }
 
 impl UartBaud {
-    fn to_baud(&self) -> u8 {
+    fn to_baud(&self) -> u32 {
         match *self {
-            UartBaud::FMR => 0x00,
-            UartBaud::DFU => 0x08,
+            UartBaud::FMR => 1000000,
+            UartBaud::DFU => 115200,
         }
     }
 }
 
 pub struct Uart0<'a, T: Client> {
     device: &'a mut T,
+    /// The index of the uart0 module on the AtmegaU2, once it has been loaded.
+    module: Option<u32>,
+    /// A buffer in the AtmegaU2's memory that every read and write is staged through. It is
+    /// allocated on first use and lives as long as this driver.
+    staging: Option<LfPointer>,
 }
 
 impl<'a, T: Client> Uart0<'a, T> {
     pub fn new(device: &'a mut T) -> Self {
-        Uart0 { device }
+        Uart0 { device, module: None, staging: None }
+    }
+
+    /// Configures the Uart0 module for FMR.
+    pub fn configure(&mut self) -> Result<()> {
+        self.device.invoke("uart0", functions::CONFIGURE, LfType::lf_void, &Args::new())?;
+        Ok(())
     }
 
-    /// Configures the Uart0 module with a given baud rate and
-    /// interrupts enabled flag.
-    pub fn configure(&mut self, baud: UartBaud, interrupts: bool) -> Result<()> {
+    /// Sets the baud rate of the Uart0 bus.
+    pub fn set_baud(&mut self, baud: UartBaud) -> Result<()> {
         let mut args = Args::new();
-        args.append(baud.to_baud())
-            .append(if interrupts { 1u8 } else { 0u8 });
-        self.device.invoke("uart0", 0, LfType::lf_void, &args)?;
+        args.append(baud.to_baud());
+        self.device.invoke("uart0", functions::SETBAUD, LfType::lf_void, &args)?;
         Ok(())
     }
 
     /// Indicates whether the Uart0 bus is ready to read or write.
     pub fn ready(&mut self) -> Result<bool> {
         let args = Args::new();
-        let ret: u8 = self.device.invoke("uart0", 1, LfType::lf_uint8, &args)? as u8;
+        let ret: u8 = self.device.invoke("uart0", functions::READY, LfType::lf_uint8, &args)? as u8;
         Ok(ret != 0)
     }
+
+    /// Returns the uart0 module index and the staging buffer, setting them up on first use.
+    fn prepare(&mut self) -> Result<(u32, LfPointer)> {
+        let module = match self.module {
+            Some(module) => module,
+            None => {
+                let module = self.device.load("uart0")? as u32;
+                self.module = Some(module);
+                module
+            }
+        };
+
+        let staging = match self.staging {
+            Some(staging) => staging,
+            None => {
+                let staging = self.device.malloc(STAGING_SIZE as u32)?;
+                self.staging = Some(staging);
+                staging
+            }
+        };
+
+        Ok((module, staging))
+    }
+
+    /// Sends a call to `function` in the uart0 module on the staging buffer, without waiting
+    /// for its result.
+    fn send_transfer(&mut self, module: u32, function: u8, staging: LfPointer, len: usize) -> Result<()> {
+        let mut args = Args::new();
+        args.append(staging)
+            .append(len as u32);
+
+        let mut packet = FmrPacket::new(FmrClass::call);
+        create_call(&mut packet, module, function, LfType::lf_void, &args)
+            .ok_or(FlipperError::Invoke)?;
+        self.device.send_packet(&mut packet, &[])
+    }
+
+    /// Sends a push or pull of `len` bytes on the staging buffer, without waiting for its result.
+    fn send_data(&mut self, class: FmrClass, staging: LfPointer, data: &[u8], len: usize) -> Result<()> {
+        let mut packet = FmrPacket::new(class);
+        unsafe {
+            packet.body.data.len = len as u32;
+            packet.body.data.ptr = staging.0 as u64;
+        }
+        self.device.send_packet(&mut packet, data)
+    }
+
+    /// Pushes `buf` into the staging buffer and writes it out of the uart. The push and the
+    /// call are sent back to back, so the whole write costs a single round trip.
+    fn write_chunk(&mut self, buf: &[u8]) -> Result<()> {
+        let (module, staging) = self.prepare()?;
+
+        self.send_data(FmrClass::push, staging, buf, buf.len())?;
+        self.send_transfer(module, functions::WRITE, staging, buf.len())?;
+
+        let push = self.device.receive_result()?;
+        let call = self.device.receive_result()?;
+        if push.error != 0 { Err(FlipperError::Push)?; }
+        if call.error != 0 { Err(FlipperError::Invoke)?; }
+        Ok(())
+    }
+
+    /// Reads from the uart into the staging buffer and pulls it into `buf`. The call and the
+    /// pull are sent back to back, so the whole read costs a single round trip.
+    fn read_chunk(&mut self, buf: &mut [u8]) -> Result<()> {
+        let (module, staging) = self.prepare()?;
+
+        self.send_transfer(module, functions::READ, staging, buf.len())?;
+        self.send_data(FmrClass::pull, staging, &[], buf.len())?;
+
+        // The device answers the call first, then sends the pulled data and its result
+        let call = self.device.receive_result()?;
+        self.device.reader().read(buf)
+            .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+        let pull = self.device.receive_result()?;
+        if call.error != 0 { Err(FlipperError::Invoke)?; }
+        if pull.error != 0 { Err(FlipperError::Pull)?; }
+        Ok(())
+    }
 }
 
 impl<'a, T: Client> Write for Uart0<'a, T> {
     fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
-        let device_buffer = self.device.malloc(buf.len() as u32).map_err(|_| io::ErrorKind::Other)?;
-        self.device.push(device_buffer, buf).map_err(|_| io::ErrorKind::Other)?;
-        let mut args = Args::new();
-        args.append(device_buffer)
-            .append(buf.len() as u32);
-        self.device.invoke("uart0", 2, LfType::lf_void, &args).map_err(|_| io::ErrorKind::Other)?;
-        self.device.free(device_buffer).map_err(|_| io::ErrorKind::Other)?;
-        Ok(buf.len())
+        if buf.len() == 0 { return Ok(0) }
+        let len = buf.len().min(STAGING_SIZE);
+        self.write_chunk(&buf[..len]).map_err(|_| io::ErrorKind::Other)?;
+        Ok(len)
     }
     fn flush(&mut self) -> io::Result<()> {
         Ok(())
@@ -65,12 +161,170 @@ impl<'a, T: Client> Write for Uart0<'a, T> {
 impl<'a, T: Client> Read for Uart0<'a, T> {
     fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
         if buf.len() == 0 { return Ok(0) }
-        let device_buffer = self.device.malloc(buf.len() as u32).map_err(|_| io::ErrorKind::Other)?;
-        let mut args = Args::new();
-        args.append(device_buffer)
-            .append(buf.len() as u32);
-        self.device.invoke("uart0", 3, LfType::lf_void, &args).map_err(|_| io::ErrorKind::Other)?;
-        self.device.free(device_buffer).map_err(|_| io::ErrorKind::Other)?;
-        Ok(buf.len())
+        let len = buf.len().min(STAGING_SIZE);
+        self.read_chunk(&mut buf[..len]).map_err(|_| io::ErrorKind::Other)?;
+        Ok(len)
+    }
+}
+
+impl<'a, T: Client> Drop for Uart0<'a, T> {
+    fn drop(&mut self) {
+        if let Some(staging) = self.staging.take() {
+            let _ = self.device.free(staging);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::collections::VecDeque;
+    use crate::runtime::Modules;
+    use crate::runtime::protocol::{FmrReturn, FMR_PACKET_SIZE};
+
+    /// An AtmegaU2 with a single uart0 module whose uart is looped back onto itself.
+    struct MockU2 {
+        modules: Modules,
+        memory: Vec<u8>,
+        uart: VecDeque<u8>,
+        incoming: Vec<u8>,
+        outgoing: VecDeque<u8>,
+        mallocs: usize,
+        round_trips: usize,
+        reading: bool,
+    }
+
+    impl MockU2 {
+        fn new() -> MockU2 {
+            MockU2 {
+                modules: Modules::new(),
+                memory: vec![0; 1024],
+                uart: VecDeque::new(),
+                incoming: Vec::new(),
+                outgoing: VecDeque::new(),
+                mallocs: 0,
+                round_trips: 0,
+                reading: false,
+            }
+        }
+
+        fn respond(&mut self, value: u64) {
+            let mut result = FmrReturn::new();
+            result.value = value;
+            self.outgoing.extend(unsafe { result.as_bytes_mut() }.iter());
+        }
+
+        /// Performs every complete packet (and push payload) that has been written.
+        fn perform(&mut self) {
+            loop {
+                if self.incoming.len() < FMR_PACKET_SIZE { return; }
+                let mut packet = FmrPacket::new(FmrClass::call);
+                unsafe { packet.as_bytes_mut() }.copy_from_slice(&self.incoming[..FMR_PACKET_SIZE]);
+                let class = self.incoming[5];
+                let (len, ptr) = unsafe { (packet.body.data.len as usize, packet.body.data.ptr as usize) };
+
+                match class {
+                    // call: uart0_read or uart0_write on (ptr, len)
+                    0 => {
+                        let argv = unsafe { &packet.body.base.0[8..] };
+                        let mut ptr = [0u8; 8];
+                        ptr.copy_from_slice(&argv[..8]);
+                        let ptr = u64::from_ne_bytes(ptr) as usize;
+                        let mut len = [0u8; 4];
+                        len.copy_from_slice(&argv[8..12]);
+                        let len = u32::from_ne_bytes(len) as usize;
+                        match unsafe { packet.body.call.function } {
+                            functions::WRITE => self.uart.extend(&self.memory[ptr..ptr + len]),
+                            functions::READ => for byte in &mut self.memory[ptr..ptr + len] {
+                                *byte = self.uart.pop_front().unwrap();
+                            },
+                            _ => panic!("unexpected function"),
+                        }
+                        self.respond(0);
+                    }
+                    // push
+                    1 => {
+                        if self.incoming.len() < FMR_PACKET_SIZE + len { return; }
+                        let data = &self.incoming[FMR_PACKET_SIZE..FMR_PACKET_SIZE + len];
+                        self.memory[ptr..ptr + len].copy_from_slice(data);
+                        self.incoming.drain(..len);
+                        self.respond(0);
+                    }
+                    // pull
+                    2 => {
+                        let data = self.memory[ptr..ptr + len].to_vec();
+                        self.outgoing.extend(data);
+                        self.respond(0);
+                    }
+                    // dyld
+                    3 => self.respond(0),
+                    // malloc
+                    4 => {
+                        self.mallocs += 1;
+                        self.respond(0x100);
+                    }
+                    _ => self.respond(0),
+                }
+                self.incoming.drain(..FMR_PACKET_SIZE);
+            }
+        }
+    }
+
+    impl Read for MockU2 {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            if !self.reading { self.round_trips += 1; }
+            self.reading = true;
+            for byte in buf.iter_mut() { *byte = self.outgoing.pop_front().unwrap(); }
+            Ok(buf.len())
+        }
+    }
+
+    impl Write for MockU2 {
+        fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+            self.reading = false;
+            self.incoming.extend_from_slice(buf);
+            self.perform();
+            Ok(buf.len())
+        }
+
+        fn flush(&mut self) -> io::Result<()> {
+            Ok(())
+        }
+    }
+
+    impl Client for MockU2 {
+        fn modules(&mut self) -> &mut Modules { &mut self.modules }
+        fn reader(&mut self) -> &mut Read { self }
+        fn writer(&mut self) -> &mut Write { self }
     }
-}
\ No newline at end of file
+
+    #[test]
+    fn test_staged_loopback() {
+        let mut u2 = MockU2::new();
+        {
+            let mut uart = Uart0::new(&mut u2);
+
+            // The first transfer loads the module and allocates the staging buffer
+            let data: Vec<u8> = (0..64).collect();
+            uart.write(&data).unwrap();
+            let mut echo = [0u8; 64];
+            uart.read(&mut echo).unwrap();
+            assert_eq!(&echo[..], &data[..]);
+        }
+        assert_eq!(u2.mallocs, 1);
+
+        let mut uart = Uart0::new(&mut u2);
+        uart.write(&[1, 2, 3]).unwrap();
+
+        // After setup, every write and every read costs one round trip
+        let before = uart.device.round_trips;
+        uart.write(&[4, 5, 6]).unwrap();
+        assert_eq!(uart.device.round_trips - before, 1);
+
+        let mut echo = [0u8; 6];
+        let before = uart.device.round_trips;
+        uart.read(&mut echo).unwrap();
+        assert_eq!(echo, [1, 2, 3, 4, 5, 6]);
+        assert_eq!(uart.device.round_trips - before, 1);
+    }
+}
@@ -3,18 +3,19 @@ use std::pin::Pin;
 use std::marker::PhantomPinned;
 
 use crate::{Client, LfType, Args};
-use crate::error::Result;
+use crate::error::{Result, FlipperError};
 use crate::device::AtsamClient;
 use crate::runtime::{
     Modules,
-    protocol::{LfFunction, LfPointer}
+    ModuleHandle,
+    Route,
+    protocol::{FmrPacket, FmrReturn, LfFunction, LfPointer}
 };
 
-lazy_static! {
-    static ref ATMEGA_MODULES: &'static [&'static str] = &[
-        "led",
-    ];
-}
+/// Modules that are implemented by the AtmegaU2 rather than the Atsam4s.
+const ATMEGA_MODULES: &[&str] = &[
+    "led",
+];
 
 pub struct Carbon<'a, Atmega: Client> {
     modules: Modules,
@@ -79,12 +80,64 @@ impl<'a, T: Client> Client for Carbon<'a, T> {
     }
 
     fn invoke(&mut self, module: &str, function: u8, ret: LfType, args: &Args) -> Result<u64> {
-        let client: &mut Client = if ATMEGA_MODULES.contains(&module) {
-            self.atmegau2()
-        } else {
-            self.atsam4s()
+        let module = self.resolve(module)?;
+        self.invoke_handle(module, function, ret, args)
+    }
+
+    /// Decides once whether the module lives on the AtmegaU2 or the Atsam4s, and loads it
+    /// there. Calls made through the handle go straight to that processor.
+    fn resolve(&mut self, module: &str) -> Result<ModuleHandle> {
+        let route = self.route(module);
+        let index = match route {
+            Route::Coprocessor => self.atmegau2().load(module)?,
+            Route::Primary => self.atsam4s().load(module)?,
+        };
+        Ok(ModuleHandle { index: index as u32, route })
+    }
+
+    fn route(&self, module: &str) -> Route {
+        if ATMEGA_MODULES.contains(&module) { Route::Coprocessor } else { Route::Primary }
+    }
+
+    /// Asks whichever processor implements the module, as `resolve` does.
+    fn lookup(&mut self, module: &str) -> Result<u64> {
+        match self.route(module) {
+            Route::Coprocessor => self.atmegau2().lookup(module),
+            Route::Primary => self.atsam4s().lookup(module),
+        }
+    }
+
+    fn invoke_packet(&mut self, module: ModuleHandle, packet: &mut FmrPacket) -> Result<u64> {
+        let client: &mut Client = match module.route {
+            Route::Coprocessor => self.atmegau2(),
+            Route::Primary => self.atsam4s(),
         };
-        client.invoke(module, function, ret, args)
+        let module = ModuleHandle { route: Route::Primary, ..module };
+        client.invoke_packet(module, packet)
+    }
+
+    /// Pipelines each run of consecutive calls bound for the same processor.
+    fn invoke_batch(&mut self, calls: &mut [(ModuleHandle, FmrPacket)], results: &mut [FmrReturn]) -> Result<()> {
+        if results.len() < calls.len() { Err(FlipperError::Invoke)?; }
+
+        let mut start = 0;
+        while start < calls.len() {
+            let route = calls[start].0.route;
+            let end = calls[start..].iter()
+                .position(|(module, _)| module.route != route)
+                .map_or(calls.len(), |len| start + len);
+
+            let client: &mut Client = match route {
+                Route::Coprocessor => self.atmegau2(),
+                Route::Primary => self.atsam4s(),
+            };
+            for (module, _) in calls[start..end].iter_mut() {
+                module.route = Route::Primary;
+            }
+            client.invoke_batch(&mut calls[start..end], &mut results[start..end])?;
+            start = end;
+        }
+        Ok(())
     }
 }
 
@@ -109,11 +162,40 @@ impl<'a, T: Client> Client for Pin<Box<Carbon<'a, T>>> {
         carbon.invoke(module, function, ret, args)
     }
 
+    fn resolve(&mut self, module: &str) -> Result<ModuleHandle> {
+        let carbon = unsafe { Pin::get_unchecked_mut(self.as_mut()) };
+        carbon.resolve(module)
+    }
+
+    fn route(&self, module: &str) -> Route {
+        (**self).route(module)
+    }
+
+    fn invoke_handle(&mut self, module: ModuleHandle, function: LfFunction, ret: LfType, args: &Args) -> Result<u64> {
+        let carbon = unsafe { Pin::get_unchecked_mut(self.as_mut()) };
+        carbon.invoke_handle(module, function, ret, args)
+    }
+
+    fn invoke_packet(&mut self, module: ModuleHandle, packet: &mut FmrPacket) -> Result<u64> {
+        let carbon = unsafe { Pin::get_unchecked_mut(self.as_mut()) };
+        carbon.invoke_packet(module, packet)
+    }
+
+    fn invoke_batch(&mut self, calls: &mut [(ModuleHandle, FmrPacket)], results: &mut [FmrReturn]) -> Result<()> {
+        let carbon = unsafe { Pin::get_unchecked_mut(self.as_mut()) };
+        carbon.invoke_batch(calls, results)
+    }
+
     fn load(&mut self, module: &str) -> Result<u64> {
         let carbon = unsafe { Pin::get_unchecked_mut(self.as_mut()) };
         carbon.load(module)
     }
 
+    fn lookup(&mut self, module: &str) -> Result<u64> {
+        let carbon = unsafe { Pin::get_unchecked_mut(self.as_mut()) };
+        carbon.lookup(module)
+    }
+
     fn push(&mut self, pointer: LfPointer, data: &[u8]) -> Result<()> {
         let carbon = unsafe { Pin::get_unchecked_mut(self.as_mut()) };
         carbon.push(pointer, data)
@@ -1,25 +1,34 @@
 use libusb::Context;
 
 mod usb;
+mod udp;
 mod atsam;
 pub mod carbon;
 
 pub use self::usb::UsbClient;
+pub use self::udp::{UdpClient, FMR_UDP_PORT};
 pub use self::atsam::AtsamClient;
 pub use self::carbon::Carbon;
 use self::usb::get_usb_devices;
 
-use std::io::{Read, Write};
-use crate::{Client, LfType, Args};
+use std::io::{self as io, Read, Write};
+use std::net::ToSocketAddrs;
+use std::time::Instant;
+use crate::Client;
 use crate::error::Result;
 use crate::runtime::{
     Modules,
-    protocol::{LfFunction, LfPointer}
+    ModuleHandle,
+    Route,
+    create_transfer,
+    trace::Tracer,
+    protocol::{FmrClass, FmrPacket, FmrReturn, LfPointer}
 };
 
 pub struct Flipper<'a> {
     inner: Box<Client + 'a>,
     modules: Modules,
+    tracer: Option<Tracer>,
 }
 
 impl<'a> Flipper<'a> {
@@ -29,8 +38,45 @@ impl<'a> Flipper<'a> {
             .collect()
     }
 
+    /// Attaches to a device, or a host emulator, served over UDP at `address`.
+    pub fn attach_network<A: ToSocketAddrs>(address: A) -> io::Result<Flipper<'a>> {
+        Ok(Flipper::new(UdpClient::connect(address)?))
+    }
+
     fn new<T: Client + 'a, I: Into<Box<T>>>(inner: I) -> Flipper<'a> {
-        Flipper { inner: inner.into(), modules: Modules::new() }
+        Flipper { inner: inner.into(), modules: Modules::new(), tracer: Tracer::from_env() }
+    }
+
+    /// Starts recording every packet sent to this device into `tracer`, or stops recording
+    /// if it is `None`. Returns the tracer that was attached before, if any.
+    ///
+    /// A tracer is attached automatically when the `FLIPPER_TRACE` environment variable
+    /// names a file to capture to. When several devices are attached, each after the first
+    /// captures to a numbered file beside it.
+    pub fn trace(&mut self, tracer: Option<Tracer>) -> Option<Tracer> {
+        std::mem::replace(&mut self.tracer, tracer)
+    }
+
+    /// Performs `op` on the inner client. When tracing, the packet built by `describe`
+    /// is recorded along with how long `op` took and the value `outcome` extracts from it.
+    ///
+    /// `describe` is only called when tracing, so the untraced path pays for one branch.
+    fn traced<T, D, V, F>(&mut self, describe: D, outcome: V, op: F) -> Result<T>
+        where D: FnOnce() -> FmrPacket,
+              V: FnOnce(&T) -> u64,
+              F: FnOnce(&mut (Client + 'a)) -> Result<T>,
+    {
+        let tracer = match self.tracer {
+            Some(ref mut tracer) => tracer,
+            None => return op(&mut *self.inner),
+        };
+
+        let start = Instant::now();
+        let result = op(&mut *self.inner);
+        let mut packet = describe();
+        packet.seal();
+        tracer.packet(start, Route::Primary, &packet, result.as_ref().ok().map(outcome));
+        result
     }
 }
 
@@ -47,27 +93,126 @@ impl<'a> Client for Flipper<'a> {
         self.inner.writer()
     }
 
-    fn invoke(&mut self, module: &str, function: LfFunction, ret: LfType, args: &Args) -> Result<u64> {
-        self.inner.invoke(module, function, ret, args)
+    // `invoke` and `invoke_handle` use the trait's defaults, which resolve the module and
+    // build the packet here and then pass through `resolve` and `invoke_packet` below. This
+    // is what the inner client would do, and lets every call be traced.
+
+    fn resolve(&mut self, module: &str) -> Result<ModuleHandle> {
+        let tracer = match self.tracer {
+            Some(ref mut tracer) => tracer,
+            None => return self.inner.resolve(module),
+        };
+
+        let start = Instant::now();
+        let result = self.inner.resolve(module);
+        tracer.resolve(start, module, result.as_ref().ok().cloned());
+        result
+    }
+
+    fn route(&self, module: &str) -> Route {
+        self.inner.route(module)
+    }
+
+    fn invoke_packet(&mut self, module: ModuleHandle, packet: &mut FmrPacket) -> Result<u64> {
+        let tracer = match self.tracer {
+            Some(ref mut tracer) => tracer,
+            None => return self.inner.invoke_packet(module, packet),
+        };
+
+        // The packet is sealed in place, so afterwards it holds exactly what was sent.
+        let start = Instant::now();
+        let result = self.inner.invoke_packet(module, packet);
+        tracer.packet(start, module.route, packet, result.as_ref().ok().cloned());
+        result
+    }
+
+    fn invoke_batch(&mut self, calls: &mut [(ModuleHandle, FmrPacket)], results: &mut [FmrReturn]) -> Result<()> {
+        let tracer = match self.tracer {
+            Some(ref mut tracer) => tracer,
+            None => return self.inner.invoke_batch(calls, results),
+        };
+
+        // Every call in the batch is recorded with the latency of the whole batch.
+        let start = Instant::now();
+        let result = self.inner.invoke_batch(calls, results);
+        for ((module, packet), answer) in calls.iter().zip(results.iter()) {
+            let outcome = if result.is_ok() && answer.error == 0 { Some(answer.value) } else { None };
+            tracer.packet(start, module.route, packet, outcome);
+        }
+        result
     }
 
     fn load(&mut self, module: &str) -> Result<u64> {
-        self.inner.load(module)
+        let tracer = match self.tracer {
+            Some(ref mut tracer) => tracer,
+            None => return self.inner.load(module),
+        };
+
+        let start = Instant::now();
+        let result = self.inner.load(module);
+        let route = self.inner.route(module);
+        let handle = result.as_ref().ok().map(|&index| ModuleHandle { index: index as u32, route });
+        tracer.resolve(start, module, handle);
+        result
+    }
+
+    fn lookup(&mut self, module: &str) -> Result<u64> {
+        let tracer = match self.tracer {
+            Some(ref mut tracer) => tracer,
+            None => return self.inner.lookup(module),
+        };
+
+        let start = Instant::now();
+        let result = self.inner.lookup(module);
+        let route = self.inner.route(module);
+        let handle = result.as_ref().ok().map(|&index| ModuleHandle { index: index as u32, route });
+        tracer.resolve(start, module, handle);
+        result
     }
 
     fn push(&mut self, pointer: LfPointer, data: &[u8]) -> Result<()> {
-        self.inner.push(pointer, data)
+        let result = self.traced(
+            || create_transfer(FmrClass::push, pointer, data.len()),
+            |_| 0,
+            |inner| inner.push(pointer, data),
+        );
+        // A failed transfer moved nothing worth replaying.
+        if let (Some(tracer), true) = (self.tracer.as_mut(), result.is_ok()) { tracer.payload(data); }
+        result
     }
 
     fn pull(&mut self, pointer: LfPointer, buffer: &mut [u8]) -> Result<()> {
-        self.inner.pull(pointer, buffer)
+        let len = buffer.len();
+        let result = self.traced(
+            || create_transfer(FmrClass::pull, pointer, len),
+            |_| 0,
+            |inner| inner.pull(pointer, &mut *buffer),
+        );
+        if let (Some(tracer), true) = (self.tracer.as_mut(), result.is_ok()) { tracer.payload(buffer); }
+        result
     }
 
     fn malloc(&mut self, size: u32) -> Result<LfPointer> {
-        self.inner.malloc(size)
+        self.traced(
+            || {
+                let mut packet = FmrPacket::new(FmrClass::malloc);
+                unsafe { packet.body.memory.size = size; }
+                packet
+            },
+            |pointer: &LfPointer| u64::from(pointer.0),
+            |inner| inner.malloc(size),
+        )
     }
 
     fn free(&mut self, pointer: LfPointer) -> Result<()> {
-        self.inner.free(pointer)
+        self.traced(
+            || {
+                let mut packet = FmrPacket::new(FmrClass::free);
+                unsafe { packet.body.memory.ptr = u64::from(pointer.0); }
+                packet
+            },
+            |_| 0,
+            |inner| inner.free(pointer),
+        )
     }
 }
\ No newline at end of file
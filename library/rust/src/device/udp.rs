@@ -0,0 +1,51 @@
+use std::io::{self as io, Read, Write};
+use std::net::{ToSocketAddrs, UdpSocket};
+use std::time::Duration;
+use crate::runtime::{
+    Client,
+    Modules,
+};
+
+/// The port a networked device, or a host emulator standing in for one, serves FMR on.
+/// Matches `LF_UDP_PORT` of the C library's network endpoint.
+pub const FMR_UDP_PORT: u16 = 3258;
+
+/// A device reached over UDP. Each write is sent as one datagram, and each read receives one.
+pub struct UdpClient {
+    socket: UdpSocket,
+    modules: Modules,
+}
+
+impl UdpClient {
+    /// Connects to the device at `address`, such as `("emulator.local", FMR_UDP_PORT)`.
+    pub fn connect<A: ToSocketAddrs>(address: A) -> io::Result<UdpClient> {
+        let socket = UdpSocket::bind(("0.0.0.0", 0))?;
+        socket.connect(address)?;
+        socket.set_read_timeout(Some(Duration::from_secs(1)))?;
+        Ok(UdpClient { socket, modules: Modules::new() })
+    }
+}
+
+impl Read for UdpClient {
+    fn read(&mut self, buf: &mut [u8]) -> Result<usize, io::Error> {
+        self.socket.recv(buf)
+    }
+}
+
+impl Write for UdpClient {
+    fn write(&mut self, buf: &[u8]) -> Result<usize, io::Error> {
+        self.socket.send(buf)
+    }
+
+    fn flush(&mut self) -> Result<(), io::Error> {
+        Ok(())
+    }
+}
+
+impl Client for UdpClient {
+    fn modules(&mut self) -> &mut Modules { &mut self.modules }
+
+    fn reader(&mut self) -> &mut Read { self }
+
+    fn writer(&mut self) -> &mut Write { self }
+}
@@ -12,21 +12,30 @@ extern crate log;
 extern crate failure;
 extern crate libc;
 extern crate libusb;
-#[macro_use]
-extern crate lazy_static;
+extern crate flipper_macros;
+
+// Lets code generated by `#[flipper_module]` name `::flipper` from inside this crate
+extern crate self as flipper;
 
 pub mod capi;
 
-#[macro_use]
-mod macros;
 mod device;
 mod runtime;
 mod error;
 
 pub use self::runtime::Args;
 pub use self::runtime::Client;
-pub use self::runtime::protocol::LfType;
-pub use self::device::Flipper;
+pub use self::runtime::Modules;
+pub use self::runtime::{LfArgType, LfReturnable};
+#[doc(hidden)]
+pub use self::runtime::__private;
+pub use self::runtime::{ModuleHandle, Route};
+pub use self::runtime::pipeline::{AsyncClient, AsyncTransport, Blocking, block_on, join_all};
+pub use self::runtime::trace;
+pub use self::runtime::replay;
+pub use self::runtime::protocol::{LfPointer, LfType};
+pub use self::device::{Flipper, UdpClient, FMR_UDP_PORT};
+pub use flipper_macros::flipper_module;
 
 pub use self::error::Result;
 pub use failure::Error;
@@ -0,0 +1,65 @@
+//! The CCITT CRC-16 (polynomial `0x1021`, initial value `0`) used to checksum FMR packets.
+//!
+//! This is the same table-driven checksum that libflipper computes in `library/c/crc.c`, so
+//! packets produced by either runtime verify against the other.
+
+use crate::runtime::protocol::LfCrc;
+
+/// The CCITT CRC 16 polynomial X^16 + X^12 + X^5 + 1.
+const POLY: u16 = 0x1021;
+
+/// Precomputed remainders of `POLY` for every possible leading byte.
+pub const CRC_TABLE: [u16; 256] = make_table();
+
+const fn make_table() -> [u16; 256] {
+    let mut table = [0u16; 256];
+    let mut i = 0;
+    while i < 256 {
+        let mut crc = (i as u16) << 8;
+        let mut bit = 0;
+        while bit < 8 {
+            crc = if crc & 0x8000 != 0 { crc << 1 ^ POLY } else { crc << 1 };
+            bit += 1;
+        }
+        table[i] = crc;
+        i += 1;
+    }
+    table
+}
+
+/// Given a buffer of data, generates a CRC of the data in the buffer.
+pub fn checksum(data: &[u8]) -> LfCrc {
+    data.iter().fold(0, |crc, &byte| {
+        crc << 8 ^ CRC_TABLE[((crc >> 8) as u8 ^ byte) as usize]
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// The original bit-at-a-time implementation, kept as a reference.
+    fn checksum_bitwise(data: &[u8]) -> u16 {
+        let mut crc: u16 = 0;
+        for &byte in data {
+            crc ^= (byte as u16) << 8;
+            for _ in 0..8 {
+                crc = if crc & 0x8000 != 0 { crc << 1 ^ POLY } else { crc << 1 };
+            }
+        }
+        crc
+    }
+
+    #[test]
+    fn test_checksum_check_value() {
+        assert_eq!(checksum(b"123456789"), 0x31C3);
+    }
+
+    #[test]
+    fn test_checksum_matches_bitwise() {
+        let data: Vec<u8> = (0..=255u8).map(|i| i.wrapping_mul(37).wrapping_add(1)).collect();
+        for len in 0..data.len() {
+            assert_eq!(checksum(&data[..len]), checksum_bitwise(&data[..len]));
+        }
+    }
+}
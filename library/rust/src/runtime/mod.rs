@@ -1,19 +1,26 @@
 pub mod protocol;
+pub mod crc;
+pub mod pipeline;
+pub mod trace;
+pub mod replay;
 
 use self::protocol::*;
 
-use std::ptr;
 use std::ops::Deref;
+use std::mem::size_of;
 use std::ffi::CString;
 use std::io::{Read, Write};
 use std::collections::HashMap;
-use std::os::raw::c_char;
 
 use crate::error::{
     Result,
     FlipperError,
 };
 
+/// The most packets of a batch that are sent ahead of their results, which is the number the
+/// device is expected to hold at once. This matches `LF_BATCH_MAX` in libflipper.
+pub const BATCH_WINDOW: usize = 16;
+
 pub trait Client {
     fn modules(&mut self) -> &mut Modules;
     fn reader(&mut self) -> &mut Read;
@@ -26,20 +33,56 @@ pub trait Client {
         ret: LfType,
         args: &Args,
     ) -> Result<u64> {
+        let module = self.resolve(module)?;
+        self.invoke_handle(module, function, ret, args)
+    }
+
+    /// Resolves a module name into a handle that can be passed to `invoke_handle`.
+    ///
+    /// Resolving looks the module up (loading it on the device if necessary) once, so that
+    /// calls made through the handle skip any name lookup. A handle is only valid for the
+    /// client that resolved it.
+    fn resolve(&mut self, module: &str) -> Result<ModuleHandle> {
+        let index = self.load(module)?;
+        Ok(ModuleHandle { index: index as LfModule, route: self.route(module) })
+    }
+
+    /// The processor that `load`, `lookup` and calls to the module are routed to.
+    fn route(&self, _module: &str) -> Route {
+        Route::Primary
+    }
+
+    /// Executes a function in a module that has already been resolved.
+    fn invoke_handle(
+        &mut self,
+        module: ModuleHandle,
+        function: LfFunction,
+        ret: LfType,
+        args: &Args,
+    ) -> Result<u64> {
 
         // Create a call packet
         let mut packet = FmrPacket::new(FmrClass::call);
 
         // Write the module index and function arguments into the packet
-        let module = self.load(module).expect("should get module");
-        let argv: Vec<_> = args.iter().map(|arg| arg.0).collect();
-        create_call(&mut packet, module as u32, function, ret, &argv)
+        create_call(&mut packet, module.index, function, ret, args)
             .ok_or(FlipperError::Invoke)?;
 
+        self.invoke_packet(module, &mut packet)
+    }
+
+    /// Executes a call packet whose function, return type and arguments have already been
+    /// encoded. The module index is filled in from `module`.
+    ///
+    /// This is the entry point used by bindings generated with `#[flipper_module]`, which
+    /// encode their arguments at compile-time known offsets.
+    fn invoke_packet(&mut self, module: ModuleHandle, packet: &mut FmrPacket) -> Result<u64> {
+        unsafe {
+            packet.body.call.module = module.index as u8;
+        }
+
         // Calculate the crc for the packet
-        let len = packet.header.len as u32;
-        let crc = calculate_crc(&packet as *const _ as *const u8, len);
-        packet.header.crc = crc;
+        packet.seal();
 
         // Send the packet as raw bytes
         self.writer().write(unsafe { packet.as_bytes() })
@@ -53,28 +96,59 @@ pub trait Client {
         Ok(result.value)
     }
 
+    /// Executes a batch of encoded call packets, storing the device's answer to `calls[i]` in
+    /// `results[i]`.
+    ///
+    /// Up to `BATCH_WINDOW` packets are sent before the first result is read, and another is
+    /// sent as each result arrives, so a batch that fits in the window costs a single round
+    /// trip on transports that can buffer it.
+    fn invoke_batch(&mut self, calls: &mut [(ModuleHandle, FmrPacket)], results: &mut [FmrReturn]) -> Result<()> {
+        if results.len() < calls.len() { Err(FlipperError::Invoke)?; }
+
+        let mut sent = 0;
+        for (i, result) in results[..calls.len()].iter_mut().enumerate() {
+            while sent < calls.len() && sent < i + BATCH_WINDOW {
+                let (module, packet) = &mut calls[sent];
+                unsafe {
+                    packet.body.call.module = module.index as u8;
+                }
+                self.send_packet(packet, &[])?;
+                sent += 1;
+            }
+            *result = self.receive_result()?;
+        }
+        Ok(())
+    }
+
     /// Given a module name, returns the index of that module on this device if the module is
     /// installed. Otherwise, returns none.
     fn load(&mut self, module: &str) -> Result<u64> {
         let modules = self.modules();
         if let Some(module) = modules.find(module) { return Ok(module as u64); }
 
+        let index = self.lookup(module)?;
+
+        // Register this module so we don't have to look it up in the future
+        let modules = self.modules();
+        let module = Module::new(module.to_string(), index as u32, 0);
+        modules.register(module);
+
+        Ok(index)
+    }
+
+    /// Asks the device for the index of a module, whether or not it has been loaded before.
+    ///
+    /// Unlike `load`, this always makes a round trip and leaves the module cache alone.
+    fn lookup(&mut self, module: &str) -> Result<u64> {
+
         // Create a dyld packet
         let mut packet = FmrPacket::new(FmrClass::dyld);
 
-        let module_cstring = CString::new(module)
-            .map_err(|_| FlipperError::Load)?;
-
         // Copy the module name into the packet
-        let buffer = module_cstring.as_bytes_with_nul();
-        let module_cstr = unsafe { &mut (packet.body.dyld.module) as *mut *mut c_char as *mut u8 };
-        unsafe { ptr::copy(buffer.as_ptr(), module_cstr, buffer.len()) };
-        packet.header.len += buffer.len() as u16;
+        create_dyld(&mut packet, module).ok_or(FlipperError::Load)?;
 
         // Calculate the crc for the packet
-        let len = packet.header.len as u32;
-        let crc = calculate_crc(&packet as *const _ as *const u8, len);
-        packet.header.crc = crc;
+        packet.seal();
 
         // Send the packet as raw bytes
         self.writer().write(unsafe { packet.as_bytes() })
@@ -86,13 +160,6 @@ pub trait Client {
             .map_err(|ioe| FlipperError::Io { inner: ioe })?;
 
         if result.error != 0 { Err(FlipperError::Load)?; }
-
-        // Register this module so we don't have to look it up in the future
-        let modules = self.modules();
-        let module_index = result.value as u32;
-        let module = Module::new(module.to_string(), module_index, 0);
-        modules.register(module);
-
         Ok(result.value)
     }
 
@@ -106,19 +173,11 @@ pub trait Client {
     /// `data.len()` must be less than or equal to `size`.
     fn push(&mut self, pointer: LfPointer, data: &[u8]) -> Result<()> {
 
-        // Create a push packet
-        let mut packet = FmrPacket::new(FmrClass::push);
-
-        // Write the length and address of the target memory buffer into the packet
-        unsafe {
-            packet.body.data.len = data.len() as u32;
-            packet.body.data.ptr = pointer.0 as u64;
-        }
+        // Create a push packet with the length and address of the target memory buffer
+        let mut packet = create_transfer(FmrClass::push, pointer, data.len());
 
         // Calculate the crc for the packet
-        let len = packet.header.len as u32;
-        let crc = calculate_crc(&packet as *const _ as *const u8, len);
-        packet.header.crc = crc;
+        packet.seal();
 
         // Write the packet as raw bytes
         self.writer().write(unsafe { packet.as_bytes() })
@@ -147,19 +206,11 @@ pub trait Client {
     /// `data.len()` must be less than or equal to `size`.
     fn pull(&mut self, pointer: LfPointer, buffer: &mut [u8]) -> Result<()> {
 
-        // Create a pull packet
-        let mut packet = FmrPacket::new(FmrClass::pull);
-
-        // Write the length and address of the target memory buffer into the packet
-        unsafe {
-            packet.body.data.len = buffer.len() as u32;
-            packet.body.data.ptr = pointer.0 as u64;
-        }
+        // Create a pull packet with the length and address of the target memory buffer
+        let mut packet = create_transfer(FmrClass::pull, pointer, buffer.len());
 
         // Calculate the crc for the packet
-        let len = packet.header.len as u32;
-        let crc = calculate_crc(&packet as *const _ as *const u8, len);
-        packet.header.crc = crc;
+        packet.seal();
 
         // Write the packet as raw bytes
         self.writer().write(unsafe { packet.as_bytes() })
@@ -190,9 +241,7 @@ pub trait Client {
         }
 
         // Calculate the crc for the packet
-        let len = packet.header.len as u32;
-        let crc = calculate_crc(&packet as *const _ as *const u8, len);
-        packet.header.crc = crc;
+        packet.seal();
 
         // Send the packet as raw bytes
         self.writer().write(unsafe { packet.as_bytes() })
@@ -219,9 +268,7 @@ pub trait Client {
         }
 
         // Calculate the crc for the packet
-        let len = packet.header.len as u32;
-        let crc = calculate_crc(&packet as *const _ as *const u8, len);
-        packet.header.crc = crc;
+        packet.seal();
 
         // Send the packet as raw bytes
         self.writer().write(unsafe { packet.as_bytes() })
@@ -235,6 +282,57 @@ pub trait Client {
         if result.error != 0 { Err(FlipperError::Free)?; }
         Ok(())
     }
+
+    /// Seals and sends a packet, followed by `payload`, without waiting for its result.
+    ///
+    /// Several packets may be sent back to back before their results are collected with
+    /// `receive_result`, which saves a round trip per packet on high-latency links.
+    fn send_packet(&mut self, packet: &mut FmrPacket, payload: &[u8]) -> Result<()> {
+        packet.seal();
+
+        self.writer().write(unsafe { packet.as_bytes() })
+            .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+
+        if !payload.is_empty() {
+            self.writer().write(payload)
+                .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+        }
+        Ok(())
+    }
+
+    /// Receives the result of the oldest packet sent with `send_packet` that hasn't been
+    /// answered yet.
+    fn receive_result(&mut self) -> Result<FmrReturn> {
+        let mut result = FmrReturn::new();
+        self.reader().read(unsafe { result.as_bytes_mut() })
+            .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+        Ok(result)
+    }
+}
+
+/// Identifies which processor of a device a module lives on.
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+pub enum Route {
+    /// The device's main processor, or the only one on single-processor devices.
+    Primary,
+    /// A co-processor that the primary processor is reached through.
+    Coprocessor,
+}
+
+/// A module that has been resolved on a particular client, along with the processor that
+/// calls to it are routed to. Obtained from `Client::resolve`.
+#[derive(Debug, Copy, Clone)]
+pub struct ModuleHandle {
+    pub(crate) index: LfModule,
+    pub(crate) route: Route,
+}
+
+impl ModuleHandle {
+    /// The index of the module on the processor it's routed to.
+    pub fn index(&self) -> LfModule { self.index }
+
+    /// The processor calls to this module are routed to.
+    pub fn route(&self) -> Route { self.route }
 }
 
 pub struct Module {
@@ -281,8 +379,11 @@ impl Modules {
 /// let three = Arg::from(30 as u32);
 /// let four  = Arg::from(40 as u64);
 /// ```
+#[derive(Copy, Clone)]
 pub struct Arg(pub(crate) LfArg);
 
+const ARG_EMPTY: Arg = Arg(LfArg { kind: LfType::lf_void, value: 0 });
+
 impl From<u8> for Arg {
     fn from(value: u8) -> Arg {
         Arg(LfArg {
@@ -331,6 +432,10 @@ impl From<LfPointer> for Arg {
 /// Represents an ordered, typed set of arguments to a Flipper remote call. This
 /// is to be used for calling `LfClient::invoke`.
 ///
+/// Arguments are stored inline, so building an argument list never touches the
+/// heap. A call can carry at most `FMR_MAX_ARGC` arguments; appending more than
+/// that causes the invocation to fail with `FlipperError::Invoke`.
+///
 /// # Example
 ///
 /// ```
@@ -342,22 +447,88 @@ impl From<LfPointer> for Arg {
 ///     .append(30 as u32)
 ///     .append(40 as u64);
 /// ```
-pub struct Args(Vec<Arg>);
+#[derive(Copy, Clone)]
+pub struct Args {
+    argv: [Arg; FMR_MAX_ARGC],
+    argc: usize,
+    overflow: bool,
+}
 
 impl Args {
     pub fn new() -> Self {
-        Args(Vec::new())
+        Args { argv: [ARG_EMPTY; FMR_MAX_ARGC], argc: 0, overflow: false }
     }
     pub fn append<T: Into<Arg>>(&mut self, arg: T) -> &mut Self {
-        self.0.push(arg.into());
+        match self.argv.get_mut(self.argc) {
+            Some(slot) => {
+                *slot = arg.into();
+                self.argc += 1;
+            }
+            None => self.overflow = true,
+        }
         self
     }
 }
 
+impl Args {
+    /// Appends a value whose type is only known at runtime, such as one passed in over FFI.
+    pub(crate) fn append_value(&mut self, kind: LfType, value: LfValue) -> &mut Self {
+        self.append(Arg(LfArg { kind, value }))
+    }
+}
+
 impl Deref for Args {
-    type Target = Vec<Arg>;
+    type Target = [Arg];
     fn deref(&self) -> &Self::Target {
-        &self.0
+        &self.argv[..self.argc]
+    }
+}
+
+/// A type that can be passed by value as an argument to a remote call.
+///
+/// The type code and encoded size are associated constants so that bindings generated with
+/// `#[flipper_module]` can compute a call's `argt` word and argument layout at compile time.
+pub trait LfArgType: Copy {
+    /// The type code sent in the call's `argt` word.
+    const KIND: LfType;
+    /// The number of bytes the value occupies in the packet.
+    const SIZE: usize;
+    /// Writes the value into the start of `buffer`, which is at least `SIZE` bytes long.
+    fn pack(self, buffer: &mut [u8]);
+}
+
+macro_rules! impl_arg_type {
+    ($($ty:ty => $kind:expr),* $(,)*) => {
+        $(
+            impl LfArgType for $ty {
+                const KIND: LfType = $kind;
+                const SIZE: usize = size_of::<$ty>();
+                #[inline]
+                fn pack(self, buffer: &mut [u8]) {
+                    buffer[..Self::SIZE].copy_from_slice(&self.to_ne_bytes());
+                }
+            }
+        )*
+    }
+}
+
+impl_arg_type! {
+    u8 => LfType::lf_uint8,
+    u16 => LfType::lf_uint16,
+    u32 => LfType::lf_uint32,
+    u64 => LfType::lf_uint64,
+    i8 => LfType::lf_int8,
+    i16 => LfType::lf_int16,
+    i32 => LfType::lf_int32,
+    i64 => LfType::lf_int64,
+}
+
+impl LfArgType for LfPointer {
+    const KIND: LfType = LfType::lf_ptr;
+    const SIZE: usize = size_of::<u64>();
+    #[inline]
+    fn pack(self, buffer: &mut [u8]) {
+        buffer[..Self::SIZE].copy_from_slice(&(self.0 as u64).to_ne_bytes());
     }
 }
 
@@ -435,64 +606,110 @@ impl From<LfReturn> for LfPointer {
     }
 }
 
-fn create_call(
+/// Encodes a call to `function` in `module` into the body of `packet`.
+///
+/// Argument values are copied straight out of `args` into the packet payload, so no
+/// intermediate buffers are allocated. Returns `None` if the arguments don't fit.
+pub(crate) fn create_call(
     packet: &mut FmrPacket,
     module: LfModule,
     function: LfFunction,
     return_type: LfType,
-    args: &[LfArg],
+    args: &Args,
 ) -> Option<()> {
-    let argc = args.len() as LfArgc;
+    if args.overflow { return None; }
 
-    let mut offset = unsafe {
-        // Populate call packet
+    let mut argt: LfTypes = 0;
+    let mut offset = size_of::<FmrCall>();
+    let payload = unsafe { &mut packet.body.base.0 };
+
+    // Copy each argument into the call packet
+    for (i, arg) in args.iter().enumerate() {
+        let kind = arg.0.kind;
+        let value = arg.0.value;
+        argt |= (((kind as u8) & LfType::MAX) as u32) << (i * 4);
+
+        // Copy the argument value into the call packet
+        let arg_size = kind.size();
+        payload.get_mut(offset..offset + arg_size)?
+            .copy_from_slice(&value.to_ne_bytes()[..arg_size]);
+
+        // Increase the offset of the next argument by the size of this one
+        offset += arg_size;
+    }
+
+    // Populate call packet
+    unsafe {
         packet.body.call.module = module as u8;
         packet.body.call.function = function;
         packet.body.call.ret = return_type;
-        packet.body.call.argc = argc;
+        packet.body.call.argt = argt;
+        packet.body.call.argc = args.len() as LfArgc;
+    }
+    packet.header.len += (offset - size_of::<FmrCall>()) as u16;
 
-        // Take the offset to the base of the argument list
-        &mut packet.body.call.argv as *mut () as *mut u8
-    };
+    Some(())
+}
 
-    // Copy each argument into the call packet
-    for i in 0..argc {
-        let arg = args.get(i as usize)?;
+/// Support for code generated by `#[flipper_module]`. Not part of the public API.
+#[doc(hidden)]
+pub mod __private {
+    pub use super::protocol::{FmrPacket, LfTypes, FMR_MAX_ARGV};
+    use super::protocol::{FmrCall, FmrClass, LfType};
+    use super::{LfReturn, LfReturnable};
+    use std::mem::size_of;
+
+    /// Creates a call packet for a function whose arguments take `argv_len` bytes. The
+    /// module index is filled in by `Client::invoke_packet`.
+    #[inline]
+    pub fn call_packet(function: u8, ret: LfType, argt: LfTypes, argc: u8, argv_len: usize) -> FmrPacket {
+        let mut packet = FmrPacket::new(FmrClass::call);
         unsafe {
-            packet.body.call.argt |= (((arg.kind as u8) & LfType::MAX) as u32) << (i * 4);
-
-            // Copy the argument value into the call packet
-            let arg_size = arg.kind.size();
-            let arg_value_address = &arg.value as *const u64;
-            ptr::copy(arg_value_address as *const u8, offset, arg_size);
-
-            // Increase the offset and size of the packet by the size of this argument
-            offset = offset.add(arg_size);
-            packet.header.len += arg_size as u16;
+            packet.body.call.function = function;
+            packet.body.call.ret = ret;
+            packet.body.call.argt = argt;
+            packet.body.call.argc = argc;
         }
+        packet.header.len += argv_len as u16;
+        packet
     }
 
-    Some(())
+    /// The argument values area of a call packet.
+    #[inline]
+    pub fn argv(packet: &mut FmrPacket) -> &mut [u8] {
+        let payload = unsafe { &mut packet.body.base.0 };
+        &mut payload[size_of::<FmrCall>()..]
+    }
+
+    /// Converts the raw value returned from a call into its declared type.
+    #[inline]
+    pub fn returned<R: LfReturnable>(value: u64) -> R {
+        R::from(LfReturn(value))
+    }
 }
 
-/// Given a memory buffer and a length, generates a CRC of the data in the buffer.
-fn calculate_crc(data: *const u8, length: u32) -> u16 {
-    const POLY: u16 = 0x1021;
-    let mut crc: u16 = 0;
-    for i in 0..length {
-        unsafe {
-            let word = ptr::read(data.offset(i as isize) as *const u16);
-            crc = crc ^ word << 8;
-            for _ in 0..8 {
-                if crc & 0x8000 != 0 {
-                    crc = crc << 1 ^ POLY;
-                } else {
-                    crc = crc << 1;
-                }
-            }
-        }
+/// Creates a push or pull packet for a transfer of `len` bytes at `pointer`.
+pub(crate) fn create_transfer(class: FmrClass, pointer: LfPointer, len: usize) -> FmrPacket {
+    let mut packet = FmrPacket::new(class);
+    unsafe {
+        packet.body.data.len = len as u32;
+        packet.body.data.ptr = pointer.0 as u64;
     }
-    crc
+    packet
+}
+
+/// Encodes a request for the index of `module` into the body of `packet`.
+///
+/// Returns `None` if the module name contains a nul byte or doesn't fit in the packet.
+pub(crate) fn create_dyld(packet: &mut FmrPacket, module: &str) -> Option<()> {
+    let module_cstring = CString::new(module).ok()?;
+    let buffer = module_cstring.as_bytes_with_nul();
+
+    let payload = unsafe { &mut packet.body.base.0 };
+    payload.get_mut(..buffer.len())?.copy_from_slice(buffer);
+    packet.header.len += buffer.len() as u16;
+
+    Some(())
 }
 
 #[cfg(test)]
@@ -501,22 +718,120 @@ mod tests {
 
     #[test]
     fn test_create_call() {
-        let args = vec![
-            LfArg { kind: LfType::lf_uint8, value: 10 },
-            LfArg { kind: LfType::lf_uint16, value: 1000 },
-            LfArg { kind: LfType::lf_uint32, value: 2000 },
-            LfArg { kind: LfType::lf_uint64, value: 4000 },
-        ];
+        let mut args = Args::new();
+        args.append(10 as u8)
+            .append(1000 as u16)
+            .append(2000 as u32)
+            .append(4000 as u64);
 
         let mut packet = FmrPacket::new(FmrClass::call);
         create_call(&mut packet, 3, 5, LfType::lf_void, &args).unwrap();
 
+        let header_len = packet.header.len;
+        assert_eq!(header_len, 8 + 1 + 2 + 4 + 8);
+
+        let call = unsafe { packet.body.call };
+        let argt = call.argt;
+        assert_eq!(call.module, 3);
+        assert_eq!(call.function, 5);
+        assert_eq!(call.argc, 4);
+        assert_eq!(argt, 0x7310);
+
         let payload = unsafe { packet.body.base.0 };
-        for chunk in payload.chunks(8) {
-            for byte in chunk {
-                print!("{:02X} ", byte);
-            }
-            println!();
+        let argv = &payload[size_of::<FmrCall>()..];
+        assert_eq!(argv[0], 10);
+        assert_eq!(&argv[1..3], &1000u16.to_ne_bytes());
+        assert_eq!(&argv[3..7], &2000u32.to_ne_bytes());
+        assert_eq!(&argv[7..15], &4000u64.to_ne_bytes());
+    }
+
+    #[test]
+    fn test_call_packet_matches_create_call() {
+        let mut args = Args::new();
+        args.append(10 as u8).append(2000 as u32).append(LfPointer(0x2000_0000));
+        let mut expected = FmrPacket::new(FmrClass::call);
+        create_call(&mut expected, 0, 5, LfType::lf_uint32, &args).unwrap();
+
+        const ARGT: LfTypes = (<u8 as LfArgType>::KIND as LfTypes)
+            | ((<u32 as LfArgType>::KIND as LfTypes) << 4)
+            | ((<LfPointer as LfArgType>::KIND as LfTypes) << 8);
+        let mut packet = __private::call_packet(5, LfType::lf_uint32, ARGT, 3, 13);
+        {
+            let argv = __private::argv(&mut packet);
+            LfArgType::pack(10u8, &mut argv[0..]);
+            LfArgType::pack(2000u32, &mut argv[1..]);
+            LfArgType::pack(LfPointer(0x2000_0000), &mut argv[5..]);
+        }
+
+        expected.seal();
+        packet.seal();
+        assert_eq!(unsafe { packet.as_bytes() }, unsafe { expected.as_bytes() });
+    }
+
+    #[crate::flipper_module("led")]
+    trait Led {
+        fn led_configure(&mut self) -> u32;
+        fn led_rgb(&mut self, red: u8, green: u8, blue: u8);
+    }
+
+    /// Records the packets written to it and answers every call with the same value.
+    struct MockClient {
+        modules: Modules,
+        written: Vec<u8>,
+        reply: Vec<u8>,
+    }
+
+    impl Client for MockClient {
+        fn modules(&mut self) -> &mut Modules { &mut self.modules }
+        fn reader(&mut self) -> &mut Read { self }
+        fn writer(&mut self) -> &mut Write { &mut self.written }
+    }
+
+    impl Read for MockClient {
+        fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+            (&self.reply[..]).read(buf)
         }
     }
+
+    #[test]
+    fn test_flipper_module() {
+        let mut modules = Modules::new();
+        modules.register(Module::new("led".to_string(), 4, 0));
+        let mut reply = FmrReturn::new();
+        reply.value = 42;
+        let reply = unsafe { reply.as_bytes_mut() }.to_vec();
+        let mut client = MockClient { modules, written: Vec::new(), reply };
+
+        let mut led = LedModule::bind(&mut client).unwrap();
+        let value: u32 = led.led_configure().unwrap();
+        led.led_rgb(10, 20, 30).unwrap();
+        assert_eq!(value, 42);
+
+        let mut args = Args::new();
+        args.append(10 as u8).append(20 as u8).append(30 as u8);
+        let mut expected = FmrPacket::new(FmrClass::call);
+        create_call(&mut expected, 4, 1, LfType::lf_void, &args).unwrap();
+        expected.seal();
+
+        let written = &client.written[FMR_PACKET_SIZE..];
+        assert_eq!(written, unsafe { expected.as_bytes() });
+    }
+
+    #[test]
+    fn test_create_call_too_many_args() {
+        let mut args = Args::new();
+        for i in 0..(FMR_MAX_ARGC + 1) { args.append(i as u8); }
+
+        let mut packet = FmrPacket::new(FmrClass::call);
+        assert!(create_call(&mut packet, 0, 0, LfType::lf_void, &args).is_none());
+    }
+
+    #[test]
+    fn test_create_call_payload_overflow() {
+        let mut args = Args::new();
+        for i in 0..FMR_MAX_ARGC { args.append(i as u64); }
+
+        let mut packet = FmrPacket::new(FmrClass::call);
+        assert!(create_call(&mut packet, 0, 0, LfType::lf_void, &args).is_none());
+    }
 }
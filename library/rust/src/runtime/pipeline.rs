@@ -0,0 +1,672 @@
+//! An asynchronous FMR client that keeps several requests in flight at once.
+//!
+//! `AsyncClient` mirrors the blocking `Client` API, but `invoke`, `push`, `pull`, `malloc` and
+//! `free` return futures instead of blocking on the transport. Each request is assigned a
+//! sequence number when it is submitted and is written to the transport as soon as the
+//! window allows, without waiting for the results of the requests before it. Flipper answers
+//! packets strictly in the order it receives them, so results are matched back to their
+//! sequence numbers by the order in which they arrive.
+//!
+//! A future that writes requests yields before reading any results, so that every other
+//! future being polled gets to submit and write its own requests first. This is what lets
+//! requests pipeline over a blocking transport, where a read waits for the device to answer.
+//! Loads of a module that is already being loaded wait for that load rather than sending
+//! another.
+//!
+//! The client doesn't depend on any particular async runtime. Transports implement
+//! `AsyncTransport`, and any executor can poll the returned futures. For programs that don't
+//! already have one, `block_on` and `join_all` provide a minimal single-threaded executor:
+//!
+//! ```rust-norun
+//! use flipper::{AsyncClient, Args, Blocking, LfType, block_on, join_all};
+//!
+//! let boards: Vec<AsyncClient<_>> = transports.into_iter()
+//!     .map(|transport| AsyncClient::new(Blocking(transport)))
+//!     .collect();
+//!
+//! let mut args = Args::new();
+//! args.append(10u8).append(0u8).append(10u8);
+//!
+//! // Sends the call to every board before waiting on any of the results.
+//! let calls = boards.iter().map(|board| board.invoke("led", 0, LfType::lf_void, &args));
+//! let results = block_on(join_all(calls.collect()));
+//! ```
+
+use std::mem::{self, size_of};
+use std::pin::Pin;
+use std::rc::Rc;
+use std::sync::Arc;
+use std::cell::RefCell;
+use std::future::Future;
+use std::thread::{self, Thread};
+use std::io::{self as io, Read, Write};
+use std::collections::{HashMap, HashSet, VecDeque};
+use std::task::{Context, Poll, RawWaker, RawWakerVTable, Waker};
+
+use crate::error::{Result, FlipperError};
+use crate::runtime::{Args, Module, Modules, create_call, create_dyld};
+use crate::runtime::protocol::*;
+
+/// The number of requests that may be outstanding on a transport by default.
+pub const DEFAULT_WINDOW: usize = 8;
+
+/// Identifies a request submitted to an `AsyncClient`.
+pub type Seq = u32;
+
+/// A non-blocking byte transport to a Flipper device.
+///
+/// Implementations follow the usual poll contract: if no progress can be made, they return
+/// `Poll::Pending` and arrange for the waker in `cx` to be woken once they can.
+pub trait AsyncTransport {
+    fn poll_read(&mut self, cx: &mut Context, buf: &mut [u8]) -> Poll<io::Result<usize>>;
+    fn poll_write(&mut self, cx: &mut Context, buf: &[u8]) -> Poll<io::Result<usize>>;
+}
+
+/// Adapts a blocking transport, such as `UsbClient`, to `AsyncTransport`.
+///
+/// Every operation completes immediately, and a read blocks until the device answers. Requests
+/// are still pipelined, because the requests of every future polled together are written
+/// before the first result is read.
+pub struct Blocking<T>(pub T);
+
+impl<T: Read + Write> AsyncTransport for Blocking<T> {
+    fn poll_read(&mut self, _cx: &mut Context, buf: &mut [u8]) -> Poll<io::Result<usize>> {
+        Poll::Ready(self.0.read(buf))
+    }
+
+    fn poll_write(&mut self, _cx: &mut Context, buf: &[u8]) -> Poll<io::Result<usize>> {
+        Poll::Ready(self.0.write(buf))
+    }
+}
+
+/// A request waiting to be written to the transport.
+struct Request {
+    seq: Seq,
+    packet: FmrPacket,
+    /// Data that follows the packet, for push requests.
+    payload: Vec<u8>,
+    /// The number of bytes the device sends back ahead of the result, for pull requests.
+    pull_len: usize,
+    /// The name of the module being loaded, for dyld requests.
+    load: Option<String>,
+}
+
+impl Request {
+    fn len(&self) -> usize {
+        FMR_PACKET_SIZE + self.payload.len()
+    }
+
+    /// The bytes of this request that haven't been written yet.
+    fn remaining(&self, written: usize) -> &[u8] {
+        if written < FMR_PACKET_SIZE {
+            unsafe { &self.packet.as_bytes()[written..] }
+        } else {
+            &self.payload[written - FMR_PACKET_SIZE..]
+        }
+    }
+}
+
+/// A request that has been sent, or is being sent, and hasn't been answered yet.
+struct InFlight {
+    seq: Seq,
+    pull_len: usize,
+    load: Option<String>,
+}
+
+/// The device's answer to a single request.
+struct Response {
+    result: FmrReturn,
+    data: Vec<u8>,
+}
+
+struct Inner<T: AsyncTransport> {
+    transport: T,
+    modules: Modules,
+    window: usize,
+    next_seq: Seq,
+    queued: VecDeque<Request>,
+    writing: Option<(Request, usize)>,
+    in_flight: VecDeque<InFlight>,
+    reading: Vec<u8>,
+    read_len: usize,
+    completed: HashMap<Seq, Response>,
+    abandoned: HashSet<Seq>,
+    waiting: HashMap<Seq, Waker>,
+    /// The dyld request in flight for each module being loaded.
+    loading: HashMap<String, Seq>,
+    /// The loads waiting on each dyld request, besides the one that sent it.
+    followers: HashMap<Seq, Vec<Waker>>,
+    failed: Option<io::ErrorKind>,
+}
+
+impl<T: AsyncTransport> Inner<T> {
+    fn submit(&mut self, mut packet: FmrPacket, payload: Vec<u8>, pull_len: usize, load: Option<String>) -> Seq {
+        let seq = self.next_seq;
+        self.next_seq = self.next_seq.wrapping_add(1);
+
+        if let Some(ref module) = load { self.loading.insert(module.clone(), seq); }
+        packet.seal();
+        self.queued.push_back(Request { seq, packet, payload, pull_len, load });
+        seq
+    }
+
+    /// Moves as many bytes as the transport will currently accept or provide.
+    fn drive(&mut self, cx: &mut Context) {
+        if self.failed.is_some() { return; }
+        if let Err(e) = self.drive_io(cx) {
+            self.failed = Some(e.kind());
+            self.wake_all();
+        }
+    }
+
+    fn drive_io(&mut self, cx: &mut Context) -> io::Result<()> {
+
+        // Write queued requests for as long as the window has room
+        let mut wrote = false;
+        loop {
+            if self.writing.is_none() {
+                if self.in_flight.len() >= self.window { break; }
+                let request = match self.queued.pop_front() {
+                    Some(request) => request,
+                    None => break,
+                };
+                let load = request.load.clone();
+                self.in_flight.push_back(InFlight { seq: request.seq, pull_len: request.pull_len, load });
+                self.writing = Some((request, 0));
+            }
+
+            let Inner { transport, writing, .. } = self;
+            let (request, written) = writing.as_mut().unwrap();
+            let sent = match transport.poll_write(cx, request.remaining(*written)) {
+                Poll::Ready(sent) => sent?,
+                Poll::Pending => break,
+            };
+            if sent == 0 { return Err(io::ErrorKind::WriteZero.into()); }
+
+            *written += sent;
+            wrote = true;
+            if *written == request.len() { self.writing = None; }
+        }
+
+        // Give the other pending futures a turn to submit and write their requests before
+        // reading, which may block until the device has answered everything written so far.
+        if wrote {
+            cx.waker().wake_by_ref();
+            return Ok(());
+        }
+
+        // Read results in the order the requests were sent
+        while let Some(front) = self.in_flight.front() {
+            let still_writing = self.writing.as_ref()
+                .map_or(false, |(request, _)| request.seq == front.seq);
+            if still_writing { break; }
+
+            let seq = front.seq;
+            let pull_len = front.pull_len;
+            let expected = pull_len + size_of::<FmrReturn>();
+            self.reading.resize(expected, 0);
+
+            if self.read_len < expected {
+                let Inner { transport, reading, read_len, .. } = self;
+                let read = match transport.poll_read(cx, &mut reading[*read_len..]) {
+                    Poll::Ready(read) => read?,
+                    Poll::Pending => break,
+                };
+                if read == 0 { return Err(io::ErrorKind::UnexpectedEof.into()); }
+                *read_len += read;
+                continue;
+            }
+
+            let mut result = FmrReturn::new();
+            unsafe { result.as_bytes_mut() }.copy_from_slice(&self.reading[pull_len..]);
+            let data = self.reading[..pull_len].to_vec();
+            self.read_len = 0;
+            let answered = self.in_flight.pop_front().unwrap();
+
+            // Loaded modules are registered here rather than by the load that sent the request,
+            // so that the loads following it find the module as soon as they are woken.
+            if let Some(module) = answered.load {
+                if result.error == 0 {
+                    self.modules.register(Module::new(module.clone(), result.value as u32, 0));
+                }
+                self.loading.remove(&module);
+                for waker in self.followers.remove(&seq).unwrap_or_default() { waker.wake(); }
+            }
+
+            if self.abandoned.remove(&seq) { continue; }
+            self.completed.insert(seq, Response { result, data });
+            if let Some(waker) = self.waiting.remove(&seq) { waker.wake(); }
+        }
+
+        Ok(())
+    }
+
+    /// Wakes every pending request so that one of them picks up driving the transport.
+    fn wake_all(&mut self) {
+        for (_, waker) in self.waiting.drain() { waker.wake(); }
+        for (_, wakers) in self.followers.drain() {
+            for waker in wakers { waker.wake(); }
+        }
+    }
+}
+
+/// A future that resolves to the device's response to one request.
+struct Reply<T: AsyncTransport> {
+    inner: Rc<RefCell<Inner<T>>>,
+    seq: Seq,
+    done: bool,
+}
+
+impl<T: AsyncTransport> Future for Reply<T> {
+    type Output = io::Result<Response>;
+
+    fn poll(mut self: Pin<&mut Self>, cx: &mut Context) -> Poll<Self::Output> {
+        let seq = self.seq;
+        let poll = {
+            let mut inner = self.inner.borrow_mut();
+            inner.drive(cx);
+
+            if let Some(response) = inner.completed.remove(&seq) {
+                // The transport may be holding our waker, so hand driving off to the others
+                inner.wake_all();
+                Poll::Ready(Ok(response))
+            } else if let Some(kind) = inner.failed {
+                inner.waiting.remove(&seq);
+                Poll::Ready(Err(kind.into()))
+            } else {
+                inner.waiting.insert(seq, cx.waker().clone());
+                Poll::Pending
+            }
+        };
+
+        if poll.is_ready() { self.done = true; }
+        poll
+    }
+}
+
+/// A future that resolves once the dyld request `seq`, sent by another load, has been answered.
+struct Follow<T: AsyncTransport> {
+    inner: Rc<RefCell<Inner<T>>>,
+    seq: Seq,
+}
+
+impl<T: AsyncTransport> Future for Follow<T> {
+    type Output = io::Result<()>;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context) -> Poll<Self::Output> {
+        let mut inner = self.inner.borrow_mut();
+        inner.drive(cx);
+
+        if let Some(kind) = inner.failed { return Poll::Ready(Err(kind.into())); }
+        if !inner.loading.values().any(|&seq| seq == self.seq) { return Poll::Ready(Ok(())); }
+
+        let wakers = inner.followers.entry(self.seq).or_insert_with(Vec::new);
+        if !wakers.iter().any(|waker| waker.will_wake(cx.waker())) { wakers.push(cx.waker().clone()); }
+        Poll::Pending
+    }
+}
+
+impl<T: AsyncTransport> Drop for Reply<T> {
+    fn drop(&mut self) {
+        if self.done { return; }
+        let mut inner = self.inner.borrow_mut();
+        inner.waiting.remove(&self.seq);
+        if inner.completed.remove(&self.seq).is_none() {
+            inner.abandoned.insert(self.seq);
+        }
+        inner.wake_all();
+    }
+}
+
+/// A Flipper client whose operations return futures and may be pipelined.
+///
+/// An `AsyncClient` is cheap to share within a thread: every operation takes `&self`, so any
+/// number of them can be outstanding at once.
+pub struct AsyncClient<T: AsyncTransport> {
+    inner: Rc<RefCell<Inner<T>>>,
+}
+
+impl<T: AsyncTransport> AsyncClient<T> {
+    pub fn new(transport: T) -> AsyncClient<T> {
+        AsyncClient::with_window(transport, DEFAULT_WINDOW)
+    }
+
+    /// Creates a client that allows at most `window` requests to be outstanding at once.
+    pub fn with_window(transport: T, window: usize) -> AsyncClient<T> {
+        let inner = Inner {
+            transport,
+            modules: Modules::new(),
+            window: window.max(1),
+            next_seq: 0,
+            queued: VecDeque::new(),
+            writing: None,
+            in_flight: VecDeque::new(),
+            reading: Vec::new(),
+            read_len: 0,
+            completed: HashMap::new(),
+            abandoned: HashSet::new(),
+            waiting: HashMap::new(),
+            loading: HashMap::new(),
+            followers: HashMap::new(),
+            failed: None,
+        };
+        AsyncClient { inner: Rc::new(RefCell::new(inner)) }
+    }
+
+    fn submit(&self, packet: FmrPacket, payload: Vec<u8>, pull_len: usize) -> Reply<T> {
+        let seq = self.inner.borrow_mut().submit(packet, payload, pull_len, None);
+        Reply { inner: self.inner.clone(), seq, done: false }
+    }
+
+    /// Given a module name, returns the index of that module on this device.
+    ///
+    /// Concurrent loads of the same module share a single request to the device.
+    pub async fn load(&self, module: &str) -> Result<u64> {
+        if let Some(index) = self.inner.borrow().modules.find(module) {
+            return Ok(index as u64);
+        }
+
+        let loading = self.inner.borrow().loading.get(module).cloned();
+        if let Some(seq) = loading {
+            Follow { inner: self.inner.clone(), seq }.await
+                .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+            let index = self.inner.borrow().modules.find(module).ok_or(FlipperError::Load)?;
+            return Ok(index as u64);
+        }
+
+        let mut packet = FmrPacket::new(FmrClass::dyld);
+        create_dyld(&mut packet, module).ok_or(FlipperError::Load)?;
+
+        // The module is registered once the device answers, before the response is handed back
+        let seq = self.inner.borrow_mut().submit(packet, Vec::new(), 0, Some(module.to_string()));
+        let response = Reply { inner: self.inner.clone(), seq, done: false }.await
+            .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+        if response.result.error != 0 { Err(FlipperError::Load)?; }
+
+        Ok(response.result.value)
+    }
+
+    /// Executes a function on the device. See `Client::invoke`.
+    pub async fn invoke(&self, module: &str, function: LfFunction, ret: LfType, args: &Args) -> Result<u64> {
+        let module = self.load(module).await?;
+
+        let mut packet = FmrPacket::new(FmrClass::call);
+        create_call(&mut packet, module as u32, function, ret, args)
+            .ok_or(FlipperError::Invoke)?;
+
+        let response = self.submit(packet, Vec::new(), 0).await
+            .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+
+        Ok(response.result.value)
+    }
+
+    /// Pushes a buffer of data to a location in Flipper's memory space. See `Client::push`.
+    pub async fn push(&self, pointer: LfPointer, data: &[u8]) -> Result<()> {
+        let mut packet = FmrPacket::new(FmrClass::push);
+        unsafe {
+            packet.body.data.len = data.len() as u32;
+            packet.body.data.ptr = pointer.0 as u64;
+        }
+
+        let response = self.submit(packet, data.to_vec(), 0).await
+            .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+        if response.result.error != 0 { Err(FlipperError::Push)?; }
+        Ok(())
+    }
+
+    /// Pulls a buffer of data from a location in Flipper's memory space. See `Client::pull`.
+    pub async fn pull(&self, pointer: LfPointer, buffer: &mut [u8]) -> Result<()> {
+        let mut packet = FmrPacket::new(FmrClass::pull);
+        unsafe {
+            packet.body.data.len = buffer.len() as u32;
+            packet.body.data.ptr = pointer.0 as u64;
+        }
+
+        let response = self.submit(packet, Vec::new(), buffer.len()).await
+            .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+        if response.result.error != 0 { Err(FlipperError::Pull)?; }
+        buffer.copy_from_slice(&response.data);
+        Ok(())
+    }
+
+    /// Allocates a buffer of data of the given size in Flipper's memory space.
+    pub async fn malloc(&self, size: u32) -> Result<LfPointer> {
+        let mut packet = FmrPacket::new(FmrClass::malloc);
+        unsafe {
+            packet.body.memory.size = size;
+        }
+
+        let response = self.submit(packet, Vec::new(), 0).await
+            .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+        if response.result.error != 0 { Err(FlipperError::Malloc)?; }
+        Ok(LfPointer(response.result.value as u32))
+    }
+
+    /// Frees a buffer of memory in Flipper's memory space.
+    pub async fn free(&self, pointer: LfPointer) -> Result<()> {
+        let mut packet = FmrPacket::new(FmrClass::free);
+        unsafe {
+            packet.body.memory.ptr = pointer.0 as u64;
+        }
+
+        let response = self.submit(packet, Vec::new(), 0).await
+            .map_err(|ioe| FlipperError::Io { inner: ioe })?;
+        if response.result.error != 0 { Err(FlipperError::Free)?; }
+        Ok(())
+    }
+}
+
+/// Runs a future to completion on the current thread, parking it while the future is pending.
+pub fn block_on<F: Future>(future: F) -> F::Output {
+    let mut future = Box::pin(future);
+    let waker = thread_waker(Arc::new(thread::current()));
+    let mut cx = Context::from_waker(&waker);
+    loop {
+        if let Poll::Ready(output) = future.as_mut().poll(&mut cx) { return output; }
+        thread::park();
+    }
+}
+
+/// A future that polls every future in a list and resolves to all of their outputs, in order.
+pub struct JoinAll<F: Future> {
+    futures: Vec<Pin<Box<F>>>,
+    outputs: Vec<Option<F::Output>>,
+}
+
+/// Waits on all of the given futures concurrently. Each future is polled before any of them
+/// is waited on, so requests from every future are submitted up front.
+pub fn join_all<F: Future>(futures: Vec<F>) -> JoinAll<F> {
+    let outputs = futures.iter().map(|_| None).collect();
+    let futures = futures.into_iter().map(Box::pin).collect();
+    JoinAll { futures, outputs }
+}
+
+impl<F: Future> Future for JoinAll<F> {
+    type Output = Vec<F::Output>;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context) -> Poll<Self::Output> {
+        // Neither field is structurally pinned: the futures are already boxed.
+        let this = unsafe { self.get_unchecked_mut() };
+
+        let mut done = true;
+        for (future, output) in this.futures.iter_mut().zip(this.outputs.iter_mut()) {
+            if output.is_some() { continue; }
+            match future.as_mut().poll(cx) {
+                Poll::Ready(value) => *output = Some(value),
+                Poll::Pending => done = false,
+            }
+        }
+
+        if !done { return Poll::Pending; }
+        Poll::Ready(this.outputs.iter_mut().map(|output| output.take().unwrap()).collect())
+    }
+}
+
+static THREAD_WAKER_VTABLE: RawWakerVTable = RawWakerVTable::new(
+    thread_waker_clone,
+    thread_waker_wake,
+    thread_waker_wake_by_ref,
+    thread_waker_drop,
+);
+
+fn thread_waker(thread: Arc<Thread>) -> Waker {
+    unsafe { Waker::from_raw(thread_raw_waker(thread)) }
+}
+
+fn thread_raw_waker(thread: Arc<Thread>) -> RawWaker {
+    RawWaker::new(Arc::into_raw(thread) as *const (), &THREAD_WAKER_VTABLE)
+}
+
+unsafe fn thread_waker_clone(data: *const ()) -> RawWaker {
+    let thread = Arc::from_raw(data as *const Thread);
+    let clone = thread.clone();
+    mem::forget(thread);
+    thread_raw_waker(clone)
+}
+
+unsafe fn thread_waker_wake(data: *const ()) {
+    Arc::from_raw(data as *const Thread).unpark();
+}
+
+unsafe fn thread_waker_wake_by_ref(data: *const ()) {
+    (*(data as *const Thread)).unpark();
+}
+
+unsafe fn thread_waker_drop(data: *const ()) {
+    drop(Arc::from_raw(data as *const Thread));
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A device that answers each packet as soon as it has been fully written.
+    struct Device {
+        received: Vec<u8>,
+        responses: VecDeque<u8>,
+        packets: usize,
+        dylds: usize,
+        bytes_read: usize,
+        max_outstanding: usize,
+    }
+
+    impl Device {
+        fn new() -> Device {
+            Device {
+                received: Vec::new(),
+                responses: VecDeque::new(),
+                packets: 0,
+                dylds: 0,
+                bytes_read: 0,
+                max_outstanding: 0,
+            }
+        }
+    }
+
+    impl Read for Device {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            // A real device would block here forever, waiting for a packet that was never sent.
+            if self.responses.is_empty() { return Err(io::ErrorKind::WouldBlock.into()); }
+            let len = buf.len().min(self.responses.len());
+            for byte in buf[..len].iter_mut() { *byte = self.responses.pop_front().unwrap(); }
+            self.bytes_read += len;
+            Ok(len)
+        }
+    }
+
+    impl Write for Device {
+        fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+            self.received.extend_from_slice(buf);
+            while self.received.len() >= FMR_PACKET_SIZE {
+                let packet: Vec<u8> = self.received.drain(..FMR_PACKET_SIZE).collect();
+                let mut result = FmrReturn::new();
+
+                // Answer dyld with module index 3, and calls with their function index
+                result.value = match packet[5] {
+                    3 => { self.dylds += 1; 3 }
+                    0 => packet[7] as u64,
+                    _ => 0,
+                };
+                self.responses.extend(unsafe { result.as_bytes_mut() }.iter());
+                self.packets += 1;
+                let outstanding = self.packets - self.bytes_read / size_of::<FmrReturn>();
+                self.max_outstanding = self.max_outstanding.max(outstanding);
+            }
+            Ok(buf.len())
+        }
+
+        fn flush(&mut self) -> io::Result<()> {
+            Ok(())
+        }
+    }
+
+    /// A device that only moves data on every other poll.
+    struct MockTransport {
+        device: Device,
+        ready: bool,
+    }
+
+    impl MockTransport {
+        fn new() -> MockTransport {
+            MockTransport { device: Device::new(), ready: false }
+        }
+
+        /// Alternates between making progress and asking to be polled again.
+        fn toggle(&mut self, cx: &mut Context) -> bool {
+            self.ready = !self.ready;
+            if !self.ready { cx.waker().wake_by_ref(); }
+            self.ready
+        }
+    }
+
+    impl AsyncTransport for MockTransport {
+        fn poll_read(&mut self, cx: &mut Context, buf: &mut [u8]) -> Poll<io::Result<usize>> {
+            if !self.toggle(cx) || self.device.responses.is_empty() { return Poll::Pending; }
+            Poll::Ready(self.device.read(buf))
+        }
+
+        fn poll_write(&mut self, cx: &mut Context, buf: &[u8]) -> Poll<io::Result<usize>> {
+            if !self.toggle(cx) { return Poll::Pending; }
+            Poll::Ready(self.device.write(buf))
+        }
+    }
+
+    #[test]
+    fn test_pipelined_invoke() {
+        let client = AsyncClient::with_window(MockTransport::new(), 4);
+        let args = Args::new();
+
+        let calls = (0..8).map(|function| client.invoke("led", function, LfType::lf_void, &args));
+        let results = block_on(join_all(calls.collect()));
+
+        for (function, result) in results.into_iter().enumerate() {
+            assert_eq!(result.unwrap(), function as u64);
+        }
+
+        let inner = client.inner.borrow();
+        assert!(inner.transport.device.max_outstanding > 1);
+        assert!(inner.transport.device.max_outstanding <= 4);
+        assert_eq!(inner.transport.device.dylds, 1);
+        assert!(inner.completed.is_empty());
+        assert!(inner.waiting.is_empty());
+        assert!(inner.loading.is_empty());
+    }
+
+    #[test]
+    fn test_blocking_pipelines() {
+        let client = AsyncClient::with_window(Blocking(Device::new()), 4);
+        let args = Args::new();
+
+        let calls = (0..8).map(|function| client.invoke("led", function, LfType::lf_void, &args));
+        let results = block_on(join_all(calls.collect()));
+
+        for (function, result) in results.into_iter().enumerate() {
+            assert_eq!(result.unwrap(), function as u64);
+        }
+
+        // Every call in the window is written before the first of their results is read.
+        let inner = client.inner.borrow();
+        assert_eq!(inner.transport.0.max_outstanding, 4);
+        assert_eq!(inner.transport.0.dylds, 1);
+    }
+}
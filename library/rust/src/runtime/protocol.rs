@@ -3,9 +3,15 @@ use std::mem::size_of;
 use std::os::raw::c_char;
 use std::fmt::{self as fmt, Debug};
 
+use super::crc;
+
 pub const FMR_MAGIC_NUMBER: u8 = 0xFE;
 pub const FMR_PACKET_SIZE: usize = 64;
 pub const FMR_PAYLOAD_SIZE: usize = FMR_PACKET_SIZE - size_of::<FmrHeader>();
+/// The number of argument types that can be encoded in a call's `argt` word.
+pub const FMR_MAX_ARGC: usize = size_of::<LfTypes>() * 8 / 4;
+/// The number of bytes of argument values that fit in a call packet.
+pub const FMR_MAX_ARGV: usize = FMR_PAYLOAD_SIZE - size_of::<FmrCall>();
 
 #[derive(Copy, Clone)]
 #[repr(C, packed)]
@@ -35,6 +41,20 @@ pub enum FmrClass {
     free = 5,
 }
 
+impl FmrClass {
+    pub fn from(byte: u8) -> Option<FmrClass> {
+        match byte {
+            0 => Some(FmrClass::call),
+            1 => Some(FmrClass::push),
+            2 => Some(FmrClass::pull),
+            3 => Some(FmrClass::dyld),
+            4 => Some(FmrClass::malloc),
+            5 => Some(FmrClass::free),
+            _ => None
+        }
+    }
+}
+
 #[derive(Debug, Copy, Clone)]
 #[repr(C, packed)]
 pub struct FmrHeader {
@@ -78,6 +98,15 @@ impl FmrPacket {
         }
     }
 
+    /// Calculates the crc over the first `header.len` bytes of the packet and stores it in
+    /// the header.
+    pub fn seal(&mut self) {
+        self.header.crc = 0;
+        let len = self.header.len as usize;
+        let crc = crc::checksum(unsafe { &self.as_bytes()[..len] });
+        self.header.crc = crc;
+    }
+
     #[allow(dead_code)]
     pub unsafe fn as_bytes(&self) -> &[u8] {
         slice::from_raw_parts(self as *const _ as *const u8, size_of::<Self>())
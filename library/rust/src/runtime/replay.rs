@@ -0,0 +1,288 @@
+//! Plays a recorded session back against another device.
+//!
+//! A session is a capture written by a `trace::Tracer` with payloads enabled. Replaying it
+//! sends every recorded packet, in order, to a stand-in for the original device, such as a
+//! host emulator reached with `UdpClient`, and times each answer. Comparing those times with
+//! the recorded ones turns a production workload into a repeatable benchmark.
+//!
+//! The stand-in generally places modules and allocations differently than the original
+//! device did, so resolves are repeated on it and the module indices of calls are rewritten
+//! to match, as are the addresses used by pushes, pulls and frees of memory that was
+//! allocated during the session. Packets are sent as-is to the stand-in, whichever processor
+//! of the original device they were routed to. Calls that were recorded as part of a batch
+//! are replayed one at a time.
+//!
+//! The original client only asked the device the first time it resolved each module, and
+//! answered later resolves from its cache. Replay does the same with a cache of its own,
+//! rather than relying on the stand-in's client, which may already hold modules it loaded
+//! before the replay started.
+
+use std::collections::HashMap;
+use std::io::{self, Read, Write};
+use std::time::Instant;
+
+use super::{Client, Route};
+use super::trace::{elapsed_micros, Record, RecordKind};
+use super::protocol::{FmrClass, FmrPacket, FmrReturn, FMR_PACKET_SIZE};
+use crate::error::{FlipperError, Result};
+
+/// The offset of a call's module index within a packet.
+const CALL_MODULE: usize = 6;
+/// The offset of the device address used by push, pull and free packets.
+const ADDRESS: usize = 10;
+
+/// The outcome of replaying one recorded operation.
+#[derive(Debug, Clone)]
+pub struct Replayed {
+    /// The recorded packet or resolve, as it was originally sent.
+    pub record: Record,
+    /// How long the stand-in took, in µs.
+    pub latency: u32,
+    /// The value the stand-in returned, or `None` if the operation failed.
+    pub outcome: Option<u64>,
+}
+
+impl Replayed {
+    /// How much slower the stand-in was than the original device, in µs.
+    pub fn delta(&self) -> i64 {
+        i64::from(self.latency) - i64::from(self.record.latency)
+    }
+
+    /// Whether the stand-in answered as the original device did. Allocations and resolves
+    /// only need to have succeeded in both, since the stand-in may place them elsewhere.
+    pub fn matches(&self) -> bool {
+        let recorded = if self.record.ok { Some(self.record.value) } else { None };
+        match (self.record.kind, self.record.class()) {
+            (RecordKind::Resolve, _) | (_, Some(FmrClass::malloc)) => recorded.is_some() == self.outcome.is_some(),
+            _ => recorded == self.outcome,
+        }
+    }
+}
+
+fn io_error(ioe: io::Error) -> FlipperError {
+    FlipperError::Io { inner: ioe }
+}
+
+fn read_u64(bytes: &[u8], offset: usize) -> Option<u64> {
+    let mut value = [0u8; 8];
+    value.copy_from_slice(bytes.get(offset..offset + 8)?);
+    Some(u64::from_le_bytes(value))
+}
+
+/// Replays a session against `client`, returning the outcome of each recorded packet and
+/// resolve in order. Fails only if the stand-in can't be communicated with.
+pub fn replay<C, I>(client: &mut C, records: I) -> Result<Vec<Replayed>>
+    where C: Client + ?Sized,
+          I: IntoIterator<Item = Record>,
+{
+    let mut modules: HashMap<(Route, u64), u64> = HashMap::new();
+    let mut resolved: HashMap<String, u64> = HashMap::new();
+    let mut addresses: HashMap<u64, u64> = HashMap::new();
+    let mut replayed = Vec::new();
+
+    let mut records = records.into_iter().peekable();
+    while let Some(record) = records.next() {
+        match record.kind {
+            RecordKind::Resolve => {
+                let name = match record.name() {
+                    Some(name) => name.to_owned(),
+                    None => continue,
+                };
+
+                // Only modules that were loaded are cached, so failed resolves go to the stand-in again.
+                let start = Instant::now();
+                let outcome = match resolved.get(&name) {
+                    Some(&index) => Some(index),
+                    None => client.lookup(&name).ok(),
+                };
+                let latency = elapsed_micros(start);
+                if let Some(index) = outcome { resolved.insert(name, index); }
+
+                if let (true, Some(index)) = (record.ok, outcome) {
+                    modules.insert((record.route, record.value), index);
+                }
+                replayed.push(Replayed { record, latency, outcome });
+            }
+            RecordKind::Packet => {
+                let mut packet = FmrPacket::new(FmrClass::call);
+                {
+                    let bytes = unsafe { packet.as_bytes_mut() };
+                    let len = record.data.len().min(FMR_PACKET_SIZE);
+                    bytes[..len].copy_from_slice(&record.data[..len]);
+                }
+
+                let class = record.class();
+                match class {
+                    Some(FmrClass::call) => {
+                        let recorded = u64::from(record.data[CALL_MODULE]);
+                        if let Some(&index) = modules.get(&(record.route, recorded)) {
+                            unsafe { packet.as_bytes_mut()[CALL_MODULE] = index as u8; }
+                        }
+                    }
+                    Some(FmrClass::push) | Some(FmrClass::pull) | Some(FmrClass::free) => {
+                        let recorded = read_u64(unsafe { packet.as_bytes() }, ADDRESS);
+                        if let Some(&address) = recorded.and_then(|address| addresses.get(&address)) {
+                            let bytes = unsafe { packet.as_bytes_mut() };
+                            bytes[ADDRESS..ADDRESS + 8].copy_from_slice(&address.to_le_bytes());
+                        }
+                    }
+                    _ => (),
+                }
+                packet.seal();
+
+                // The transfer length is the first field of a push or pull body.
+                let transfer = match class {
+                    Some(FmrClass::push) | Some(FmrClass::pull) => unsafe { packet.body.data.len as usize },
+                    _ => 0,
+                };
+                let payload = match records.peek() {
+                    Some(next) if next.kind == RecordKind::Payload => records.next().map(|next| next.data),
+                    _ => None,
+                };
+
+                let start = Instant::now();
+                client.writer().write(unsafe { packet.as_bytes() }).map_err(io_error)?;
+                match class {
+                    Some(FmrClass::push) => {
+                        // Sessions recorded without payloads push zeroes of the same length.
+                        let data = payload.unwrap_or_else(|| vec![0; transfer]);
+                        client.writer().write(&data).map_err(io_error)?;
+                    }
+                    Some(FmrClass::pull) => {
+                        let mut data = vec![0; transfer];
+                        client.reader().read(&mut data).map_err(io_error)?;
+                    }
+                    _ => (),
+                }
+                let mut result = FmrReturn::new();
+                client.reader().read(unsafe { result.as_bytes_mut() }).map_err(io_error)?;
+                let latency = elapsed_micros(start);
+
+                let outcome = if result.error == 0 { Some(result.value) } else { None };
+                if let (Some(FmrClass::malloc), true, Some(address)) = (class, record.ok, outcome) {
+                    addresses.insert(record.value, address);
+                }
+                replayed.push(Replayed { record, latency, outcome });
+            }
+            // A payload without a push or pull before it has nothing to replay.
+            RecordKind::Payload => (),
+        }
+    }
+    Ok(replayed)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::runtime::{Module, Modules};
+    use crate::runtime::__private::call_packet;
+    use crate::runtime::create_transfer;
+    use crate::runtime::trace::recorded_bytes;
+    use crate::runtime::protocol::{LfPointer, LfType};
+
+    /// A stand-in device that loads every module at index 9, allocates everything at
+    /// 0x2000, and otherwise answers with the module index of the call it was sent.
+    struct StandIn {
+        modules: Modules,
+        sent: Vec<Vec<u8>>,
+        answers: Vec<u8>,
+    }
+
+    impl Read for StandIn {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            let len = buf.len().min(self.answers.len());
+            buf[..len].copy_from_slice(&self.answers[..len]);
+            self.answers.drain(..len);
+            Ok(len)
+        }
+    }
+
+    impl Write for StandIn {
+        fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+            self.sent.push(buf.to_vec());
+            let answer = match buf.get(5) {
+                _ if buf.len() != FMR_PACKET_SIZE => return Ok(buf.len()),
+                Some(3) => 9,
+                Some(4) => 0x2000,
+                Some(0) => u64::from(buf[CALL_MODULE]),
+                _ => 0,
+            };
+            self.answers.extend_from_slice(&answer.to_le_bytes());
+            self.answers.push(0);
+            Ok(buf.len())
+        }
+        fn flush(&mut self) -> io::Result<()> { Ok(()) }
+    }
+
+    impl Client for StandIn {
+        fn modules(&mut self) -> &mut Modules { &mut self.modules }
+        fn reader(&mut self) -> &mut Read { self }
+        fn writer(&mut self) -> &mut Write { self }
+    }
+
+    fn packet_record(packet: &mut FmrPacket, value: u64) -> Record {
+        packet.seal();
+        Record {
+            kind: RecordKind::Packet,
+            route: Route::Primary,
+            ok: true,
+            timestamp: 0,
+            latency: 100,
+            value,
+            data: recorded_bytes(packet).to_vec(),
+        }
+    }
+
+    #[test]
+    fn test_replay_remaps_session() {
+        let resolve = Record {
+            kind: RecordKind::Resolve,
+            route: Route::Primary,
+            ok: true,
+            timestamp: 0,
+            latency: 100,
+            value: 2,
+            data: b"led".to_vec(),
+        };
+
+        let mut call = call_packet(1, LfType::lf_uint32, 0, 0, 0);
+        unsafe { call.body.call.module = 2; }
+        let mut malloc = FmrPacket::new(FmrClass::malloc);
+        unsafe { malloc.body.memory.size = 4; }
+        let mut push = create_transfer(FmrClass::push, LfPointer(0x1000), 4);
+        let payload = Record { kind: RecordKind::Payload, value: 4, data: vec![1, 2, 3, 4], ..resolve.clone() };
+
+        let records = vec![
+            resolve.clone(),
+            resolve,
+            packet_record(&mut call, 2),
+            packet_record(&mut malloc, 0x1000),
+            packet_record(&mut push, 0),
+            payload,
+        ];
+
+        // The stand-in's client already has the module cached, which replay doesn't rely on.
+        let mut modules = Modules::new();
+        modules.register(Module::new("led".to_string(), 5, 0));
+        let mut stand_in = StandIn { modules, sent: Vec::new(), answers: Vec::new() };
+        let replayed = replay(&mut stand_in, records).unwrap();
+
+        assert_eq!(replayed.len(), 5);
+        // Only the first resolve was sent to the stand-in, as only the first was recorded doing so.
+        let dylds = stand_in.sent.iter().filter(|sent| sent.len() == FMR_PACKET_SIZE && sent[5] == 3).count();
+        assert_eq!(dylds, 1);
+        assert_eq!(replayed[0].outcome, Some(9));
+        assert_eq!(replayed[1].outcome, Some(9));
+
+        // The call was rewritten to the index the stand-in loaded the module at.
+        assert_eq!(replayed[2].outcome, Some(9));
+        assert!(!replayed[2].matches());
+        assert!(replayed[3].matches());
+        assert!(replayed[4].matches());
+
+        // The push targets the stand-in's allocation and carries the recorded payload.
+        let push = &stand_in.sent[stand_in.sent.len() - 2];
+        assert_eq!(read_u64(push, ADDRESS), Some(0x2000));
+        assert_eq!(stand_in.sent.last().unwrap(), &vec![1, 2, 3, 4]);
+    }
+}
@@ -0,0 +1,420 @@
+//! Capture of the FMR traffic between a host and a device.
+//!
+//! When a `Tracer` is attached to a `Flipper`, every packet it sends is recorded along with
+//! its result, a timestamp and the time the device took to answer. Records have a fixed
+//! 24-byte prefix followed by the bytes of the packet that was sent, and are written through
+//! a buffer, so tracing costs two clock reads and a copy of at most 88 bytes per packet.
+//!
+//! A tracer can also record the data moved by pushes and pulls, which makes the capture a
+//! complete session that `replay` can play back against another device.
+//!
+//! A capture starts with a 20-byte header:
+//!
+//! | offset | size | field                                             |
+//! |--------|------|---------------------------------------------------|
+//! | 0      | 8    | the magic bytes `FMRTRACE`                        |
+//! | 8      | 2    | the format version, currently 1                   |
+//! | 10     | 2    | reserved                                          |
+//! | 12     | 8    | when the capture started, in µs since the epoch   |
+//!
+//! Each record is then laid out as follows, with all integers little-endian:
+//!
+//! | offset | size | field                                                  |
+//! |--------|------|--------------------------------------------------------|
+//! | 0      | 1    | the kind of record: 0 for a packet, 1 for a resolve, 2 for a payload |
+//! | 1      | 1    | the route: 0 for the primary processor, 1 for the co-processor |
+//! | 2      | 1    | 1 if the operation succeeded, 0 otherwise              |
+//! | 3      | 1    | the length of the data that follows the prefix, except for payloads |
+//! | 4      | 8    | when the operation started, in µs since the capture started |
+//! | 12     | 4    | how long the operation took, in µs                     |
+//! | 16     | 8    | the value returned, the module index of a resolve, or the length of a payload |
+//! | 24     | len  | the packet as sent, without trailing zeroes, the name of the resolved module, or the payload |
+//!
+//! A payload record holds the data pushed or pulled by the packet record before it.
+
+use std::env;
+use std::fs::File;
+use std::io::{self, BufWriter, Read, Write};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+use super::{ModuleHandle, Route};
+use super::protocol::{FmrClass, FmrPacket, FMR_PACKET_SIZE};
+
+/// The bytes every capture starts with.
+pub const CAPTURE_MAGIC: &[u8; 8] = b"FMRTRACE";
+/// The version of the capture format written by this library.
+pub const CAPTURE_VERSION: u16 = 1;
+/// The environment variable which, when set to a path, makes every `Flipper` trace to it.
+/// Each device after the first traces to its own file, numbered as by `numbered_path`.
+pub const TRACE_ENV: &str = "FLIPPER_TRACE";
+/// The environment variable which, when set, makes traces started from `TRACE_ENV` also
+/// record push and pull payloads.
+pub const TRACE_PAYLOADS_ENV: &str = "FLIPPER_TRACE_PAYLOADS";
+
+const HEADER_SIZE: usize = 20;
+const PREFIX_SIZE: usize = 24;
+/// The largest payload a reader will accept, which guards against corrupt captures.
+const MAX_PAYLOAD: u64 = 16 * 1024 * 1024;
+
+/// The number of captures started from `TRACE_ENV` by this process.
+static ENV_CAPTURES: AtomicUsize = AtomicUsize::new(0);
+
+pub(crate) fn micros(duration: Duration) -> u64 {
+    duration.as_secs() * 1_000_000 + u64::from(duration.subsec_micros())
+}
+
+/// The time since `start` in µs, saturating at `u32::MAX`.
+pub(crate) fn elapsed_micros(start: Instant) -> u32 {
+    micros(start.elapsed()).min(u64::from(u32::max_value())) as u32
+}
+
+/// The bytes of `packet` that a capture records.
+///
+/// Only call and dyld packets count their bodies in `header.len`, so everything up to the last
+/// nonzero byte is kept instead. Readers treat the rest of the packet as zeroes.
+pub(crate) fn recorded_bytes(packet: &FmrPacket) -> &[u8] {
+    let bytes = unsafe { packet.as_bytes() };
+    let used = bytes.iter().rposition(|&byte| byte != 0).map_or(0, |last| last + 1);
+    &bytes[..used.max(packet.header.len as usize).min(FMR_PACKET_SIZE)]
+}
+
+/// The path of the `n`th capture of several sharing `path`. The first is written to `path`
+/// itself, and the others insert their number before its extension, as in `session.1.trace`.
+pub fn numbered_path(path: &Path, n: usize) -> PathBuf {
+    if n == 0 { return path.to_path_buf(); }
+    let mut name = path.file_stem().unwrap_or_default().to_os_string();
+    name.push(format!(".{}", n));
+    if let Some(extension) = path.extension() {
+        name.push(".");
+        name.push(extension);
+    }
+    path.with_file_name(name)
+}
+
+/// What a record describes.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum RecordKind {
+    /// A packet sent to the device, and the device's result.
+    Packet,
+    /// A module name being resolved to an index.
+    Resolve,
+    /// The data moved by the push or pull before it.
+    Payload,
+}
+
+/// A single entry of a capture.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Record {
+    pub kind: RecordKind,
+    pub route: Route,
+    pub ok: bool,
+    /// When the operation started, in µs since the capture started.
+    pub timestamp: u64,
+    /// How long the operation took, in µs.
+    pub latency: u32,
+    /// The value returned, the module index of a resolve, or the length of a payload.
+    pub value: u64,
+    /// The packet as sent, the name of the resolved module, or the payload.
+    pub data: Vec<u8>,
+}
+
+impl Record {
+    /// The class of a packet record.
+    pub fn class(&self) -> Option<FmrClass> {
+        match self.kind {
+            RecordKind::Packet => self.data.get(5).and_then(|&class| FmrClass::from(class)),
+            _ => None,
+        }
+    }
+
+    /// The module index and function of a call packet.
+    pub fn call(&self) -> Option<(u8, u8)> {
+        match self.class() {
+            Some(FmrClass::call) => Some((*self.data.get(6)?, *self.data.get(7)?)),
+            _ => None,
+        }
+    }
+
+    /// The module name of a resolve record.
+    pub fn name(&self) -> Option<&str> {
+        match self.kind {
+            RecordKind::Resolve => ::std::str::from_utf8(&self.data).ok(),
+            _ => None,
+        }
+    }
+}
+
+/// Writes a capture of the traffic of a `Flipper`.
+///
+/// Failing to write the capture never fails the operation being traced; the tracer stops
+/// recording instead.
+pub struct Tracer {
+    out: BufWriter<Box<Write>>,
+    epoch: Instant,
+    payloads: bool,
+    failed: bool,
+}
+
+impl Tracer {
+    /// Starts a capture written to `out`.
+    pub fn new<W: Write + 'static>(out: W) -> io::Result<Tracer> {
+        let mut out = BufWriter::with_capacity(64 * 1024, Box::new(out) as Box<Write>);
+        let since_epoch = SystemTime::now().duration_since(UNIX_EPOCH).unwrap_or_default();
+
+        let mut header = [0u8; HEADER_SIZE];
+        header[..8].copy_from_slice(CAPTURE_MAGIC);
+        header[8..10].copy_from_slice(&CAPTURE_VERSION.to_le_bytes());
+        header[12..20].copy_from_slice(&micros(since_epoch).to_le_bytes());
+        out.write_all(&header)?;
+
+        Ok(Tracer { out, epoch: Instant::now(), payloads: false, failed: false })
+    }
+
+    /// Sets whether the data moved by pushes and pulls is recorded. This is off by default,
+    /// since it costs a copy of every transfer.
+    pub fn with_payloads(mut self, payloads: bool) -> Tracer {
+        self.payloads = payloads;
+        self
+    }
+
+    /// Starts a capture written to the file at `path`, replacing it if it exists.
+    pub fn create<P: AsRef<Path>>(path: P) -> io::Result<Tracer> {
+        Tracer::new(File::create(path)?)
+    }
+
+    /// Starts a capture written to the path named by `FLIPPER_TRACE`, if it is set.
+    ///
+    /// Every device attached by a process gets a tracer of its own, so only the first capture
+    /// is written to the path as named. The ones after it are numbered, so that they don't
+    /// replace it.
+    pub fn from_env() -> Option<Tracer> {
+        let path = PathBuf::from(env::var_os(TRACE_ENV)?);
+        let path = numbered_path(&path, ENV_CAPTURES.fetch_add(1, Ordering::Relaxed));
+        match Tracer::create(&path) {
+            Ok(tracer) => Some(tracer.with_payloads(env::var_os(TRACE_PAYLOADS_ENV).is_some())),
+            Err(e) => {
+                warn!("failed to start trace at {:?}: {}", path, e);
+                None
+            }
+        }
+    }
+
+    fn record(&mut self, kind: RecordKind, route: Route, start: Instant, outcome: Option<u64>, data: &[u8]) {
+        if self.failed { return; }
+
+        // The length of the data is kept in a byte. Packets always fit, and a module name that
+        // doesn't couldn't have been sent in a dyld packet, so its record is left out rather
+        // than cut short.
+        if data.len() > u8::max_value() as usize {
+            warn!("not tracing a {}-byte record, longer than a record can hold", data.len());
+            return;
+        }
+
+        let timestamp = micros(start.duration_since(self.epoch));
+        let latency = elapsed_micros(start);
+        let len = data.len();
+
+        let mut prefix = [0u8; PREFIX_SIZE];
+        prefix[0] = kind as u8;
+        prefix[1] = match route { Route::Primary => 0, Route::Coprocessor => 1 };
+        prefix[2] = outcome.is_some() as u8;
+        prefix[3] = len as u8;
+        prefix[4..12].copy_from_slice(&timestamp.to_le_bytes());
+        prefix[12..16].copy_from_slice(&latency.to_le_bytes());
+        prefix[16..24].copy_from_slice(&outcome.unwrap_or(0).to_le_bytes());
+
+        let written = self.out.write_all(&prefix).and_then(|_| self.out.write_all(data));
+        if let Err(e) = written {
+            warn!("failed to write trace, stopping: {}", e);
+            self.failed = true;
+        }
+    }
+
+    /// Records a packet which was sent at `start`. `outcome` is the value the device
+    /// returned, or `None` if the operation failed.
+    pub fn packet(&mut self, start: Instant, route: Route, packet: &FmrPacket, outcome: Option<u64>) {
+        self.record(RecordKind::Packet, route, start, outcome, recorded_bytes(packet));
+    }
+
+    /// Records a module name which started being resolved at `start`. Names longer than 255
+    /// bytes are too long to load, and aren't recorded.
+    pub fn resolve(&mut self, start: Instant, module: &str, handle: Option<ModuleHandle>) {
+        let route = handle.map_or(Route::Primary, |handle| handle.route);
+        let index = handle.map(|handle| u64::from(handle.index));
+        self.record(RecordKind::Resolve, route, start, index, module.as_bytes());
+    }
+
+    /// Records the data moved by the push or pull that was just recorded, if payloads are
+    /// being recorded.
+    pub fn payload(&mut self, data: &[u8]) {
+        if self.failed || !self.payloads { return; }
+
+        let mut prefix = [0u8; PREFIX_SIZE];
+        prefix[0] = RecordKind::Payload as u8;
+        prefix[2] = 1;
+        prefix[4..12].copy_from_slice(&micros(self.epoch.elapsed()).to_le_bytes());
+        prefix[16..24].copy_from_slice(&(data.len() as u64).to_le_bytes());
+
+        let written = self.out.write_all(&prefix).and_then(|_| self.out.write_all(data));
+        if let Err(e) = written {
+            warn!("failed to write trace, stopping: {}", e);
+            self.failed = true;
+        }
+    }
+
+    /// Writes any buffered records to the capture.
+    pub fn flush(&mut self) -> io::Result<()> {
+        self.out.flush()
+    }
+}
+
+impl Drop for Tracer {
+    fn drop(&mut self) {
+        let _ = self.flush();
+    }
+}
+
+/// Reads the records of a capture written by a `Tracer`.
+pub struct CaptureReader<R: Read> {
+    inner: R,
+    epoch: u64,
+}
+
+impl<R: Read> CaptureReader<R> {
+    /// Reads the header of a capture.
+    pub fn new(mut inner: R) -> io::Result<CaptureReader<R>> {
+        let mut header = [0u8; HEADER_SIZE];
+        inner.read_exact(&mut header)?;
+
+        let mut version = [0u8; 2];
+        version.copy_from_slice(&header[8..10]);
+        if &header[..8] != CAPTURE_MAGIC || u16::from_le_bytes(version) != CAPTURE_VERSION {
+            return Err(io::Error::new(io::ErrorKind::InvalidData, "not a Flipper capture"));
+        }
+
+        let mut epoch = [0u8; 8];
+        epoch.copy_from_slice(&header[12..20]);
+        Ok(CaptureReader { inner, epoch: u64::from_le_bytes(epoch) })
+    }
+
+    /// When the capture started, in µs since the Unix epoch.
+    pub fn epoch(&self) -> u64 {
+        self.epoch
+    }
+
+    fn read_record(&mut self) -> io::Result<Option<Record>> {
+        let mut prefix = [0u8; PREFIX_SIZE];
+        match self.inner.read(&mut prefix[..1])? {
+            0 => return Ok(None),
+            _ => self.inner.read_exact(&mut prefix[1..])?,
+        }
+
+        let invalid = |what| io::Error::new(io::ErrorKind::InvalidData, what);
+        let kind = match prefix[0] {
+            0 => RecordKind::Packet,
+            1 => RecordKind::Resolve,
+            2 => RecordKind::Payload,
+            _ => return Err(invalid("unknown record kind")),
+        };
+        let route = match prefix[1] {
+            0 => Route::Primary,
+            1 => Route::Coprocessor,
+            _ => return Err(invalid("unknown route")),
+        };
+
+        let mut timestamp = [0u8; 8];
+        let mut latency = [0u8; 4];
+        let mut value = [0u8; 8];
+        timestamp.copy_from_slice(&prefix[4..12]);
+        latency.copy_from_slice(&prefix[12..16]);
+        value.copy_from_slice(&prefix[16..24]);
+
+        let value = u64::from_le_bytes(value);
+        let len = match kind {
+            RecordKind::Payload if value > MAX_PAYLOAD => return Err(invalid("payload too large")),
+            RecordKind::Payload => value as usize,
+            _ => prefix[3] as usize,
+        };
+        let mut data = vec![0u8; len];
+        self.inner.read_exact(&mut data)?;
+
+        Ok(Some(Record {
+            kind,
+            route,
+            ok: prefix[2] != 0,
+            timestamp: u64::from_le_bytes(timestamp),
+            latency: u32::from_le_bytes(latency),
+            value,
+            data,
+        }))
+    }
+}
+
+impl<R: Read> Iterator for CaptureReader<R> {
+    type Item = io::Result<Record>;
+
+    fn next(&mut self) -> Option<io::Result<Record>> {
+        self.read_record().transpose()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::runtime::__private::call_packet;
+    use crate::runtime::protocol::LfType;
+
+    #[test]
+    fn test_capture_round_trip() {
+        let path = env::temp_dir().join(format!("flipper-trace-{}.trace", std::process::id()));
+        let mut tracer = Tracer::create(&path).unwrap();
+
+        let start = Instant::now();
+        let handle = ModuleHandle { index: 3, route: Route::Coprocessor };
+        tracer.resolve(start, "led", Some(handle));
+
+        let mut packet = call_packet(1, LfType::lf_uint32, 0x0, 1, 1);
+        unsafe { packet.body.call.module = 3; }
+        packet.seal();
+        tracer.packet(start, Route::Coprocessor, &packet, Some(42));
+        tracer.resolve(start, "missing", None);
+        // A name too long for its record is left out rather than cut short.
+        tracer.resolve(start, &"x".repeat(300), None);
+        tracer.payload(&[1, 2, 3]);
+        let mut tracer = tracer.with_payloads(true);
+        tracer.payload(&[0xAA; 300]);
+        drop(tracer);
+
+        let reader = CaptureReader::new(File::open(&path).unwrap()).unwrap();
+        assert!(reader.epoch() > 0);
+        let records: Vec<Record> = reader.collect::<io::Result<_>>().unwrap();
+        std::fs::remove_file(&path).unwrap();
+
+        assert_eq!(records.len(), 4);
+        assert_eq!(records[0].kind, RecordKind::Resolve);
+        assert_eq!(records[0].name(), Some("led"));
+        assert_eq!(records[0].route, Route::Coprocessor);
+        assert_eq!((records[0].ok, records[0].value), (true, 3));
+
+        assert_eq!(records[1].kind, RecordKind::Packet);
+        assert_eq!(records[1].data, recorded_bytes(&packet));
+        assert_eq!(records[1].call(), Some((3, 1)));
+        assert_eq!((records[1].ok, records[1].value), (true, 42));
+
+        assert_eq!(records[2].name(), Some("missing"));
+        assert!(!records[2].ok);
+
+        // Payloads are only recorded once enabled, and may be longer than a packet.
+        assert_eq!(records[3].kind, RecordKind::Payload);
+        assert_eq!(records[3].data, vec![0xAA; 300]);
+    }
+
+    #[test]
+    fn test_numbered_path() {
+        assert_eq!(numbered_path(Path::new("out/session.trace"), 0), Path::new("out/session.trace"));
+        assert_eq!(numbered_path(Path::new("out/session.trace"), 2), Path::new("out/session.2.trace"));
+        assert_eq!(numbered_path(Path::new("session"), 1), Path::new("session.1"));
+    }
+}
@@ -17,14 +17,127 @@ public struct FlipperError: Error, CustomStringConvertible {
     }
 }
 
+/// Copies `value` into a call's argument area at `offset`, which need not be aligned.
+public func lfPack<T>(_ value: T, into argv: UnsafeMutableRawPointer, at offset: Int) {
+    withUnsafeBytes(of: value) { bytes in
+        (argv + offset).copyMemory(from: bytes.baseAddress!, byteCount: bytes.count)
+    }
+}
+
+/// The module's index on the device it was last resolved on.
+final class ModuleHandle {
+    var raw = _lf_handle()
+}
+
 public struct Module {
     let device: UnsafeMutablePointer<_lf_device>?
     let name: String
+    let handle = ModuleHandle()
     
     init(name: String, device: Flipper) {
         self.name = name
         self.device = device.device
     }
+
+    /// Looks up the module's index on its device, unless that was already done.
+    func resolve() throws {
+        name.withCString { bytes in
+            _ = lf_resolve(device, bytes, &handle.raw)
+        }
+        if let err = FlipperError.current {
+            throw err
+        }
+    }
+
+    /// Prepares a call packet whose arguments `pack` copies into the returned argument area.
+    func prepare(
+        _ packet: inout _fmr_packet,
+        index: UInt8,
+        ret: LFType,
+        argt: UInt32,
+        argc: UInt8,
+        argvLength: UInt8
+        ) throws -> UnsafeMutableRawPointer {
+        guard let argv = lf_call_init(&packet, index, ret.rawValue, argt, argc, argvLength) else {
+            throw FlipperError.current ?? FlipperError(message: "failed to prepare call")
+        }
+        return UnsafeMutableRawPointer(argv)
+    }
+
+    public func invoke(
+        index: UInt8,
+        argt: UInt32,
+        argc: UInt8,
+        argvLength: UInt8,
+        pack: (UnsafeMutableRawPointer) -> Void
+        ) throws {
+        _ = try invoke(index: index, argt: argt, argc: argc, argvLength: argvLength, pack: pack) as LFVoid
+    }
+
+    /// Performs a call whose `argt` word and argument layout are known ahead of time.
+    /// `pack` copies each argument into the packet with `lfPack`.
+    public func invoke<Ret: LFReturnable>(
+        index: UInt8,
+        argt: UInt32,
+        argc: UInt8,
+        argvLength: UInt8,
+        pack: (UnsafeMutableRawPointer) -> Void
+        ) throws -> Ret {
+        try resolve()
+        var packet = _fmr_packet()
+        var ret = lf_return_t()
+        pack(try prepare(&packet, index: index, ret: Ret.lfType, argt: argt, argc: argc, argvLength: argvLength))
+        lf_invoke_packet(device, &handle.raw, &packet, &ret)
+        if let err = FlipperError.current {
+            throw err
+        }
+        return Ret.init(lfReturn: ret)
+    }
+
+    public func invokeBatch(
+        index: UInt8,
+        argt: UInt32,
+        argc: UInt8,
+        argvLength: UInt8,
+        count: Int,
+        pack: (Int, UnsafeMutableRawPointer) -> Void
+        ) throws {
+        _ = try invokeBatch(index: index, argt: argt, argc: argc, argvLength: argvLength,
+                            count: count, pack: pack) as [LFVoid]
+    }
+
+    /// Performs `count` calls to the same function, sending up to `LF_BATCH_MAX` of them
+    /// back to back before collecting their results. `pack` copies the arguments of the
+    /// call with the given index.
+    public func invokeBatch<Ret: LFReturnable>(
+        index: UInt8,
+        argt: UInt32,
+        argc: UInt8,
+        argvLength: UInt8,
+        count: Int,
+        pack: (Int, UnsafeMutableRawPointer) -> Void
+        ) throws -> [Ret] {
+        try resolve()
+        var results: [Ret] = []
+        results.reserveCapacity(count)
+        var packets = [_fmr_packet](repeating: _fmr_packet(), count: Int(LF_BATCH_MAX))
+        var retvals = [lf_return_t](repeating: 0, count: Int(LF_BATCH_MAX))
+        var done = 0
+        while done < count {
+            let n = min(count - done, packets.count)
+            for i in 0..<n {
+                pack(done + i, try prepare(&packets[i], index: index, ret: Ret.lfType, argt: argt,
+                                           argc: argc, argvLength: argvLength))
+            }
+            lf_invoke_packed(device, &handle.raw, &packets, &retvals, n)
+            if let err = FlipperError.current {
+                throw err
+            }
+            results.append(contentsOf: retvals[0..<n].map { Ret(lfReturn: $0) })
+            done += n
+        }
+        return results
+    }
     
     public func invoke(index: UInt8, args: [LFArg]) throws {
         _ = try invoke(index: index, args: args) as LFVoid
@@ -0,0 +1,274 @@
+/* clock_gettime, nanosleep, strdup and strtok_r are POSIX, not C99. */
+#define _POSIX_C_SOURCE 200809L
+
+#include "libflipper.h"
+#include "linkemu.h"
+#include <errno.h>
+#include <time.h>
+
+const struct _lf_link_profile lf_link_uart_115200 = { .bandwidth = 115200, .symbol_bits = 10 };
+const struct _lf_link_profile lf_link_usb_full_speed = { .bandwidth = 19 * 64 * 8 * 1000, .symbol_bits = 8, .frame_us = 1000 };
+
+/* The profile fields that can be named in a profile string. */
+static const struct {
+    const char *name;
+    size_t offset;
+} lf_link_fields[] = {
+    { "bandwidth", offsetof(struct _lf_link_profile, bandwidth) },
+    { "symbol_bits", offsetof(struct _lf_link_profile, symbol_bits) },
+    { "frame_us", offsetof(struct _lf_link_profile, frame_us) },
+    { "latency_us", offsetof(struct _lf_link_profile, latency_us) },
+    { "jitter_us", offsetof(struct _lf_link_profile, jitter_us) },
+    { "loss_ppm", offsetof(struct _lf_link_profile, loss_ppm) },
+    { "reorder_ppm", offsetof(struct _lf_link_profile, reorder_ppm) },
+    { "seed", offsetof(struct _lf_link_profile, seed) },
+};
+
+static uint64_t lf_link_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* xorshift32, which is plenty for choosing which transfers to disturb. */
+static uint32_t lf_link_random(struct _lf_link_context *context) {
+    uint32_t x = context->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return context->rng = x;
+}
+
+static bool lf_link_chance(struct _lf_link_context *context, uint32_t ppm) {
+    return ppm && lf_link_random(context) % 1000000 < ppm;
+}
+
+/* Waits until a transfer of 'length' bytes over one direction of the link would have arrived. */
+static void lf_link_transfer(struct _lf_link_context *context, uint64_t *idle, uint32_t length) {
+    struct _lf_link_profile *profile = &context->profile;
+    uint64_t now = lf_link_now();
+
+    /* A transfer can't start until the previous one in the same direction has been clocked out. */
+    uint64_t done = (*idle > now) ? *idle : now;
+    if (profile->bandwidth) {
+        uint32_t bits = profile->symbol_bits ? profile->symbol_bits : 8;
+        done += ((uint64_t)length * bits * 1000000 + profile->bandwidth - 1) / profile->bandwidth;
+    }
+    *idle = done;
+
+    uint64_t arrival = done + profile->latency_us;
+    if (profile->jitter_us) arrival += lf_link_random(context) % (profile->jitter_us + 1);
+    if (profile->frame_us) arrival = (arrival + profile->frame_us - 1) / profile->frame_us * profile->frame_us;
+
+    if (arrival <= now) return;
+    context->stats.delay_us += arrival - now;
+    struct timespec delay = { .tv_sec = (arrival - now) / 1000000, .tv_nsec = (arrival - now) % 1000000 * 1000 };
+    while (nanosleep(&delay, &delay) && errno == EINTR)
+        ;
+}
+
+/* Delivers the write that was held back, if there is one. */
+static int lf_link_deliver_held(struct _lf_link_context *context) {
+    if (!context->held) return lf_success;
+
+    uint8_t *held = context->held;
+    context->held = NULL;
+    lf_link_transfer(context, &context->tx_idle, context->held_length);
+    int e = context->inner->write(context->inner, held, context->held_length);
+    free(held);
+    return e;
+}
+
+int lf_link_read(struct _lf_device *device, void *dst, uint32_t length) {
+    lf_assert(device, E_NULL, "invalid device");
+
+    struct _lf_link_context *context = (struct _lf_link_context *)device->_ep_ctx;
+    lf_assert(context, E_NULL, "invalid context");
+
+    /* Anything still held back is sent before waiting for an answer, since the answer may depend on it. */
+    lf_assert(lf_link_deliver_held(context) == lf_success, E_COMMUNICATION, "Failed to deliver held write to '%s'.",
+              device->name);
+    context->stats.reads++;
+
+    /* The request never arrived, so no answer will either. */
+    if (context->lost) {
+        context->lost = false;
+        lf_link_transfer(context, &context->rx_idle, length);
+        lf_assert(false, E_TIMEOUT, "Timed out reading from '%s' across the emulated link.", device->name);
+    }
+
+    lf_assert(context->inner->read(context->inner, dst, length) == lf_success, E_COMMUNICATION,
+              "Failed to read from '%s' across the emulated link.", device->name);
+    lf_link_transfer(context, &context->rx_idle, length);
+    context->stats.bytes += length;
+
+    if (lf_link_chance(context, context->profile.loss_ppm)) {
+        context->stats.lost++;
+        lf_assert(false, E_TIMEOUT, "Timed out reading from '%s' across the emulated link.", device->name);
+    }
+    return lf_success;
+
+fail:
+    return lf_error;
+}
+
+int lf_link_write(struct _lf_device *device, void *src, uint32_t length) {
+    lf_assert(device, E_NULL, "invalid device");
+
+    struct _lf_link_context *context = (struct _lf_link_context *)device->_ep_ctx;
+    lf_assert(context, E_NULL, "invalid context");
+    context->stats.writes++;
+    context->stats.bytes += length;
+
+    /* Once part of an exchange is lost, the device can't make sense of the rest of it. */
+    if (context->lost || lf_link_chance(context, context->profile.loss_ppm)) {
+        if (!context->lost) context->stats.lost++;
+        context->lost = true;
+        lf_link_transfer(context, &context->tx_idle, length);
+        return lf_success;
+    }
+
+    if (!context->held && lf_link_chance(context, context->profile.reorder_ppm)) {
+        context->held = malloc(length);
+        lf_assert(context->held, E_MALLOC, "Failed to allocate memory to hold write.");
+        memcpy(context->held, src, length);
+        context->held_length = length;
+        context->stats.reordered++;
+        return lf_success;
+    }
+
+    lf_link_transfer(context, &context->tx_idle, length);
+    lf_assert(context->inner->write(context->inner, src, length) == lf_success, E_COMMUNICATION,
+              "Failed to write to '%s' across the emulated link.", device->name);
+    lf_assert(lf_link_deliver_held(context) == lf_success, E_COMMUNICATION, "Failed to deliver held write to '%s'.",
+              device->name);
+    return lf_success;
+
+fail:
+    return lf_error;
+}
+
+int lf_link_release(void *_device) {
+    struct _lf_device *device = _device;
+    lf_assert(device, E_NULL, "invalid device");
+
+    struct _lf_link_context *context = device->_ep_ctx;
+    lf_assert(context, E_NULL, "invalid context");
+
+    struct _lf_device *inner = context->inner;
+    if (inner->release) inner->release(inner);
+    lf_device_release(inner);
+    free(context->held);
+    free(context);
+    device->_ep_ctx = NULL;
+    return lf_success;
+
+fail:
+    return lf_error;
+}
+
+int lf_link_profile_parse(const char *spec, struct _lf_link_profile *profile) {
+    char *copy = NULL;
+    lf_assert(spec, E_NULL, "invalid profile");
+    lf_assert(profile, E_NULL, "invalid profile");
+
+    copy = strdup(spec);
+    lf_assert(copy, E_MALLOC, "Failed to allocate memory to parse link profile.");
+    memset(profile, 0, sizeof(*profile));
+
+    char *save = NULL;
+    for (char *field = strtok_r(copy, ",", &save); field; field = strtok_r(NULL, ",", &save)) {
+        if (!strcmp(field, "uart")) {
+            *profile = lf_link_uart_115200;
+            continue;
+        } else if (!strcmp(field, "usb")) {
+            *profile = lf_link_usb_full_speed;
+            continue;
+        }
+
+        char *value = strchr(field, '=');
+        lf_assert(value, E_CONFIGURATION, "Expected 'field=value' in link profile, found '%s'.", field);
+        *value++ = '\0';
+
+        char *end = NULL;
+        unsigned long number = strtoul(value, &end, 10);
+        lf_assert(*value && !*end && number <= UINT32_MAX, E_CONFIGURATION, "Invalid value for '%s' in link profile.",
+                  field);
+
+        size_t i;
+        for (i = 0; i < sizeof(lf_link_fields) / sizeof(*lf_link_fields); i++) {
+            if (!strcmp(field, lf_link_fields[i].name)) break;
+        }
+        lf_assert(i < sizeof(lf_link_fields) / sizeof(*lf_link_fields), E_CONFIGURATION,
+                  "Unknown field '%s' in link profile.", field);
+        *(uint32_t *)((uint8_t *)profile + lf_link_fields[i].offset) = (uint32_t)number;
+    }
+
+    free(copy);
+    return lf_success;
+
+fail:
+    free(copy);
+    return lf_error;
+}
+
+struct _lf_device *lf_link_device_create(struct _lf_device *inner, const struct _lf_link_profile *profile) {
+    struct _lf_link_context *context = NULL;
+    struct _lf_device *device = NULL;
+    lf_assert(inner, E_NULL, "invalid device");
+    lf_assert(profile, E_NULL, "invalid profile");
+
+    device = lf_device_create(lf_link_read, lf_link_write, lf_link_release);
+    lf_assert(device, E_ENDPOINT, "Failed to create device");
+    device->_ep_ctx = calloc(1, sizeof(struct _lf_link_context));
+    context = (struct _lf_link_context *)device->_ep_ctx;
+    lf_assert(context, E_NULL, "Failed to allocate memory for context");
+
+    context->inner = inner;
+    context->profile = *profile;
+    /* xorshift never leaves zero, so it can't be seeded with it. */
+    context->rng = profile->seed ? profile->seed : 0x6c696e6b;
+
+    /* The wrapper stands in for the inner device from now on. */
+    if (inner->name) device->name = strdup(inner->name);
+    device->version = inner->version;
+    device->type = inner->type;
+    device->modules = inner->modules;
+    inner->modules = NULL;
+    return device;
+
+fail:
+    if (device) lf_device_release(device);
+    return NULL;
+}
+
+struct _lf_device *lf_link_device_from_env(struct _lf_device *inner) {
+    struct _lf_link_profile profile;
+    const char *spec = getenv(LF_LINK_ENV);
+    if (!spec || !inner) return inner;
+
+    struct _lf_device *device = NULL;
+    lf_assert(lf_link_profile_parse(spec, &profile) == lf_success, E_CONFIGURATION, "Invalid %s '%s'.", LF_LINK_ENV,
+              spec);
+    device = lf_link_device_create(inner, &profile);
+    lf_assert(device, E_ENDPOINT, "Failed to emulate link.");
+    return device;
+
+fail:
+    /* The inner device is only handed over on success, so it has to be released here. */
+    if (inner->release) inner->release(inner);
+    lf_device_release(inner);
+    return NULL;
+}
+
+const struct _lf_link_stats *lf_link_stats(struct _lf_device *device) {
+    lf_assert(device, E_NULL, "invalid device");
+    lf_assert(device->read == lf_link_read, E_ENDPOINT, "Device '%s' is not behind an emulated link.", device->name);
+
+    struct _lf_link_context *context = (struct _lf_link_context *)device->_ep_ctx;
+    lf_assert(context, E_NULL, "invalid context");
+    return &context->stats;
+
+fail:
+    return NULL;
+}
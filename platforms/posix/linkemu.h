@@ -0,0 +1,76 @@
+/* linkemu.h - An endpoint that imposes the behavior of a slower, lossier link on another endpoint. */
+
+#ifndef __lf_linkemu_h__
+#define __lf_linkemu_h__
+
+/* The environment variable from which a link profile can be read, e.g. "uart,jitter_us=200,loss_ppm=1000". */
+#define LF_LINK_ENV "FLIPPER_LINK"
+
+/* Describes the link to emulate. Zero in any field disables that effect. */
+struct _lf_link_profile {
+    /* The bits per second the link carries. */
+    uint32_t bandwidth;
+    /* The bits on the wire per byte transferred, e.g. 10 for UART 8N1 framing. */
+    uint32_t symbol_bits;
+    /* Transfers complete on a frame boundary of this many microseconds, e.g. 1000 for full-speed USB. */
+    uint32_t frame_us;
+    /* The fixed delay, in microseconds, before a transfer arrives. */
+    uint32_t latency_us;
+    /* The most random delay, in microseconds, added to the latency of each transfer. */
+    uint32_t jitter_us;
+    /* The chance, in parts per million, that a transfer is lost. */
+    uint32_t loss_ppm;
+    /* The chance, in parts per million, that a write arrives after the write that follows it. */
+    uint32_t reorder_ppm;
+    /* Seeds the random effects, so that runs can be repeated. */
+    uint32_t seed;
+};
+
+/* A UART at 115200 baud with 8N1 framing. */
+extern const struct _lf_link_profile lf_link_uart_115200;
+/* Bulk transfers over full-speed USB, at most 19 packets of 64 bytes per 1ms frame. */
+extern const struct _lf_link_profile lf_link_usb_full_speed;
+
+/* What the link has done so far. */
+struct _lf_link_stats {
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t lost;
+    uint32_t reordered;
+    uint64_t bytes;
+    /* The total time, in microseconds, the link has delayed transfers by. */
+    uint64_t delay_us;
+};
+
+struct _lf_link_context {
+    /* The device whose endpoint carries the traffic. */
+    struct _lf_device *inner;
+    struct _lf_link_profile profile;
+    struct _lf_link_stats stats;
+    uint32_t rng;
+    /* When each direction of the link is next idle, in microseconds. */
+    uint64_t tx_idle;
+    uint64_t rx_idle;
+    /* A write held back to be delivered after the next one. */
+    uint8_t *held;
+    uint32_t held_length;
+    /* Set once a write is lost, until the read that would have answered it. */
+    bool lost;
+};
+
+int lf_link_read(struct _lf_device *device, void *dst, uint32_t length);
+int lf_link_write(struct _lf_device *device, void *src, uint32_t length);
+int lf_link_release(void *device);
+
+/* Parses a profile of the form "[uart|usb][,field=value]...", where the fields are those of the profile. */
+int lf_link_profile_parse(const char *spec, struct _lf_link_profile *profile);
+
+/* Wraps a device so that its traffic crosses an emulated link. The new device takes ownership of the inner one. */
+struct _lf_device *lf_link_device_create(struct _lf_device *inner, const struct _lf_link_profile *profile);
+/* Wraps a device using the profile in LF_LINK_ENV, or returns it unchanged if the variable isn't set. The inner
+   device is released if it can't be wrapped. */
+struct _lf_device *lf_link_device_from_env(struct _lf_device *inner);
+
+const struct _lf_link_stats *lf_link_stats(struct _lf_device *device);
+
+#endif
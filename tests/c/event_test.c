@@ -0,0 +1,36 @@
+/* event_test tests event flags */
+
+#include <flipper/flipper.h>
+#include <tests.h>
+
+#define RX (1 << 0)
+#define TX (1 << 1)
+#define ERR (1 << 2)
+
+int event_test(void) {
+
+    struct _lf_event event = { 0 };
+
+    /* Nothing is ready until a flag is set. */
+    lf_assert(!lf_event_ready(&event, RX | TX, false), E_UNIMPLEMENTED, "Expected no flags to be ready.");
+    lf_assert(!lf_event_take(&event, RX | TX, false), E_UNIMPLEMENTED, "Expected nothing to take.");
+
+    /* A wait for any flag takes the flags of its mask that are set, and leaves the others. */
+    lf_event_set(&event, RX | ERR);
+    lf_assert(lf_event_take(&event, RX | TX, false) == RX, E_UNIMPLEMENTED, "Expected to take RX.");
+    lf_assert(event.flags == ERR, E_UNIMPLEMENTED, "Expected ERR to be left set.");
+
+    /* A wait for every flag takes nothing until they are all set. */
+    lf_event_set(&event, RX);
+    lf_assert(!lf_event_take(&event, RX | TX, true), E_UNIMPLEMENTED, "Expected a partial set not to be taken.");
+    lf_assert(event.flags == (RX | ERR), E_UNIMPLEMENTED, "Expected a failed take to leave the flags.");
+    lf_event_set(&event, TX);
+    lf_assert(lf_event_take(&event, RX | TX, true) == (RX | TX), E_UNIMPLEMENTED, "Expected to take RX and TX.");
+
+    /* Clearing returns the flags that were set. */
+    lf_assert(lf_event_clear(&event, ERR) == ERR && !event.flags, E_UNIMPLEMENTED, "Expected ERR to be cleared.");
+
+    return lf_success;
+fail:
+    return lf_error;
+}
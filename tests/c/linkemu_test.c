@@ -0,0 +1,97 @@
+/* linkemu_test tests the link emulator */
+
+/* clock_gettime is POSIX, not C99. */
+#define _POSIX_C_SOURCE 200809L
+
+#include <flipper/flipper.h>
+#include "posix/linkemu.h"
+#include <time.h>
+
+/* A loopback endpoint that reads back what was written to it. */
+static uint8_t loop[64];
+static uint32_t loop_length;
+
+static int loop_write(struct _lf_device *device, void *src, uint32_t length) {
+    lf_assert(loop_length + length <= sizeof(loop), E_OVERFLOW, "Loopback overflowed.");
+    memcpy(loop + loop_length, src, length);
+    loop_length += length;
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+static int loop_read(struct _lf_device *device, void *dst, uint32_t length) {
+    lf_assert(length <= loop_length, E_UNDERFLOW, "Loopback underflowed.");
+    memcpy(dst, loop, length);
+    memmove(loop, loop + length, loop_length - length);
+    loop_length -= length;
+    return lf_success;
+fail:
+    return lf_error;
+}
+
+static uint64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int linkemu_test(void) {
+
+    /* Profiles start from a preset and override its fields. */
+    struct _lf_link_profile profile;
+    lf_assert(lf_link_profile_parse("uart,latency_us=300,seed=7", &profile), E_UNIMPLEMENTED, "Failed to parse.");
+    lf_assert(profile.bandwidth == 115200 && profile.symbol_bits == 10, E_UNIMPLEMENTED, "Preset was not applied.");
+    lf_assert(profile.latency_us == 300 && profile.seed == 7, E_UNIMPLEMENTED, "Fields were not applied.");
+    lf_assert(!lf_link_profile_parse("latency=300", &profile) && lf_error_get() != E_OK, E_UNIMPLEMENTED,
+              "Unknown field was accepted.");
+    lf_error_set(E_OK);
+    lf_assert(!lf_link_profile_parse("latency_us=fast", &profile) && lf_error_get() != E_OK, E_UNIMPLEMENTED,
+              "Invalid value was accepted.");
+    lf_error_set(E_OK);
+
+    /* 64 bytes at 115200 baud, 10 bits to the byte, take at least 5.5ms to write. */
+    struct _lf_device *inner = lf_device_create(loop_read, loop_write, NULL);
+    lf_assert(inner, E_UNIMPLEMENTED, "Failed to create loopback.");
+    struct _lf_device *device = lf_link_device_create(inner, &lf_link_uart_115200);
+    lf_assert(device, E_UNIMPLEMENTED, "Failed to create link.");
+
+    uint8_t packet[64] = { 0 };
+    uint64_t start = now_us();
+    lf_assert(device->write(device, packet, sizeof(packet)), E_UNIMPLEMENTED, "Failed to write across link.");
+    lf_assert(now_us() - start >= 5555, E_UNIMPLEMENTED, "Write was faster than the link allows.");
+    lf_assert(device->read(device, packet, sizeof(packet)), E_UNIMPLEMENTED, "Failed to read across link.");
+    device->release(device);
+    lf_device_release(device);
+
+    /* A write that is always reordered arrives after the next one. */
+    inner = lf_device_create(loop_read, loop_write, NULL);
+    device = lf_link_device_create(inner, &(struct _lf_link_profile){ .reorder_ppm = 1000000 });
+    lf_assert(device, E_UNIMPLEMENTED, "Failed to create link.");
+
+    uint8_t first = 1, second = 2, got[2];
+    lf_assert(device->write(device, &first, 1), E_UNIMPLEMENTED, "Failed to write first byte.");
+    lf_assert(device->write(device, &second, 1), E_UNIMPLEMENTED, "Failed to write second byte.");
+    lf_assert(device->read(device, got, 2), E_UNIMPLEMENTED, "Failed to read reordered bytes.");
+    lf_assert(got[0] == 2 && got[1] == 1, E_UNIMPLEMENTED, "Writes were not reordered.");
+    lf_assert(lf_link_stats(device)->reordered == 1, E_UNIMPLEMENTED, "Reorder was not counted.");
+    device->release(device);
+    lf_device_release(device);
+
+    /* A lost write is never answered. */
+    inner = lf_device_create(loop_read, loop_write, NULL);
+    device = lf_link_device_create(inner, &(struct _lf_link_profile){ .loss_ppm = 1000000 });
+    lf_assert(device, E_UNIMPLEMENTED, "Failed to create link.");
+
+    lf_assert(device->write(device, &first, 1), E_UNIMPLEMENTED, "Failed to write across lossy link.");
+    lf_assert(loop_length == 0, E_UNIMPLEMENTED, "Lost write reached the endpoint.");
+    lf_assert(!device->read(device, got, 1) && lf_error_get() != E_OK, E_UNIMPLEMENTED, "Lost write was answered.");
+    lf_error_set(E_OK);
+    lf_assert(lf_link_stats(device)->lost == 1, E_UNIMPLEMENTED, "Loss was not counted.");
+    device->release(device);
+    lf_device_release(device);
+
+    return lf_success;
+fail:
+    return lf_error;
+}
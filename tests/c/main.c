@@ -4,11 +4,17 @@
 
 extern int dyld_test(void);
 extern int ll_test(void);
+extern int linkemu_test(void);
+extern int queue_test(void);
+extern int event_test(void);
 
 int main(int argc, char *argv[]) {
 
     lf_assert(dyld_test(), E_TEST, "Failed dyld_test.");
     lf_assert(ll_test(), E_TEST, "Failed ll_test.");
+    lf_assert(linkemu_test(), E_TEST, "Failed linkemu_test.");
+    lf_assert(queue_test(), E_TEST, "Failed queue_test.");
+    lf_assert(event_test(), E_TEST, "Failed event_test.");
 
     return EXIT_SUCCESS;
 fail:
@@ -0,0 +1,76 @@
+/* queue_test tests the lock-free queues */
+
+#include <flipper/flipper.h>
+#include <tests.h>
+#include <pthread.h>
+
+#define PRODUCERS 4
+#define PUSHES 2000
+
+/* A queue item, large enough that a torn copy would show. */
+struct item {
+    uint32_t producer;
+    uint32_t value;
+    uint8_t check;
+};
+
+static struct _lf_mpsc shared;
+static uint32_t shared_storage[LF_MPSC_STORAGE(64, sizeof(struct item)) / sizeof(uint32_t)];
+
+static void *producer(void *arg) {
+    struct item item = { (uint32_t)(uintptr_t)arg, 0, 0 };
+    for (item.value = 0; item.value < PUSHES; item.value++) {
+        item.check = (uint8_t)(item.producer ^ item.value);
+        while (!lf_mpsc_push(&shared, &item));
+    }
+    return NULL;
+}
+
+int queue_test(void) {
+
+    /* Capacities must be powers of two. */
+    uint32_t spsc_storage[LF_SPSC_STORAGE(4, sizeof(uint32_t)) / sizeof(uint32_t)];
+    struct _lf_spsc spsc;
+    lf_assert(!lf_spsc_init(&spsc, spsc_storage, sizeof(uint32_t), 3), E_UNIMPLEMENTED, "Expected a capacity of 3 to be refused.");
+    lf_assert(lf_spsc_init(&spsc, spsc_storage, sizeof(uint32_t), 4), E_UNIMPLEMENTED, "Failed to create a queue.");
+
+    /* Fill and drain the queue a few times over, so that its positions wrap around the storage. */
+    uint32_t next = 0, expected = 0, value;
+    for (int round = 0; round < 3; round++) {
+        while (lf_spsc_push(&spsc, &next)) next++;
+        lf_assert(lf_spsc_count(&spsc) == 4, E_UNIMPLEMENTED, "Expected a full queue to hold 4 items.");
+        lf_assert(!lf_spsc_pop(&spsc, &value) || value == expected++, E_UNIMPLEMENTED, "Items popped out of order.");
+        lf_assert(lf_spsc_push(&spsc, &next) && next++, E_UNIMPLEMENTED, "Expected room after a pop.");
+        while (lf_spsc_pop(&spsc, &value)) {
+            lf_assert(value == expected++, E_UNIMPLEMENTED, "Items popped out of order.");
+        }
+    }
+    lf_assert(expected == next && !lf_spsc_count(&spsc), E_UNIMPLEMENTED, "Expected every item to be popped.");
+
+    /* A full MPSC queue refuses pushes, and an empty one pops nothing. */
+    struct item item = { 0, 0, 0 };
+    lf_assert(lf_mpsc_init(&shared, shared_storage, sizeof(struct item), 64), E_UNIMPLEMENTED, "Failed to create a queue.");
+    for (int i = 0; i < 64; i++) {
+        lf_assert(lf_mpsc_push(&shared, &item), E_UNIMPLEMENTED, "Expected room in the queue.");
+    }
+    lf_assert(!lf_mpsc_push(&shared, &item), E_UNIMPLEMENTED, "Expected a full queue to refuse a push.");
+    while (lf_mpsc_pop(&shared, &item));
+    lf_assert(!lf_mpsc_pop(&shared, &item), E_UNIMPLEMENTED, "Expected an empty queue.");
+
+    /* Producers racing to push each see their own items popped whole and in order. */
+    pthread_t threads[PRODUCERS];
+    uint32_t seen[PRODUCERS] = { 0 }, popped = 0;
+    for (uintptr_t i = 0; i < PRODUCERS; i++) pthread_create(&threads[i], NULL, producer, (void *)i);
+    while (popped < PRODUCERS * PUSHES) {
+        if (!lf_mpsc_pop(&shared, &item)) continue;
+        lf_assert(item.producer < PRODUCERS && item.check == (uint8_t)(item.producer ^ item.value), E_UNIMPLEMENTED,
+                  "Popped a torn item.");
+        lf_assert(item.value == seen[item.producer]++, E_UNIMPLEMENTED, "A producer's items were popped out of order.");
+        popped++;
+    }
+    for (int i = 0; i < PRODUCERS; i++) pthread_join(threads[i], NULL);
+
+    return lf_success;
+fail:
+    return lf_error;
+}